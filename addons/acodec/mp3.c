@@ -5,6 +5,7 @@
  */
 
 
+#define ALLEGRO_INTERNAL_UNSTABLE
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_acodec.h"
 #include "allegro5/allegro_audio.h"
@@ -25,6 +26,7 @@ typedef struct MP3FILE
 {
    mp3dec_t dec;
 
+   ALLEGRO_FILE *file;        /* kept open if file_buffer is borrowed */
    uint8_t* file_buffer;      /* encoded MP3 file */
    int64_t file_size;         /* in bytes */
    int64_t next_frame_offset; /* next frame offset, in bytes */
@@ -71,27 +73,36 @@ ALLEGRO_SAMPLE *_al_load_mp3_f(ALLEGRO_FILE *f)
 
    mp3dec_file_info_t info;
    ALLEGRO_SAMPLE *spl = NULL;
+   size_t borrowed_size;
+   const uint8_t *borrowed = al_fborrow(f, &borrowed_size);
 
-   /* Read our file size. */
-   int64_t filesize = al_fsize(f);
-   if (filesize == -1) {
-      ALLEGRO_WARN("Could not determine file size.\n");
-      return NULL;
+   if (borrowed) {
+      /* Decode straight from the file's own buffer. */
+      mp3dec_load_buf(&dec, borrowed, borrowed_size, &info, NULL, NULL);
+      al_fseek(f, borrowed_size, ALLEGRO_SEEK_CUR);
    }
+   else {
+      /* Read our file size. */
+      int64_t filesize = al_fsize(f);
+      if (filesize == -1) {
+         ALLEGRO_WARN("Could not determine file size.\n");
+         return NULL;
+      }
+
+      /* Allocate buffer and read all the file. */
+      uint8_t* mp3data = (uint8_t*)al_malloc(filesize);
+      size_t readbytes = al_fread(f, mp3data, filesize);
+      if (readbytes != (size_t)filesize) {
+         ALLEGRO_WARN("Failed to read file into memory.\n");
+         al_free(mp3data);
+         return NULL;
+      }
 
-   /* Allocate buffer and read all the file. */
-   uint8_t* mp3data = (uint8_t*)al_malloc(filesize);
-   size_t readbytes = al_fread(f, mp3data, filesize);
-   if (readbytes != (size_t)filesize) {
-      ALLEGRO_WARN("Failed to read file into memory.\n");
+      /* Decode the file contents, and copy to a new buffer. */
+      mp3dec_load_buf(&dec, mp3data, filesize, &info, NULL, NULL);
       al_free(mp3data);
-      return NULL;
    }
 
-   /* Decode the file contents, and copy to a new buffer. */
-   mp3dec_load_buf(&dec, mp3data, filesize, &info, NULL, NULL);
-   al_free(mp3data);
-
    if (info.buffer == NULL) {
       ALLEGRO_WARN("Could not decode MP3.\n");
       return NULL;
@@ -249,7 +260,10 @@ static void mp3_stream_close(ALLEGRO_AUDIO_STREAM *stream)
    _al_acodec_stop_feed_thread(stream);
 
    al_free(mp3file->frame_offsets);
-   al_free(mp3file->file_buffer);
+   if (mp3file->file)
+      al_fclose(mp3file->file);
+   else
+      al_free(mp3file->file_buffer);
    al_free(mp3file);
    stream->extra = NULL;
    stream->feed_thread = NULL;
@@ -259,22 +273,33 @@ ALLEGRO_AUDIO_STREAM *_al_load_mp3_audio_stream_f(ALLEGRO_FILE* f, size_t buffer
 {
    MP3FILE* mp3file = al_calloc(sizeof(MP3FILE), 1);
    mp3dec_init(&mp3file->dec);
-
-   /* Read our file size. */
-   mp3file->file_size = al_fsize(f);
-   if (mp3file->file_size == -1) {
-      ALLEGRO_WARN("Could not determine file size.\n");
-      goto failure;
+   size_t borrowed_size;
+   const uint8_t *borrowed = al_fborrow(f, &borrowed_size);
+   bool is_borrowed = (borrowed != NULL);
+
+   if (is_borrowed) {
+      /* Decode directly from the file's buffer.  It stays valid until the
+       * file is closed, which happens when the stream is destroyed.
+       */
+      mp3file->file_buffer = (uint8_t *)borrowed;
+      mp3file->file_size = borrowed_size;
    }
+   else {
+      /* Read our file size. */
+      mp3file->file_size = al_fsize(f);
+      if (mp3file->file_size == -1) {
+         ALLEGRO_WARN("Could not determine file size.\n");
+         goto failure;
+      }
 
-   /* Allocate buffer and read all the file. */
-   mp3file->file_buffer = (uint8_t*)al_malloc(mp3file->file_size);
-   size_t readbytes = al_fread(f, mp3file->file_buffer, mp3file->file_size);
-   if (readbytes != (size_t)mp3file->file_size) {
-      ALLEGRO_WARN("Failed to read file into memory.\n");
-      goto failure;
+      /* Allocate buffer and read all the file. */
+      mp3file->file_buffer = (uint8_t*)al_malloc(mp3file->file_size);
+      size_t readbytes = al_fread(f, mp3file->file_buffer, mp3file->file_size);
+      if (readbytes != (size_t)mp3file->file_size) {
+         ALLEGRO_WARN("Failed to read file into memory.\n");
+         goto failure;
+      }
    }
-   al_fclose(f);
 
    /* Go through all the frames, to build the offset table. */
    int frame_offset_capacity = 0;
@@ -323,6 +348,12 @@ ALLEGRO_AUDIO_STREAM *_al_load_mp3_audio_stream_f(ALLEGRO_FILE* f, size_t buffer
       goto failure;
    }
 
+   /* The caller closes the file if we fail, so only take it over now. */
+   if (is_borrowed)
+      mp3file->file = f;
+   else
+      al_fclose(f);
+
    stream->extra = mp3file;
    stream->feeder = mp3_stream_update;
    stream->unload_feeder = mp3_stream_close;
@@ -339,8 +370,8 @@ ALLEGRO_AUDIO_STREAM *_al_load_mp3_audio_stream_f(ALLEGRO_FILE* f, size_t buffer
    return stream;
 failure:
    al_free(mp3file->frame_offsets);
-   al_free(mp3file->file_buffer);
-   al_free(mp3file->frame_buffer);
+   if (!is_borrowed)
+      al_free(mp3file->file_buffer);
    al_free(mp3file);
    return NULL;
 }
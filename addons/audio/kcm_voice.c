@@ -10,6 +10,8 @@
 
 #include <stdio.h>
 
+#define ALLEGRO_INTERNAL_UNSTABLE
+
 #include "allegro5/allegro_audio.h"
 #include "allegro5/internal/aintern_audio.h"
 #include "allegro5/internal/aintern_audio_cfg.h"
@@ -81,7 +83,7 @@ ALLEGRO_VOICE *al_create_voice(unsigned int freq,
    voice->chan_conf = chan_conf;
    voice->frequency = freq;
 
-   voice->mutex = al_create_mutex();
+   voice->mutex = al_create_mutex_adaptive();
    voice->cond = al_create_cond();
    /* XXX why is this needed? there should only be one active driver */
    voice->driver = _al_kcm_driver;
@@ -36,6 +36,68 @@ ALLEGRO_IIO_FUNC(bool, al_is_image_addon_initialized, (void));
 ALLEGRO_IIO_FUNC(void, al_shutdown_image_addon, (void));
 ALLEGRO_IIO_FUNC(uint32_t, al_get_allegro_image_version, (void));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_IIO_SRC)
+/* Type: ALLEGRO_IMAGE_ROWS
+ */
+typedef struct ALLEGRO_IMAGE_ROWS ALLEGRO_IMAGE_ROWS;
+
+struct ALLEGRO_IMAGE_ROWS {
+   int image_width;
+   int image_height;
+   int x;
+   int y;
+   int width;
+   int height;
+};
+
+ALLEGRO_IIO_FUNC(bool, al_load_bitmap_rows, (const char *filename,
+   int x, int y, int w, int h, int flags,
+   bool (*callback)(const ALLEGRO_IMAGE_ROWS *rows, int row,
+      const unsigned char *pixels, void *extra),
+   void *extra));
+ALLEGRO_IIO_FUNC(bool, al_load_bitmap_rows_f, (ALLEGRO_FILE *fp,
+   const char *ident, int x, int y, int w, int h, int flags,
+   bool (*callback)(const ALLEGRO_IMAGE_ROWS *rows, int row,
+      const unsigned char *pixels, void *extra),
+   void *extra));
+ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, al_load_bitmap_region, (const char *filename,
+   int x, int y, int w, int h, int flags));
+ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, al_load_bitmap_region_f, (ALLEGRO_FILE *fp,
+   const char *ident, int x, int y, int w, int h, int flags));
+
+/* Type: ALLEGRO_IMAGE_INFO
+ */
+typedef struct ALLEGRO_IMAGE_INFO ALLEGRO_IMAGE_INFO;
+
+struct ALLEGRO_IMAGE_INFO {
+   int width;
+   int height;
+   int channels;
+   int bit_depth;
+};
+
+ALLEGRO_IIO_FUNC(bool, al_probe_bitmap, (const char *filename,
+   ALLEGRO_IMAGE_INFO *info));
+ALLEGRO_IIO_FUNC(bool, al_probe_bitmap_f, (ALLEGRO_FILE *fp,
+   const char *ident, ALLEGRO_IMAGE_INFO *info));
+
+/* Type: ALLEGRO_IMAGE_ANIMATION
+ */
+typedef struct ALLEGRO_IMAGE_ANIMATION ALLEGRO_IMAGE_ANIMATION;
+
+ALLEGRO_IIO_FUNC(ALLEGRO_IMAGE_ANIMATION *, al_open_image_animation,
+   (const char *filename, int flags));
+ALLEGRO_IIO_FUNC(ALLEGRO_IMAGE_ANIMATION *, al_open_image_animation_f,
+   (ALLEGRO_FILE *fp, const char *ident, int flags));
+ALLEGRO_IIO_FUNC(void, al_close_image_animation, (ALLEGRO_IMAGE_ANIMATION *anim));
+ALLEGRO_IIO_FUNC(int, al_get_image_animation_width, (ALLEGRO_IMAGE_ANIMATION *anim));
+ALLEGRO_IIO_FUNC(int, al_get_image_animation_height, (ALLEGRO_IMAGE_ANIMATION *anim));
+ALLEGRO_IIO_FUNC(int, al_get_image_animation_frame_count, (ALLEGRO_IMAGE_ANIMATION *anim));
+ALLEGRO_IIO_FUNC(int, al_get_image_animation_loop_count, (ALLEGRO_IMAGE_ANIMATION *anim));
+ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, al_get_image_animation_frame,
+   (ALLEGRO_IMAGE_ANIMATION *anim, int index, double *duration));
+#endif
+
 
 #ifdef __cplusplus
 }
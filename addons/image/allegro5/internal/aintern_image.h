@@ -27,12 +27,14 @@ ALLEGRO_IIO_FUNC(bool, _al_save_pcx, (const char *filename, ALLEGRO_BITMAP *bmp)
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_pcx_f, (ALLEGRO_FILE *f, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_pcx_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(bool, _al_identify_pcx, (ALLEGRO_FILE *f));
+ALLEGRO_IIO_FUNC(bool, _al_probe_pcx, (ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info));
 
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_bmp, (const char *filename, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_bmp, (const char *filename, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_bmp_f, (ALLEGRO_FILE *f, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_bmp_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(bool, _al_identify_bmp, (ALLEGRO_FILE *f));
+ALLEGRO_IIO_FUNC(bool, _al_probe_bmp, (ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info));
 
 
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_tga, (const char *filename, int flags));
@@ -40,14 +42,52 @@ ALLEGRO_IIO_FUNC(bool, _al_save_tga, (const char *filename, ALLEGRO_BITMAP *bmp)
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_tga_f, (ALLEGRO_FILE *f, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_tga_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(bool, _al_identify_tga, (ALLEGRO_FILE *f));
+ALLEGRO_IIO_FUNC(bool, _al_probe_tga, (ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info));
 
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_dds, (const char *filename, int flags));
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_dds_f, (ALLEGRO_FILE *f, int flags));
+ALLEGRO_IIO_FUNC(bool, _al_save_dds, (const char *filename, ALLEGRO_BITMAP *bmp));
+ALLEGRO_IIO_FUNC(bool, _al_save_dds_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(bool, _al_identify_dds, (ALLEGRO_FILE *f));
+ALLEGRO_IIO_FUNC(bool, _al_probe_dds, (ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info));
+
+/* A request to stream the rows of a rectangle of an image, see
+ * al_load_bitmap_rows_f.  w or h <= 0 extend to the edge of the image.
+ */
+typedef struct _AL_IMAGE_ROW_REQUEST {
+   int x, y, w, h;
+   bool (*callback)(const ALLEGRO_IMAGE_ROWS *rows, int row,
+      const unsigned char *pixels, void *extra);
+   void *extra;
+} _AL_IMAGE_ROW_REQUEST;
+
+ALLEGRO_IIO_FUNC(bool, _al_clip_image_rows, (const _AL_IMAGE_ROW_REQUEST *req,
+   int image_w, int image_h, ALLEGRO_IMAGE_ROWS *rows));
+
+/* An open animated image, filled in by the format's reader.  Frames are
+ * decoded strictly in order; see al_open_image_animation_f.
+ */
+typedef struct _AL_IMAGE_ANIMATION_SOURCE {
+   int width, height;
+   int frame_count;
+   int loop_count;
+   void *data;
+   /* Decodes the next frame into ABGR_8888_LE pixels, width * 4 bytes per
+    * row, valid until the next call.  end_ms is when the frame ends,
+    * counted from the start of the animation.
+    */
+   bool (*next_frame)(void *data, const unsigned char **pixels, int *end_ms);
+   bool (*rewind)(void *data);
+   /* Frees the reader, but leaves the file open. */
+   void (*destroy)(void *data);
+} _AL_IMAGE_ANIMATION_SOURCE;
 
 ALLEGRO_IIO_FUNC(bool, _al_identify_png, (ALLEGRO_FILE *f));
 ALLEGRO_IIO_FUNC(bool, _al_identify_jpg, (ALLEGRO_FILE *f));
 ALLEGRO_IIO_FUNC(bool, _al_identify_webp, (ALLEGRO_FILE *f));
+ALLEGRO_IIO_FUNC(bool, _al_probe_png, (ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info));
+ALLEGRO_IIO_FUNC(bool, _al_probe_jpg, (ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info));
+ALLEGRO_IIO_FUNC(bool, _al_probe_webp, (ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info));
 
 #ifdef ALLEGRO_CFG_IIO_HAVE_FREEIMAGE
 ALLEGRO_IIO_FUNC(bool, _al_init_fi, (void));
@@ -81,6 +121,8 @@ ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_png, (const char *filename, int flag
 ALLEGRO_IIO_FUNC(bool, _al_save_png, (const char *filename, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_png_f, (ALLEGRO_FILE *f, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_png_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
+ALLEGRO_IIO_FUNC(bool, _al_load_png_rows_f, (ALLEGRO_FILE *f, int flags,
+   const _AL_IMAGE_ROW_REQUEST *req));
 #endif
 
 #ifdef ALLEGRO_CFG_IIO_HAVE_JPG
@@ -88,6 +130,8 @@ ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_jpg, (const char *filename, int flag
 ALLEGRO_IIO_FUNC(bool, _al_save_jpg, (const char *filename, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_jpg_f, (ALLEGRO_FILE *f, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_jpg_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
+ALLEGRO_IIO_FUNC(bool, _al_load_jpg_rows_f, (ALLEGRO_FILE *f, int flags,
+   const _AL_IMAGE_ROW_REQUEST *req));
 #endif
 
 #ifdef ALLEGRO_CFG_IIO_HAVE_WEBP
@@ -95,6 +139,10 @@ ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_webp, (const char *filename, int fla
 ALLEGRO_IIO_FUNC(bool, _al_save_webp, (const char *filename, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_webp_f, (ALLEGRO_FILE *f, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_webp_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
+#ifdef ALLEGRO_CFG_IIO_HAVE_WEBPDEMUX
+ALLEGRO_IIO_FUNC(bool, _al_open_webp_animation_f, (ALLEGRO_FILE *f, int flags,
+   _AL_IMAGE_ANIMATION_SOURCE *src));
+#endif
 #endif
 
 #ifdef __cplusplus
@@ -7,7 +7,9 @@
 #cmakedefine ALLEGRO_CFG_IIO_HAVE_ANDROID
 #cmakedefine ALLEGRO_CFG_IIO_HAVE_PNG
 #cmakedefine ALLEGRO_CFG_IIO_HAVE_JPG
+#cmakedefine ALLEGRO_CFG_IIO_HAVE_JPG_CROP
 #cmakedefine ALLEGRO_CFG_IIO_HAVE_WEBP
+#cmakedefine ALLEGRO_CFG_IIO_HAVE_WEBPDEMUX
 
 /* which formats are supported and wanted? */
 #cmakedefine ALLEGRO_CFG_IIO_SUPPORT_PNG
@@ -0,0 +1,271 @@
+/* Animated images, decoded a frame at a time.
+ */
+
+#include <string.h>
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_image.h"
+
+ALLEGRO_DEBUG_CHANNEL("image")
+
+
+/* Number of decoded frames kept around.  Decoding a frame reuses the
+ * bitmap of the frame this many places before it.
+ */
+#define ANIMATION_RING_SIZE   4
+
+typedef struct ANIMATION_FRAME {
+   ALLEGRO_BITMAP *bitmap;
+   int index;              /* -1 if the bitmap holds no frame yet */
+   double duration;
+} ANIMATION_FRAME;
+
+struct ALLEGRO_IMAGE_ANIMATION {
+   ALLEGRO_FILE *fp;
+   _AL_IMAGE_ANIMATION_SOURCE src;
+   int next_index;         /* the frame src.next_frame decodes next */
+   int next_start_ms;
+   ANIMATION_FRAME ring[ANIMATION_RING_SIZE];
+};
+
+
+
+static bool open_source(ALLEGRO_FILE *fp, const char *ident, int flags,
+   _AL_IMAGE_ANIMATION_SOURCE *src)
+{
+   const char *ext = al_identify_bitmap_f(fp);
+   if (ext)
+      ident = ext;
+   if (!ident) {
+      ALLEGRO_ERROR("Could not identify animation.\n");
+      return false;
+   }
+
+#ifdef ALLEGRO_CFG_IIO_HAVE_WEBPDEMUX
+   if (0 == _al_stricmp(ident, ".webp"))
+      return _al_open_webp_animation_f(fp, flags, src);
+#endif
+
+   (void)flags;
+   (void)src;
+   ALLEGRO_ERROR("No animation reader for %s.\n", ident);
+   return false;
+}
+
+
+
+static void destroy_animation(ALLEGRO_IMAGE_ANIMATION *anim)
+{
+   int i;
+
+   for (i = 0; i < ANIMATION_RING_SIZE; i++)
+      al_destroy_bitmap(anim->ring[i].bitmap);
+   anim->src.destroy(anim->src.data);
+   al_free(anim);
+}
+
+
+
+/* Function: al_open_image_animation_f
+ */
+ALLEGRO_IMAGE_ANIMATION *al_open_image_animation_f(ALLEGRO_FILE *fp,
+   const char *ident, int flags)
+{
+   ALLEGRO_IMAGE_ANIMATION *anim;
+   int i;
+
+   ASSERT(fp);
+
+   anim = al_calloc(1, sizeof(*anim));
+   if (!anim)
+      return NULL;
+
+   if (!open_source(fp, ident, flags, &anim->src)) {
+      al_free(anim);
+      return NULL;
+   }
+
+   for (i = 0; i < ANIMATION_RING_SIZE; i++) {
+      anim->ring[i].index = -1;
+      anim->ring[i].bitmap = al_create_bitmap(anim->src.width,
+         anim->src.height);
+      if (!anim->ring[i].bitmap) {
+         ALLEGRO_ERROR("%dx%d bitmap creation failed\n", anim->src.width,
+            anim->src.height);
+         destroy_animation(anim);
+         return NULL;
+      }
+   }
+
+   anim->fp = fp;
+   return anim;
+}
+
+
+
+/* Function: al_open_image_animation
+ */
+ALLEGRO_IMAGE_ANIMATION *al_open_image_animation(const char *filename,
+   int flags)
+{
+   ALLEGRO_FILE *fp;
+   ALLEGRO_IMAGE_ANIMATION *anim;
+
+   ASSERT(filename);
+
+   fp = al_fopen(filename, "rb");
+   if (!fp) {
+      ALLEGRO_ERROR("Unable to open %s for reading.\n", filename);
+      return NULL;
+   }
+
+   anim = al_open_image_animation_f(fp, strrchr(filename, '.'), flags);
+   if (!anim)
+      al_fclose(fp);
+
+   return anim;
+}
+
+
+
+/* Function: al_close_image_animation
+ */
+void al_close_image_animation(ALLEGRO_IMAGE_ANIMATION *anim)
+{
+   ALLEGRO_FILE *fp;
+
+   if (!anim)
+      return;
+
+   fp = anim->fp;
+   destroy_animation(anim);
+   al_fclose(fp);
+}
+
+
+
+/* Function: al_get_image_animation_width
+ */
+int al_get_image_animation_width(ALLEGRO_IMAGE_ANIMATION *anim)
+{
+   ASSERT(anim);
+   return anim->src.width;
+}
+
+
+
+/* Function: al_get_image_animation_height
+ */
+int al_get_image_animation_height(ALLEGRO_IMAGE_ANIMATION *anim)
+{
+   ASSERT(anim);
+   return anim->src.height;
+}
+
+
+
+/* Function: al_get_image_animation_frame_count
+ */
+int al_get_image_animation_frame_count(ALLEGRO_IMAGE_ANIMATION *anim)
+{
+   ASSERT(anim);
+   return anim->src.frame_count;
+}
+
+
+
+/* Function: al_get_image_animation_loop_count
+ */
+int al_get_image_animation_loop_count(ALLEGRO_IMAGE_ANIMATION *anim)
+{
+   ASSERT(anim);
+   return anim->src.loop_count;
+}
+
+
+
+static bool copy_frame(ALLEGRO_IMAGE_ANIMATION *anim, ALLEGRO_BITMAP *bitmap,
+   const unsigned char *pixels)
+{
+   ALLEGRO_LOCKED_REGION *lock;
+   int row_size = anim->src.width * 4;
+   int y;
+
+   lock = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_WRITEONLY);
+   if (!lock)
+      return false;
+
+   for (y = 0; y < anim->src.height; y++) {
+      memcpy((unsigned char *)lock->data + y * lock->pitch,
+         pixels + y * row_size, row_size);
+   }
+
+   al_unlock_bitmap(bitmap);
+   return true;
+}
+
+
+
+/* Function: al_get_image_animation_frame
+ */
+ALLEGRO_BITMAP *al_get_image_animation_frame(ALLEGRO_IMAGE_ANIMATION *anim,
+   int index, double *duration)
+{
+   ANIMATION_FRAME *frame;
+   const unsigned char *pixels;
+   int end_ms;
+
+   ASSERT(anim);
+
+   if (index < 0 || index >= anim->src.frame_count)
+      return NULL;
+
+   frame = &anim->ring[index % ANIMATION_RING_SIZE];
+
+   if (frame->index != index) {
+      /* Each frame is drawn on top of the previous ones, so going back
+       * means starting over.
+       */
+      if (index < anim->next_index) {
+         if (!anim->src.rewind(anim->src.data))
+            return NULL;
+         anim->next_index = 0;
+         anim->next_start_ms = 0;
+      }
+
+      while (anim->next_index <= index) {
+         int i = anim->next_index;
+         int start_ms = anim->next_start_ms;
+         ANIMATION_FRAME *f = &anim->ring[i % ANIMATION_RING_SIZE];
+
+         if (!anim->src.next_frame(anim->src.data, &pixels, &end_ms)) {
+            ALLEGRO_ERROR("Could not decode animation frame %d.\n", i);
+            return NULL;
+         }
+         anim->next_index++;
+         anim->next_start_ms = end_ms;
+
+         /* Frames which would be replaced before the one asked for are only
+          * decoded, not copied.
+          */
+         if (i > index - ANIMATION_RING_SIZE && f->index != i) {
+            f->index = -1;
+            if (!copy_frame(anim, f->bitmap, pixels))
+               return NULL;
+            f->index = i;
+            f->duration = (end_ms - start_ms) / 1000.0;
+         }
+      }
+   }
+
+   if (duration)
+      *duration = frame->duration;
+   return frame->bitmap;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
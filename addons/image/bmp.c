@@ -228,7 +228,8 @@ static void read_palette(int ncolors, PalEntry *pal, ALLEGRO_FILE *f,
    int flags, const BMPINFOHEADER *infoheader, int win_flag)
 {
    int i;
-   unsigned char c[3];
+   unsigned char raw[256 * 4];
+   int entry_size = win_flag ? 4 : 3;
    uint32_t r, g, b, a;
    bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
 
@@ -237,9 +238,12 @@ static void read_palette(int ncolors, PalEntry *pal, ALLEGRO_FILE *f,
 
    decode_bitfield(infoheader->biAlphaMask, &as, &am);
 
+   ASSERT(ncolors <= 256);
+   al_fread(f, raw, ncolors * entry_size);
+
    for (i = 0; i < ncolors; i++) {
       uint32_t pixel;
-      al_fread(f, c, 3);
+      const unsigned char *c = raw + i * entry_size;
       r = c[2];
       g = c[1];
       b = c[0];
@@ -273,10 +277,6 @@ static void read_palette(int ncolors, PalEntry *pal, ALLEGRO_FILE *f,
       pal[i].g = g;
       pal[i].b = b;
       pal[i].a = a;
-
-      if (win_flag) {
-         al_fgetc(f);
-      }
    }
 }
 
@@ -443,7 +443,8 @@ static void read_16_argb_1555_line(ALLEGRO_FILE *f, char *buf, char *data,
       uint16_t pixel = read_16le(buf + i*2);
       data32[i] = ALLEGRO_CONVERT_ARGB_1555_TO_ABGR_8888_LE(pixel);
 
-      if (premul && (pixel & 0x8000))
+      /* A clear alpha bit means transparent. */
+      if (premul && !(pixel & 0x8000))
          data32[i] = 0;
    }
 }
@@ -580,9 +581,10 @@ static void read_32_argb_8888_line(ALLEGRO_FILE *f, char *buf, char *data,
       data32[i] = ALLEGRO_CONVERT_ARGB_8888_TO_ABGR_8888_LE(pixel);
 
       if (premul && a != 255) {
-         data[i*4+1] = data[i*4+1] * a / 255;
-         data[i*4+2] = data[i*4+2] * a / 255;
-         data[i*4+3] = data[i*4+3] * a / 255;
+         unsigned char *c = (unsigned char *)(data32 + i);
+         c[0] = c[0] * a / 255;
+         c[1] = c[1] * a / 255;
+         c[2] = c[2] * a / 255;
       }
    }
 }
@@ -608,9 +610,10 @@ static void read_32_rgba_8888_line(ALLEGRO_FILE *f, char *buf, char *data,
       data32[i] = ALLEGRO_CONVERT_RGBA_8888_TO_ABGR_8888_LE(pixel);
 
       if (premul && a != 255) {
-         data[i*4]   = data[i*4] * a / 255;
-         data[i*4+1] = data[i*4+1] * a / 255;
-         data[i*4+2] = data[i*4+2] * a / 255;
+         unsigned char *c = (unsigned char *)(data32 + i);
+         c[0] = c[0] * a / 255;
+         c[1] = c[1] * a / 255;
+         c[2] = c[2] * a / 255;
       }
    }
 }
@@ -713,7 +716,7 @@ static bool read_RGB_image_indices(ALLEGRO_FILE *f, int flags,
  *  For reading the standard palette mapped BMP image format
  */
 static bool read_RGB_paletted_image(ALLEGRO_FILE *f, int flags,
-   const BMPINFOHEADER *infoheader, PalEntry* pal,
+   const BMPINFOHEADER *infoheader, const uint32_t *pal32,
    ALLEGRO_LOCKED_REGION *lr, bmp_line_fn fn)
 {
    int i, j, line, height, width, dir;
@@ -746,14 +749,11 @@ static bool read_RGB_paletted_image(ALLEGRO_FILE *f, int flags,
 
    for (i = 0; i < height; i++, line += dir) {
       char *data = (char *)lr->data + lr->pitch * line;
+      uint32_t *data32 = (uint32_t *)data;
       fn(f, linebuf, data, width, false);
 
       for (j = 0; j < width; ++j) {
-         unsigned char idx = linebuf[j];
-         data[j*4]   = pal[idx].r;
-         data[j*4+1] = pal[idx].g;
-         data[j*4+2] = pal[idx].b;
-         data[j*4+3] = pal[idx].a;
+         data32[j] = pal32[(unsigned char)linebuf[j]];
       }
    }
 
@@ -1167,7 +1167,8 @@ static bool read_RLE4_compressed_image(ALLEGRO_FILE *f, unsigned char *buf,
                   }
                   for (j = 0; j < count; j++) {
                      if ((j % 4) == 0) {
-                        val = (uint16_t)al_fread16le(f);
+                        val = al_fgetc(f) & 0xFF;
+                        val |= (al_fgetc(f) & 0xFF) << 8;
                         for (k = 0; k < 2; k++) {
                            b[2 * k + 1] = val & 15;
                            val = val >> 4;
@@ -1207,6 +1208,7 @@ ALLEGRO_BITMAP *_al_load_bmp_f(ALLEGRO_FILE *f, int flags)
    BMPINFOHEADER infoheader;
    ALLEGRO_BITMAP *bmp;
    PalEntry pal[256];
+   uint32_t pal32[256];
    int64_t file_start;
    int64_t header_start;
    unsigned long biSize;
@@ -1418,7 +1420,11 @@ ALLEGRO_BITMAP *_al_load_bmp_f(ALLEGRO_FILE *f, int flags)
       return bmp;
    }
    
-   if (infoheader.biBitCount <= 8 && keep_index) {
+   /* Indices only exist for paletted images. */
+   if (infoheader.biBitCount > 8)
+      keep_index = false;
+
+   if (keep_index) {
       lr = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8,
          ALLEGRO_LOCK_WRITEONLY);
    }
@@ -1433,6 +1439,15 @@ ALLEGRO_BITMAP *_al_load_bmp_f(ALLEGRO_FILE *f, int flags)
       return NULL;
    }
 
+   /* RLE images have always ignored the palette alpha. */
+   if (infoheader.biBitCount <= 8) {
+      int i;
+      for (i = 0; i < 256; i++) {
+         int a = (infoheader.biCompression == BIT_RGB) ? pal[i].a : 255;
+         pal32[i] = IIO_ABGR_LE(pal[i].r, pal[i].g, pal[i].b, a);
+      }
+   }
+
    if (infoheader.biCompression == BIT_RLE8
        || infoheader.biCompression == BIT_RLE4) {
       /* Questionable but most loaders handle this, so we should. */
@@ -1447,8 +1462,8 @@ ALLEGRO_BITMAP *_al_load_bmp_f(ALLEGRO_FILE *f, int flags)
    switch (infoheader.biCompression) {
       case BIT_RGB:
          if (infoheader.biBitCount == 32 && !infoheader.biHaveAlphaMask) {
-            if (!read_RGB_image_32bit_alpha_hack(f, flags, &infoheader, lr))
-               return NULL;
+            loaded_ok = read_RGB_image_32bit_alpha_hack(f, flags,
+               &infoheader, lr);
          }
          else {
             bmp_line_fn fn = NULL;
@@ -1463,24 +1478,26 @@ ALLEGRO_BITMAP *_al_load_bmp_f(ALLEGRO_FILE *f, int flags)
                case 32: fn = read_32_xrgb_8888_line; break;
                default:
                   ALLEGRO_ERROR("No decoding function for bit depth %d\n", infoheader.biBitCount);
-                  return NULL;
+                  loaded_ok = false;
+                  break;
             }
+            if (!fn)
+               break;
 
             if (infoheader.biBitCount == 16 && infoheader.biAlphaMask == 0x00008000U)
                fn = read_16_argb_1555_line;
             else if (infoheader.biBitCount == 32 && infoheader.biAlphaMask == 0xFF000000U)
                fn = read_32_argb_8888_line;
             if (keep_index) {
-               if (!read_RGB_image_indices(f, flags, &infoheader, lr, fn))
-                  return NULL;
+               loaded_ok = read_RGB_image_indices(f, flags, &infoheader, lr,
+                  fn);
             }
             else if (infoheader.biBitCount <= 8) {
-               if (!read_RGB_paletted_image(f, flags, &infoheader, pal, lr, fn))
-                  return NULL;
+               loaded_ok = read_RGB_paletted_image(f, flags, &infoheader,
+                  pal32, lr, fn);
             }
             else {
-               if (!read_RGB_image(f, flags, &infoheader, lr, fn))
-                  return NULL;
+               loaded_ok = read_RGB_image(f, flags, &infoheader, lr, fn);
             }
          }
          break;
@@ -1556,22 +1573,17 @@ ALLEGRO_BITMAP *_al_load_bmp_f(ALLEGRO_FILE *f, int flags)
    if (infoheader.biCompression == BIT_RLE8
        || infoheader.biCompression == BIT_RLE4) {
       int x, y;
-      unsigned char *data;
 
       for (y = 0; y < abs((int)infoheader.biHeight); y++) {
-         data = (unsigned char *)lr->data + lr->pitch * y;
-         for (x = 0; x < (int)infoheader.biWidth; x++) {
-            if (keep_index) {
-               data[0] = buf[y * infoheader.biWidth + x];
-               data++;
-            }
-            else {
-               data[0] = pal[buf[y * infoheader.biWidth + x]].r;
-               data[1] = pal[buf[y * infoheader.biWidth + x]].g;
-               data[2] = pal[buf[y * infoheader.biWidth + x]].b;
-               data[3] = 255;
-               data += 4;
-            }
+         const unsigned char *src = buf + y * infoheader.biWidth;
+         unsigned char *data = (unsigned char *)lr->data + lr->pitch * y;
+         if (keep_index) {
+            memcpy(data, src, infoheader.biWidth);
+         }
+         else {
+            uint32_t *data32 = (uint32_t *)data;
+            for (x = 0; x < (int)infoheader.biWidth; x++)
+               data32[x] = pal32[src[x]];
          }
       }
       al_free(buf);
@@ -1737,4 +1749,53 @@ bool _al_identify_bmp(ALLEGRO_FILE *f)
    return false;
 }
 
+
+bool _al_probe_bmp(ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info)
+{
+   BMPFILEHEADER fileheader;
+   BMPINFOHEADER infoheader;
+   unsigned long biSize;
+
+   memset(&infoheader, 0, sizeof(infoheader));
+   if (read_bmfileheader(f, &fileheader) != 0)
+      return false;
+
+   biSize = (uint32_t)al_fread32le(f);
+   switch (biSize) {
+      case WININFOHEADERSIZE:
+      case WININFOHEADERSIZEV2:
+      case WININFOHEADERSIZEV3:
+      case WININFOHEADERSIZEV4:
+      case WININFOHEADERSIZEV5:
+         if (read_win_bminfoheader(f, &infoheader) != 0)
+            return false;
+         break;
+
+      case OS2INFOHEADERSIZE:
+         if (read_os2_bminfoheader(f, &infoheader) != 0)
+            return false;
+         break;
+
+      default:
+         return false;
+   }
+
+   if ((int)infoheader.biWidth <= 0 || infoheader.biHeight == 0 || al_feof(f))
+      return false;
+
+   /* BITMAPV3INFOHEADER and above end with the RGB and alpha bit masks. */
+   if (biSize >= WININFOHEADERSIZEV3 && infoheader.biBitCount == 16) {
+      if (!al_fseek(f, 12, ALLEGRO_SEEK_CUR))
+         return false;
+      infoheader.biAlphaMask = (uint32_t)al_fread32le(f) & 0xFFFF;
+   }
+
+   info->width = infoheader.biWidth;
+   info->height = abs((int)infoheader.biHeight);
+   info->channels = (infoheader.biBitCount == 32 || infoheader.biAlphaMask) ?
+      4 : 3;
+   info->bit_depth = infoheader.biBitCount;
+   return true;
+}
+
 /* vim: set sts=3 sw=3 et: */
@@ -8,7 +8,7 @@
  *                                           /\____/
  *                                           \_/__/
  *
- *      A simple DDS reader.
+ *      A simple DDS reader and writer.
  *
  *      See readme.txt for copyright information.
  */
@@ -16,6 +16,7 @@
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
 #include "allegro5/internal/aintern_image.h"
+#include "allegro5/internal/aintern_pixels.h"
 
 #include "iio.h"
 
@@ -58,6 +59,13 @@ typedef struct {
 
 #define DDPF_FOURCC 0x4
 
+#define DDSD_CAPS 0x1
+#define DDSD_HEIGHT 0x2
+#define DDSD_WIDTH 0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_LINEARSIZE 0x80000
+#define DDSCAPS_TEXTURE 0x1000
+
 ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
 {
    ALLEGRO_BITMAP *bmp;
@@ -113,9 +121,16 @@ ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
    block_size = al_get_pixel_block_size(format);
 
    al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
-   al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
    al_set_new_bitmap_format(format);
    bmp = al_create_bitmap(w, h);
+   if (!bmp && !(al_get_new_bitmap_flags() & ALLEGRO_VIDEO_BITMAP)) {
+      /* The display can't hold compressed textures, but memory bitmaps
+       * decode them in software.
+       */
+      al_set_new_bitmap_flags((al_get_new_bitmap_flags() &
+         ~ALLEGRO_CONVERT_BITMAP) | ALLEGRO_MEMORY_BITMAP);
+      bmp = al_create_bitmap(w, h);
+   }
    if (!bmp) {
       ALLEGRO_ERROR("Failed to create bitmap.\n");
       goto FAIL;
@@ -184,6 +199,120 @@ ALLEGRO_BITMAP *_al_load_dds(const char *filename, int flags)
    return bmp;
 }
 
+/* Bitmaps in other formats are compressed to DXT5, or to DXT1 if they have
+ * no alpha channel.
+ */
+bool _al_save_dds_f(ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp)
+{
+   ALLEGRO_BITMAP *compressed = NULL;
+   ALLEGRO_LOCKED_REGION *lr;
+   ALLEGRO_STATE state;
+   int w = al_get_bitmap_width(bmp);
+   int h = al_get_bitmap_height(bmp);
+   int format = al_get_bitmap_format(bmp);
+   int fourcc, block_width, block_height, block_size;
+   int pitch, rows, ii;
+   bool ret = true;
+   ASSERT(f);
+   ASSERT(bmp);
+
+   if (!_al_pixel_format_is_compressed(format)) {
+      format = _al_pixel_format_has_alpha(format) ?
+         ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5 :
+         ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1;
+      al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+      al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+      al_set_new_bitmap_format(format);
+      compressed = al_clone_bitmap(bmp);
+      al_restore_state(&state);
+      if (!compressed) {
+         ALLEGRO_ERROR("Failed to compress the bitmap.\n");
+         return false;
+      }
+      bmp = compressed;
+   }
+
+   switch (format) {
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:
+         fourcc = FOURCC('D', 'X', 'T', '1');
+         break;
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:
+         fourcc = FOURCC('D', 'X', 'T', '3');
+         break;
+      default:
+         fourcc = FOURCC('D', 'X', 'T', '5');
+         break;
+   }
+
+   block_width = al_get_pixel_block_width(format);
+   block_height = al_get_pixel_block_height(format);
+   block_size = al_get_pixel_block_size(format);
+   pitch = (w + block_width - 1) / block_width * block_size;
+   rows = (h + block_height - 1) / block_height;
+
+   lr = al_lock_bitmap_blocked(bmp, ALLEGRO_LOCK_READONLY);
+   if (!lr) {
+      ALLEGRO_ERROR("Could not lock the bitmap.\n");
+      al_destroy_bitmap(compressed);
+      return false;
+   }
+
+   al_set_errno(0);
+
+   al_fwrite32le(f, 0x20534444);
+   al_fwrite32le(f, DDS_HEADER_SIZE);
+   al_fwrite32le(f, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+      DDSD_LINEARSIZE);
+   al_fwrite32le(f, h);
+   al_fwrite32le(f, w);
+   al_fwrite32le(f, pitch * rows);
+   al_fwrite32le(f, 0); /* depth */
+   al_fwrite32le(f, 0); /* mipmap count */
+   for (ii = 0; ii < 11; ii++)
+      al_fwrite32le(f, 0);
+   al_fwrite32le(f, DDS_PIXELFORMAT_SIZE);
+   al_fwrite32le(f, DDPF_FOURCC);
+   al_fwrite32le(f, fourcc);
+   for (ii = 0; ii < 5; ii++)
+      al_fwrite32le(f, 0);
+   al_fwrite32le(f, DDSCAPS_TEXTURE);
+   for (ii = 0; ii < 4; ii++)
+      al_fwrite32le(f, 0);
+
+   for (ii = 0; ii < rows; ii++) {
+      if (al_fwrite(f, (char *)lr->data + ii * lr->pitch, pitch) !=
+            (size_t)pitch) {
+         ret = false;
+         break;
+      }
+   }
+
+   al_unlock_bitmap(bmp);
+   al_destroy_bitmap(compressed);
+
+   return ret && !al_get_errno();
+}
+
+bool _al_save_dds(const char *filename, ALLEGRO_BITMAP *bmp)
+{
+   ALLEGRO_FILE *f;
+   bool retsave;
+   bool retclose;
+   ASSERT(filename);
+
+   f = al_fopen(filename, "wb");
+   if (!f) {
+      ALLEGRO_ERROR("Unable to open %s for writing.\n", filename);
+      return false;
+   }
+
+   retsave = _al_save_dds_f(f, bmp);
+
+   retclose = al_fclose(f);
+
+   return retsave && retclose;
+}
+
 bool _al_identify_dds(ALLEGRO_FILE *f)
 {
    uint8_t x[4];
@@ -196,3 +325,35 @@ bool _al_identify_dds(ALLEGRO_FILE *f)
       return false;
    return true;
 }
+
+
+bool _al_probe_dds(ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info)
+{
+   DDS_HEADER header;
+
+   if (al_fread32le(f) != 0x20534444)
+      return false;
+   if (al_fread(f, &header, sizeof(DDS_HEADER)) != DDS_HEADER_SIZE)
+      return false;
+
+   info->width = header.dwWidth;
+   info->height = header.dwHeight;
+   info->channels = 4;
+
+   /* Only what _al_load_dds_f understands. */
+   if (!(header.ddspf.dwFlags & DDPF_FOURCC))
+      return false;
+   switch (header.ddspf.dwFourCC) {
+      case FOURCC('D', 'X', 'T', '1'):
+         info->bit_depth = 4;
+         break;
+      case FOURCC('D', 'X', 'T', '3'):
+      case FOURCC('D', 'X', 'T', '5'):
+         info->bit_depth = 8;
+         break;
+      default:
+         return false;
+   }
+
+   return info->width > 0 && info->height > 0;
+}
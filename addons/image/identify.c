@@ -1,7 +1,12 @@
+#include <string.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_image.h"
 
+ALLEGRO_DEBUG_CHANNEL("image")
+
 bool _al_identify_png(ALLEGRO_FILE *f)
 {
    uint8_t x[8];
@@ -37,3 +42,218 @@ bool _al_identify_webp(ALLEGRO_FILE *f)
       return false;
    return true;
 }
+
+bool _al_probe_png(ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info)
+{
+   static const int channels[7] = {1, 0, 3, 3, 2, 0, 4};
+   uint8_t x[8];
+   int depth, colour_type;
+
+   if (!_al_identify_png(f))
+      return false;
+   if (al_fread32be(f) != 13)
+      return false;
+   al_fread(f, x, 4);
+   if (memcmp(x, "IHDR", 4) != 0)
+      return false;
+   info->width = al_fread32be(f);
+   info->height = al_fread32be(f);
+   depth = al_fgetc(f);
+   colour_type = al_fgetc(f);
+   if (colour_type < 0 || colour_type > 6 || channels[colour_type] == 0)
+      return false;
+   info->channels = channels[colour_type];
+   info->bit_depth = depth * (colour_type == 3 ? 1 : info->channels);
+
+   if (info->width <= 0 || info->height <= 0 || al_feof(f))
+      return false;
+
+   /* A tRNS chunk adds an alpha channel.  It has to come before the image
+    * data, so only a few small chunks need to be skipped to find it.
+    */
+   if (colour_type == 0 || colour_type == 2 || colour_type == 3) {
+      int32_t length;
+      /* Rest of IHDR and its CRC. */
+      al_fseek(f, 3 + 4, ALLEGRO_SEEK_CUR);
+      for (;;) {
+         length = al_fread32be(f);
+         if (al_fread(f, x, 4) != 4 || length < 0)
+            break;
+         if (memcmp(x, "tRNS", 4) == 0) {
+            info->channels = (colour_type == 0) ? 2 : 4;
+            break;
+         }
+         if (memcmp(x, "IDAT", 4) == 0 || memcmp(x, "IEND", 4) == 0)
+            break;
+         if (!al_fseek(f, length + 4, ALLEGRO_SEEK_CUR))
+            break;
+      }
+   }
+
+   return true;
+}
+
+bool _al_probe_jpg(ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info)
+{
+   int marker, length, precision;
+
+   /* Unlike _al_identify_jpg this does not insist on a JFIF segment, so
+    * Exif files from cameras can be probed too.
+    */
+   if ((uint16_t)al_fread16be(f) != 0xffd8)
+      return false;
+
+   for (;;) {
+      if (al_fgetc(f) != 0xff)
+         return false;
+      do {
+         marker = al_fgetc(f);
+      } while (marker == 0xff);
+      if (marker == EOF || marker == 0xd9 || marker == 0xda)
+         return false;
+      /* Markers without a payload. */
+      if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+         continue;
+      length = (uint16_t)al_fread16be(f);
+      if (length < 2)
+         return false;
+      /* SOF0 to SOF15, except DHT, JPG and DAC. */
+      if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 &&
+            marker != 0xc8 && marker != 0xcc) {
+         precision = al_fgetc(f);
+         info->height = (uint16_t)al_fread16be(f);
+         info->width = (uint16_t)al_fread16be(f);
+         info->channels = al_fgetc(f);
+         info->bit_depth = precision * info->channels;
+         return !al_feof(f) && info->width > 0 && info->height > 0 &&
+            info->channels > 0;
+      }
+      if (!al_fseek(f, length - 2, ALLEGRO_SEEK_CUR))
+         return false;
+   }
+}
+
+bool _al_probe_webp(ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info)
+{
+   uint8_t x[10];
+
+   if (!_al_identify_webp(f))
+      return false;
+   if (al_fread(f, x, 4) != 4)
+      return false;
+   al_fread32le(f); /* chunk size */
+
+   if (memcmp(x, "VP8 ", 4) == 0) {
+      /* Frame tag, then the key frame start code and the dimensions. */
+      if (al_fread(f, x, 10) != 10 || x[3] != 0x9d || x[4] != 0x01 ||
+            x[5] != 0x2a)
+         return false;
+      info->width = (x[6] | (x[7] << 8)) & 0x3fff;
+      info->height = (x[8] | (x[9] << 8)) & 0x3fff;
+      info->channels = 3;
+   }
+   else if (memcmp(x, "VP8L", 4) == 0) {
+      uint32_t bits;
+      if (al_fgetc(f) != 0x2f)
+         return false;
+      bits = (uint32_t)al_fread32le(f);
+      info->width = (bits & 0x3fff) + 1;
+      info->height = ((bits >> 14) & 0x3fff) + 1;
+      info->channels = (bits & (1 << 28)) ? 4 : 3;
+   }
+   else if (memcmp(x, "VP8X", 4) == 0) {
+      if (al_fread(f, x, 10) != 10)
+         return false;
+      info->width = (x[4] | (x[5] << 8) | (x[6] << 16)) + 1;
+      info->height = (x[7] | (x[8] << 8) | (x[9] << 16)) + 1;
+      info->channels = (x[0] & 0x10) ? 4 : 3;
+   }
+   else {
+      return false;
+   }
+
+   info->bit_depth = 8 * info->channels;
+   return !al_feof(f) && info->width > 0 && info->height > 0;
+}
+
+
+typedef struct PROBER {
+   const char *ext;
+   bool (*probe)(ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info);
+} PROBER;
+
+static const PROBER probers[] = {
+   {".png", _al_probe_png},
+   {".jpg", _al_probe_jpg},
+   {".jpeg", _al_probe_jpg},
+   {".webp", _al_probe_webp},
+   {".bmp", _al_probe_bmp},
+   {".tga", _al_probe_tga},
+   {".pcx", _al_probe_pcx},
+   {".dds", _al_probe_dds}
+};
+
+
+/* Function: al_probe_bitmap_f
+ */
+bool al_probe_bitmap_f(ALLEGRO_FILE *fp, const char *ident,
+   ALLEGRO_IMAGE_INFO *info)
+{
+   const char *ext;
+   int64_t pos;
+   bool ret = false;
+   unsigned i;
+
+   ASSERT(fp);
+   ASSERT(info);
+
+   ext = al_identify_bitmap_f(fp);
+   if (ext)
+      ident = ext;
+   if (!ident) {
+      ALLEGRO_ERROR("Could not identify bitmap.\n");
+      return false;
+   }
+
+   pos = al_ftell(fp);
+   for (i = 0; i < sizeof(probers) / sizeof(probers[0]); i++) {
+      if (0 == _al_stricmp(ident, probers[i].ext)) {
+         ret = probers[i].probe(fp, info);
+         break;
+      }
+   }
+   al_fseek(fp, pos, ALLEGRO_SEEK_SET);
+
+   if (i == sizeof(probers) / sizeof(probers[0]))
+      ALLEGRO_ERROR("No probe for %s.\n", ident);
+   else if (!ret)
+      ALLEGRO_ERROR("Invalid %s header.\n", ident);
+
+   return ret;
+}
+
+
+/* Function: al_probe_bitmap
+ */
+bool al_probe_bitmap(const char *filename, ALLEGRO_IMAGE_INFO *info)
+{
+   ALLEGRO_FILE *fp;
+   bool ret;
+
+   ASSERT(filename);
+
+   fp = al_fopen(filename, "rb");
+   if (!fp) {
+      ALLEGRO_ERROR("Unable to open %s for reading.\n", filename);
+      return false;
+   }
+
+   ret = al_probe_bitmap_f(fp, strrchr(filename, '.'), info);
+
+   al_fclose(fp);
+
+   return ret;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
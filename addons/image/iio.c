@@ -40,6 +40,8 @@ bool al_init_image_addon(void)
 
    success |= al_register_bitmap_loader(".dds", _al_load_dds);
    success |= al_register_bitmap_loader_f(".dds", _al_load_dds_f);
+   success |= al_register_bitmap_saver(".dds", _al_save_dds);
+   success |= al_register_bitmap_saver_f(".dds", _al_save_dds_f);
    success |= al_register_bitmap_identifier(".dds", _al_identify_dds);
 
    /* Even if we don't have libpng or libjpeg we most likely have a
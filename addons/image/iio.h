@@ -12,5 +12,15 @@ typedef struct PalEntry {
 } PalEntry;
 
 
+/* Packs a colour in the memory order of ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE. */
+#ifdef ALLEGRO_BIG_ENDIAN
+   #define IIO_ABGR_LE(r, g, b, a) \
+      (((uint32_t)(r) << 24) | ((uint32_t)(g) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(a))
+#else
+   #define IIO_ABGR_LE(r, g, b, a) \
+      ((uint32_t)(r) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(a) << 24))
+#endif
+
+
 #endif
 
@@ -11,8 +11,13 @@
 
 #define BUFFER_SIZE 4096
 
+/* Maximum number of scanlines requested from libjpeg per call. */
+#define MAX_SCANLINES 16
+
+#define ALLEGRO_INTERNAL_UNSTABLE
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_image.h"
 
 #include "iio.h"
@@ -158,13 +163,34 @@ struct load_jpg_entry_helper_data {
    unsigned char *row;
 };
 
+/* Pick the largest DCT scaling denominator (libjpeg supports 1/2, 1/4 and
+ * 1/8) whose output is still at least as big as the requested load size.
+ * A zero dimension in the load size places no constraint on that axis.
+ */
+static int choose_scale_denom(int w, int h, int load_w, int load_h)
+{
+   int denom;
+
+   if (load_w <= 0 && load_h <= 0)
+      return 1;
+
+   for (denom = 8; denom > 1; denom /= 2) {
+      if ((load_w <= 0 || (w + denom - 1) / denom >= load_w) &&
+          (load_h <= 0 || (h + denom - 1) / denom >= load_h))
+         break;
+   }
+   return denom;
+}
+
 static void load_jpg_entry_helper(ALLEGRO_FILE *fp,
    struct load_jpg_entry_helper_data *data, int flags)
 {
    struct jpeg_decompress_struct cinfo;
    struct my_err_mgr jerr;
    ALLEGRO_LOCKED_REGION *lock;
-   int w, h, s;
+   unsigned char *rows[MAX_SCANLINES];
+   int w, h, s, i, n;
+   int load_w, load_h;
 
    /* ALLEGRO_NO_PREMULTIPLIED_ALPHA does not apply.
     * ALLEGRO_KEEP_INDEX does not apply.
@@ -190,6 +216,17 @@ static void load_jpg_entry_helper(ALLEGRO_FILE *fp,
    jpeg_create_decompress(&cinfo);
    jpeg_packfile_src(&cinfo, fp, data->buffer);
    jpeg_read_header(&cinfo, true);
+
+   al_get_new_bitmap_load_size(&load_w, &load_h);
+   cinfo.scale_num = 1;
+   cinfo.scale_denom = choose_scale_denom(cinfo.image_width,
+      cinfo.image_height, load_w, load_h);
+   if (cinfo.scale_denom > 1) {
+      ALLEGRO_DEBUG("Decoding %dx%d JPEG at 1/%d scale\n",
+         (int)cinfo.image_width, (int)cinfo.image_height,
+         (int)cinfo.scale_denom);
+   }
+
    jpeg_start_decompress(&cinfo);
 
    w = cinfo.output_width;
@@ -227,32 +264,46 @@ static void load_jpg_entry_helper(ALLEGRO_FILE *fp,
        ALLEGRO_LOCK_WRITEONLY);
 #endif
 
+   /* Ask libjpeg for several scanlines at a time.  It returns at most one
+    * iMCU row group per call, but that is still far fewer calls (and less
+    * internal copying) than asking for one row at a time.
+    */
    if (s == 3) {
       /* Colour. */
       int y;
 
       for (y = cinfo.output_scanline; y < h; y = cinfo.output_scanline) {
-         unsigned char *out[1];
-         out[0] = ((unsigned char *)lock->data) + y * lock->pitch;
-         jpeg_read_scanlines(&cinfo, (void *)out, 1);
+         n = _ALLEGRO_MIN(h - y, MAX_SCANLINES);
+         for (i = 0; i < n; i++)
+            rows[i] = ((unsigned char *)lock->data) + (y + i) * lock->pitch;
+         jpeg_read_scanlines(&cinfo, (void *)rows, n);
       }
    }
    else if (s == 1) {
       /* Greyscale. */
       unsigned char *in;
       unsigned char *out;
-      int x, y;
+      int x, y, got;
 
-      data->row = al_malloc(w);
+      data->row = al_malloc(w * MAX_SCANLINES);
+      if (!data->row) {
+         data->error = true;
+         goto error;
+      }
+      for (i = 0; i < MAX_SCANLINES; i++)
+         rows[i] = data->row + i * w;
       for (y = cinfo.output_scanline; y < h; y = cinfo.output_scanline) {
-         jpeg_read_scanlines(&cinfo, (void *)&data->row, 1);
-         in = data->row;
-         out = ((unsigned char *)lock->data) + y * lock->pitch;
-         for (x = 0; x < w; x++) {
-            *out++ = *in;
-            *out++ = *in;
-            *out++ = *in;
-            in++;
+         n = _ALLEGRO_MIN(h - y, MAX_SCANLINES);
+         got = jpeg_read_scanlines(&cinfo, (void *)rows, n);
+         for (i = 0; i < got; i++) {
+            in = rows[i];
+            out = ((unsigned char *)lock->data) + (y + i) * lock->pitch;
+            for (x = 0; x < w; x++) {
+               *out++ = *in;
+               *out++ = *in;
+               *out++ = *in;
+               in++;
+            }
          }
       }
    }
@@ -287,6 +338,151 @@ ALLEGRO_BITMAP *_al_load_jpg_f(ALLEGRO_FILE *fp, int flags)
    return data.bmp;
 }
 
+/* See comment about load_jpg_entry_helper_data. */
+struct load_jpg_rows_helper_data {
+   bool error;
+   JOCTET *buffer;
+   unsigned char *scanlines;
+   unsigned char *row;
+};
+
+/* Streams the rows of the requested rectangle to the callback.  With
+ * libjpeg-turbo the columns outside the rectangle are cropped away (to the
+ * nearest iMCU boundary) and the rows above it are skipped without colour
+ * conversion; decoding always stops after the last requested row.
+ */
+static void load_jpg_rows_helper(ALLEGRO_FILE *fp,
+   struct load_jpg_rows_helper_data *data, const _AL_IMAGE_ROW_REQUEST *req)
+{
+   struct jpeg_decompress_struct cinfo;
+   struct my_err_mgr jerr;
+   ALLEGRO_IMAGE_ROWS info;
+   unsigned char *rows[MAX_SCANLINES];
+   unsigned char *in, *out;
+   JDIMENSION xoffset = 0;
+   int x, y, s, i, n, got, last;
+   bool stop = false;
+
+   data->error = false;
+
+   cinfo.err = jpeg_std_error(&jerr.pub);
+   jerr.pub.error_exit = my_error_exit;
+   if (setjmp(jerr.jmpenv) != 0) {
+      /* Longjmp'd. */
+      data->error = true;
+      goto longjmp_error;
+   }
+
+   jpeg_create_decompress(&cinfo);
+
+   data->buffer = al_malloc(BUFFER_SIZE);
+   if (!data->buffer) {
+      data->error = true;
+      goto abort;
+   }
+
+   jpeg_packfile_src(&cinfo, fp, data->buffer);
+   jpeg_read_header(&cinfo, true);
+   jpeg_start_decompress(&cinfo);
+
+   s = cinfo.output_components;
+   if (s != 1 && s != 3) {
+      ALLEGRO_ERROR("%d components makes no sense\n", s);
+      data->error = true;
+      goto abort;
+   }
+
+   if (!_al_clip_image_rows(req, cinfo.output_width, cinfo.output_height,
+         &info)) {
+      data->error = true;
+      goto abort;
+   }
+
+#ifdef ALLEGRO_CFG_IIO_HAVE_JPG_CROP
+   {
+      /* Fancy upsampling replicates chroma at the edges of the cropped
+       * area, so keep one extra pixel on either side to get exactly the
+       * same pixels as a full decode.
+       */
+      int x1 = _ALLEGRO_MAX(info.x - 1, 0);
+      int x2 = _ALLEGRO_MIN(info.x + info.width + 1, info.image_width);
+      JDIMENSION cropped_w = x2 - x1;
+      xoffset = x1;
+      jpeg_crop_scanline(&cinfo, &xoffset, &cropped_w);
+      if (info.y > 0)
+         jpeg_skip_scanlines(&cinfo, info.y);
+   }
+#endif
+
+   data->scanlines = al_malloc(cinfo.output_width * s * MAX_SCANLINES);
+   data->row = al_malloc(info.width * 4);
+   if (!data->scanlines || !data->row) {
+      data->error = true;
+      goto abort;
+   }
+   for (i = 0; i < MAX_SCANLINES; i++)
+      rows[i] = data->scanlines + i * cinfo.output_width * s;
+
+   last = info.y + info.height;
+   for (y = cinfo.output_scanline; y < last && !stop;
+         y = cinfo.output_scanline) {
+      n = _ALLEGRO_MIN(last - y, MAX_SCANLINES);
+      got = jpeg_read_scanlines(&cinfo, (void *)rows, n);
+      for (i = 0; i < got && !stop; i++) {
+         if (y + i < info.y)
+            continue;
+         in = rows[i] + (info.x - xoffset) * s;
+         out = data->row;
+         if (s == 3) {
+            for (x = 0; x < info.width; x++) {
+               *out++ = in[0];
+               *out++ = in[1];
+               *out++ = in[2];
+               *out++ = 255;
+               in += 3;
+            }
+         }
+         else {
+            for (x = 0; x < info.width; x++) {
+               *out++ = *in;
+               *out++ = *in;
+               *out++ = *in;
+               *out++ = 255;
+               in++;
+            }
+         }
+         stop = !req->callback(&info, y + i - info.y, data->row, req->extra);
+      }
+   }
+
+ abort:
+   /* We usually stop before the end of the image, which
+    * jpeg_finish_decompress would complain about.
+    */
+   jpeg_abort_decompress(&cinfo);
+
+ longjmp_error:
+   jpeg_destroy_decompress(&cinfo);
+
+   al_free(data->buffer);
+   al_free(data->scanlines);
+   al_free(data->row);
+}
+
+bool _al_load_jpg_rows_f(ALLEGRO_FILE *fp, int flags,
+   const _AL_IMAGE_ROW_REQUEST *req)
+{
+   struct load_jpg_rows_helper_data data;
+
+   /* ALLEGRO_NO_PREMULTIPLIED_ALPHA and ALLEGRO_KEEP_INDEX do not apply. */
+   (void)flags;
+
+   memset(&data, 0, sizeof(data));
+   load_jpg_rows_helper(fp, &data, req);
+
+   return !data.error;
+}
+
 /* See comment about load_jpg_entry_helper_data. */
 struct save_jpg_entry_helper_data {
    bool error;
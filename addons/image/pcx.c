@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
 #include "allegro5/internal/aintern_image.h"
@@ -19,7 +21,8 @@ ALLEGRO_BITMAP *_al_load_pcx_f(ALLEGRO_FILE *f, int flags)
    char ch;
    ALLEGRO_LOCKED_REGION *lr;
    unsigned char *buf;
-   PalEntry pal[256];
+   unsigned char pal[256 * 3];
+   uint32_t pal32[256];
    bool keep_index;
    ASSERT(f);
 
@@ -101,6 +104,13 @@ ALLEGRO_BITMAP *_al_load_pcx_f(ALLEGRO_FILE *f, int flags)
       return NULL;
    }
 
+   if (!buf) {
+      ALLEGRO_ERROR("Failed to allocate enough memory.\n");
+      al_unlock_bitmap(b);
+      al_destroy_bitmap(b);
+      return NULL;
+   }
+
    xx = 0;                      /* index into buf, only for bpp = 8 */
 
    for (y = 0; y < height; y++) {       /* read RLE encoded PCX data */
@@ -133,40 +143,35 @@ ALLEGRO_BITMAP *_al_load_pcx_f(ALLEGRO_FILE *f, int flags)
          }
       }
       if (bpp == 24) {
-         char *dest = (char*)lr->data + y*lr->pitch;
+         uint32_t *dest = (uint32_t *)((char*)lr->data + y*lr->pitch);
          for (x = 0; x < width; x++) {
-            dest[x*4    ] = buf[x];
-            dest[x*4 + 1] = buf[x + width];
-            dest[x*4 + 2] = buf[x + width * 2];
-            dest[x*4 + 3] = 255;
+            dest[x] = IIO_ABGR_LE(buf[x], buf[x + width], buf[x + width * 2],
+               255);
          }
       }
    }
 
    if (bpp == 8) {               /* look for a 256 color palette */
+      memset(pal, 0, sizeof(pal));
       while ((c = al_fgetc(f)) != EOF) {
          if (c == 12) {
-            for (c = 0; c < 256; c++) {
-               pal[c].r = al_fgetc(f);
-               pal[c].g = al_fgetc(f);
-               pal[c].b = al_fgetc(f);
-            }
+            al_fread(f, pal, sizeof(pal));
             break;
          }
       }
+      for (c = 0; c < 256; c++) {
+         pal32[c] = IIO_ABGR_LE(pal[c*3], pal[c*3 + 1], pal[c*3 + 2], 255);
+      }
       for (y = 0; y < height; y++) {
          char *dest = (char*)lr->data + y*lr->pitch;
-         for (x = 0; x < width; x++) {
-            int index = buf[y * width + x];
-            if (keep_index) {
-               dest[x] = index;
-            }
-            else {
-               dest[x*4    ] = pal[index].r;
-               dest[x*4 + 1] = pal[index].g;
-               dest[x*4 + 2] = pal[index].b;
-               dest[x*4 + 3] = 255;
-            }
+         const unsigned char *src = buf + y * width;
+         if (keep_index) {
+            memcpy(dest, src, width);
+         }
+         else {
+            uint32_t *dest32 = (uint32_t *)dest;
+            for (x = 0; x < width; x++)
+               dest32[x] = pal32[src[x]];
          }
       }
    }
@@ -324,4 +329,27 @@ bool _al_identify_pcx(ALLEGRO_FILE *f)
 }
 
 
+bool _al_probe_pcx(ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info)
+{
+   unsigned char header[66];
+   int xmin, ymin, xmax, ymax;
+
+   if (al_fread(f, header, 66) != 66 || header[0] != 0x0a || header[3] != 8)
+      return false;
+
+   xmin = header[4] | (header[5] << 8);
+   ymin = header[6] | (header[7] << 8);
+   xmax = header[8] | (header[9] << 8);
+   ymax = header[10] | (header[11] << 8);
+
+   info->width = xmax - xmin + 1;
+   info->height = ymax - ymin + 1;
+   /* One plane is paletted, three are RGB. */
+   info->channels = 3;
+   info->bit_depth = header[65] * 8;
+   return info->width > 0 && info->height > 0 &&
+      (header[65] == 1 || header[65] == 3);
+}
+
+
 /* vim: set sts=3 sw=3 et: */
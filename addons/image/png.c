@@ -6,8 +6,10 @@
 #include <png.h>
 #include <zlib.h>
 
+#define ALLEGRO_INTERNAL_UNSTABLE
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_image.h"
 
 #include "iio.h"
@@ -86,37 +88,51 @@ static int check_if_png(ALLEGRO_FILE *fp)
 
 
 
-/* really_load_png:
- *  Worker routine, used by load_png and load_memory_png.
+/* Everything really_load_png and the row reader need to know about the
+ * image once the libpng transformations have been set up.
  */
-static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
-   int flags)
+typedef struct PNG_LOAD_INFO {
+   png_uint_32 width, height;
+   png_uint_32 real_rowbytes;
+   int color_type, interlace_type;
+   int bpp;
+   int number_passes;
+   int num_trans;
+   bool has_alpha;
+   png_bytep trans;
+   PalEntry pal[256];
+} PNG_LOAD_INFO;
+
+/* Pixel layouts setup_png_read can ask libpng for. */
+enum {
+   PNG_LAYOUT_NATIVE,   /* 8, 24 or 32 bpp as stored, see convert_png_row */
+   PNG_LAYOUT_RGBA,     /* always 32 bpp, bytes R, G, B, A */
+   PNG_LAYOUT_BGRA      /* always 32 bpp, bytes B, G, R, A */
+};
+
+
+
+/* setup_png_read:
+ *  Sets up the transformations we want from libpng, after png_read_info.
+ *  With PNG_LAYOUT_RGBA or PNG_LAYOUT_BGRA libpng itself expands palettes,
+ *  grayscale and missing alpha, so rows can be read straight into a
+ *  locked bitmap.
+ */
+static void setup_png_read(png_structp png_ptr, png_infop info_ptr,
+   PNG_LOAD_INFO *li, int layout)
 {
-   ALLEGRO_BITMAP *bmp;
-   png_uint_32 width, height, rowbytes, real_rowbytes;
-   int bit_depth, color_type, interlace_type;
+   png_uint_32 rowbytes;
+   int bit_depth;
    double image_gamma, screen_gamma;
    int intent;
-   int bpp;
-   int number_passes, pass;
-   int num_trans = 0;
-   PalEntry pal[256];
-   png_bytep trans;
-   ALLEGRO_LOCKED_REGION *lock;
-   unsigned char *buf;
-   unsigned char *dest;
-   bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
-   bool index_only;
 
    ALLEGRO_ASSERT(png_ptr && info_ptr);
 
-   /* The call to png_read_info() gives us all of the information from the
-    * PNG file before the first IDAT (image data chunk).
-    */
-   png_read_info(png_ptr, info_ptr);
+   li->num_trans = 0;
+   li->trans = NULL;
 
-   png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth,
-                &color_type, &interlace_type, NULL, NULL);
+   png_get_IHDR(png_ptr, info_ptr, &li->width, &li->height, &bit_depth,
+                &li->color_type, &li->interlace_type, NULL, NULL);
 
    /* Extract multiple pixels with bit depths of 1, 2, and 4 from a single
     * byte into separate bytes (useful for paletted and grayscale images).
@@ -124,16 +140,27 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
    png_set_packing(png_ptr);
 
    /* Expand grayscale images to the full 8 bits from 1, 2, or 4 bits/pixel */
-   if ((color_type == PNG_COLOR_TYPE_GRAY) && (bit_depth < 8))
+   if ((li->color_type == PNG_COLOR_TYPE_GRAY) && (bit_depth < 8))
       png_set_expand(png_ptr);
 
    /* Adds a full alpha channel if there is transparency information
     * in a tRNS chunk.
     */
+   li->has_alpha = (li->color_type & PNG_COLOR_MASK_ALPHA);
    if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
-      if (!(color_type & PNG_COLOR_MASK_PALETTE))
+      if (!(li->color_type & PNG_COLOR_MASK_PALETTE) ||
+          layout != PNG_LAYOUT_NATIVE)
          png_set_tRNS_to_alpha(png_ptr);
-      png_get_tRNS(png_ptr, info_ptr, &trans, &num_trans, NULL);
+      png_get_tRNS(png_ptr, info_ptr, &li->trans, &li->num_trans, NULL);
+      li->has_alpha = true;
+   }
+
+   if (layout != PNG_LAYOUT_NATIVE) {
+      if (li->color_type & PNG_COLOR_MASK_PALETTE)
+         png_set_palette_to_rgb(png_ptr);
+      png_set_filler(png_ptr, 0xff, PNG_FILLER_AFTER);
+      if (layout == PNG_LAYOUT_BGRA)
+         png_set_bgr(png_ptr);
    }
 
    /* Convert 16-bits per colour component to 8-bits per colour component. */
@@ -141,8 +168,8 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
       png_set_strip_16(png_ptr);
 
    /* Convert grayscale to RGB triplets */
-   if ((color_type == PNG_COLOR_TYPE_GRAY) ||
-       (color_type == PNG_COLOR_TYPE_GRAY_ALPHA))
+   if ((li->color_type == PNG_COLOR_TYPE_GRAY) ||
+       (li->color_type == PNG_COLOR_TYPE_GRAY_ALPHA))
       png_set_gray_to_rgb(png_ptr);
 
    /* Optionally, tell libpng to handle the gamma correction for us. */
@@ -159,7 +186,7 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
    }
 
    /* Turn on interlace handling. */
-   number_passes = png_set_interlace_handling(png_ptr);
+   li->number_passes = png_set_interlace_handling(png_ptr);
 
    /* Call to gamma correct and add the background to the palette
     * and update info structure.
@@ -167,169 +194,285 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
    png_read_update_info(png_ptr, info_ptr);
 
    /* Palettes. */
-   if (color_type & PNG_COLOR_MASK_PALETTE) {
+   if (li->color_type & PNG_COLOR_MASK_PALETTE) {
       int num_palette, i;
       png_colorp palette;
 
       if (png_get_PLTE(png_ptr, info_ptr, &palette, &num_palette)) {
          /* We don't actually dither, we just copy the palette. */
          for (i = 0; ((i < num_palette) && (i < 256)); i++) {
-            pal[i].r = palette[i].red;
-            pal[i].g = palette[i].green;
-            pal[i].b = palette[i].blue;
+            li->pal[i].r = palette[i].red;
+            li->pal[i].g = palette[i].green;
+            li->pal[i].b = palette[i].blue;
          }
 
          for (; i < 256; i++)
-            pal[i].r = pal[i].g = pal[i].b = 0;
+            li->pal[i].r = li->pal[i].g = li->pal[i].b = 0;
       }
    }
 
    rowbytes = png_get_rowbytes(png_ptr, info_ptr);
 
    /* Allocate the memory to hold the image using the fields of info_ptr. */
-   bpp = rowbytes * 8 / width;
+   li->bpp = rowbytes * 8 / li->width;
 
    /* Allegro cannot handle less than 8 bpp. */
-   if (bpp < 8)
-      bpp = 8;
+   if (li->bpp < 8)
+      li->bpp = 8;
 
 
-   if ((bpp == 24) || (bpp == 32)) {
+   if (layout == PNG_LAYOUT_NATIVE && ((li->bpp == 24) || (li->bpp == 32))) {
 #ifdef ALLEGRO_BIG_ENDIAN
       png_set_bgr(png_ptr);
       png_set_swap_alpha(png_ptr);
 #endif
    }
 
-   bmp = al_create_bitmap(width, height);
+   // TODO: can this be different from rowbytes?
+   li->real_rowbytes = ((li->bpp + 7) / 8) * li->width;
+}
+
+
+
+/* convert_png_row:
+ *  Converts n pixels of a row as returned by libpng to RGBA (or to palette
+ *  indices if index_only is set).
+ */
+static void convert_png_row(const PNG_LOAD_INFO *li, unsigned char *dest,
+   unsigned char *ptr, int n, bool index_only, bool premul)
+{
+   int i;
+
+   switch (li->bpp) {
+      case 8:
+         if (index_only) {
+            for (i = 0; i < n; i++) {
+               *(dest++) = *(ptr++);
+            }
+         }
+         else if (li->color_type & PNG_COLOR_MASK_PALETTE) {
+            for (i = 0; i < n; i++) {
+               int pix = ptr[0];
+               ptr++;
+               dest[0] = li->pal[pix].r;
+               dest[1] = li->pal[pix].g;
+               dest[2] = li->pal[pix].b;
+               if (pix < li->num_trans) {
+                  int a = li->trans[pix];
+                  dest[3] = a;
+                  if (premul) {
+                     dest[0] = dest[0] * a / 255;
+                     dest[1] = dest[1] * a / 255;
+                     dest[2] = dest[2] * a / 255;
+                  }
+               } else {
+                  dest[3] = 255;
+               }
+               dest += 4;
+            }
+         }
+         else {
+            for (i = 0; i < n; i++) {
+               int pix = ptr[0];
+               ptr++;
+               *(dest++) = pix;
+               *(dest++) = pix;
+               *(dest++) = pix;
+               *(dest++) = 255;
+            }
+         }
+         break;
+
+      case 24:
+         for (i = 0; i < n; i++) {
+            uint32_t pix = _AL_READ3BYTES(ptr);
+            ptr += 3;
+            *(dest++) = pix & 0xff;
+            *(dest++) = (pix >> 8) & 0xff;
+            *(dest++) = (pix >> 16) & 0xff;
+            *(dest++) = 255;
+         }
+         break;
+
+      case 32:
+         for (i = 0; i < n; i++) {
+            uint32_t pix = *(uint32_t*)ptr;
+            int r = pix & 0xff;
+            int g = (pix >> 8) & 0xff;
+            int b = (pix >> 16) & 0xff;
+            int a = (pix >> 24) & 0xff;
+            ptr += 4;
+
+            if (premul) {
+               r = r * a / 255;
+               g = g * a / 255;
+               b = b * a / 255;
+            }
+
+            *(dest++) = r;
+            *(dest++) = g;
+            *(dest++) = b;
+            *(dest++) = a;
+         }
+         break;
+
+      default:
+         ALLEGRO_ASSERT(li->bpp == 8 || li->bpp == 24 || li->bpp == 32);
+         break;
+   }
+}
+
+
+
+/* direct_png_lock_format:
+ *  Returns the format to lock a bitmap of the given format with so that
+ *  libpng can write rows straight into it, and which layout to ask for.
+ *  Other formats are locked as ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE and
+ *  converted on unlock.
+ */
+static int direct_png_lock_format(int format, int *layout)
+{
+   switch (format) {
+#ifndef ALLEGRO_BIG_ENDIAN
+      case ALLEGRO_PIXEL_FORMAT_ABGR_8888:
+         *layout = PNG_LAYOUT_RGBA;
+         return format;
+      case ALLEGRO_PIXEL_FORMAT_ARGB_8888:
+         *layout = PNG_LAYOUT_BGRA;
+         return format;
+#endif
+      default:
+         *layout = PNG_LAYOUT_RGBA;
+         return ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE;
+   }
+}
+
+
+
+/* premultiply_rows:
+ *  Premultiplies 32 bpp rows in place.  The alpha byte is last in both
+ *  layouts, so the colour bytes need not be told apart.  (t + 1 + (t >> 8))
+ *  >> 8 equals t / 255 for all products of two bytes.
+ */
+static void premultiply_rows(png_bytepp rows, int width, int height)
+{
+   int x, y;
+
+   for (y = 0; y < height; y++) {
+      unsigned char *p = rows[y];
+      for (x = 0; x < width; x++, p += 4) {
+         unsigned a = p[3];
+         if (a != 255) {
+            unsigned t0 = p[0] * a;
+            unsigned t1 = p[1] * a;
+            unsigned t2 = p[2] * a;
+            p[0] = (t0 + 1 + (t0 >> 8)) >> 8;
+            p[1] = (t1 + 1 + (t1 >> 8)) >> 8;
+            p[2] = (t2 + 1 + (t2 >> 8)) >> 8;
+         }
+      }
+   }
+}
+
+
+
+/* really_load_png:
+ *  Worker routine, used by load_png and load_memory_png.
+ */
+static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
+   int flags)
+{
+   ALLEGRO_BITMAP *bmp;
+   PNG_LOAD_INFO li;
+   int pass;
+   ALLEGRO_LOCKED_REGION *lock;
+   png_bytepp rows;
+   unsigned char *buf;
+   unsigned char *dest;
+   bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
+   png_uint_32 y;
+   int layout;
+   int lock_format;
+
+   /* The call to png_read_info() gives us all of the information from the
+    * PNG file before the first IDAT (image data chunk).
+    */
+   png_read_info(png_ptr, info_ptr);
+
+   bmp = al_create_bitmap(png_get_image_width(png_ptr, info_ptr),
+      png_get_image_height(png_ptr, info_ptr));
    if (!bmp) {
       ALLEGRO_ERROR("al_create_bitmap failed while loading PNG.\n");
       return NULL;
    }
 
-   // TODO: can this be different from rowbytes?
-   real_rowbytes = ((bpp + 7) / 8) * width;
-   if (interlace_type == PNG_INTERLACE_ADAM7)
-      buf = al_malloc(real_rowbytes * height);
-   else
-      buf = al_malloc(real_rowbytes);
-
-   if (bpp == 8 && (color_type & PNG_COLOR_MASK_PALETTE) &&
+   if ((png_get_color_type(png_ptr, info_ptr) & PNG_COLOR_MASK_PALETTE) &&
       (flags & ALLEGRO_KEEP_INDEX))
    {
+      setup_png_read(png_ptr, info_ptr, &li, PNG_LAYOUT_NATIVE);
+
+      if (li.interlace_type == PNG_INTERLACE_ADAM7)
+         buf = al_malloc(li.real_rowbytes * li.height);
+      else
+         buf = al_malloc(li.real_rowbytes);
+
       lock = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8,
          ALLEGRO_LOCK_WRITEONLY);
-      index_only = true;
+
+      /* Read the image, one line at a time (easier to debug!) */
+      for (pass = 0; pass < li.number_passes; pass++) {
+         unsigned char *ptr;
+         dest = lock->data;
+
+         for (y = 0; y < li.height; y++) {
+            /* For interlaced pictures, the row needs to be initialized with
+             * the contents of the previous pass.
+             */
+            if (li.interlace_type == PNG_INTERLACE_ADAM7)
+               ptr = buf + y * li.real_rowbytes;
+            else
+               ptr = buf;
+            png_read_row(png_ptr, NULL, ptr);
+
+            convert_png_row(&li, dest, ptr, li.width, true, premul);
+            dest += lock->pitch;
+         }
+      }
+
+      al_free(buf);
    }
    else {
-      lock = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
-         ALLEGRO_LOCK_WRITEONLY);
-      index_only = false;
-   }
-
-   /* Read the image, one line at a time (easier to debug!) */
-   for (pass = 0; pass < number_passes; pass++) {
-      png_uint_32 y;
-      unsigned int i;
-      unsigned char *ptr;
-      dest = lock->data;
-
-      for (y = 0; y < height; y++) {
-         unsigned char *dest_row_start = dest;
-         /* For interlaced pictures, the row needs to be initialized with
-          * the contents of the previous pass.
-          */
-         if (interlace_type == PNG_INTERLACE_ADAM7)
-            ptr = buf + y * real_rowbytes;
-         else
-            ptr = buf;
-         png_read_row(png_ptr, NULL, ptr);
-   
-         switch (bpp) {
-            case 8:
-               if (index_only) {
-                  for (i = 0; i < width; i++) {
-                     *(dest++) = *(ptr++);
-                  }
-               }
-               else if (color_type & PNG_COLOR_MASK_PALETTE) {
-                  for (i = 0; i < width; i++) {
-                     int pix = ptr[0];
-                     ptr++;
-                     dest[0] = pal[pix].r;
-                     dest[1] = pal[pix].g;
-                     dest[2] = pal[pix].b;
-                     if (pix < num_trans) {
-                        int a = trans[pix];
-                        dest[3] = a;
-                        if (premul) {
-                           dest[0] = dest[0] * a / 255;
-                           dest[1] = dest[1] * a / 255;
-                           dest[2] = dest[2] * a / 255;
-                        }
-                     } else {
-                        dest[3] = 255;
-                     }
-                     dest += 4;
-                  }
-               }
-               else {
-                  for (i = 0; i < width; i++) {
-                     int pix = ptr[0];
-                     ptr++;
-                     *(dest++) = pix;
-                     *(dest++) = pix;
-                     *(dest++) = pix;
-                     *(dest++) = 255;
-                  }
-               }
-               break;
-
-            case 24:
-               for (i = 0; i < width; i++) {
-                  uint32_t pix = _AL_READ3BYTES(ptr);
-                  ptr += 3;
-                  *(dest++) = pix & 0xff;
-                  *(dest++) = (pix >> 8) & 0xff;
-                  *(dest++) = (pix >> 16) & 0xff;
-                  *(dest++) = 255;
-               }
-               break;
+      /* Let libpng expand everything to 32 bpp and decode straight into
+       * the bitmap, in its own format where possible.  Interlaced images
+       * need no separate buffer either, libpng combines the passes in
+       * place.
+       */
+      lock_format = direct_png_lock_format(al_get_bitmap_format(bmp), &layout);
+      setup_png_read(png_ptr, info_ptr, &li, layout);
+      ALLEGRO_ASSERT(li.bpp == 32);
+
+      lock = al_lock_bitmap(bmp, lock_format, ALLEGRO_LOCK_WRITEONLY);
+      rows = al_malloc(li.height * sizeof(png_bytep));
+      if (!lock || !rows) {
+         ALLEGRO_ERROR("Out of memory while loading PNG.\n");
+         al_free(rows);
+         al_destroy_bitmap(bmp);
+         return NULL;
+      }
 
-            case 32:
-               for (i = 0; i < width; i++) {
-                  uint32_t pix = *(uint32_t*)ptr;
-                  int r = pix & 0xff;
-                  int g = (pix >> 8) & 0xff;
-                  int b = (pix >> 16) & 0xff;
-                  int a = (pix >> 24) & 0xff;
-                  ptr += 4;
+      for (y = 0; y < li.height; y++)
+         rows[y] = (unsigned char *)lock->data + y * lock->pitch;
 
-                  if (premul) {
-                     r = r * a / 255;
-                     g = g * a / 255;
-                     b = b * a / 255;
-                  }
+      png_read_image(png_ptr, rows);
 
-                  *(dest++) = r;
-                  *(dest++) = g;
-                  *(dest++) = b;
-                  *(dest++) = a;
-               }
-               break;
+      if (premul && li.has_alpha)
+         premultiply_rows(rows, li.width, li.height);
 
-            default:
-               ALLEGRO_ASSERT(bpp == 8 || bpp == 24 || bpp == 32);
-               break;
-         }
-         dest = dest_row_start + lock->pitch;
-      }
+      al_free(rows);
    }
 
    al_unlock_bitmap(bmp);
 
-   al_free(buf);
-
    /* Read rest of file, and get additional chunks in info_ptr. */
    png_read_end(png_ptr, info_ptr);
 
@@ -337,20 +480,17 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
 }
 
 
-/* Load a PNG file from disk, doing colour coversion if required.
+
+/* create_png_read_struct:
+ *  Checks the signature and creates the libpng structures for reading from
+ *  an Allegro file.  The caller still has to set up the error handler.
  */
-ALLEGRO_BITMAP *_al_load_png_f(ALLEGRO_FILE *fp, int flags)
+static bool create_png_read_struct(ALLEGRO_FILE *fp, png_structp *png_ptr,
+   png_infop *info_ptr)
 {
-   jmp_buf jmpbuf;
-   ALLEGRO_BITMAP *bmp;
-   png_structp png_ptr;
-   png_infop info_ptr;
-
-   ALLEGRO_ASSERT(fp);
-
    if (!check_if_png(fp)) {
       ALLEGRO_ERROR("Not a png.\n");
-      return NULL;
+      return false;
    }
 
    /* Create and initialize the png_struct with the desired error handler
@@ -359,21 +499,46 @@ ALLEGRO_BITMAP *_al_load_png_f(ALLEGRO_FILE *fp, int flags)
     * the compiler header file version, so that we know if the application
     * was compiled with a compatible version of the library.
     */
-   png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
-                                    (void *)NULL, NULL, NULL);
-   if (!png_ptr) {
+   *png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                     (void *)NULL, NULL, NULL);
+   if (!*png_ptr) {
       ALLEGRO_ERROR("png_ptr == NULL\n");
-      return NULL;
+      return false;
    }
 
    /* Allocate/initialize the memory for image information. */
-   info_ptr = png_create_info_struct(png_ptr);
-   if (!info_ptr) {
-      png_destroy_read_struct(&png_ptr, (png_infopp) NULL, (png_infopp) NULL);
+   *info_ptr = png_create_info_struct(*png_ptr);
+   if (!*info_ptr) {
+      png_destroy_read_struct(png_ptr, (png_infopp) NULL, (png_infopp) NULL);
       ALLEGRO_ERROR("png_create_info_struct failed\n");
-      return NULL;
+      return false;
    }
 
+   /* Use Allegro packfile routines. */
+   png_set_read_fn(*png_ptr, fp, (png_rw_ptr) read_data);
+
+   /* We have already read some of the signature. */
+   png_set_sig_bytes(*png_ptr, PNG_BYTES_TO_CHECK);
+
+   return true;
+}
+
+
+
+/* Load a PNG file from disk, doing colour coversion if required.
+ */
+ALLEGRO_BITMAP *_al_load_png_f(ALLEGRO_FILE *fp, int flags)
+{
+   jmp_buf jmpbuf;
+   ALLEGRO_BITMAP *bmp;
+   png_structp png_ptr;
+   png_infop info_ptr;
+
+   ALLEGRO_ASSERT(fp);
+
+   if (!create_png_read_struct(fp, &png_ptr, &info_ptr))
+      return NULL;
+
    /* Set error handling. */
    if (setjmp(jmpbuf)) {
       /* Free all of the memory associated with the png_ptr and info_ptr */
@@ -384,12 +549,6 @@ ALLEGRO_BITMAP *_al_load_png_f(ALLEGRO_FILE *fp, int flags)
    }
    png_set_error_fn(png_ptr, jmpbuf, user_error_fn, NULL);
 
-   /* Use Allegro packfile routines. */
-   png_set_read_fn(png_ptr, fp, (png_rw_ptr) read_data);
-
-   /* We have already read some of the signature. */
-   png_set_sig_bytes(png_ptr, PNG_BYTES_TO_CHECK);
-
    /* Really load the image now. */
    bmp = really_load_png(png_ptr, info_ptr, flags);
 
@@ -401,6 +560,111 @@ ALLEGRO_BITMAP *_al_load_png_f(ALLEGRO_FILE *fp, int flags)
 
 
 
+/* We keep data for load_png_rows_helper in a structure allocated in the
+ * caller's stack frame so that it is still valid after a longjmp.
+ */
+struct load_png_rows_data {
+   png_structp png_ptr;
+   png_infop info_ptr;
+   unsigned char *buf;
+   unsigned char *row;
+};
+
+/* load_png_rows_helper:
+ *  Streams the rows of the requested rectangle to the callback.  Rows above
+ *  the rectangle still have to be inflated, but are never converted, and
+ *  nothing below the rectangle is read at all.  Only interlaced images need
+ *  a buffer for the whole image.
+ */
+static bool load_png_rows_helper(struct load_png_rows_data *data, int flags,
+   const _AL_IMAGE_ROW_REQUEST *req)
+{
+   PNG_LOAD_INFO li;
+   ALLEGRO_IMAGE_ROWS info;
+   bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
+   bool interlaced;
+   png_uint_32 y, last;
+   int pass;
+
+   png_read_info(data->png_ptr, data->info_ptr);
+   setup_png_read(data->png_ptr, data->info_ptr, &li, PNG_LAYOUT_NATIVE);
+
+   if (!_al_clip_image_rows(req, li.width, li.height, &info))
+      return false;
+
+   interlaced = (li.interlace_type == PNG_INTERLACE_ADAM7);
+   last = info.y + info.height;
+
+   if (interlaced)
+      data->buf = al_malloc(li.real_rowbytes * last);
+   else
+      data->buf = al_malloc(li.real_rowbytes);
+   data->row = al_malloc(info.width * 4);
+   if (!data->buf || !data->row)
+      return false;
+
+   /* All passes of an interlaced image have to be read before any row is
+    * complete, but nothing after the last row we need is used.
+    */
+   if (interlaced) {
+      for (pass = 0; pass < li.number_passes - 1; pass++) {
+         for (y = 0; y < li.height; y++) {
+            png_read_row(data->png_ptr, NULL, y < last ?
+               data->buf + y * li.real_rowbytes : NULL);
+         }
+      }
+   }
+
+   for (y = 0; y < last; y++) {
+      unsigned char *ptr = data->buf;
+      if (interlaced)
+         ptr += y * li.real_rowbytes;
+      png_read_row(data->png_ptr, NULL, ptr);
+
+      if (y < (png_uint_32)info.y)
+         continue;
+
+      convert_png_row(&li, data->row, ptr + info.x * (li.bpp / 8),
+         info.width, false, premul);
+      if (!req->callback(&info, y - info.y, data->row, req->extra))
+         break;
+   }
+
+   return true;
+}
+
+bool _al_load_png_rows_f(ALLEGRO_FILE *fp, int flags,
+   const _AL_IMAGE_ROW_REQUEST *req)
+{
+   jmp_buf jmpbuf;
+   struct load_png_rows_data data;
+   bool ret;
+
+   ALLEGRO_ASSERT(fp);
+   ALLEGRO_ASSERT(req);
+
+   memset(&data, 0, sizeof(data));
+   if (!create_png_read_struct(fp, &data.png_ptr, &data.info_ptr))
+      return false;
+
+   if (setjmp(jmpbuf)) {
+      ALLEGRO_ERROR("Error reading PNG file\n");
+      ret = false;
+   }
+   else {
+      png_set_error_fn(data.png_ptr, jmpbuf, user_error_fn, NULL);
+      ret = load_png_rows_helper(&data, flags, req);
+   }
+
+   png_destroy_read_struct(&data.png_ptr, &data.info_ptr, (png_infopp) NULL);
+   al_free(data.buf);
+   al_free(data.row);
+
+   return ret;
+}
+
+
+
 
 
 ALLEGRO_BITMAP *_al_load_png(const char *filename, int flags)
@@ -471,6 +735,329 @@ static int translate_compression_level(const char* value) {
    return strtol(value, NULL, 10);
 }
 
+/* Large images are saved by our own banded encoder, pigz-style.  The image
+ * is split into bands of rows which are filtered and deflated independently
+ * on the task worker pool.  Every band but the last ends with a sync flush,
+ * so the raw deflate streams can simply be concatenated, and each band is
+ * primed with the filtered data of the 32 KiB before it, so the compression
+ * ratio is almost the same as for a single stream.
+ */
+#define PNG_BAND_BYTES     (1 << 20)
+#define PNG_WINDOW_SIZE    32768
+
+/* translate_band_rows:
+ *  Translate the png_band_rows config value into the number of rows per
+ *  band, or 0 to use libpng.  A number forces the banded encoder whatever
+ *  the worker count; "auto" (or NULL) picks about PNG_BAND_BYTES per band
+ *  if there is more than one worker.
+ */
+static int translate_band_rows(const char *value, int width)
+{
+   if (!value || strcmp(value, "auto") == 0) {
+      if (al_get_task_worker_count() < 2)
+         return 0;
+      return _ALLEGRO_MAX(1, PNG_BAND_BYTES / (width * 4 + 1));
+   }
+   return _ALLEGRO_MAX(0, strtol(value, NULL, 10));
+}
+
+typedef struct PNG_BAND {
+   const unsigned char *pixels;
+   int pitch;
+   int width;
+   int y0, y1;
+   int level;
+   bool last;
+   unsigned char *out;
+   size_t out_size;
+   uLong adler;
+   bool ok;
+} PNG_BAND;
+
+
+
+static int paeth_predictor(int a, int b, int c)
+{
+   int p = a + b - c;
+   int pa = abs(p - a);
+   int pb = abs(p - b);
+   int pc = abs(p - c);
+
+   if (pa <= pb && pa <= pc)
+      return a;
+   if (pb <= pc)
+      return b;
+   return c;
+}
+
+
+
+/* filter_rgba_row:
+ *  Writes the filter type byte and the filtered bytes of one 32 bpp row to
+ *  out.  Like libpng we try all five filters and keep the one with the
+ *  smallest sum of absolute (signed) values.  The loops are kept simple so
+ *  the compiler can vectorise them.  scratch must hold 4 * n bytes.
+ */
+static void filter_rgba_row(const unsigned char *row, const unsigned char *prev,
+   int n, unsigned char *scratch, unsigned char *out)
+{
+   unsigned char *f[4];
+   unsigned sum[5] = {0, 0, 0, 0, 0};
+   int i, best;
+
+   for (i = 0; i < 4; i++)
+      f[i] = scratch + i * n;
+
+   for (i = 0; i < n; i++) {
+      int left = (i >= 4) ? row[i - 4] : 0;
+      int upleft = (i >= 4) ? prev[i - 4] : 0;
+      unsigned char sub = row[i] - left;
+      unsigned char up = row[i] - prev[i];
+      unsigned char avg = row[i] - ((left + prev[i]) >> 1);
+      unsigned char pae = row[i] - paeth_predictor(left, prev[i], upleft);
+
+      f[0][i] = sub;
+      f[1][i] = up;
+      f[2][i] = avg;
+      f[3][i] = pae;
+      sum[0] += abs((signed char)row[i]);
+      sum[1] += abs((signed char)sub);
+      sum[2] += abs((signed char)up);
+      sum[3] += abs((signed char)avg);
+      sum[4] += abs((signed char)pae);
+   }
+
+   best = 0;
+   for (i = 1; i < 5; i++) {
+      if (sum[i] < sum[best])
+         best = i;
+   }
+
+   out[0] = best;
+   memcpy(out + 1, best == 0 ? row : f[best - 1], n);
+}
+
+
+
+/* png_band_proc:
+ *  Filters and deflates one band.  Runs on a task worker.
+ */
+static void png_band_proc(void *arg)
+{
+   PNG_BAND *band = arg;
+   const int n = band->width * 4;
+   const size_t rowbytes = n + 1;
+   unsigned char *filtered = NULL;
+   unsigned char *scratch = NULL;
+   unsigned char *zero = NULL;
+   size_t dict_bytes, in_bytes, bound;
+   int dict_rows, y;
+   z_stream z;
+
+   band->ok = false;
+
+   /* Refilter enough rows before the band to fill the deflate window.
+    * Filtering is deterministic, so they come out exactly as the previous
+    * band compressed them.
+    */
+   dict_rows = _ALLEGRO_MIN(band->y0,
+      (int)((PNG_WINDOW_SIZE + rowbytes - 1) / rowbytes));
+   dict_bytes = dict_rows * rowbytes;
+   in_bytes = (band->y1 - band->y0) * rowbytes;
+
+   filtered = al_malloc(dict_bytes + in_bytes);
+   scratch = al_malloc(4 * n);
+   zero = al_calloc(1, n);
+   if (!filtered || !scratch || !zero)
+      goto done;
+
+   for (y = band->y0 - dict_rows; y < band->y1; y++) {
+      const unsigned char *row = band->pixels + y * band->pitch;
+      const unsigned char *prev = (y > 0) ? row - band->pitch : zero;
+      filter_rgba_row(row, prev, n, scratch,
+         filtered + (y - (band->y0 - dict_rows)) * rowbytes);
+   }
+
+   band->adler = adler32(adler32(0L, Z_NULL, 0), filtered + dict_bytes,
+      in_bytes);
+
+   memset(&z, 0, sizeof(z));
+   if (deflateInit2(&z, band->level, Z_DEFLATED, -15, 8, Z_FILTERED) != Z_OK)
+      goto done;
+
+   if (dict_bytes > 0) {
+      size_t len = _ALLEGRO_MIN(dict_bytes, PNG_WINDOW_SIZE);
+      deflateSetDictionary(&z, filtered + dict_bytes - len, len);
+   }
+
+   /* A sync flush adds an empty stored block on top of deflateBound. */
+   bound = deflateBound(&z, in_bytes) + 16;
+   band->out = al_malloc(bound);
+   if (band->out) {
+      int ret;
+      z.next_in = filtered + dict_bytes;
+      z.avail_in = in_bytes;
+      z.next_out = band->out;
+      z.avail_out = bound;
+      ret = deflate(&z, band->last ? Z_FINISH : Z_SYNC_FLUSH);
+      band->out_size = bound - z.avail_out;
+      band->ok = band->last ? (ret == Z_STREAM_END) :
+         (ret == Z_OK && z.avail_in == 0);
+   }
+   deflateEnd(&z);
+
+ done:
+   al_free(filtered);
+   al_free(scratch);
+   al_free(zero);
+}
+
+
+
+static bool write_chunk(ALLEGRO_FILE *fp, const char *type,
+   const unsigned char *head, size_t head_len,
+   const unsigned char *data, size_t data_len,
+   const unsigned char *tail, size_t tail_len)
+{
+   uLong crc = crc32(0L, Z_NULL, 0);
+
+   al_fwrite32be(fp, head_len + data_len + tail_len);
+   al_fwrite(fp, type, 4);
+   crc = crc32(crc, (const Bytef *)type, 4);
+   if (head_len) {
+      al_fwrite(fp, head, head_len);
+      crc = crc32(crc, head, head_len);
+   }
+   if (data_len) {
+      al_fwrite(fp, data, data_len);
+      crc = crc32(crc, data, data_len);
+   }
+   if (tail_len) {
+      al_fwrite(fp, tail, tail_len);
+      crc = crc32(crc, tail, tail_len);
+   }
+   al_fwrite32be(fp, crc);
+
+   return !al_ferror(fp);
+}
+
+
+
+/* save_rgba_banded:
+ *  Writes a 32 bpp PNG with the banded encoder, including all chunks.
+ */
+static bool save_rgba_banded(ALLEGRO_FILE *fp, ALLEGRO_BITMAP *bmp,
+   int level, int rows_per_band)
+{
+   static const unsigned char signature[8] = {
+      0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+   };
+   const int w = al_get_bitmap_width(bmp);
+   const int h = al_get_bitmap_height(bmp);
+   const int num_bands = (h + rows_per_band - 1) / rows_per_band;
+   ALLEGRO_LOCKED_REGION *lock;
+   ALLEGRO_TASK_GROUP *group;
+   PNG_BAND *bands;
+   unsigned char ihdr[13];
+   unsigned char zhead[2];
+   unsigned char ztail[4];
+   uLong adler;
+   bool ok = true;
+   int i;
+
+   bands = al_calloc(num_bands, sizeof(PNG_BAND));
+   if (!bands)
+      return false;
+
+   lock = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_READONLY);
+   if (!lock) {
+      al_free(bands);
+      return false;
+   }
+
+   group = al_create_task_group();
+   for (i = 0; i < num_bands; i++) {
+      PNG_BAND *band = &bands[i];
+      band->pixels = lock->data;
+      band->pitch = lock->pitch;
+      band->width = w;
+      band->y0 = i * rows_per_band;
+      band->y1 = _ALLEGRO_MIN(h, band->y0 + rows_per_band);
+      band->level = level;
+      band->last = (i == num_bands - 1);
+      if (!group || !al_run_task(group, png_band_proc, band))
+         png_band_proc(band);
+   }
+   if (group) {
+      al_wait_task_group(group);
+      al_destroy_task_group(group);
+   }
+
+   al_unlock_bitmap(bmp);
+
+   /* The adler32 of the whole zlib stream is combined from the bands. */
+   adler = adler32(0L, Z_NULL, 0);
+   for (i = 0; i < num_bands; i++) {
+      ok = ok && bands[i].ok;
+      adler = adler32_combine(adler, bands[i].adler,
+         (bands[i].y1 - bands[i].y0) * (w * 4 + 1));
+   }
+
+   if (ok) {
+      /* zlib header: deflate with a 32K window, FLEVEL from the level. */
+      zhead[0] = 0x78;
+      if (level >= 0 && level < 2)
+         zhead[1] = 0x01;
+      else if (level >= 2 && level < 6)
+         zhead[1] = 0x5e;
+      else if (level <= 6)
+         zhead[1] = 0x9c;
+      else
+         zhead[1] = 0xda;
+
+      ztail[0] = adler >> 24;
+      ztail[1] = adler >> 16;
+      ztail[2] = adler >> 8;
+      ztail[3] = adler;
+
+      ihdr[0] = w >> 24;
+      ihdr[1] = w >> 16;
+      ihdr[2] = w >> 8;
+      ihdr[3] = w;
+      ihdr[4] = h >> 24;
+      ihdr[5] = h >> 16;
+      ihdr[6] = h >> 8;
+      ihdr[7] = h;
+      ihdr[8] = 8;
+      ihdr[9] = PNG_COLOR_TYPE_RGB_ALPHA;
+      ihdr[10] = PNG_COMPRESSION_TYPE_BASE;
+      ihdr[11] = PNG_FILTER_TYPE_BASE;
+      ihdr[12] = PNG_INTERLACE_NONE;
+
+      ok = (al_fwrite(fp, signature, 8) == 8);
+      ok = ok && write_chunk(fp, "IHDR", ihdr, 13, NULL, 0, NULL, 0);
+      for (i = 0; ok && i < num_bands; i++) {
+         ok = write_chunk(fp, "IDAT",
+            zhead, (i == 0) ? 2 : 0,
+            bands[i].out, bands[i].out_size,
+            ztail, bands[i].last ? 4 : 0);
+      }
+      ok = ok && write_chunk(fp, "IEND", NULL, 0, NULL, 0, NULL, 0);
+   }
+   else {
+      ALLEGRO_ERROR("Failed to compress PNG band.\n");
+   }
+
+   for (i = 0; i < num_bands; i++)
+      al_free(bands[i].out);
+   al_free(bands);
+
+   return ok;
+}
+
+
+
 /* save_rgba:
  *  Core save routine for 32 bpp images.
  */
@@ -506,6 +1093,23 @@ bool _al_save_png_f(ALLEGRO_FILE *fp, ALLEGRO_BITMAP *bmp)
    png_structp png_ptr = NULL;
    png_infop info_ptr = NULL;
    int colour_type;
+   int rows_per_band;
+
+   /* Set compression level. */
+   int z_level = translate_compression_level(
+      al_get_config_value(al_get_system_config(), "image", "png_compression_level")
+   );
+
+   /* Use the banded encoder if there is more than one band and more than
+    * one worker to run them on.
+    */
+   rows_per_band = translate_band_rows(
+      al_get_config_value(al_get_system_config(), "image", "png_band_rows"),
+      al_get_bitmap_width(bmp)
+   );
+   if (rows_per_band > 0 && al_get_bitmap_height(bmp) > rows_per_band) {
+      return save_rgba_banded(fp, bmp, z_level, rows_per_band);
+   }
 
    /* Create and initialize the png_struct with the
     * desired error handler functions.
@@ -544,10 +1148,6 @@ bool _al_save_png_f(ALLEGRO_FILE *fp, ALLEGRO_BITMAP *bmp)
     */
    colour_type = PNG_COLOR_TYPE_RGB_ALPHA;
 
-   /* Set compression level. */
-   int z_level = translate_compression_level(
-      al_get_config_value(al_get_system_config(), "image", "png_compression_level")
-   );
    png_set_compression_level(png_ptr, z_level);
 
    png_set_IHDR(png_ptr, info_ptr,
@@ -0,0 +1,254 @@
+/* Loading parts of images and streaming image rows.
+ */
+
+#include <string.h>
+
+#define ALLEGRO_INTERNAL_UNSTABLE
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_image.h"
+
+ALLEGRO_DEBUG_CHANNEL("image")
+
+
+typedef struct REGION_LOAD {
+   ALLEGRO_BITMAP *bmp;
+   ALLEGRO_LOCKED_REGION *lock;
+} REGION_LOAD;
+
+
+
+/* Clips the requested rectangle to the image.  Returns false if nothing of
+ * the image is left.
+ */
+bool _al_clip_image_rows(const _AL_IMAGE_ROW_REQUEST *req, int image_w,
+   int image_h, ALLEGRO_IMAGE_ROWS *rows)
+{
+   int x1, y1, x2, y2;
+
+   x1 = _ALLEGRO_MAX(req->x, 0);
+   y1 = _ALLEGRO_MAX(req->y, 0);
+   x2 = (req->w > 0) ? _ALLEGRO_MIN(req->x + req->w, image_w) : image_w;
+   y2 = (req->h > 0) ? _ALLEGRO_MIN(req->y + req->h, image_h) : image_h;
+
+   if (x1 >= x2 || y1 >= y2) {
+      ALLEGRO_ERROR("Region %d,%d %dx%d is outside the %dx%d image.\n",
+         req->x, req->y, req->w, req->h, image_w, image_h);
+      return false;
+   }
+
+   rows->image_width = image_w;
+   rows->image_height = image_h;
+   rows->x = x1;
+   rows->y = y1;
+   rows->width = x2 - x1;
+   rows->height = y2 - y1;
+   return true;
+}
+
+
+
+/* For formats without a row reader we decode the whole image into a memory
+ * bitmap and stream the rows out of that.
+ */
+static bool load_rows_fallback(ALLEGRO_FILE *fp, const char *ident, int flags,
+   const _AL_IMAGE_ROW_REQUEST *req)
+{
+   ALLEGRO_STATE state;
+   ALLEGRO_BITMAP *bmp;
+   ALLEGRO_LOCKED_REGION *lock;
+   ALLEGRO_IMAGE_ROWS info;
+   bool ret = false;
+   int y;
+
+   al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+   al_set_new_bitmap_load_size(0, 0);
+   bmp = al_load_bitmap_flags_f(fp, ident, flags & ~ALLEGRO_KEEP_INDEX);
+   al_restore_state(&state);
+
+   if (!bmp)
+      return false;
+
+   if (_al_clip_image_rows(req, al_get_bitmap_width(bmp),
+         al_get_bitmap_height(bmp), &info)) {
+      lock = al_lock_bitmap_region(bmp, info.x, info.y, info.width,
+         info.height, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+         ALLEGRO_LOCK_READONLY);
+      if (lock) {
+         for (y = 0; y < info.height; y++) {
+            const unsigned char *row = (unsigned char *)lock->data +
+               y * lock->pitch;
+            if (!req->callback(&info, y, row, req->extra))
+               break;
+         }
+         al_unlock_bitmap(bmp);
+         ret = true;
+      }
+   }
+
+   al_destroy_bitmap(bmp);
+   return ret;
+}
+
+
+
+static bool load_rows(ALLEGRO_FILE *fp, const char *ident, int flags,
+   const _AL_IMAGE_ROW_REQUEST *req)
+{
+   const char *ext = al_identify_bitmap_f(fp);
+   if (ext)
+      ident = ext;
+   if (!ident) {
+      ALLEGRO_ERROR("Could not identify bitmap.\n");
+      return false;
+   }
+
+#ifdef ALLEGRO_CFG_IIO_HAVE_PNG
+   if (0 == _al_stricmp(ident, ".png"))
+      return _al_load_png_rows_f(fp, flags, req);
+#endif
+
+#ifdef ALLEGRO_CFG_IIO_HAVE_JPG
+   if (0 == _al_stricmp(ident, ".jpg") || 0 == _al_stricmp(ident, ".jpeg"))
+      return _al_load_jpg_rows_f(fp, flags, req);
+#endif
+
+   return load_rows_fallback(fp, ident, flags, req);
+}
+
+
+
+/* Function: al_load_bitmap_rows_f
+ */
+bool al_load_bitmap_rows_f(ALLEGRO_FILE *fp, const char *ident,
+   int x, int y, int w, int h, int flags,
+   bool (*callback)(const ALLEGRO_IMAGE_ROWS *rows, int row,
+      const unsigned char *pixels, void *extra),
+   void *extra)
+{
+   _AL_IMAGE_ROW_REQUEST req;
+
+   ASSERT(fp);
+   ASSERT(callback);
+
+   req.x = x;
+   req.y = y;
+   req.w = w;
+   req.h = h;
+   req.callback = callback;
+   req.extra = extra;
+
+   return load_rows(fp, ident, flags, &req);
+}
+
+
+
+/* Function: al_load_bitmap_rows
+ */
+bool al_load_bitmap_rows(const char *filename,
+   int x, int y, int w, int h, int flags,
+   bool (*callback)(const ALLEGRO_IMAGE_ROWS *rows, int row,
+      const unsigned char *pixels, void *extra),
+   void *extra)
+{
+   ALLEGRO_FILE *fp;
+   bool ret;
+
+   ASSERT(filename);
+
+   fp = al_fopen(filename, "rb");
+   if (!fp) {
+      ALLEGRO_ERROR("Unable to open %s for reading.\n", filename);
+      return false;
+   }
+
+   ret = al_load_bitmap_rows_f(fp, strrchr(filename, '.'), x, y, w, h,
+      flags, callback, extra);
+
+   al_fclose(fp);
+
+   return ret;
+}
+
+
+
+static bool region_row(const ALLEGRO_IMAGE_ROWS *rows, int row,
+   const unsigned char *pixels, void *extra)
+{
+   REGION_LOAD *load = extra;
+
+   if (!load->bmp) {
+      load->bmp = al_create_bitmap(rows->width, rows->height);
+      if (!load->bmp) {
+         ALLEGRO_ERROR("%dx%d bitmap creation failed\n", rows->width,
+            rows->height);
+         return false;
+      }
+      load->lock = al_lock_bitmap(load->bmp,
+         ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+      if (!load->lock)
+         return false;
+   }
+
+   memcpy((unsigned char *)load->lock->data + row * load->lock->pitch,
+      pixels, rows->width * 4);
+   return true;
+}
+
+
+
+/* Function: al_load_bitmap_region_f
+ */
+ALLEGRO_BITMAP *al_load_bitmap_region_f(ALLEGRO_FILE *fp, const char *ident,
+   int x, int y, int w, int h, int flags)
+{
+   REGION_LOAD load;
+   bool ok;
+
+   ASSERT(fp);
+
+   load.bmp = NULL;
+   load.lock = NULL;
+   ok = al_load_bitmap_rows_f(fp, ident, x, y, w, h, flags, region_row,
+      &load);
+
+   if (load.lock)
+      al_unlock_bitmap(load.bmp);
+   if (load.bmp && (!ok || !load.lock)) {
+      al_destroy_bitmap(load.bmp);
+      load.bmp = NULL;
+   }
+
+   return load.bmp;
+}
+
+
+
+/* Function: al_load_bitmap_region
+ */
+ALLEGRO_BITMAP *al_load_bitmap_region(const char *filename,
+   int x, int y, int w, int h, int flags)
+{
+   ALLEGRO_FILE *fp;
+   ALLEGRO_BITMAP *bmp;
+
+   ASSERT(filename);
+
+   fp = al_fopen(filename, "rb");
+   if (!fp) {
+      ALLEGRO_ERROR("Unable to open %s for reading.\n", filename);
+      return NULL;
+   }
+
+   bmp = al_load_bitmap_region_f(fp, strrchr(filename, '.'), x, y, w, h,
+      flags);
+
+   al_fclose(fp);
+
+   return bmp;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
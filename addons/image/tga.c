@@ -22,6 +22,8 @@
  */
 
 
+#include <string.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
 #include "allegro5/internal/aintern_image.h"
@@ -32,168 +34,48 @@
 ALLEGRO_DEBUG_CHANNEL("image")
 
 
-/* raw_tga_read8:
- *  Helper for reading 256-color raw data from TGA files.
- *  Returns pointer past the end.
+/* raw_tga_read:
+ *  Helper for reading a row of raw data from TGA files.  A short read is
+ *  padded with zeros.
  */
-static INLINE unsigned char *raw_tga_read8(unsigned char *b, int w, ALLEGRO_FILE *f)
+static void raw_tga_read(unsigned char *b, int w, int size, ALLEGRO_FILE *f)
 {
-   return b + al_fread(f, b, w);
-}
-
+   size_t n = (size_t)w * size;
+   size_t got = al_fread(f, b, n);
 
-
-/* rle_tga_read8:
- *  Helper for reading 256-color RLE data from TGA files.
- *  Returns pointer past the end or NULL for error.
- */
-static unsigned char *rle_tga_read8(unsigned char *b, int w, ALLEGRO_FILE *f)
-{
-   int value, count, c = 0;
-
-   do {
-      count = al_fgetc(f);
-      if (count & 0x80) {
-         /* run-length packet */
-         count = (count & 0x7F) + 1;
-         c += count;
-         if (c > w) {
-            /* Stepped past the end of the line, error */
-            return NULL;
-         }
-         value = al_fgetc(f);
-         while (count--)
-            *b++ = value;
-      }
-      else {
-         /* raw packet */
-         count++;
-         c += count;
-         if (c > w) {
-            /* Stepped past the end of the line, error */
-            return NULL;
-         }
-         b = raw_tga_read8(b, count, f);
-      }
-   } while (c < w);
-   return b;
+   if (got < n)
+      memset(b + got, 0, n - got);
 }
 
 
 
-/* single_tga_read32:
- *  Helper for reading a single 32-bit data from TGA files.
+/* rle_tga_read:
+ *  Helper for reading a row of RLE data from TGA files, with pixels of
+ *  the given size in bytes.  Returns false for error.
  */
-static INLINE int32_t single_tga_read32(ALLEGRO_FILE *f)
-{
-   return al_fread32le(f);
-}
-
-
-
-/* raw_tga_read32:
- *  Helper for reading 32-bit raw data from TGA files.
- *  Returns pointer past the end.
- */
-static unsigned int *raw_tga_read32(unsigned int *b, int w, ALLEGRO_FILE *f)
-{
-   while (w--)
-      *b++ = single_tga_read32(f);
-
-   return b;
-}
-
-
-
-/* rle_tga_read32:
- *  Helper for reading 32-bit RLE data from TGA files.
- *  Returns pointer past the end or NULL for error.
- */
-static unsigned int *rle_tga_read32(unsigned int *b, int w, ALLEGRO_FILE *f)
-{
-   int color, count, c = 0;
-
-   do {
-      count = al_fgetc(f);
-      if (count & 0x80) {
-         /* run-length packet */
-         count = (count & 0x7F) + 1;
-         c += count;
-         if (c > w) {
-            /* Stepped past the end of the line, error */
-            return NULL;
-         }
-         color = single_tga_read32(f);
-         while (count--)
-            *b++ = color;
-      }
-      else {
-         /* raw packet */
-         count++;
-         c += count;
-         if (c > w) {
-            /* Stepped past the end of the line, error */
-            return NULL;
-         }
-         b = raw_tga_read32(b, count, f);
-      }
-   } while (c < w);
-   return b;
-}
-
-
-/* single_tga_read24:
- *  Helper for reading a single 24-bit data from TGA files.
- */
-static INLINE void single_tga_read24(ALLEGRO_FILE *f, unsigned char color[3])
-{
-   al_fread(f, color, 3);
-}
-
-
-
-/* raw_tga_read24:
- *  Helper for reading 24-bit raw data from TGA files.
- *  Returns pointer past the end.
- */
-static unsigned char *raw_tga_read24(unsigned char *b, int w, ALLEGRO_FILE *f)
-{
-   while (w--) {
-      single_tga_read24(f, b);
-      b += 3;
-   }
-
-   return b;
-}
-
-
-
-/* rle_tga_read24:
- *  Helper for reading 24-bit RLE data from TGA files.
- *  Returns pointer past the end or NULL for error.
- */
-static unsigned char *rle_tga_read24(unsigned char *b, int w, ALLEGRO_FILE *f)
+static bool rle_tga_read(unsigned char *b, int w, int size, ALLEGRO_FILE *f)
 {
    int count, c = 0;
-   unsigned char color[3];
 
    do {
       count = al_fgetc(f);
+      if (count == EOF)
+         return false;
       if (count & 0x80) {
          /* run-length packet */
          count = (count & 0x7F) + 1;
          c += count;
          if (c > w) {
             /* Stepped past the end of the line, error */
-            return NULL;
+            return false;
          }
-         single_tga_read24(f, color);
-         while (count--) {
-            b[0] = color[0];
-            b[1] = color[1];
-            b[2] = color[2];
-            b += 3;
+         if (al_fread(f, b, size) != (size_t)size)
+            return false;
+         while (--count) {
+            memcpy(b + size, b, size);
+            b += size;
          }
+         b += size;
       }
       else {
          /* raw packet */
@@ -201,76 +83,18 @@ static unsigned char *rle_tga_read24(unsigned char *b, int w, ALLEGRO_FILE *f)
          c += count;
          if (c > w) {
             /* Stepped past the end of the line, error */
-            return NULL;
+            return false;
          }
-         b = raw_tga_read24(b, count, f);
+         if (al_fread(f, b, count * size) != (size_t)(count * size))
+            return false;
+         b += count * size;
       }
    } while (c < w);
-   return b;
-}
-
-
-
-/* single_tga_read16:
- *  Helper for reading a single 16-bit data from TGA files.
- */
-static INLINE int single_tga_read16(ALLEGRO_FILE *f)
-{
-   return al_fread16le(f);
-}
-
-
-
-/* raw_tga_read16:
- *  Helper for reading 16-bit raw data from TGA files.
- *  Returns pointer past the end.
- */
-static unsigned short *raw_tga_read16(unsigned short *b, int w, ALLEGRO_FILE *f)
-{
-   while (w--)
-      *b++ = single_tga_read16(f);
-
-   return b;
+   return true;
 }
 
 
 
-/* rle_tga_read16:
- *  Helper for reading 16-bit RLE data from TGA files.
- *  Returns pointer past the end or NULL for error.
- */
-static unsigned short *rle_tga_read16(unsigned short *b, int w, ALLEGRO_FILE *f)
-{
-   int color, count, c = 0;
-
-   do {
-      count = al_fgetc(f);
-      if (count & 0x80) {
-         /* run-length packet */
-         count = (count & 0x7F) + 1;
-         c += count;
-         if (c > w) {
-            /* Stepped past the end of the line, error */
-            return NULL;
-         }
-         color = single_tga_read16(f);
-         while (count--)
-            *b++ = color;
-      }
-      else {
-         /* raw packet */
-         count++;
-         c += count;
-         if (c > w) {
-            /* Stepped past the end of the line, error */
-            return NULL;
-         }
-         b = raw_tga_read16(b, count, f);
-      }
-   } while (c < w);
-   return b;
-}
-
 typedef unsigned char palette_entry[3];
 
 /* Like load_tga, but starts loading from the current place in the ALLEGRO_FILE
@@ -293,9 +117,12 @@ ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
    unsigned int c, i;
    int y;
    int compressed;
+   int pixel_size;
    ALLEGRO_BITMAP *bmp;
    ALLEGRO_LOCKED_REGION *lr;
    unsigned char *buf;
+   uint32_t pal32[256];
+   bool ok = true;
    bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
    ASSERT(f);
 
@@ -371,6 +198,9 @@ ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
             image_palette[i][1] = i;
             image_palette[i][2] = i;
          }
+         /* All values are valid "palette" indices. */
+         palette_start = 0;
+         palette_colors = 256;
          break;
 
       default:
@@ -426,152 +256,85 @@ ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
    }
 
    /* bpp + 1 accounts for 15 bpp. */
-   buf = al_malloc(image_width * ((bpp + 1) / 8));
+   pixel_size = (bpp + 1) / 8;
+   buf = al_malloc(image_width * pixel_size);
    if (!buf) {
       al_unlock_bitmap(bmp);
       al_destroy_bitmap(bmp);
       ALLEGRO_ERROR("Failed to allocate enough memory.\n");
       return NULL;
    }
+   for (i = 0; i < 256; i++) {
+      palette_entry *entry = image_palette + i;
+      pal32[i] = IIO_ABGR_LE((*entry)[2], (*entry)[1], (*entry)[0], 255);
+   }
 
-   for (y = 0; y < image_height; y++) {
+   for (y = 0; y < image_height && ok; y++) {
       int true_y = (top_to_bottom) ? y : (image_height - 1 - y);
+      uint32_t *dest = (uint32_t *)((unsigned char *)lr->data +
+         lr->pitch*true_y);
+      int step = 1;
+      const unsigned char *src = buf;
+
+      if (!left_to_right) {
+         dest += image_width - 1;
+         step = -1;
+      }
+
+      if (compressed) {
+         if (!rle_tga_read(buf, image_width, pixel_size, f)) {
+            ALLEGRO_ERROR("Invalid image data.\n");
+            ok = false;
+            break;
+         }
+      }
+      else {
+         raw_tga_read(buf, image_width, pixel_size, f);
+      }
 
       switch (image_type) {
 
          case 1:
-         case 3: {
-            unsigned char *ptr;
-            if (compressed)
-               ptr = rle_tga_read8(buf, image_width, f);
-            else
-               ptr = raw_tga_read8(buf, image_width, f);
-            if (!ptr) {
-               al_free(buf);
-               al_unlock_bitmap(bmp);
-               al_destroy_bitmap(bmp);
-               ALLEGRO_ERROR("Invalid image data.\n");
-               return NULL;
-            }
-         }
-            for (i = 0; i < image_width; i++) {
-               int true_x = (left_to_right) ? i : (image_width - 1 - i);
-               int pix = buf[i];
-
-               unsigned char *dest = (unsigned char *)lr->data +
-                  lr->pitch*true_y + true_x*4;
+         case 3:
+            for (i = 0; i < image_width; i++, dest += step) {
+               int pix = src[i];
                if (pix < palette_start || pix >= (palette_start + palette_colors)) {
-                  al_free(buf);
-                  al_unlock_bitmap(bmp);
-                  al_destroy_bitmap(bmp);
                   ALLEGRO_ERROR("Invalid image data.\n");
-                  return NULL;
+                  ok = false;
+                  break;
                }
-               palette_entry* entry = image_palette + pix;
-               dest[0] = (*entry)[2];
-               dest[1] = (*entry)[1];
-               dest[2] = (*entry)[0];
-               dest[3] = 255;
+               *dest = pal32[pix];
             }
-
             break;
 
          case 2:
             if (bpp == 32) {
-               unsigned int *ptr;
-               if (compressed)
-                  ptr = rle_tga_read32((unsigned int *)buf, image_width, f);
-               else
-                  ptr = raw_tga_read32((unsigned int *)buf, image_width, f);
-               if (!ptr) {
-                  al_free(buf);
-                  al_unlock_bitmap(bmp);
-                  al_destroy_bitmap(bmp);
-                  ALLEGRO_ERROR("Invalid image data.\n");
-                  return NULL;
-               }
-               for (i = 0; i < image_width; i++) {
-                  int true_x = (left_to_right) ? i : (image_width - 1 - i);
-                  unsigned char *dest = (unsigned char *)lr->data +
-                     lr->pitch*true_y + true_x*4;
-
-#ifdef ALLEGRO_BIG_ENDIAN
-                  int a = buf[i * 4 + 0];
-                  int r = buf[i * 4 + 1];
-                  int g = buf[i * 4 + 2];
-                  int b = buf[i * 4 + 3];
-#else
-                  int b = buf[i * 4 + 0];
-                  int g = buf[i * 4 + 1];
-                  int r = buf[i * 4 + 2];
-                  int a = buf[i * 4 + 3];
-#endif
+               for (i = 0; i < image_width; i++, src += 4, dest += step) {
+                  int b = src[0];
+                  int g = src[1];
+                  int r = src[2];
+                  int a = src[3];
                   if (premul) {
                      r = r * a / 255;
                      g = g * a / 255;
                      b = b * a / 255;
                   }
-
-                  dest[0] = r;
-                  dest[1] = g;
-                  dest[2] = b;
-                  dest[3] = a;
+                  *dest = IIO_ABGR_LE(r, g, b, a);
                }
             }
             else if (bpp == 24) {
-               unsigned char *ptr;
-               if (compressed)
-                  ptr = rle_tga_read24(buf, image_width, f);
-               else
-                  ptr = raw_tga_read24(buf, image_width, f);
-               if (!ptr) {
-                  al_free(buf);
-                  al_unlock_bitmap(bmp);
-                  al_destroy_bitmap(bmp);
-                  ALLEGRO_ERROR("Invalid image data.\n");
-                  return NULL;
-               }
-               for (i = 0; i < image_width; i++) {
-                  int true_x = (left_to_right) ? i : (image_width - 1 - i);
-                  int b = buf[i * 3 + 0];
-                  int g = buf[i * 3 + 1];
-                  int r = buf[i * 3 + 2];
-
-                  unsigned char *dest = (unsigned char *)lr->data +
-                     lr->pitch*true_y + true_x*4;
-                  dest[0] = r;
-                  dest[1] = g;
-                  dest[2] = b;
-                  dest[3] = 255;
+               for (i = 0; i < image_width; i++, src += 3, dest += step) {
+                  *dest = IIO_ABGR_LE(src[2], src[1], src[0], 255);
                }
             }
             else {
-               unsigned short *ptr;
-               if (compressed)
-                  ptr = rle_tga_read16((unsigned short *)buf, image_width, f);
-               else
-                  ptr = raw_tga_read16((unsigned short *)buf, image_width, f);
-               if (!ptr) {
-                  al_free(buf);
-                  al_unlock_bitmap(bmp);
-                  al_destroy_bitmap(bmp);
-                  ALLEGRO_ERROR("Invalid image data.\n");
-                  return NULL;
-               }
-               for (i = 0; i < image_width; i++) {
-                  int true_x = (left_to_right) ? i : (image_width - 1 - i);
-                  int pix = *((unsigned short *)(buf + i * 2));
+               for (i = 0; i < image_width; i++, src += 2, dest += step) {
+                  int pix = src[0] | (src[1] << 8);
                   /* TODO - do something with the 1-bit A value (alpha?) */
                   int r = _al_rgb_scale_5[(pix >> 10) & 0x1F];
                   int g = _al_rgb_scale_5[(pix >> 5) & 0x1F];
                   int b = _al_rgb_scale_5[(pix & 0x1F)];
-
-                  unsigned char *dest = (unsigned char *)lr->data +
-                     lr->pitch*true_y + true_x*4;
-                  dest[0] = r;
-                  dest[1] = g;
-                  dest[2] = b;
-                  dest[3] = 255;
+                  *dest = IIO_ABGR_LE(r, g, b, 255);
                }
             }
             break;
@@ -581,6 +344,11 @@ ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
    al_free(buf);
    al_unlock_bitmap(bmp);
 
+   if (!ok) {
+      al_destroy_bitmap(bmp);
+      return NULL;
+   }
+
    if (al_get_errno()) {
       ALLEGRO_ERROR("Error detected: %d.\n", al_get_errno());
       al_destroy_bitmap(bmp);
@@ -700,4 +468,37 @@ bool _al_identify_tga(ALLEGRO_FILE *f)
 }
 
 
+bool _al_probe_tga(ALLEGRO_FILE *f, ALLEGRO_IMAGE_INFO *info)
+{
+   unsigned char header[18];
+
+   if (al_fread(f, header, 18) != 18)
+      return false;
+
+   info->width = header[12] | (header[13] << 8);
+   info->height = header[14] | (header[15] << 8);
+   info->bit_depth = header[16];
+   if (info->width == 0 || info->height == 0)
+      return false;
+
+   switch (header[2] & 7) {
+      case 1:
+         /* paletted image */
+         info->channels = 3;
+         break;
+      case 2:
+         /* truecolor image */
+         info->channels = (info->bit_depth == 32) ? 4 : 3;
+         break;
+      case 3:
+         /* grayscale image */
+         info->channels = 1;
+         break;
+      default:
+         return false;
+   }
+   return true;
+}
+
+
 /* vim: set sts=3 sw=3 et: */
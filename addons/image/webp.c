@@ -6,12 +6,17 @@
 #include <webp/decode.h>
 #include <webp/encode.h>
 
+#define ALLEGRO_INTERNAL_UNSTABLE
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
 #include "allegro5/internal/aintern_image.h"
 
 #include "iio.h"
 
+#ifdef ALLEGRO_CFG_IIO_HAVE_WEBPDEMUX
+#include <webp/demux.h>
+#endif
+
 ALLEGRO_DEBUG_CHANNEL("image")
 
 
@@ -20,38 +25,208 @@ ALLEGRO_DEBUG_CHANNEL("image")
  ****************************************************************************/
 
 
-static ALLEGRO_BITMAP *load_from_buffer(const uint8_t* data, size_t data_size,
-   int flags)
+/* Compressed data is fed to the incremental decoder in pieces this big. */
+#define WEBP_CHUNK_SIZE    65536
+
+
+/* Create the bitmap for a still image and point the decoder's output at
+ * it.  The bitmap is returned locked.
+ */
+static ALLEGRO_BITMAP *create_output(WebPDecoderConfig *config, int flags)
 {
    ALLEGRO_BITMAP *bmp;
    ALLEGRO_LOCKED_REGION *lock;
    bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
+   int h = config->input.height;
 
-   WebPDecoderConfig config;
-   WebPInitDecoderConfig(&config);
+   bmp = al_create_bitmap(config->input.width, h);
+   if (!bmp) {
+      ALLEGRO_ERROR("al_create_bitmap failed while loading WebP.\n");
+      return NULL;
+   }
 
-   if (WebPGetFeatures(data, data_size, &config.input) != VP8_STATUS_OK) {
-      ALLEGRO_ERROR("Could not read WebP stream info\n");
+   lock = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_WRITEONLY);
+   if (!lock) {
+      ALLEGRO_ERROR("Could not lock bitmap while loading WebP.\n");
+      al_destroy_bitmap(bmp);
+      return NULL;
+   }
+
+   config->output.colorspace = premul ? MODE_rgbA : MODE_RGBA;
+   config->output.is_external_memory = 1;
+   /* libwebp wants a positive stride, but can write the rows bottom up. */
+   if (lock->pitch < 0) {
+      config->options.flip = 1;
+      config->output.u.RGBA.rgba = (uint8_t*)lock->data + lock->pitch * (h - 1);
+      config->output.u.RGBA.stride = -lock->pitch;
+   }
+   else {
+      config->output.u.RGBA.rgba = (uint8_t*)lock->data;
+      config->output.u.RGBA.stride = lock->pitch;
+   }
+   config->output.u.RGBA.size = (size_t)config->output.u.RGBA.stride * h;
+
+   return bmp;
+}
+
+
+/* Read the rest of the file into buf, after the size bytes already there.
+ * buf is freed on failure.
+ */
+static uint8_t *read_rest(ALLEGRO_FILE *fp, uint8_t *buf, size_t size,
+   size_t capacity, size_t *ret_size)
+{
+   int64_t fsize = al_fsize(fp);
+   int64_t pos = al_ftell(fp);
+   uint8_t *tmp;
+   size_t got;
+
+   /* One byte more than the rest of the file, so that reading it all
+    * leaves room and ends the loop.
+    */
+   if (fsize >= 0 && pos >= 0 && fsize >= pos &&
+         (uint64_t)(fsize - pos) >= capacity - size) {
+      capacity = size + (size_t)(fsize - pos) + 1;
+      tmp = al_realloc(buf, capacity);
+      if (!tmp) {
+         al_free(buf);
+         return NULL;
+      }
+      buf = tmp;
+   }
+
+   for (;;) {
+      if (size == capacity) {
+         capacity *= 2;
+         tmp = al_realloc(buf, capacity);
+         if (!tmp) {
+            al_free(buf);
+            return NULL;
+         }
+         buf = tmp;
+      }
+      got = al_fread(fp, buf + size, capacity - size);
+      size += got;
+      if (size < capacity)
+         break;
+   }
+
+   if (al_ferror(fp)) {
+      ALLEGRO_ERROR("Could not read WebP file\n");
+      al_free(buf);
+      return NULL;
+   }
+
+   *ret_size = size;
+   return buf;
+}
+
+
+#ifdef ALLEGRO_CFG_IIO_HAVE_WEBPDEMUX
+static WebPAnimDecoder *new_anim_decoder(const WebPData *webp_data,
+   int flags)
+{
+   WebPAnimDecoderOptions options;
+   bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
+
+   if (!WebPAnimDecoderOptionsInit(&options)) {
+      ALLEGRO_ERROR("Mismatched libwebpdemux version\n");
+      return NULL;
+   }
+   options.color_mode = premul ? MODE_rgbA : MODE_RGBA;
+   options.use_threads = 0;
+
+   return WebPAnimDecoderNew(webp_data, &options);
+}
+
+
+/* al_load_bitmap on an animation returns its first frame. */
+static ALLEGRO_BITMAP *load_first_frame(const uint8_t *data, size_t data_size,
+   int flags)
+{
+   ALLEGRO_BITMAP *bmp = NULL;
+   ALLEGRO_LOCKED_REGION *lock;
+   WebPAnimDecoder *dec;
+   WebPAnimInfo info;
+   WebPData webp_data;
+   uint8_t *pixels;
+   int timestamp;
+   int y;
+
+   webp_data.bytes = data;
+   webp_data.size = data_size;
+   dec = new_anim_decoder(&webp_data, flags);
+   if (!dec) {
+      ALLEGRO_ERROR("Could not read WebP animation\n");
       return NULL;
    }
 
-   bmp = al_create_bitmap(config.input.width, config.input.height);
+   if (!WebPAnimDecoderGetInfo(dec, &info) ||
+         !WebPAnimDecoderGetNext(dec, &pixels, &timestamp)) {
+      ALLEGRO_ERROR("Could not decode WebP animation\n");
+      goto done;
+   }
+
+   bmp = al_create_bitmap(info.canvas_width, info.canvas_height);
    if (!bmp) {
       ALLEGRO_ERROR("al_create_bitmap failed while loading WebP.\n");
-      return NULL;
+      goto done;
    }
 
    lock = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
       ALLEGRO_LOCK_WRITEONLY);
+   if (!lock) {
+      al_destroy_bitmap(bmp);
+      bmp = NULL;
+      goto done;
+   }
+   for (y = 0; y < (int)info.canvas_height; y++) {
+      memcpy((uint8_t*)lock->data + y * lock->pitch,
+         pixels + y * info.canvas_width * 4, info.canvas_width * 4);
+   }
+   al_unlock_bitmap(bmp);
+
+done:
+   WebPAnimDecoderDelete(dec);
+   return bmp;
+}
+#else
+static ALLEGRO_BITMAP *load_first_frame(const uint8_t *data, size_t data_size,
+   int flags)
+{
+   (void)data;
+   (void)data_size;
+   (void)flags;
+   ALLEGRO_ERROR("WebP animations need libwebpdemux\n");
+   return NULL;
+}
+#endif
+
+
+static ALLEGRO_BITMAP *load_from_buffer(const uint8_t* data, size_t data_size,
+   int flags)
+{
+   ALLEGRO_BITMAP *bmp;
 
-   config.output.colorspace = premul ? MODE_rgbA : MODE_RGBA;
-   config.output.u.RGBA.rgba = (uint8_t*)lock->data;
-   config.output.u.RGBA.stride = lock->pitch;
-   config.output.u.RGBA.size = lock->pitch * config.input.height;
-   config.output.is_external_memory = 1;
+   WebPDecoderConfig config;
+   WebPInitDecoderConfig(&config);
+
+   if (WebPGetFeatures(data, data_size, &config.input) != VP8_STATUS_OK) {
+      ALLEGRO_ERROR("Could not read WebP stream info\n");
+      return NULL;
+   }
+
+   if (config.input.has_animation)
+      return load_first_frame(data, data_size, flags);
+
+   bmp = create_output(&config, flags);
+   if (!bmp)
+      return NULL;
 
    if (WebPDecode(data, data_size, &config) != VP8_STATUS_OK) {
       ALLEGRO_ERROR("Could not decode WebP stream\n");
+      al_unlock_bitmap(bmp);
       al_destroy_bitmap(bmp);
       return NULL;
    }
@@ -62,28 +237,99 @@ static ALLEGRO_BITMAP *load_from_buffer(const uint8_t* data, size_t data_size,
 }
 
 
-ALLEGRO_BITMAP *_al_load_webp_f(ALLEGRO_FILE *fp, int flags)
+/* Decode a still image while reading it, so the compressed data never has
+ * to be in memory all at once.
+ */
+static ALLEGRO_BITMAP *load_incrementally(ALLEGRO_FILE *fp, int flags)
 {
-   ALLEGRO_ASSERT(fp);
    ALLEGRO_BITMAP *bmp;
+   WebPDecoderConfig config;
+   WebPIDecoder *idec;
+   VP8StatusCode status;
+   uint8_t *buf;
+   size_t size = 0;
+   size_t got;
+
+   buf = al_malloc(WEBP_CHUNK_SIZE);
+   if (!buf)
+      return NULL;
 
-   size_t data_size = al_fsize(fp);
-   uint8_t *data = al_malloc(data_size * sizeof(uint8_t));
+   WebPInitDecoderConfig(&config);
 
-   if (al_fread(fp, data, data_size) != data_size) {
-      ALLEGRO_ERROR("Could not read WebP file\n");
-      free(data);
+   /* The headers nearly always fit in the first chunk. */
+   do {
+      got = al_fread(fp, buf + size, WEBP_CHUNK_SIZE - size);
+      size += got;
+      status = WebPGetFeatures(buf, size, &config.input);
+   } while (status == VP8_STATUS_NOT_ENOUGH_DATA && got > 0 &&
+      size < WEBP_CHUNK_SIZE);
+
+   if (status != VP8_STATUS_OK) {
+      ALLEGRO_ERROR("Could not read WebP stream info\n");
+      al_free(buf);
+      return NULL;
+   }
+
+   /* Animations can only be decoded from memory. */
+   if (config.input.has_animation) {
+      buf = read_rest(fp, buf, size, WEBP_CHUNK_SIZE, &size);
+      if (!buf)
+         return NULL;
+      bmp = load_from_buffer(buf, size, flags);
+      al_free(buf);
+      return bmp;
+   }
+
+   bmp = create_output(&config, flags);
+   if (!bmp) {
+      al_free(buf);
       return NULL;
    }
 
-   bmp = load_from_buffer(data, data_size, flags);
+   idec = WebPIDecode(NULL, 0, &config);
+   if (idec) {
+      status = WebPIAppend(idec, buf, size);
+      while (status == VP8_STATUS_SUSPENDED) {
+         got = al_fread(fp, buf, WEBP_CHUNK_SIZE);
+         if (got == 0)
+            break;
+         status = WebPIAppend(idec, buf, got);
+      }
+      WebPIDelete(idec);
+   }
+
+   al_free(buf);
+   al_unlock_bitmap(bmp);
 
-   free(data);
+   if (!idec || status != VP8_STATUS_OK) {
+      ALLEGRO_ERROR("Could not decode WebP stream\n");
+      al_destroy_bitmap(bmp);
+      return NULL;
+   }
 
    return bmp;
 }
 
 
+ALLEGRO_BITMAP *_al_load_webp_f(ALLEGRO_FILE *fp, int flags)
+{
+   ALLEGRO_ASSERT(fp);
+   ALLEGRO_BITMAP *bmp;
+   const uint8_t *borrowed;
+   size_t borrowed_size;
+
+   /* Decode straight out of the file's buffer if it has one. */
+   borrowed = al_fborrow(fp, &borrowed_size);
+   if (borrowed) {
+      bmp = load_from_buffer(borrowed, borrowed_size, flags);
+      al_fseek(fp, borrowed_size, ALLEGRO_SEEK_CUR);
+      return bmp;
+   }
+
+   return load_incrementally(fp, flags);
+}
+
+
 
 
 
@@ -110,6 +356,109 @@ ALLEGRO_BITMAP *_al_load_webp(const char *filename, int flags)
 
 
 
+/*****************************************************************************
+ * Animations
+ ****************************************************************************/
+
+
+#ifdef ALLEGRO_CFG_IIO_HAVE_WEBPDEMUX
+
+typedef struct WEBP_ANIMATION {
+   uint8_t *data;             /* NULL if borrowed from the file */
+   WebPData webp_data;
+   WebPAnimDecoder *dec;
+} WEBP_ANIMATION;
+
+
+static bool webp_anim_next_frame(void *data, const unsigned char **pixels,
+   int *end_ms)
+{
+   WEBP_ANIMATION *anim = data;
+   uint8_t *buf;
+
+   if (!WebPAnimDecoderGetNext(anim->dec, &buf, end_ms))
+      return false;
+   *pixels = buf;
+   return true;
+}
+
+
+static bool webp_anim_rewind(void *data)
+{
+   WEBP_ANIMATION *anim = data;
+
+   WebPAnimDecoderReset(anim->dec);
+   return true;
+}
+
+
+static void webp_anim_destroy(void *data)
+{
+   WEBP_ANIMATION *anim = data;
+
+   WebPAnimDecoderDelete(anim->dec);
+   al_free(anim->data);
+   al_free(anim);
+}
+
+
+/* The decoder only needs the compressed data, the frames are decoded one at
+ * a time as they are asked for.  The file stays open while the animation
+ * is, so borrowed data remains valid.
+ */
+bool _al_open_webp_animation_f(ALLEGRO_FILE *fp, int flags,
+   _AL_IMAGE_ANIMATION_SOURCE *src)
+{
+   WEBP_ANIMATION *anim;
+   WebPAnimInfo info;
+   const uint8_t *borrowed;
+   size_t size;
+
+   anim = al_calloc(1, sizeof(*anim));
+   if (!anim)
+      return false;
+
+   borrowed = al_fborrow(fp, &size);
+   if (!borrowed) {
+      anim->data = al_malloc(WEBP_CHUNK_SIZE);
+      if (anim->data)
+         anim->data = read_rest(fp, anim->data, 0, WEBP_CHUNK_SIZE, &size);
+      if (!anim->data) {
+         al_free(anim);
+         return false;
+      }
+      borrowed = anim->data;
+   }
+
+   anim->webp_data.bytes = borrowed;
+   anim->webp_data.size = size;
+   anim->dec = new_anim_decoder(&anim->webp_data, flags);
+   if (!anim->dec || !WebPAnimDecoderGetInfo(anim->dec, &info) ||
+         info.frame_count == 0) {
+      ALLEGRO_ERROR("Could not read WebP animation\n");
+      if (anim->dec)
+         WebPAnimDecoderDelete(anim->dec);
+      al_free(anim->data);
+      al_free(anim);
+      return false;
+   }
+
+   src->width = info.canvas_width;
+   src->height = info.canvas_height;
+   src->frame_count = info.frame_count;
+   src->loop_count = info.loop_count;
+   src->data = anim;
+   src->next_frame = webp_anim_next_frame;
+   src->rewind = webp_anim_rewind;
+   src->destroy = webp_anim_destroy;
+   return true;
+}
+
+#endif
+
+
+
+
 /*****************************************************************************
  * Saving routines
  ****************************************************************************/
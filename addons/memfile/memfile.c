@@ -1,5 +1,6 @@
 #include <allegro5/allegro.h>
 #include "allegro5/allegro_memfile.h"
+#include "allegro5/internal/aintern_file.h"
 
 typedef struct ALLEGRO_FILE_MEMFILE ALLEGRO_FILE_MEMFILE;
 
@@ -11,11 +12,46 @@ struct ALLEGRO_FILE_MEMFILE {
    int64_t size;
    int64_t pos;
    char *mem;
+
+   /* Growable memfiles own mem, which has room for capacity bytes. */
+   bool growable;
+   int64_t capacity;
 };
 
+#define MIN_CAPACITY 256
+
 static bool memfile_fclose(ALLEGRO_FILE *fp)
 {
-   al_free(al_get_file_userdata(fp));
+   ALLEGRO_FILE_MEMFILE *mf = al_get_file_userdata(fp);
+
+   if (mf->growable)
+      al_free(mf->mem);
+   al_free(mf);
+   return true;
+}
+
+/* Make room for at least `needed` bytes, doubling the capacity so that
+ * sequential writes are amortised O(1).
+ */
+static bool memfile_reserve(ALLEGRO_FILE_MEMFILE *mf, int64_t needed)
+{
+   int64_t capacity = mf->capacity ? mf->capacity : MIN_CAPACITY;
+   char *mem;
+
+   if (needed <= mf->capacity)
+      return true;
+
+   while (capacity < needed)
+      capacity *= 2;
+   if ((uint64_t)capacity > (size_t)-1)
+      return false;
+
+   mem = al_realloc(mf->mem, capacity);
+   if (!mem)
+      return false;
+
+   mf->mem = mem;
+   mf->capacity = capacity;
    return true;
 }
 
@@ -53,6 +89,18 @@ static size_t memfile_fwrite(ALLEGRO_FILE *fp, const void *ptr, size_t size)
       al_set_errno(EPERM);
       return 0;
    }   
+
+   if (mf->growable) {
+      if (!memfile_reserve(mf, mf->pos + size)) {
+         al_set_errno(ENOMEM);
+         return 0;
+      }
+      memcpy(mf->mem + mf->pos, ptr, size);
+      mf->pos += size;
+      if (mf->pos > mf->size)
+         mf->size = mf->pos;
+      return size;
+   }
    
    if (mf->size - mf->pos < (int64_t)size) {
       /* partial write */
@@ -192,10 +240,82 @@ ALLEGRO_FILE *al_open_memfile(void *mem, int64_t size, const char *mode)
    if (!memfile) {
       al_free(userdata);
    }
+   else if (userdata->readable && !userdata->writable) {
+      _al_set_file_read_ahead(memfile, true);
+   }
+
+   return memfile;
+}
+
+/* Function: al_create_memfile
+ */
+ALLEGRO_FILE *al_create_memfile(int64_t capacity)
+{
+   ALLEGRO_FILE *memfile;
+   ALLEGRO_FILE_MEMFILE *userdata = NULL;
+
+   ASSERT(capacity >= 0);
+
+   userdata = al_calloc(1, sizeof(ALLEGRO_FILE_MEMFILE));
+   if (!userdata) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   userdata->readable = true;
+   userdata->writable = true;
+   userdata->growable = true;
+
+   if (capacity > 0 && !memfile_reserve(userdata, capacity)) {
+      al_free(userdata);
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   memfile = al_create_file_handle(&memfile_vtable, userdata);
+   if (!memfile) {
+      al_free(userdata->mem);
+      al_free(userdata);
+   }
 
    return memfile;
 }
 
+/* Function: al_detach_memfile_buffer
+ */
+void *al_detach_memfile_buffer(ALLEGRO_FILE *fp, int64_t *ret_size)
+{
+   ALLEGRO_FILE_MEMFILE *mf;
+   void *mem;
+
+   ASSERT(fp);
+
+   if (fp->vtable != &memfile_vtable)
+      return NULL;
+   mf = al_get_file_userdata(fp);
+   if (!mf->growable)
+      return NULL;
+
+   /* Make sure a buffer is returned even if nothing was written. */
+   if (!memfile_reserve(mf, 1)) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   mem = mf->mem;
+   if (ret_size)
+      *ret_size = mf->size;
+
+   mf->mem = NULL;
+   mf->capacity = 0;
+   mf->size = 0;
+   mf->pos = 0;
+   mf->eof = false;
+   fp->ungetc_len = 0;
+
+   return mem;
+}
+
 /* Function: al_get_allegro_memfile_version
  */
 uint32_t al_get_allegro_memfile_version(void)
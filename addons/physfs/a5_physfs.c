@@ -7,6 +7,8 @@
 #include <physfs.h>
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_physfs.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_exitfunc.h"
 
 #include "allegro_physfs_intern.h"
 
@@ -20,8 +22,35 @@ struct ALLEGRO_FILE_PHYSFS
    PHYSFS_file *phys;
    bool error_indicator;
    char error_msg[80];
+
+   /* Read window, for files opened for reading only.  Seeking inside a
+    * compressed archive member makes PhysFS decode everything from the
+    * start of the member (backwards) or up to the target (forwards), so
+    * seeks only move pos, and the PhysFS handle at phys_pos is moved once
+    * a read misses the window.
+    */
+   unsigned char *window;
+   size_t window_size;
+   int64_t window_start;
+   size_t window_len;
+   int64_t pos;
+   int64_t phys_pos;
+   int64_t length;
+   bool eof;
+   ALLEGRO_PHYSFS_STATS stats;
 };
 
+#define DEFAULT_READ_AHEAD  (64 * 1024)
+
+/* Shared by every thread, so the read-ahead size and the totals are only
+ * touched with physfs_mutex held.  The mutex is created by the first call
+ * to al_set_physfs_file_interface or al_set_physfs_read_ahead; until then
+ * the size is still the default and nothing has been counted.
+ */
+static ALLEGRO_MUTEX *physfs_mutex;
+static size_t read_ahead_size = DEFAULT_READ_AHEAD;
+static ALLEGRO_PHYSFS_STATS total_stats;   /* totals of closed files */
+
 /* forward declaration */
 static const ALLEGRO_FILE_INTERFACE file_phys_vtable;
 
@@ -104,16 +133,93 @@ static void *file_phys_fopen(const char *filename, const char *mode)
    fp->phys = phys;
    fp->error_indicator = false;
    fp->error_msg[0] = '\0';
+   memset(&fp->stats, 0, sizeof(fp->stats));
+   fp->window = NULL;
+   fp->window_size = 0;
+   fp->window_start = 0;
+   fp->window_len = 0;
+   fp->pos = 0;
+   fp->phys_pos = 0;
+   fp->length = -1;
+   fp->eof = false;
+
+   if (streq(mode, "r") || streq(mode, "rb")) {
+      size_t size = al_get_physfs_read_ahead();
+      if (size > 0) {
+         fp->length = PHYSFS_fileLength(phys);
+         /* Needed for ALLEGRO_SEEK_END without asking PhysFS each time. */
+         if (fp->length >= 0)
+            fp->window = al_malloc(size);
+         if (fp->window)
+            fp->window_size = size;
+      }
+   }
 
    return fp;
 }
 
 
+static void add_stats(ALLEGRO_PHYSFS_STATS *dst, const ALLEGRO_PHYSFS_STATS *src)
+{
+   dst->physfs_reads += src->physfs_reads;
+   dst->physfs_bytes_read += src->physfs_bytes_read;
+   dst->physfs_seeks += src->physfs_seeks;
+   dst->redecoded_bytes += src->redecoded_bytes;
+   dst->buffered_bytes += src->buffered_bytes;
+}
+
+
+/* phys_read_at:
+ *  Read from the PhysFS handle at fp->pos, seeking it there first if
+ *  necessary.  Does not move fp->pos.
+ */
+static size_t phys_read_at(ALLEGRO_FILE_PHYSFS *fp, void *buf, size_t size)
+{
+   PHYSFS_sint64 n;
+
+   if (fp->phys_pos != fp->pos) {
+      /* A backwards seek restarts decoding at the start of the member. */
+      if (fp->phys_pos < 0 || fp->pos < fp->phys_pos)
+         fp->stats.redecoded_bytes += fp->pos;
+      else
+         fp->stats.redecoded_bytes += fp->pos - fp->phys_pos;
+      fp->stats.physfs_seeks++;
+
+      if (!PHYSFS_seek(fp->phys, fp->pos)) {
+         phys_set_errno(fp);
+         /* Unknown, so the next read seeks again. */
+         fp->phys_pos = -1;
+         return 0;
+      }
+      fp->phys_pos = fp->pos;
+   }
+
+   n = PHYSFS_readBytes(fp->phys, buf, size);
+   fp->stats.physfs_reads++;
+   if (n < 0) {
+      phys_set_errno(fp);
+      fp->phys_pos = -1;
+      return 0;
+   }
+
+   fp->stats.physfs_bytes_read += n;
+   fp->phys_pos += n;
+   return n;
+}
+
+
 static bool file_phys_fclose(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_file *phys_fp = fp->phys;
 
+   if (physfs_mutex) {
+      al_lock_mutex(physfs_mutex);
+      add_stats(&total_stats, &fp->stats);
+      al_unlock_mutex(physfs_mutex);
+   }
+
+   al_free(fp->window);
    al_free(fp);
 
    if (PHYSFS_close(phys_fp) == 0) {
@@ -125,6 +231,52 @@ static bool file_phys_fclose(ALLEGRO_FILE *f)
 }
 
 
+static size_t file_phys_fread_window(ALLEGRO_FILE_PHYSFS *fp,
+   unsigned char *buf, size_t buf_size)
+{
+   size_t done = 0;
+
+   while (done < buf_size) {
+      size_t want = buf_size - done;
+      size_t n;
+
+      if (fp->pos >= fp->window_start &&
+            fp->pos < fp->window_start + (int64_t)fp->window_len) {
+         size_t offset = fp->pos - fp->window_start;
+         n = _ALLEGRO_MIN(want, fp->window_len - offset);
+         memcpy(buf + done, fp->window + offset, n);
+         fp->stats.buffered_bytes += n;
+      }
+      else if (want >= fp->window_size) {
+         /* Large reads bypass the window. */
+         n = phys_read_at(fp, buf + done, want);
+         if (n < want) {
+            fp->pos += n;
+            done += n;
+            if (!fp->error_indicator)
+               fp->eof = true;
+            break;
+         }
+      }
+      else {
+         fp->window_start = fp->pos;
+         fp->window_len = phys_read_at(fp, fp->window, fp->window_size);
+         if (fp->window_len == 0) {
+            if (!fp->error_indicator)
+               fp->eof = true;
+            break;
+         }
+         continue;
+      }
+
+      fp->pos += n;
+      done += n;
+   }
+
+   return done;
+}
+
+
 static size_t file_phys_fread(ALLEGRO_FILE *f, void *buf, size_t buf_size)
 {
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
@@ -133,6 +285,9 @@ static size_t file_phys_fread(ALLEGRO_FILE *f, void *buf, size_t buf_size)
    if (buf_size == 0)
       return 0;
 
+   if (fp->window)
+      return file_phys_fread_window(fp, buf, buf_size);
+
    n = PHYSFS_readBytes(fp->phys, buf, buf_size);
    if (n < 0) {
       phys_set_errno(fp);
@@ -176,6 +331,9 @@ static int64_t file_phys_ftell(ALLEGRO_FILE *f)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_sint64 n;
 
+   if (fp->window)
+      return fp->pos;
+
    n = PHYSFS_tell(fp->phys);
    if (n < 0) {
       phys_set_errno(fp);
@@ -191,6 +349,27 @@ static bool file_phys_seek(ALLEGRO_FILE *f, int64_t offset, int whence)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_sint64 base;
 
+   if (fp->window) {
+      switch (whence) {
+         case ALLEGRO_SEEK_SET: base = 0; break;
+         case ALLEGRO_SEEK_CUR: base = fp->pos; break;
+         case ALLEGRO_SEEK_END: base = fp->length; break;
+         default:
+            al_set_errno(EINVAL);
+            return false;
+      }
+      /* Files are only read, so there is nothing past the end.  PhysFS
+       * refuses such seeks inside archives as well.
+       */
+      if (base + offset < 0 || base + offset > fp->length) {
+         al_set_errno(EINVAL);
+         return false;
+      }
+      fp->pos = base + offset;
+      fp->eof = false;
+      return true;
+   }
+
    switch (whence) {
       case ALLEGRO_SEEK_SET:
          base = 0;
@@ -230,6 +409,9 @@ static bool file_phys_feof(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
 
+   if (fp->window)
+      return fp->eof;
+
    return PHYSFS_eof(fp->phys);
 }
 
@@ -258,6 +440,7 @@ static void file_phys_fclearerr(ALLEGRO_FILE *f)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
 
    fp->error_indicator = false;
+   fp->eof = false;
 
    /* PhysicsFS doesn't provide a way to clear the EOF indicator. */
 }
@@ -268,6 +451,9 @@ static off_t file_phys_fsize(ALLEGRO_FILE *f)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_sint64 n;
 
+   if (fp->window)
+      return fp->length;
+
    n = PHYSFS_fileLength(fp->phys);
    if (n < 0) {
       phys_set_errno(fp);
@@ -296,15 +482,88 @@ static const ALLEGRO_FILE_INTERFACE file_phys_vtable =
 };
 
 
+static void destroy_physfs_mutex(void)
+{
+   al_destroy_mutex(physfs_mutex);
+   physfs_mutex = NULL;
+   read_ahead_size = DEFAULT_READ_AHEAD;
+}
+
+
+static void create_physfs_mutex(void)
+{
+   if (!physfs_mutex) {
+      physfs_mutex = al_create_mutex();
+      _al_add_exit_func(destroy_physfs_mutex, "destroy_physfs_mutex");
+   }
+}
+
+
 /* Function: al_set_physfs_file_interface
  */
 void al_set_physfs_file_interface(void)
 {
+   create_physfs_mutex();
    al_set_new_file_interface(&file_phys_vtable);
    _al_set_physfs_fs_interface();
 }
 
 
+/* Function: al_set_physfs_read_ahead
+ */
+void al_set_physfs_read_ahead(size_t size)
+{
+   create_physfs_mutex();
+   if (physfs_mutex) {
+      al_lock_mutex(physfs_mutex);
+      read_ahead_size = size;
+      al_unlock_mutex(physfs_mutex);
+   }
+}
+
+
+/* Function: al_get_physfs_read_ahead
+ */
+size_t al_get_physfs_read_ahead(void)
+{
+   size_t size = DEFAULT_READ_AHEAD;
+
+   if (physfs_mutex) {
+      al_lock_mutex(physfs_mutex);
+      size = read_ahead_size;
+      al_unlock_mutex(physfs_mutex);
+   }
+   return size;
+}
+
+
+/* Function: al_get_physfs_stats
+ */
+void al_get_physfs_stats(ALLEGRO_PHYSFS_STATS *stats)
+{
+   ASSERT(stats);
+
+   memset(stats, 0, sizeof(*stats));
+   if (physfs_mutex) {
+      al_lock_mutex(physfs_mutex);
+      *stats = total_stats;
+      al_unlock_mutex(physfs_mutex);
+   }
+}
+
+
+/* Function: al_reset_physfs_stats
+ */
+void al_reset_physfs_stats(void)
+{
+   if (physfs_mutex) {
+      al_lock_mutex(physfs_mutex);
+      memset(&total_stats, 0, sizeof(total_stats));
+      al_unlock_mutex(physfs_mutex);
+   }
+}
+
+
 /* Function: al_get_allegro_physfs_version
  */
 uint32_t al_get_allegro_physfs_version(void)
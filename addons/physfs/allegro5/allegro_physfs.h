@@ -33,6 +33,26 @@ extern "C" {
 ALLEGRO_PHYSFS_FUNC(void, al_set_physfs_file_interface, (void));
 ALLEGRO_PHYSFS_FUNC(uint32_t, al_get_allegro_physfs_version, (void));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_PHYSFS_SRC)
+/* Type: ALLEGRO_PHYSFS_STATS
+ */
+typedef struct ALLEGRO_PHYSFS_STATS ALLEGRO_PHYSFS_STATS;
+
+struct ALLEGRO_PHYSFS_STATS
+{
+   uint64_t physfs_reads;
+   uint64_t physfs_bytes_read;
+   uint64_t physfs_seeks;
+   uint64_t redecoded_bytes;
+   uint64_t buffered_bytes;
+};
+
+ALLEGRO_PHYSFS_FUNC(void, al_set_physfs_read_ahead, (size_t size));
+ALLEGRO_PHYSFS_FUNC(size_t, al_get_physfs_read_ahead, (void));
+ALLEGRO_PHYSFS_FUNC(void, al_get_physfs_stats, (ALLEGRO_PHYSFS_STATS *stats));
+ALLEGRO_PHYSFS_FUNC(void, al_reset_physfs_stats, (void));
+#endif
+
 
 #ifdef __cplusplus
 }
@@ -1,8 +1,11 @@
 set(ALLEGRO_SRC_FILES
     src/allegro.c
     src/bitmap.c
+    src/bitmap_atlas.c
+    src/bitmap_cache.c
     src/bitmap_draw.c
     src/bitmap_io.c
+    src/bitmap_loader.c
     src/bitmap_lock.c
     src/bitmap_pixel.c
     src/bitmap_type.c
@@ -15,15 +18,19 @@ set(ALLEGRO_SRC_FILES
     src/display.c
     src/display_settings.c
     src/drawing.c
+    src/dxt.c
     src/dtor.c
     src/events.c
     src/evtsrc.c
     src/exitfunc.c
     src/file.c
+    src/file_async.c
     src/file_slice.c
     src/file_stdio.c
     src/fshook.c
+    src/fshook_pack.c
     src/fshook_stdio.c
+    src/fshook_walk.c
     src/fullscreen_mode.c
     src/haptic.c
     src/inline.c
@@ -41,6 +48,7 @@ set(ALLEGRO_SRC_FILES
     src/pixels.c
     src/shader.c
     src/system.c
+    src/tasks.c
     src/threads.c
     src/timernu.c
     src/tls.c
@@ -217,6 +225,7 @@ set(ALLEGRO_INCLUDE_ALLEGRO_FILES
     include/allegro5/altime.h
     include/allegro5/base.h
     include/allegro5/bitmap.h
+    include/allegro5/bitmap_atlas.h
     include/allegro5/bitmap_draw.h
     include/allegro5/bitmap_io.h
     include/allegro5/bitmap_lock.h
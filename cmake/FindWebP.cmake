@@ -47,6 +47,14 @@ find_library(
 )
 mark_as_advanced(WEBP_LIBRARIES)
 
+# libwebpdemux is optional, it is only needed for animations.
+find_library(
+    WEBPDEMUX_LIBRARIES
+    NAMES webpdemux
+    HINTS ${PC_WEBP_LIBDIR} ${PC_WEBP_LIBRARY_DIRS}
+)
+mark_as_advanced(WEBPDEMUX_LIBRARIES)
+
 include(FindPackageHandleStandardArgs)
 set(FPHSA_NAME_MISMATCHED TRUE)
 find_package_handle_standard_args(WebP REQUIRED_VARS WEBP_INCLUDE_DIRS WEBP_LIBRARIES
@@ -25,17 +25,20 @@ enum Mode {
    ALL,
    PLAIN_BLIT,
    SCALED_BLIT,
-   ROTATE_BLIT
+   ROTATE_BLIT,
+   BLENDED_PIXELS
 };
 
 static char const *names[] = {
-   "", "Plain blit", "Scaled blit", "Rotated blit"
+   "", "Plain blit", "Scaled blit", "Rotated blit", "Blended pixels"
 };
 
 ALLEGRO_DISPLAY *display;
 
 static void step(enum Mode mode, ALLEGRO_BITMAP *b2)
 {
+   int x, y;
+
    switch (mode) {
       case ALL: break;
       case PLAIN_BLIT:
@@ -48,6 +51,14 @@ static void step(enum Mode mode, ALLEGRO_BITMAP *b2)
          al_draw_scaled_rotated_bitmap(b2, 10, 10, 10, 10, 2.0, 2.0,
             ALLEGRO_PI/30, 0);
          break;
+      case BLENDED_PIXELS:
+         /* Dominated by the per-call state lookups rather than blending. */
+         for (y = 0; y < 100; y++) {
+            for (x = 0; x < 100; x++) {
+               al_put_blended_pixel(x, y, al_map_rgba(x, y, 0, 128));
+            }
+         }
+         break;
    }
 }
 
@@ -141,6 +152,9 @@ int main(int argc, char **argv)
          case 2:
             mode = ROTATE_BLIT;
             break;
+         case 3:
+            mode = BLENDED_PIXELS;
+            break;
       }
    }
 
@@ -160,7 +174,7 @@ int main(int argc, char **argv)
    }
    
    if (mode == ALL) {
-      for (mode = PLAIN_BLIT; mode <= ROTATE_BLIT; mode++) {
+      for (mode = PLAIN_BLIT; mode <= BLENDED_PIXELS; mode++) {
          do_test(mode);
       }
    }
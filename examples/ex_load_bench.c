@@ -0,0 +1,112 @@
+/*
+ *    Benchmark for image loading from files.
+ *
+ *    Saves a large BMP and TGA image to temporary files and then times how
+ *    long it takes to load them back.  Both loaders do most of their reading
+ *    a few bytes at a time, so this mostly measures the file layer.
+ */
+
+#include <stdio.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+
+#include "common.c"
+
+#define SIZE 2048
+#define TEST_TIME 3.0
+
+static ALLEGRO_BITMAP *make_test_bitmap(void)
+{
+   ALLEGRO_BITMAP *bmp;
+   ALLEGRO_LOCKED_REGION *lr;
+   int x, y;
+
+   bmp = al_create_bitmap(SIZE, SIZE);
+   if (!bmp)
+      return NULL;
+
+   lr = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_WRITEONLY);
+   for (y = 0; y < SIZE; y++) {
+      unsigned char *row = (unsigned char *)lr->data + y * lr->pitch;
+      for (x = 0; x < SIZE; x++) {
+         /* Some runs of equal pixels so that RLE has something to do. */
+         row[x * 4 + 0] = (x / 16) ^ y;
+         row[x * 4 + 1] = (x / 4) + y;
+         row[x * 4 + 2] = y / 8;
+         row[x * 4 + 3] = 255;
+      }
+   }
+   al_unlock_bitmap(bmp);
+
+   return bmp;
+}
+
+static void bench(const char *name, const char *filename)
+{
+   ALLEGRO_BITMAP *bmp;
+   double t0, t1;
+   int n = 0;
+
+   t0 = al_get_time();
+   do {
+      bmp = al_load_bitmap(filename);
+      if (!bmp)
+         abort_example("Could not load %s.\n", filename);
+      al_destroy_bitmap(bmp);
+      n++;
+      t1 = al_get_time();
+   } while (t1 - t0 < TEST_TIME);
+
+   log_printf("%-4s %8.2f ms per load (%d loads)\n", name,
+      (t1 - t0) * 1000.0 / n, n);
+}
+
+int main(int argc, char **argv)
+{
+   ALLEGRO_BITMAP *bmp;
+   ALLEGRO_PATH *bmp_path, *tga_path;
+   ALLEGRO_FILE *f;
+
+   (void)argc;
+   (void)argv;
+
+   if (!al_init()) {
+      abort_example("Could not init Allegro.\n");
+   }
+   al_init_image_addon();
+   open_log();
+
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+   bmp = make_test_bitmap();
+   if (!bmp)
+      abort_example("Could not create bitmap.\n");
+
+   f = al_make_temp_file("ex_load_bench_XXXXXX.bmp", &bmp_path);
+   if (!f || !al_save_bitmap_f(f, ".bmp", bmp))
+      abort_example("Could not write BMP file.\n");
+   al_fclose(f);
+
+   f = al_make_temp_file("ex_load_bench_XXXXXX.tga", &tga_path);
+   if (!f || !al_save_bitmap_f(f, ".tga", bmp))
+      abort_example("Could not write TGA file.\n");
+   al_fclose(f);
+
+   al_destroy_bitmap(bmp);
+
+   log_printf("Loading %dx%d images for %.0f seconds each.\n", SIZE, SIZE,
+      TEST_TIME);
+   bench("BMP", al_path_cstr(bmp_path, ALLEGRO_NATIVE_PATH_SEP));
+   bench("TGA", al_path_cstr(tga_path, ALLEGRO_NATIVE_PATH_SEP));
+
+   al_remove_filename(al_path_cstr(bmp_path, ALLEGRO_NATIVE_PATH_SEP));
+   al_remove_filename(al_path_cstr(tga_path, ALLEGRO_NATIVE_PATH_SEP));
+   al_destroy_path(bmp_path);
+   al_destroy_path(tga_path);
+
+   close_log(true);
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
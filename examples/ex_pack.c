@@ -0,0 +1,358 @@
+/*
+ *    Pack file builder and benchmark.
+ *
+ *    Packs every file below a directory into a pack file, which can be
+ *    opened with al_open_pack.  Files are compressed with LZ4 if -z is
+ *    given and it makes them smaller.  Afterwards each file is opened and
+ *    read once directly and once from the pack, and the times compared.
+ *
+ *    Usage: ex_pack [-z] output.pack directory
+ */
+
+#define ALLEGRO_UNSTABLE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <allegro5/allegro.h>
+
+#include "common.c"
+
+#define HEADER_SIZE   24
+#define RECORD_SIZE   40
+
+typedef struct ENTRY
+{
+   char *path;       /* on disk */
+   char *name;       /* in the pack */
+   uint32_t hash;
+   uint32_t method;
+   uint32_t name_offset;
+   uint64_t offset;
+   uint64_t stored_size;
+   uint64_t size;
+} ENTRY;
+
+static ENTRY *entries;
+static int num_entries;
+static size_t root_len;
+static bool compress;
+
+static uint32_t hash_name(const char *name)
+{
+   uint32_t h = 2166136261u;
+
+   while (*name) {
+      h ^= (unsigned char)*name++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+static char *copy_string(const char *s)
+{
+   char *p = malloc(strlen(s) + 1);
+   strcpy(p, s);
+   return p;
+}
+
+static int add_file(ALLEGRO_FS_ENTRY *e, void *extra)
+{
+   const char *path = al_get_fs_entry_name(e);
+   ENTRY *entry;
+   char *p;
+
+   (void)extra;
+
+   if (al_get_fs_entry_mode(e) & ALLEGRO_FILEMODE_ISDIR)
+      return ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+
+   entries = realloc(entries, (num_entries + 1) * sizeof(ENTRY));
+   entry = &entries[num_entries++];
+   memset(entry, 0, sizeof(*entry));
+   entry->path = copy_string(path);
+   entry->name = copy_string(path + root_len);
+   for (p = entry->name; *p; p++) {
+      if (*p == '\\')
+         *p = '/';
+   }
+   entry->hash = hash_name(entry->name);
+   return ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+   const ENTRY *ea = a;
+   const ENTRY *eb = b;
+
+   if (ea->hash != eb->hash)
+      return ea->hash < eb->hash ? -1 : 1;
+   return strcmp(ea->name, eb->name);
+}
+
+static void put32(unsigned char *p, uint32_t x)
+{
+   p[0] = x;
+   p[1] = x >> 8;
+   p[2] = x >> 16;
+   p[3] = x >> 24;
+}
+
+static void put64(unsigned char *p, uint64_t x)
+{
+   put32(p, (uint32_t)x);
+   put32(p + 4, (uint32_t)(x >> 32));
+}
+
+static uint32_t read32(const unsigned char *p)
+{
+   uint32_t x;
+   memcpy(&x, p, 4);
+   return x;
+}
+
+static unsigned char *put_length(unsigned char *op, size_t len)
+{
+   while (len >= 255) {
+      *op++ = 255;
+      len -= 255;
+   }
+   *op++ = len;
+   return op;
+}
+
+static unsigned char *put_sequence(unsigned char *op,
+   const unsigned char *lit, size_t lit_len, size_t offset, size_t match_len)
+{
+   unsigned char *token = op++;
+
+   *token = (lit_len < 15 ? lit_len : 15) << 4;
+   if (lit_len >= 15)
+      op = put_length(op, lit_len - 15);
+   memcpy(op, lit, lit_len);
+   op += lit_len;
+
+   if (match_len > 0) {
+      *op++ = offset;
+      *op++ = offset >> 8;
+      match_len -= 4;
+      *token |= match_len < 15 ? match_len : 15;
+      if (match_len >= 15)
+         op = put_length(op, match_len - 15);
+   }
+   return op;
+}
+
+/* Greedy LZ4 block compressor.  dst must hold size + size / 255 + 16
+ * bytes.  Returns the compressed size.
+ */
+static size_t lz4_compress(const unsigned char *src, size_t size,
+   unsigned char *dst)
+{
+   static size_t table[1 << 14];
+   unsigned char *op = dst;
+   size_t ip = 0;
+   size_t anchor = 0;
+
+   memset(table, 0, sizeof(table));
+
+   /* The last match must start 12 bytes and end 5 bytes before the end. */
+   while (size >= 13 && ip < size - 12) {
+      uint32_t seq = read32(src + ip);
+      uint32_t h = (seq * 2654435761u) >> 18;
+      size_t ref = table[h];
+
+      table[h] = ip + 1;
+      if (ref && ip - (ref - 1) <= 65535 && read32(src + ref - 1) == seq) {
+         size_t len = 4;
+         ref--;
+         while (ip + len < size - 5 && src[ref + len] == src[ip + len])
+            len++;
+         op = put_sequence(op, src + anchor, ip - anchor, ip - ref, len);
+         ip += len;
+         anchor = ip;
+      }
+      else {
+         ip++;
+      }
+   }
+
+   op = put_sequence(op, src + anchor, size - anchor, 0, 0);
+   return op - dst;
+}
+
+static void write_pack(const char *filename)
+{
+   ALLEGRO_FILE *out;
+   unsigned char header[HEADER_SIZE];
+   unsigned char record[RECORD_SIZE];
+   uint32_t names_size = 0;
+   uint64_t offset;
+   int i;
+
+   qsort(entries, num_entries, sizeof(ENTRY), compare_entries);
+
+   for (i = 0; i < num_entries; i++) {
+      entries[i].name_offset = names_size;
+      names_size += strlen(entries[i].name) + 1;
+   }
+
+   out = al_fopen(filename, "wb");
+   if (!out)
+      abort_example("Could not open %s.\n", filename);
+
+   memset(header, 0, sizeof(header));
+   memcpy(header, "AL5PACK", 8);
+   put32(header + 8, 1);
+   put32(header + 12, num_entries);
+   put32(header + 16, names_size);
+   al_fwrite(out, header, sizeof(header));
+
+   /* The index is written once the data offsets are known. */
+   memset(record, 0, sizeof(record));
+   for (i = 0; i < num_entries; i++)
+      al_fwrite(out, record, sizeof(record));
+   for (i = 0; i < num_entries; i++)
+      al_fwrite(out, entries[i].name, strlen(entries[i].name) + 1);
+
+   offset = al_ftell(out);
+   for (i = 0; i < num_entries; i++) {
+      ENTRY *e = &entries[i];
+      ALLEGRO_FILE *in = al_fopen(e->path, "rb");
+      unsigned char *data, *packed = NULL;
+      size_t size, packed_size = 0;
+
+      if (!in)
+         abort_example("Could not open %s.\n", e->path);
+      size = al_fsize(in);
+      data = malloc(size + 1);
+      if (al_fread(in, data, size) != size)
+         abort_example("Could not read %s.\n", e->path);
+      al_fclose(in);
+
+      /* Keep entries aligned so they can be used in place. */
+      while (offset % 8) {
+         al_fputc(out, 0);
+         offset++;
+      }
+
+      if (compress) {
+         packed = malloc(size + size / 255 + 16);
+         packed_size = lz4_compress(data, size, packed);
+      }
+
+      e->offset = offset;
+      e->size = size;
+      if (packed && packed_size < size) {
+         e->method = 1;
+         e->stored_size = packed_size;
+         al_fwrite(out, packed, packed_size);
+      }
+      else {
+         e->method = 0;
+         e->stored_size = size;
+         al_fwrite(out, data, size);
+      }
+      offset += e->stored_size;
+
+      free(packed);
+      free(data);
+   }
+
+   al_fseek(out, HEADER_SIZE, ALLEGRO_SEEK_SET);
+   for (i = 0; i < num_entries; i++) {
+      ENTRY *e = &entries[i];
+      put32(record, e->hash);
+      put32(record + 4, e->method);
+      put32(record + 8, e->name_offset);
+      put32(record + 12, strlen(e->name));
+      put64(record + 16, e->offset);
+      put64(record + 24, e->stored_size);
+      put64(record + 32, e->size);
+      al_fwrite(out, record, sizeof(record));
+   }
+
+   if (al_ferror(out))
+      abort_example("Error writing %s.\n", filename);
+   al_fclose(out);
+
+   log_printf("Packed %d files into %s (%.1f KiB).\n", num_entries, filename,
+      offset / 1024.0);
+}
+
+static bool read_all(ALLEGRO_FILE *f)
+{
+   char buf[4096];
+
+   if (!f)
+      return false;
+   while (al_fread(f, buf, sizeof(buf)) == sizeof(buf))
+      ;
+   al_fclose(f);
+   return true;
+}
+
+static void benchmark(const char *filename)
+{
+   ALLEGRO_PACK *pack;
+   double t0, t1, t2;
+   int i;
+
+   t0 = al_get_time();
+   for (i = 0; i < num_entries; i++) {
+      if (!read_all(al_fopen(entries[i].path, "rb")))
+         abort_example("Could not read %s.\n", entries[i].path);
+   }
+   t1 = al_get_time();
+
+   pack = al_open_pack(filename);
+   if (!pack)
+      abort_example("Could not open %s.\n", filename);
+   for (i = 0; i < num_entries; i++) {
+      if (!read_all(al_open_pack_entry(pack, entries[i].name)))
+         abort_example("Could not read %s from the pack.\n", entries[i].name);
+   }
+   al_close_pack(pack);
+   t2 = al_get_time();
+
+   log_printf("Reading every file: %.2f ms from disk, %.2f ms from the pack.\n",
+      (t1 - t0) * 1000.0, (t2 - t1) * 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+   ALLEGRO_FS_ENTRY *root;
+   int arg = 1;
+
+   if (!al_init()) {
+      abort_example("Could not init Allegro.\n");
+   }
+   open_log();
+
+   if (arg < argc && strcmp(argv[arg], "-z") == 0) {
+      compress = true;
+      arg++;
+   }
+   if (argc - arg != 2) {
+      log_printf("Usage: %s [-z] output.pack directory\n", argv[0]);
+      close_log(true);
+      return 1;
+   }
+
+   root = al_create_fs_entry(argv[arg + 1]);
+   if (!root || !(al_get_fs_entry_mode(root) & ALLEGRO_FILEMODE_ISDIR))
+      abort_example("%s is not a directory.\n", argv[arg + 1]);
+   root_len = strlen(al_get_fs_entry_name(root));
+   if (root_len > 0 && !strchr("/\\", al_get_fs_entry_name(root)[root_len - 1]))
+      root_len++;
+
+   al_for_each_fs_entry(root, add_file, NULL);
+   al_destroy_fs_entry(root);
+
+   write_pack(argv[arg]);
+   benchmark(argv[arg]);
+
+   close_log(true);
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
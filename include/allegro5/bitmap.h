@@ -54,6 +54,8 @@ AL_FUNC(int, al_get_new_bitmap_samples, (void));
 AL_FUNC(void, al_set_new_bitmap_samples, (int samples));
 AL_FUNC(void, al_get_new_bitmap_wrap, (ALLEGRO_BITMAP_WRAP *u, ALLEGRO_BITMAP_WRAP *v));
 AL_FUNC(void, al_set_new_bitmap_wrap, (ALLEGRO_BITMAP_WRAP u, ALLEGRO_BITMAP_WRAP v));
+AL_FUNC(void, al_get_new_bitmap_load_size, (int *w, int *h));
+AL_FUNC(void, al_set_new_bitmap_load_size, (int w, int h));
 #endif
 
 AL_FUNC(int, al_get_bitmap_width, (ALLEGRO_BITMAP *bitmap));
@@ -0,0 +1,35 @@
+#ifndef __al_included_allegro5_bitmap_atlas_h
+#define __al_included_allegro5_bitmap_atlas_h
+
+#include "allegro5/bitmap.h"
+#include "allegro5/config.h"
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_BITMAP_ATLAS
+ */
+typedef struct ALLEGRO_BITMAP_ATLAS ALLEGRO_BITMAP_ATLAS;
+
+AL_FUNC(ALLEGRO_BITMAP_ATLAS *, al_create_bitmap_atlas, (int w, int h, int padding, int extrude));
+AL_FUNC(void, al_destroy_bitmap_atlas, (ALLEGRO_BITMAP_ATLAS *atlas));
+AL_FUNC(ALLEGRO_BITMAP *, al_add_bitmap_to_atlas, (ALLEGRO_BITMAP_ATLAS *atlas, ALLEGRO_BITMAP *bitmap));
+AL_FUNC(int, al_add_bitmaps_to_atlas, (ALLEGRO_BITMAP_ATLAS *atlas,
+   ALLEGRO_BITMAP **bitmaps, int count, ALLEGRO_BITMAP **sub_bitmaps));
+AL_FUNC(ALLEGRO_BITMAP *, al_get_bitmap_atlas_bitmap, (ALLEGRO_BITMAP_ATLAS *atlas));
+AL_FUNC(int, al_get_bitmap_atlas_count, (ALLEGRO_BITMAP_ATLAS *atlas));
+AL_FUNC(ALLEGRO_BITMAP *, al_get_bitmap_atlas_entry, (ALLEGRO_BITMAP_ATLAS *atlas, int index));
+AL_FUNC(ALLEGRO_CONFIG *, al_get_bitmap_atlas_layout, (ALLEGRO_BITMAP_ATLAS *atlas));
+AL_FUNC(ALLEGRO_BITMAP_ATLAS *, al_create_bitmap_atlas_from_layout, (ALLEGRO_BITMAP *bitmap,
+   const ALLEGRO_CONFIG *layout));
+#endif
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set sts=3 sw=3 et: */
@@ -38,6 +38,17 @@ AL_FUNC(bool, al_save_bitmap_f, (ALLEGRO_FILE *fp, const char *ident, ALLEGRO_BI
 AL_FUNC(char const *, al_identify_bitmap_f, (ALLEGRO_FILE *fp));
 AL_FUNC(char const *, al_identify_bitmap, (char const *filename));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+typedef struct ALLEGRO_BITMAP_LOADER ALLEGRO_BITMAP_LOADER;
+
+AL_FUNC(ALLEGRO_BITMAP_LOADER *, al_create_bitmap_loader, (void));
+AL_FUNC(void, al_destroy_bitmap_loader, (ALLEGRO_BITMAP_LOADER *loader));
+AL_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_bitmap_loader_event_source, (ALLEGRO_BITMAP_LOADER *loader));
+AL_FUNC(int, al_load_bitmap_async, (ALLEGRO_BITMAP_LOADER *loader, const char *filename, int flags));
+
+AL_FUNC(bool, al_set_bitmap_cache_path, (const char *path));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
@@ -49,7 +49,10 @@ enum
    ALLEGRO_EVENT_TOUCH_CANCEL                = 53,
    
    ALLEGRO_EVENT_DISPLAY_CONNECTED           = 60,
-   ALLEGRO_EVENT_DISPLAY_DISCONNECTED        = 61
+   ALLEGRO_EVENT_DISPLAY_DISCONNECTED        = 61,
+
+   ALLEGRO_EVENT_FILE_READ                   = 70,
+   ALLEGRO_EVENT_BITMAP_LOADED               = 71
 };
 
 
@@ -181,6 +184,27 @@ typedef struct ALLEGRO_TOUCH_EVENT
 
 
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+typedef struct ALLEGRO_FILE_EVENT
+{
+   _AL_EVENT_HEADER(struct ALLEGRO_EVENT_SOURCE)
+   void *buffer;
+   int64_t offset;
+   size_t size;
+   size_t bytes_read;
+} ALLEGRO_FILE_EVENT;
+
+typedef struct ALLEGRO_BITMAP_EVENT
+{
+   _AL_EVENT_HEADER(struct ALLEGRO_EVENT_SOURCE)
+   struct ALLEGRO_BITMAP *bitmap;
+   const char *filename;
+   int index;
+} ALLEGRO_BITMAP_EVENT;
+#endif
+
+
+
 /* Type: ALLEGRO_USER_EVENT
  */
 typedef struct ALLEGRO_USER_EVENT ALLEGRO_USER_EVENT;
@@ -217,6 +241,10 @@ union ALLEGRO_EVENT
    ALLEGRO_TIMER_EVENT    timer;
    ALLEGRO_TOUCH_EVENT    touch;
    ALLEGRO_USER_EVENT     user;
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+   ALLEGRO_FILE_EVENT     file;
+   ALLEGRO_BITMAP_EVENT   bitmap;
+#endif
 };
 
 
@@ -234,6 +262,22 @@ AL_FUNC(void, al_unref_user_event, (ALLEGRO_USER_EVENT *));
 AL_FUNC(void, al_set_event_source_data, (ALLEGRO_EVENT_SOURCE*, intptr_t data));
 AL_FUNC(intptr_t, al_get_event_source_data, (const ALLEGRO_EVENT_SOURCE*));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_EVENT_SOURCE_STATS
+ */
+typedef struct ALLEGRO_EVENT_SOURCE_STATS ALLEGRO_EVENT_SOURCE_STATS;
+
+struct ALLEGRO_EVENT_SOURCE_STATS
+{
+   unsigned int num_emitted;
+   unsigned int num_dropped;
+};
+
+AL_FUNC(void, al_get_event_source_stats, (ALLEGRO_EVENT_SOURCE *source,
+                                          ALLEGRO_EVENT_SOURCE_STATS *stats));
+AL_FUNC(void, al_reset_event_source_stats, (ALLEGRO_EVENT_SOURCE *source));
+#endif
+
 
 
 /* Event queues */
@@ -264,6 +308,28 @@ AL_FUNC(bool, al_wait_for_event_until, (ALLEGRO_EVENT_QUEUE *queue,
                                         ALLEGRO_EVENT *ret_event,
                                         ALLEGRO_TIMEOUT *timeout));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_EVENT_QUEUE_STATS
+ */
+typedef struct ALLEGRO_EVENT_QUEUE_STATS ALLEGRO_EVENT_QUEUE_STATS;
+
+struct ALLEGRO_EVENT_QUEUE_STATS
+{
+   unsigned int num_queued;
+   unsigned int num_dropped;
+   unsigned int num_dequeued;
+   unsigned int depth;
+   unsigned int peak_depth;
+   unsigned int num_expansions;
+   double total_latency;
+   double max_latency;
+};
+
+AL_FUNC(void, al_get_event_queue_stats, (ALLEGRO_EVENT_QUEUE *queue,
+                                         ALLEGRO_EVENT_QUEUE_STATS *stats));
+AL_FUNC(void, al_reset_event_queue_stats, (ALLEGRO_EVENT_QUEUE *queue));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
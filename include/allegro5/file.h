@@ -2,6 +2,7 @@
 #define __al_included_allegro5_file_h
 
 #include "allegro5/base.h"
+#include "allegro5/events.h"
 #include "allegro5/path.h"
 #include "allegro5/utf8.h"
 
@@ -61,6 +62,9 @@ AL_FUNC(const char *, al_ferrmsg, (ALLEGRO_FILE *f));
 AL_FUNC(void, al_fclearerr, (ALLEGRO_FILE *f));
 AL_FUNC(int, al_fungetc, (ALLEGRO_FILE *f, int c));
 AL_FUNC(int64_t, al_fsize, (ALLEGRO_FILE *f));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(const void *, al_fborrow, (ALLEGRO_FILE *f, size_t *ret_size));
+#endif
 
 /* Convenience functions. */
 AL_FUNC(int, al_fgetc, (ALLEGRO_FILE *f));
@@ -88,6 +92,13 @@ AL_FUNC(ALLEGRO_FILE*, al_make_temp_file, (const char *tmpl,
 AL_FUNC(ALLEGRO_FILE*, al_fopen_slice, (ALLEGRO_FILE *fp,
       size_t initial_size, const char *mode));
 
+/* Asynchronous reads. */
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(bool, al_fread_async, (ALLEGRO_FILE *f, int64_t offset, void *ptr,
+      size_t size));
+AL_FUNC(ALLEGRO_EVENT_SOURCE *, al_get_file_event_source, (ALLEGRO_FILE *f));
+#endif
+
 /* Thread-local state. */
 AL_FUNC(const ALLEGRO_FILE_INTERFACE *, al_get_new_file_interface, (void));
 AL_FUNC(void, al_set_new_file_interface, (const ALLEGRO_FILE_INTERFACE *
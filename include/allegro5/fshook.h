@@ -132,6 +132,31 @@ AL_FUNC(int,  al_for_each_fs_entry, (ALLEGRO_FS_ENTRY *dir,
                                      int (*callback)(ALLEGRO_FS_ENTRY *entry, void *extra),
                                      void *extra));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_FS_WALK_ENTRY
+ */
+typedef struct ALLEGRO_FS_WALK_ENTRY ALLEGRO_FS_WALK_ENTRY;
+
+struct ALLEGRO_FS_WALK_ENTRY {
+   const char *path;
+   const char *name;
+   uint32_t mode;
+   off_t size;
+   time_t mtime;
+};
+
+/* Enum: ALLEGRO_FS_WALK_FLAGS
+ */
+enum ALLEGRO_FS_WALK_FLAGS {
+   ALLEGRO_FS_WALK_STAT        = 1 << 0,
+   ALLEGRO_FS_WALK_DIRECTORIES = 1 << 1
+};
+
+AL_FUNC(int, al_walk_directory, (const char *path, const char *patterns,
+   int flags, int (*callback)(const ALLEGRO_FS_WALK_ENTRY *entries, int count,
+   void *extra), void *extra));
+#endif
+
 
 /* Thread-local state. */
 AL_FUNC(const ALLEGRO_FS_INTERFACE *, al_get_fs_interface, (void));
@@ -139,6 +164,18 @@ AL_FUNC(void, al_set_fs_interface, (const ALLEGRO_FS_INTERFACE *vtable));
 AL_FUNC(void, al_set_standard_fs_interface, (void));
 
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_PACK
+ */
+typedef struct ALLEGRO_PACK ALLEGRO_PACK;
+
+AL_FUNC(ALLEGRO_PACK *, al_open_pack, (const char *filename));
+AL_FUNC(void, al_close_pack, (ALLEGRO_PACK *pack));
+AL_FUNC(ALLEGRO_FILE *, al_open_pack_entry, (ALLEGRO_PACK *pack, const char *name));
+AL_FUNC(void, al_set_pack_file_interface, (ALLEGRO_PACK *pack));
+#endif
+
+
 #ifdef __cplusplus
    }
 #endif
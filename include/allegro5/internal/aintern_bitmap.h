@@ -181,6 +181,11 @@ void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color);
 
 /* Bitmap I/O */
 void _al_init_iio_table(void);
+void _al_init_bitmap_cache(void);
+ALLEGRO_BITMAP *_al_load_bitmap_cached(const char *filename, int flags,
+   ALLEGRO_BITMAP *(*load)(const char *filename, int flags),
+   ALLEGRO_BITMAP *(*load_f)(ALLEGRO_FILE *fp, const char *filename,
+      int flags));
 
 
 int _al_get_bitmap_memory_format(ALLEGRO_BITMAP *bitmap);
@@ -2,6 +2,7 @@
 #define __al_included_allegro5_aintern_blend_h
 
 #include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_display.h"
 
 #ifdef __cplusplus
    extern "C" {
@@ -242,7 +243,25 @@ void _al_blend_inline(
 #endif
 
 
-void _al_blend_memory(ALLEGRO_COLOR *src_color, ALLEGRO_BITMAP *dest,
+/* Snapshot of the calling thread's drawing state, fetched with a single
+ * thread local storage lookup.  The pointers stay valid until the target
+ * bitmap is changed or destroyed.
+ */
+typedef struct _AL_DRAWING_STATE
+{
+   ALLEGRO_BITMAP *target;
+   /* The target's bitmap blender if it has one, else the thread's. */
+   const ALLEGRO_BLENDER *blender;
+   /* The target's transform, or NULL if there is no target. */
+   const ALLEGRO_TRANSFORM *transform;
+   /* The thread's blend color, as used by the memory blenders. */
+   ALLEGRO_COLOR blend_color;
+} _AL_DRAWING_STATE;
+
+bool _al_get_drawing_state(_AL_DRAWING_STATE *state);
+
+void _al_blend_memory(const _AL_DRAWING_STATE *state,
+   ALLEGRO_COLOR *src_color, ALLEGRO_BITMAP *dest,
    int dx, int dy, ALLEGRO_COLOR *result);
 
 
@@ -1,7 +1,20 @@
 #ifndef __al_included_allegro5_aintern_config_h
 #define __al_included_allegro5_aintern_config_h
 
-#include "allegro5/internal/aintern_aatree.h"
+/* Hash table from names to sections, or from keys to entries.  The linked
+ * lists keep the insertion order, which is the order things are saved in.
+ */
+typedef struct _AL_CONFIG_SLOT {
+   uint32_t hash;
+   const ALLEGRO_USTR *key;   /* owned by the value */
+   void *value;               /* NULL if the slot is empty */
+} _AL_CONFIG_SLOT;
+
+typedef struct _AL_CONFIG_INDEX {
+   _AL_CONFIG_SLOT *slots;
+   unsigned int capacity;     /* zero or a power of two */
+   unsigned int count;
+} _AL_CONFIG_INDEX;
 
 struct ALLEGRO_CONFIG_ENTRY {
    bool is_comment;
@@ -14,16 +27,15 @@ struct ALLEGRO_CONFIG_SECTION {
    ALLEGRO_USTR *name;
    ALLEGRO_CONFIG_ENTRY *head;
    ALLEGRO_CONFIG_ENTRY *last;
-   _AL_AATREE *tree;
+   _AL_CONFIG_INDEX index;
    ALLEGRO_CONFIG_SECTION *prev, *next;
 };
 
 struct ALLEGRO_CONFIG {
    ALLEGRO_CONFIG_SECTION *head;
    ALLEGRO_CONFIG_SECTION *last;
-   _AL_AATREE *tree;
+   _AL_CONFIG_INDEX index;
 };
 
 
 #endif
-
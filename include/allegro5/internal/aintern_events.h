@@ -16,6 +16,9 @@ struct ALLEGRO_EVENT_SOURCE_REAL
    _AL_MUTEX mutex;
    _AL_VECTOR queues;
    intptr_t data;
+   /* Statistics, protected by the mutex. */
+   unsigned int num_emitted;
+   unsigned int num_dropped;
 };
 
 typedef struct ALLEGRO_USER_EVENT_DESCRIPTOR
@@ -36,7 +39,7 @@ void _al_event_source_on_unregistration_from_queue(ALLEGRO_EVENT_SOURCE*, ALLEGR
 bool _al_event_source_needs_to_generate_event(ALLEGRO_EVENT_SOURCE*);
 void _al_event_source_emit_event(ALLEGRO_EVENT_SOURCE *, ALLEGRO_EVENT*);
 
-void _al_event_queue_push_event(ALLEGRO_EVENT_QUEUE*, const ALLEGRO_EVENT*);
+bool _al_event_queue_push_event(ALLEGRO_EVENT_QUEUE*, const ALLEGRO_EVENT*);
 
 
 #ifdef __cplusplus
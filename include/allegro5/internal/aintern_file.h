@@ -7,8 +7,13 @@
 
 
 extern const ALLEGRO_FILE_INTERFACE _al_file_interface_stdio;
+extern const ALLEGRO_FILE_INTERFACE _al_file_interface_slice;
+extern const ALLEGRO_FILE_INTERFACE _al_file_interface_pack;
 
 #define ALLEGRO_UNGETC_SIZE 16
+#define ALLEGRO_READ_AHEAD_SIZE 4096
+
+typedef struct _AL_FILE_ASYNC _AL_FILE_ASYNC;
 
 struct ALLEGRO_FILE
 {
@@ -16,8 +21,38 @@ struct ALLEGRO_FILE
    void *userdata;
    unsigned char ungetc[ALLEGRO_UNGETC_SIZE];
    int ungetc_len;
+
+   /* Read-ahead buffer, used to serve small reads without going through
+    * the vtable.  The backend's position is at the end of the buffered
+    * data.  rbuf is allocated on first use, and only if read_ahead is set.
+    */
+   bool read_ahead;
+   bool rbuf_eof;
+   unsigned char *rbuf;
+   size_t rbuf_pos;
+   size_t rbuf_len;
+
+   /* Name passed to al_fopen_interface, or NULL.  al_fread_async opens a
+    * second handle with it so that worker threads never touch this one.
+    */
+   char *path;
+
+   /* State for al_fread_async, created on first use. */
+   _AL_FILE_ASYNC *async;
 };
 
+ALLEGRO_FILE *_al_fopen_mapped(const char *path);
+int _al_fungetc_buffered(ALLEGRO_FILE *f, int c);
+AL_FUNC(void, _al_set_file_read_ahead, (ALLEGRO_FILE *f, bool enable));
+const void *_al_file_stdio_borrow(ALLEGRO_FILE *f, size_t *ret_size);
+bool _al_file_stdio_is_mapped(ALLEGRO_FILE *f);
+bool _al_file_stdio_pread(ALLEGRO_FILE *f, int64_t offset, void *ptr,
+   size_t size, size_t *ret_size);
+void _al_init_file_async(void);
+void _al_file_async_close(ALLEGRO_FILE *f);
+const void *_al_file_slice_borrow(ALLEGRO_FILE *f, size_t *ret_size);
+const void *_al_file_pack_borrow(ALLEGRO_FILE *f, size_t *ret_size);
+
 #ifdef __cplusplus
    }
 #endif
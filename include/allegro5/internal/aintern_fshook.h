@@ -25,6 +25,16 @@
 
 extern struct ALLEGRO_FS_INTERFACE _al_fs_interface_stdio;
 
+bool _al_fs_stdio_read_names(const char *path,
+   bool (*proc)(const char *name, uint32_t mode, bool is_link, void *arg),
+   void *arg);
+bool _al_fs_stdio_stat(const char *path, uint32_t *mode, off_t *size,
+   time_t *mtime);
+ALLEGRO_FILE *_al_fs_stdio_create_temp(const char *path,
+   ALLEGRO_USTR *tmp_path);
+bool _al_fs_stdio_commit_temp(const char *tmp_path, const char *path,
+   bool keep);
+
 
 #ifdef __cplusplus
    }
@@ -494,6 +494,16 @@ AL_FUNC(bool, _al_pixel_format_is_compressed, (int format));
 AL_FUNC(int, _al_get_real_pixel_format, (ALLEGRO_DISPLAY *display, int format));
 AL_FUNC(char const*, _al_pixel_format_name, (ALLEGRO_PIXEL_FORMAT format));
 
+AL_FUNC(void, _al_decode_dxt_blocks, (int format, const void *src,
+   int src_pitch, void *dst, int dst_pitch, int sx, int sy, int dx, int dy,
+   int width, int height));
+AL_FUNC(void, _al_encode_dxt_blocks, (int format, const void *src,
+   int src_pitch, void *dst, int dst_pitch, int sx, int sy, int dx, int dy,
+   int width, int height));
+AL_FUNC(void, _al_convert_compressed_data, (const void *src, int src_format,
+   int src_pitch, void *dst, int dst_format, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height));
+
 
 #ifdef __cplusplus
    }
@@ -11,6 +11,7 @@
 typedef struct _AL_THREAD _AL_THREAD;
 typedef struct _AL_MUTEX _AL_MUTEX;
 typedef struct _AL_COND _AL_COND;
+typedef struct _AL_RWLOCK _AL_RWLOCK;
 
 
 void _al_thread_create(_AL_THREAD*, void (*proc)(_AL_THREAD*, void*), void *arg);
@@ -23,10 +24,21 @@ void _al_thread_detach(_AL_THREAD*);
 
 void _al_mutex_init(_AL_MUTEX*);
 void _al_mutex_init_recursive(_AL_MUTEX*);
+void _al_mutex_init_adaptive(_AL_MUTEX*);
 void _al_mutex_destroy(_AL_MUTEX*);
 /* static inline void _al_mutex_lock(_AL_MUTEX*); */
 /* static inline void _al_mutex_unlock(_AL_MUTEX*); */
 
+void _al_rwlock_init(_AL_RWLOCK*);
+void _al_rwlock_destroy(_AL_RWLOCK*);
+/* These are inline except on Windows. */
+#ifdef ALLEGRO_WINDOWS
+void _al_rwlock_lock_read(_AL_RWLOCK*);
+void _al_rwlock_unlock_read(_AL_RWLOCK*);
+void _al_rwlock_lock_write(_AL_RWLOCK*);
+void _al_rwlock_unlock_write(_AL_RWLOCK*);
+#endif
+
 /* All 5 functions below are declared inline in aintuthr.h.
  * FIXME: Why are they all inline? And if they have to be, why not treat them
  * the same as the two functions above?
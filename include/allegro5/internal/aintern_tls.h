@@ -11,6 +11,9 @@ void _al_reinitialize_tls_values(void);
 
 int *_al_tls_get_dtor_owner_count(void);
 
+void *_al_tls_get_task_worker(void);
+void _al_tls_set_task_worker(void *worker);
+
 
 #ifdef __cplusplus
    }
@@ -38,6 +38,15 @@ struct _AL_COND
    pthread_cond_t cond;
 };
 
+struct _AL_RWLOCK
+{
+   bool inited;
+   pthread_rwlock_t lock;
+};
+
+#define _AL_RWLOCK_UNINITED            { false, PTHREAD_RWLOCK_INITIALIZER }
+#define _AL_MARK_RWLOCK_UNINITED(L)    do { L.inited = false; } while (0)
+
 typedef struct ALLEGRO_TIMEOUT_UNIX ALLEGRO_TIMEOUT_UNIX;
 struct ALLEGRO_TIMEOUT_UNIX
 {
@@ -68,6 +77,27 @@ AL_INLINE(void, _al_mutex_unlock, (struct _AL_MUTEX *m),
       pthread_mutex_unlock(&m->mutex);
 })
 
+AL_INLINE(void, _al_rwlock_lock_read, (struct _AL_RWLOCK *l),
+{
+   if (l->inited)
+      pthread_rwlock_rdlock(&l->lock);
+})
+AL_INLINE(void, _al_rwlock_unlock_read, (struct _AL_RWLOCK *l),
+{
+   if (l->inited)
+      pthread_rwlock_unlock(&l->lock);
+})
+AL_INLINE(void, _al_rwlock_lock_write, (struct _AL_RWLOCK *l),
+{
+   if (l->inited)
+      pthread_rwlock_wrlock(&l->lock);
+})
+AL_INLINE(void, _al_rwlock_unlock_write, (struct _AL_RWLOCK *l),
+{
+   if (l->inited)
+      pthread_rwlock_unlock(&l->lock);
+})
+
 AL_INLINE(void, _al_cond_init, (struct _AL_COND *cond),
 {
    pthread_cond_init(&cond->cond, NULL);
@@ -40,6 +40,18 @@ struct _AL_COND
    CRITICAL_SECTION mtxUnblockLock;
 };
 
+/* Holds a slim reader/writer lock.  SRWLOCK itself is only declared for
+ * Vista and later targets, so it is only touched in wxthread.c.
+ */
+struct _AL_RWLOCK
+{
+   bool inited;
+   void *srw;
+};
+
+#define _AL_RWLOCK_UNINITED            { false, NULL }
+#define _AL_MARK_RWLOCK_UNINITED(L)    do { L.inited = false; } while (0)
+
 typedef struct ALLEGRO_TIMEOUT_WIN ALLEGRO_TIMEOUT_WIN;
 struct ALLEGRO_TIMEOUT_WIN
 {
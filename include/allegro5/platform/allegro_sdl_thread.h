@@ -30,6 +30,15 @@ struct _AL_COND
    SDL_cond *cond;
 };
 
+/* SDL 2 has no reader/writer lock, so readers are serialised too. */
+struct _AL_RWLOCK
+{
+   SDL_mutex *mutex;
+};
+
+#define _AL_RWLOCK_UNINITED            { NULL }
+#define _AL_MARK_RWLOCK_UNINITED(L)    do { L.mutex = NULL; } while (0)
+
 typedef struct ALLEGRO_TIMEOUT_SDL ALLEGRO_TIMEOUT_SDL;
 struct ALLEGRO_TIMEOUT_SDL
 {
@@ -55,6 +64,27 @@ AL_INLINE(void, _al_mutex_unlock, (struct _AL_MUTEX *m),
       SDL_UnlockMutex(m->mutex);
 })
 
+AL_INLINE(void, _al_rwlock_lock_read, (struct _AL_RWLOCK *l),
+{
+   if (l->mutex)
+      SDL_LockMutex(l->mutex);
+})
+AL_INLINE(void, _al_rwlock_unlock_read, (struct _AL_RWLOCK *l),
+{
+   if (l->mutex)
+      SDL_UnlockMutex(l->mutex);
+})
+AL_INLINE(void, _al_rwlock_lock_write, (struct _AL_RWLOCK *l),
+{
+   if (l->mutex)
+      SDL_LockMutex(l->mutex);
+})
+AL_INLINE(void, _al_rwlock_unlock_write, (struct _AL_RWLOCK *l),
+{
+   if (l->mutex)
+      SDL_UnlockMutex(l->mutex);
+})
+
 AL_INLINE(void, _al_cond_init, (struct _AL_COND *cond),
 {
    cond->cond = SDL_CreateCond();
@@ -34,6 +34,16 @@ typedef struct ALLEGRO_MUTEX ALLEGRO_MUTEX;
  */
 typedef struct ALLEGRO_COND ALLEGRO_COND;
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+/* Type: ALLEGRO_RWLOCK
+ */
+typedef struct ALLEGRO_RWLOCK ALLEGRO_RWLOCK;
+
+/* Type: ALLEGRO_TASK_GROUP
+ */
+typedef struct ALLEGRO_TASK_GROUP ALLEGRO_TASK_GROUP;
+#endif
+
 
 AL_FUNC(ALLEGRO_THREAD *, al_create_thread,
    (void *(*proc)(ALLEGRO_THREAD *thread, void *arg), void *arg));
@@ -50,6 +60,9 @@ AL_FUNC(void, al_run_detached_thread, (void *(*proc)(void *arg), void *arg));
 
 AL_FUNC(ALLEGRO_MUTEX *, al_create_mutex, (void));
 AL_FUNC(ALLEGRO_MUTEX *, al_create_mutex_recursive, (void));
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(ALLEGRO_MUTEX *, al_create_mutex_adaptive, (void));
+#endif
 AL_FUNC(void, al_lock_mutex, (ALLEGRO_MUTEX *mutex));
 AL_FUNC(void, al_unlock_mutex, (ALLEGRO_MUTEX *mutex));
 AL_FUNC(void, al_destroy_mutex, (ALLEGRO_MUTEX *mutex));
@@ -62,6 +75,24 @@ AL_FUNC(int, al_wait_cond_until, (ALLEGRO_COND *cond, ALLEGRO_MUTEX *mutex,
 AL_FUNC(void, al_broadcast_cond, (ALLEGRO_COND *cond));
 AL_FUNC(void, al_signal_cond, (ALLEGRO_COND *cond));
 
+#if defined(ALLEGRO_UNSTABLE) || defined(ALLEGRO_INTERNAL_UNSTABLE) || defined(ALLEGRO_SRC)
+AL_FUNC(ALLEGRO_RWLOCK *, al_create_rwlock, (void));
+AL_FUNC(void, al_destroy_rwlock, (ALLEGRO_RWLOCK *rwlock));
+AL_FUNC(void, al_lock_rwlock_read, (ALLEGRO_RWLOCK *rwlock));
+AL_FUNC(void, al_unlock_rwlock_read, (ALLEGRO_RWLOCK *rwlock));
+AL_FUNC(void, al_lock_rwlock_write, (ALLEGRO_RWLOCK *rwlock));
+AL_FUNC(void, al_unlock_rwlock_write, (ALLEGRO_RWLOCK *rwlock));
+
+AL_FUNC(ALLEGRO_TASK_GROUP *, al_create_task_group, (void));
+AL_FUNC(void, al_destroy_task_group, (ALLEGRO_TASK_GROUP *group));
+AL_FUNC(bool, al_run_task, (ALLEGRO_TASK_GROUP *group,
+                    void (*proc)(void *arg), void *arg));
+AL_FUNC(void, al_wait_task_group, (ALLEGRO_TASK_GROUP *group));
+AL_FUNC(void, al_set_task_group_continuation, (ALLEGRO_TASK_GROUP *group,
+                    void (*proc)(void *arg), void *arg));
+AL_FUNC(int, al_get_task_worker_count, (void));
+#endif
+
 #ifdef __cplusplus
    }
 #endif
@@ -0,0 +1,386 @@
+#!/usr/bin/env python3
+"""Generate the BMP, TGA and PCX images used by tests/test_image.ini.
+
+Every depth and compression mode of a format encodes one of a few test
+pictures, and a PNG of each picture is written as the reference.  Files
+holding the same picture must load to the same pixels.
+
+Usage, from the toplevel A5 folder:
+
+    misc/make_test_images.py
+
+The files are written to tests/data.
+"""
+
+import os, struct, sys, zlib
+
+W = 22
+H = 12
+
+
+def truecolor(x, y):
+    """An opaque picture, with runs on the first rows for RLE."""
+    if y < 3:
+        x = x // 5 * 5
+    return ((x * 11 + 7) & 255, (y * 21 + 3) & 255, (x * y * 7 + 40) & 255)
+
+
+def alpha(x, y):
+    """Like truecolor, with alpha from fully transparent to opaque."""
+    r, g, b = truecolor(x, y)
+    return (r, g, b, min(255, (x + y * 2) * 8))
+
+
+PALETTE = [(i * 16, 255 - i * 12, (i * 85) & 255) for i in range(16)]
+
+
+def paletted(x, y):
+    """A 16 colour picture, with runs on the first rows for RLE."""
+    if y < 4:
+        return (x // 3 + y) % 16
+    return (x + 3 * y) % 16
+
+
+def scale(v, bits):
+    """Like _al_rgb_scale_5 and _al_rgb_scale_6."""
+    return v * 255 // ((1 << bits) - 1)
+
+
+def rgb555(x, y):
+    r, g, b = truecolor(x, y)
+    return (r >> 3, g >> 3, b >> 3)
+
+
+def rgb565(x, y):
+    r, g, b = truecolor(x, y)
+    return (r >> 3, g >> 2, b >> 3)
+
+
+def grey(x, y):
+    return (x * 11 + y * 3) & 255
+
+
+def rows(fn):
+    return [[fn(x, y) for x in range(W)] for y in range(H)]
+
+
+# PNG references
+
+def png(path, pixels, channels):
+    def chunk(kind, data):
+        crc = zlib.crc32(kind + data) & 0xffffffff
+        return struct.pack(">I", len(data)) + kind + data + struct.pack(">I", crc)
+
+    colour_type = {3: 2, 4: 6}[channels]
+    raw = b"".join(b"\0" + bytes(c for p in row for c in p) for row in pixels)
+    with open(path, "wb") as f:
+        f.write(b"\x89PNG\r\n\x1a\n")
+        f.write(chunk(b"IHDR", struct.pack(">IIBBBBB", W, H, 8, colour_type,
+            0, 0, 0)))
+        f.write(chunk(b"IDAT", zlib.compress(raw, 9)))
+        f.write(chunk(b"IEND", b""))
+
+
+# BMP
+
+def bmp_row_bytes(indices, bpp):
+    out = bytearray()
+    if bpp >= 8:
+        out = bytearray(indices)
+    else:
+        per_byte = 8 // bpp
+        for i in range(0, len(indices), per_byte):
+            byte = 0
+            for j, v in enumerate(indices[i:i + per_byte]):
+                byte |= v << (8 - bpp * (j + 1))
+            out.append(byte)
+    while len(out) % 4:
+        out.append(0)
+    return bytes(out)
+
+
+def bmp_rle8(pixels):
+    out = bytearray()
+    for row in reversed(pixels):
+        x = 0
+        while x < W:
+            n = 1
+            while x + n < W and row[x + n] == row[x] and n < 255:
+                n += 1
+            if n >= 3 or W - x < 3:
+                out += bytes([n, row[x]])
+                x += n
+            else:
+                # An absolute run up to the next repeat.
+                n = 3
+                while x + n < W and n < 255 and not (x + n + 2 < W and
+                        row[x + n] == row[x + n + 1] == row[x + n + 2]):
+                    n += 1
+                out += bytes([0, n]) + bytes(row[x:x + n])
+                if n & 1:
+                    out.append(0)
+                x += n
+        out += b"\0\0"
+    out[-2:] = b"\0\1"
+    return bytes(out)
+
+
+def bmp_rle4(pixels):
+    out = bytearray()
+    for row in reversed(pixels):
+        x = 0
+        while x < W:
+            # Runs alternate between two colours; use a single one.
+            n = 1
+            while x + n < W and row[x + n] == row[x] and n < 255:
+                n += 1
+            if n >= 4 or W - x < 4:
+                out += bytes([n, row[x] << 4 | row[x]])
+                x += n
+            else:
+                n = 4
+                while x + n < W and n < 255 and not (x + n + 3 < W and
+                        row[x + n] == row[x + n + 1] == row[x + n + 2] ==
+                        row[x + n + 3]):
+                    n += 1
+                data = row[x:x + n] + [0]
+                packed = bytes(data[i] << 4 | data[i + 1]
+                    for i in range(0, n, 2))
+                out += bytes([0, n]) + packed
+                if len(packed) & 1:
+                    out.append(0)
+                x += n
+        out += b"\0\0"
+    out[-2:] = b"\0\1"
+    return bytes(out)
+
+
+def bmp(path, bpp, data, palette=None, compression=0, masks=None,
+        header_size=40, top_down=False):
+    pal = b""
+    if palette:
+        if header_size == 12:
+            pal = b"".join(bytes([b, g, r]) for r, g, b in palette)
+        else:
+            pal = b"".join(bytes([b, g, r, 0]) for r, g, b in palette)
+    if header_size == 12:
+        info = struct.pack("<IHHHH", 12, W, H, 1, bpp)
+    else:
+        info = struct.pack("<IiiHHIIiiII", header_size, W,
+            -H if top_down else H, 1, bpp, compression, len(data),
+            2835, 2835, len(palette) if palette else 0, 0)
+        if header_size > 40:
+            info += struct.pack("<" + "I" * len(masks), *masks)
+        info += b"\0" * (header_size - len(info))
+        if compression == 3 and header_size == 40:
+            # The masks follow a BITMAPINFOHEADER.
+            info += struct.pack("<III", *masks[:3])
+    offset = 14 + len(info) + len(pal)
+    with open(path, "wb") as f:
+        f.write(b"BM" + struct.pack("<IHHI", offset + len(data), 0, 0, offset))
+        f.write(info + pal + data)
+
+
+def bmp_pixels(pixels, bpp, pack, top_down=False):
+    order = pixels if top_down else list(reversed(pixels))
+    out = bytearray()
+    for row in order:
+        line = bytearray()
+        for p in row:
+            line += pack(p)
+        while len(line) % 4:
+            line.append(0)
+        out += line
+    return bytes(out)
+
+
+def write_bmps(d):
+    pal = rows(paletted)
+    mono = [[(x // 2 + y) & 1 for x in range(W)] for y in range(H)]
+    four = [[v & 3 for v in row] for row in pal]
+    tc = rows(truecolor)
+    al = rows(alpha)
+
+    def indexed(pixels, bpp):
+        return b"".join(bmp_row_bytes(row, bpp) for row in reversed(pixels))
+
+    bmp(d + "/bmp_1.bmp", 1, indexed(mono, 1), PALETTE[:2])
+    bmp(d + "/bmp_2.bmp", 2, indexed(four, 2), PALETTE[:4])
+    bmp(d + "/bmp_4.bmp", 4, indexed(pal, 4), PALETTE)
+    bmp(d + "/bmp_4_rle.bmp", 4, bmp_rle4(pal), PALETTE, compression=2)
+    bmp(d + "/bmp_8.bmp", 8, indexed(pal, 8), PALETTE + [(0, 0, 0)] * 240)
+    bmp(d + "/bmp_8_rle.bmp", 8, bmp_rle8(pal), PALETTE, compression=1)
+    bmp(d + "/bmp_8_os2.bmp", 8, indexed(pal, 8), PALETTE, header_size=12)
+
+    def p555(p, a=0):
+        r, g, b = p[0] >> 3, p[1] >> 3, p[2] >> 3
+        return struct.pack("<H", a << 15 | r << 10 | g << 5 | b)
+
+    def p565(p):
+        return struct.pack("<H", (p[0] >> 3) << 11 | (p[1] >> 2) << 5 | p[2] >> 3)
+
+    bmp(d + "/bmp_16_555.bmp", 16, bmp_pixels(tc, 16, p555))
+    bmp(d + "/bmp_16_565.bmp", 16, bmp_pixels(tc, 16, p565),
+        compression=3, masks=[0xF800, 0x07E0, 0x001F])
+    bmp(d + "/bmp_16_1555.bmp", 16, bmp_pixels(tc, 16, lambda p: p555(p, 1)),
+        masks=[0x7C00, 0x03E0, 0x001F, 0x8000], header_size=56)
+    bmp(d + "/bmp_24.bmp", 24, bmp_pixels(tc, 24,
+        lambda p: bytes([p[2], p[1], p[0]])))
+    bmp(d + "/bmp_24_top_down.bmp", 24, bmp_pixels(tc, 24,
+        lambda p: bytes([p[2], p[1], p[0]]), top_down=True), top_down=True)
+    bmp(d + "/bmp_32_xrgb.bmp", 32, bmp_pixels(tc, 32,
+        lambda p: bytes([p[2], p[1], p[0], 0])))
+    bmp(d + "/bmp_32_argb.bmp", 32, bmp_pixels(al, 32,
+        lambda p: bytes([p[2], p[1], p[0], p[3]])),
+        masks=[0xFF0000, 0xFF00, 0xFF, 0xFF000000], header_size=56)
+    bmp(d + "/bmp_32_rgba.bmp", 32, bmp_pixels(al, 32,
+        lambda p: bytes([p[3], p[2], p[1], p[0]])), compression=3,
+        masks=[0xFF000000, 0xFF0000, 0xFF00, 0xFF], header_size=56)
+    # Masks that no special case handles.
+    bmp(d + "/bmp_32_bitfields.bmp", 32, bmp_pixels(tc, 32,
+        lambda p: bytes([0, p[0], p[1], p[2]])), compression=3,
+        masks=[0xFF00, 0xFF0000, 0xFF000000])
+
+
+# TGA
+
+def tga_rle(row, size):
+    out = bytearray()
+    x = 0
+    while x < len(row):
+        n = 1
+        while x + n < len(row) and row[x + n] == row[x] and n < 128:
+            n += 1
+        if n >= 2:
+            out += bytes([0x80 | (n - 1)]) + row[x]
+        else:
+            n = 1
+            while x + n < len(row) and n < 128 and not (x + n + 1 < len(row)
+                    and row[x + n] == row[x + n + 1]):
+                n += 1
+            out += bytes([n - 1]) + b"".join(row[x:x + n])
+        x += n
+    return bytes(out)
+
+
+def tga(path, image_type, bpp, pixels, pack, palette=None, top_down=False):
+    cmap = b""
+    if palette:
+        cmap = b"".join(bytes([b, g, r]) for r, g, b in palette)
+    descriptor = (0x20 if top_down else 0) | (8 if bpp == 32 else 0)
+    header = struct.pack("<BBBHHBHHHHBB", 0, 1 if palette else 0, image_type,
+        0, len(palette) if palette else 0, 24 if palette else 0,
+        0, 0, W, H, bpp, descriptor)
+    order = pixels if top_down else list(reversed(pixels))
+    data = bytearray()
+    for row in order:
+        packed = [pack(p) for p in row]
+        if image_type & 8:
+            data += tga_rle(packed, bpp // 8)
+        else:
+            data += b"".join(packed)
+    with open(path, "wb") as f:
+        f.write(header + cmap + data)
+
+
+def write_tgas(d):
+    pal = rows(paletted)
+    tc = rows(truecolor)
+    al = rows(alpha)
+    gr = rows(grey)
+
+    def index(v):
+        return bytes([v])
+
+    def bgr(p):
+        return bytes([p[2], p[1], p[0]])
+
+    def bgra(p):
+        return bytes([p[2], p[1], p[0], p[3]])
+
+    def p555(p):
+        return struct.pack("<H", (p[0] >> 3) << 10 | (p[1] >> 3) << 5 | p[2] >> 3)
+
+    tga(d + "/tga_8_cmap.tga", 1, 8, pal, index, PALETTE)
+    tga(d + "/tga_8_cmap_rle.tga", 9, 8, pal, index, PALETTE)
+    tga(d + "/tga_8_grey.tga", 3, 8, gr, index)
+    tga(d + "/tga_8_grey_rle.tga", 11, 8, gr, index)
+    tga(d + "/tga_16.tga", 2, 16, tc, p555)
+    tga(d + "/tga_16_rle.tga", 10, 16, tc, p555)
+    tga(d + "/tga_24.tga", 2, 24, tc, bgr)
+    tga(d + "/tga_24_rle.tga", 10, 24, tc, bgr)
+    tga(d + "/tga_24_top_down.tga", 2, 24, tc, bgr, top_down=True)
+    tga(d + "/tga_32.tga", 2, 32, al, bgra)
+    tga(d + "/tga_32_rle.tga", 10, 32, al, bgra)
+
+
+# PCX
+
+def pcx_rle(line):
+    out = bytearray()
+    x = 0
+    while x < len(line):
+        n = 1
+        while x + n < len(line) and line[x + n] == line[x] and n < 63:
+            n += 1
+        if n > 1 or line[x] >= 0xC0:
+            out += bytes([0xC0 | n, line[x]])
+        else:
+            out.append(line[x])
+        x += n
+    return bytes(out)
+
+
+def pcx(path, planes, lines, palette=None):
+    header = struct.pack("<BBBBHHHHHH", 10, 5, 1, 8, 0, 0, W - 1, H - 1,
+        72, 72)
+    header += b"\0" * 48 + bytes([0, planes]) + struct.pack("<HH", W, 1)
+    header += b"\0" * (128 - len(header))
+    data = b"".join(pcx_rle(line) for line in lines)
+    with open(path, "wb") as f:
+        f.write(header + data)
+        if palette:
+            f.write(b"\x0c" + b"".join(bytes(c) for c in palette))
+            f.write(b"\0" * (3 * (256 - len(palette))))
+
+
+def write_pcxs(d):
+    pal = rows(paletted)
+    tc = rows(truecolor)
+    pcx(d + "/pcx_8.pcx", 1, pal, PALETTE)
+    lines = []
+    for row in tc:
+        for c in range(3):
+            lines.append([p[c] for p in row])
+    pcx(d + "/pcx_24.pcx", 3, lines)
+
+
+def write_references(d):
+    png(d + "/ref_rgb.png", rows(truecolor), 3)
+    png(d + "/ref_rgba.png", rows(alpha), 4)
+    png(d + "/ref_paletted.png",
+        [[PALETTE[v] for v in row] for row in rows(paletted)], 3)
+    png(d + "/ref_1.png", [[PALETTE[(x // 2 + y) & 1] for x in range(W)]
+        for y in range(H)], 3)
+    png(d + "/ref_2.png", [[PALETTE[v & 3] for v in row]
+        for row in rows(paletted)], 3)
+    png(d + "/ref_grey.png", [[(v, v, v) for v in row]
+        for row in rows(grey)], 3)
+    png(d + "/ref_555.png", [[tuple(scale(c, 5) for c in p) for p in row]
+        for row in rows(rgb555)], 3)
+    png(d + "/ref_565.png", [[(scale(p[0], 5), scale(p[1], 6), scale(p[2], 5))
+        for p in row] for row in rows(rgb565)], 3)
+
+
+def main(argv):
+    d = "tests/data"
+    if not os.path.isdir(d):
+        os.mkdir(d)
+    write_bmps(d)
+    write_tgas(d)
+    write_pcxs(d)
+    write_references(d)
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -39,7 +39,8 @@ static ALLEGRO_BITMAP *create_memory_bitmap(ALLEGRO_DISPLAY *current_display,
    ALLEGRO_BITMAP *bitmap;
    int pitch;
 
-   if (_al_pixel_format_is_video_only(format)) {
+   if (_al_pixel_format_is_video_only(format) &&
+         !_al_pixel_format_is_compressed(format)) {
       /* Can't have a video-only memory bitmap... */
       return NULL;
    }
@@ -48,7 +49,21 @@ static ALLEGRO_BITMAP *create_memory_bitmap(ALLEGRO_DISPLAY *current_display,
 
    bitmap = al_calloc(1, sizeof *bitmap);
 
-   pitch = w * al_get_pixel_size(format);
+   if (_al_pixel_format_is_compressed(format)) {
+      /* Compressed memory bitmaps store whole blocks, one row of blocks
+       * per pitch.
+       */
+      int block_width = al_get_pixel_block_width(format);
+      int block_height = al_get_pixel_block_height(format);
+      pitch = _al_get_least_multiple(w, block_width) / block_width *
+         al_get_pixel_block_size(format);
+      bitmap->memory = al_malloc(pitch *
+         (_al_get_least_multiple(h, block_height) / block_height));
+   }
+   else {
+      pitch = w * al_get_pixel_size(format);
+      bitmap->memory = al_malloc(pitch * h);
+   }
 
    bitmap->vt = NULL;
    bitmap->_format = format;
@@ -73,7 +88,6 @@ static ALLEGRO_BITMAP *create_memory_bitmap(ALLEGRO_DISPLAY *current_display,
    al_orthographic_transform(&bitmap->proj_transform, 0, 0, -1.0, w, h, 1.0);
    bitmap->parent = NULL;
    bitmap->xofs = bitmap->yofs = 0;
-   bitmap->memory = al_malloc(pitch * h);
    bitmap->use_bitmap_blender = false;
    bitmap->blender.blend_color = al_map_rgba(0, 0, 0, 0);
    al_get_new_bitmap_wrap(&bitmap->_wrap_u, &bitmap->_wrap_v);
@@ -778,6 +792,14 @@ void _al_convert_bitmap_data(
       return;
    }
 
+   /* Compressed formats are decoded and encoded in software. */
+   if (_al_pixel_format_is_compressed(src_format) ||
+         _al_pixel_format_is_compressed(dst_format)) {
+      _al_convert_compressed_data(src, src_format, src_pitch,
+         dst, dst_format, dst_pitch, sx, sy, dx, dy, width, height);
+      return;
+   }
+
    /* Video-only formats don't have conversion functions, so they should have
     * been taken care of before reaching this location. */
    ASSERT(!_al_pixel_format_is_video_only(src_format));
@@ -0,0 +1,606 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Bitmap atlases.
+ *
+ *      See LICENSE.txt for copyright information.
+ *
+ *      Bitmaps are packed with the MaxRects algorithm: the atlas keeps a
+ *      list of maximal free rectangles, which may overlap.  Each new
+ *      bitmap goes to the free rectangle it fits most snugly ("best short
+ *      side fit"), and every free rectangle it intersects is split into
+ *      the up to four maximal rectangles around it.
+ */
+
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_dtor.h"
+#include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("bitmap")
+
+
+typedef struct ATLAS_RECT
+{
+   int x, y, w, h;
+} ATLAS_RECT;
+
+typedef struct ATLAS_ENTRY
+{
+   ATLAS_RECT rect;        /* the bitmap itself, without extrusion */
+   ALLEGRO_BITMAP *sub;
+} ATLAS_ENTRY;
+
+struct ALLEGRO_BITMAP_ATLAS
+{
+   ALLEGRO_BITMAP *bitmap;
+   int padding;
+   int extrude;
+   _AL_VECTOR free_rects;  /* ATLAS_RECT */
+   _AL_VECTOR entries;     /* ATLAS_ENTRY */
+   _AL_LIST_ITEM *dtor_item;
+};
+
+
+
+static bool rect_contains(const ATLAS_RECT *a, const ATLAS_RECT *b)
+{
+   return b->x >= a->x && b->y >= a->y &&
+      b->x + b->w <= a->x + a->w && b->y + b->h <= a->y + a->h;
+}
+
+
+
+static bool rects_intersect(const ATLAS_RECT *a, const ATLAS_RECT *b)
+{
+   return a->x < b->x + b->w && b->x < a->x + a->w &&
+      a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+
+
+static void push_rect(_AL_VECTOR *vec, int x, int y, int w, int h)
+{
+   ATLAS_RECT *r = _al_vector_alloc_back(vec);
+   r->x = x;
+   r->y = y;
+   r->w = w;
+   r->h = h;
+}
+
+
+
+/* Returns the space a w*h bitmap takes up in the atlas, including its
+ * extruded border and the padding to the right and below.
+ */
+static ATLAS_RECT node_size(ALLEGRO_BITMAP_ATLAS *atlas, int w, int h)
+{
+   ATLAS_RECT node;
+   node.x = 0;
+   node.y = 0;
+   node.w = w + 2 * atlas->extrude + atlas->padding;
+   node.h = h + 2 * atlas->extrude + atlas->padding;
+   return node;
+}
+
+
+
+static bool find_position(ALLEGRO_BITMAP_ATLAS *atlas, ATLAS_RECT *node)
+{
+   int best_short = INT_MAX;
+   int best_long = INT_MAX;
+   unsigned i;
+
+   for (i = 0; i < _al_vector_size(&atlas->free_rects); i++) {
+      const ATLAS_RECT *r = _al_vector_ref(&atlas->free_rects, i);
+      int dw = r->w - node->w;
+      int dh = r->h - node->h;
+      int s, l;
+
+      if (dw < 0 || dh < 0)
+         continue;
+      s = _ALLEGRO_MIN(dw, dh);
+      l = _ALLEGRO_MAX(dw, dh);
+      if (s < best_short || (s == best_short && l < best_long)) {
+         best_short = s;
+         best_long = l;
+         node->x = r->x;
+         node->y = r->y;
+      }
+   }
+
+   return best_short != INT_MAX;
+}
+
+
+
+static void place_rect(ALLEGRO_BITMAP_ATLAS *atlas, const ATLAS_RECT *used)
+{
+   _AL_VECTOR split = _AL_VECTOR_INITIALIZER(ATLAS_RECT);
+   unsigned i, j;
+
+   for (i = 0; i < _al_vector_size(&atlas->free_rects); i++) {
+      const ATLAS_RECT *r = _al_vector_ref(&atlas->free_rects, i);
+
+      if (!rects_intersect(r, used)) {
+         *(ATLAS_RECT *)_al_vector_alloc_back(&split) = *r;
+         continue;
+      }
+
+      if (used->x > r->x)
+         push_rect(&split, r->x, r->y, used->x - r->x, r->h);
+      if (used->x + used->w < r->x + r->w)
+         push_rect(&split, used->x + used->w, r->y,
+            r->x + r->w - (used->x + used->w), r->h);
+      if (used->y > r->y)
+         push_rect(&split, r->x, r->y, r->w, used->y - r->y);
+      if (used->y + used->h < r->y + r->h)
+         push_rect(&split, r->x, used->y + used->h,
+            r->w, r->y + r->h - (used->y + used->h));
+   }
+
+   /* Drop the rectangles which are covered by another one. */
+   for (i = 0; i < _al_vector_size(&split); i++) {
+      for (j = i + 1; j < _al_vector_size(&split); j++) {
+         const ATLAS_RECT *a = _al_vector_ref(&split, i);
+         const ATLAS_RECT *b = _al_vector_ref(&split, j);
+         if (rect_contains(b, a)) {
+            _al_vector_delete_at(&split, i);
+            i--;
+            break;
+         }
+         if (rect_contains(a, b)) {
+            _al_vector_delete_at(&split, j);
+            j--;
+         }
+      }
+   }
+
+   _al_vector_free(&atlas->free_rects);
+   atlas->free_rects = split;
+}
+
+
+
+/* Copies the bitmap into the atlas at x, y, repeating its edge pixels
+ * outwards to fill the extruded border.
+ */
+static bool copy_pixels(ALLEGRO_BITMAP_ATLAS *atlas, ALLEGRO_BITMAP *bitmap,
+   int x, int y)
+{
+   int format = al_get_bitmap_format(atlas->bitmap);
+   int ps = al_get_pixel_size(format);
+   int w = al_get_bitmap_width(bitmap);
+   int h = al_get_bitmap_height(bitmap);
+   int e = atlas->extrude;
+   ALLEGRO_LOCKED_REGION *src, *dst;
+   int row, k;
+
+   src = al_lock_bitmap(bitmap, format, ALLEGRO_LOCK_READONLY);
+   if (!src) {
+      ALLEGRO_ERROR("Failed to lock the source bitmap.\n");
+      return false;
+   }
+   dst = al_lock_bitmap_region(atlas->bitmap, x, y, w + 2 * e, h + 2 * e,
+      format, ALLEGRO_LOCK_WRITEONLY);
+   if (!dst) {
+      ALLEGRO_ERROR("Failed to lock the atlas bitmap.\n");
+      al_unlock_bitmap(bitmap);
+      return false;
+   }
+
+   for (row = 0; row < h; row++) {
+      const char *s = (const char *)src->data + row * src->pitch;
+      char *d = (char *)dst->data + (row + e) * dst->pitch;
+      memcpy(d + e * ps, s, w * ps);
+      for (k = 0; k < e; k++) {
+         memcpy(d + k * ps, s, ps);
+         memcpy(d + (e + w + k) * ps, s + (w - 1) * ps, ps);
+      }
+   }
+   for (k = 0; k < e; k++) {
+      char *d = (char *)dst->data;
+      memcpy(d + k * dst->pitch, d + e * dst->pitch, (w + 2 * e) * ps);
+      memcpy(d + (e + h + k) * dst->pitch, d + (e + h - 1) * dst->pitch,
+         (w + 2 * e) * ps);
+   }
+
+   al_unlock_bitmap(atlas->bitmap);
+   al_unlock_bitmap(bitmap);
+   return true;
+}
+
+
+
+/* Records an entry at node and creates its sub-bitmap. */
+static ALLEGRO_BITMAP *add_entry(ALLEGRO_BITMAP_ATLAS *atlas,
+   const ATLAS_RECT *node, int w, int h)
+{
+   ATLAS_ENTRY *entry;
+   ALLEGRO_BITMAP *sub;
+
+   /* The sub-bitmaps are destroyed with the atlas. */
+   _al_push_destructor_owner();
+   sub = al_create_sub_bitmap(atlas->bitmap, node->x + atlas->extrude,
+      node->y + atlas->extrude, w, h);
+   _al_pop_destructor_owner();
+   if (!sub)
+      return NULL;
+
+   place_rect(atlas, node);
+
+   entry = _al_vector_alloc_back(&atlas->entries);
+   entry->rect.x = node->x + atlas->extrude;
+   entry->rect.y = node->y + atlas->extrude;
+   entry->rect.w = w;
+   entry->rect.h = h;
+   entry->sub = sub;
+   return sub;
+}
+
+
+
+static ALLEGRO_BITMAP_ATLAS *create_atlas(ALLEGRO_BITMAP *bitmap,
+   int padding, int extrude)
+{
+   ALLEGRO_BITMAP_ATLAS *atlas = al_calloc(1, sizeof(*atlas));
+   if (!atlas)
+      return NULL;
+
+   atlas->bitmap = bitmap;
+   atlas->padding = padding;
+   atlas->extrude = extrude;
+   _al_vector_init(&atlas->free_rects, sizeof(ATLAS_RECT));
+   _al_vector_init(&atlas->entries, sizeof(ATLAS_ENTRY));
+
+   /* The padding of bitmaps on the right and bottom edges may hang over. */
+   push_rect(&atlas->free_rects, 0, 0, al_get_bitmap_width(bitmap) + padding,
+      al_get_bitmap_height(bitmap) + padding);
+
+   /* Registered after the bitmap, so it is destroyed first on shutdown. */
+   atlas->dtor_item = _al_register_destructor(_al_dtor_list, "bitmap_atlas",
+      atlas, (void (*)(void *))al_destroy_bitmap_atlas);
+
+   return atlas;
+}
+
+
+
+/* Function: al_create_bitmap_atlas
+ */
+ALLEGRO_BITMAP_ATLAS *al_create_bitmap_atlas(int w, int h, int padding,
+   int extrude)
+{
+   ALLEGRO_BITMAP_ATLAS *atlas;
+   ALLEGRO_BITMAP *bitmap;
+   ALLEGRO_LOCKED_REGION *lr;
+   int format;
+   int y;
+
+   ASSERT(w > 0);
+   ASSERT(h > 0);
+   ASSERT(padding >= 0);
+   ASSERT(extrude >= 0);
+
+   bitmap = al_create_bitmap(w, h);
+   if (!bitmap) {
+      ALLEGRO_ERROR("Failed to create a %dx%d atlas bitmap.\n", w, h);
+      return NULL;
+   }
+
+   format = al_get_bitmap_format(bitmap);
+   if (_al_pixel_format_is_compressed(format)) {
+      ALLEGRO_ERROR("Atlas bitmaps cannot be compressed.\n");
+      al_destroy_bitmap(bitmap);
+      return NULL;
+   }
+
+   /* Start out transparent, which is all zeros in every format. */
+   lr = al_lock_bitmap(bitmap, format, ALLEGRO_LOCK_WRITEONLY);
+   if (!lr) {
+      al_destroy_bitmap(bitmap);
+      return NULL;
+   }
+   for (y = 0; y < h; y++)
+      memset((char *)lr->data + y * lr->pitch, 0, w * lr->pixel_size);
+   al_unlock_bitmap(bitmap);
+
+   atlas = create_atlas(bitmap, padding, extrude);
+   if (!atlas)
+      al_destroy_bitmap(bitmap);
+   return atlas;
+}
+
+
+
+/* Function: al_destroy_bitmap_atlas
+ */
+void al_destroy_bitmap_atlas(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   unsigned i;
+
+   if (!atlas)
+      return;
+
+   _al_unregister_destructor(_al_dtor_list, atlas->dtor_item);
+
+   for (i = 0; i < _al_vector_size(&atlas->entries); i++) {
+      ATLAS_ENTRY *entry = _al_vector_ref(&atlas->entries, i);
+      al_destroy_bitmap(entry->sub);
+   }
+   al_destroy_bitmap(atlas->bitmap);
+
+   _al_vector_free(&atlas->entries);
+   _al_vector_free(&atlas->free_rects);
+   al_free(atlas);
+}
+
+
+
+/* Function: al_add_bitmap_to_atlas
+ */
+ALLEGRO_BITMAP *al_add_bitmap_to_atlas(ALLEGRO_BITMAP_ATLAS *atlas,
+   ALLEGRO_BITMAP *bitmap)
+{
+   int w, h;
+   ATLAS_RECT node;
+
+   ASSERT(atlas);
+   ASSERT(bitmap);
+
+   w = al_get_bitmap_width(bitmap);
+   h = al_get_bitmap_height(bitmap);
+   if (w <= 0 || h <= 0)
+      return NULL;
+
+   node = node_size(atlas, w, h);
+   if (!find_position(atlas, &node)) {
+      ALLEGRO_DEBUG("No room for a %dx%d bitmap.\n", w, h);
+      return NULL;
+   }
+
+   if (!copy_pixels(atlas, bitmap, node.x, node.y))
+      return NULL;
+
+   return add_entry(atlas, &node, w, h);
+}
+
+
+
+typedef struct SORT_ITEM
+{
+   int index;
+   int w, h;
+} SORT_ITEM;
+
+static int sort_larger_first(const void *a, const void *b)
+{
+   const SORT_ITEM *ia = a;
+   const SORT_ITEM *ib = b;
+   int la = _ALLEGRO_MAX(ia->w, ia->h);
+   int lb = _ALLEGRO_MAX(ib->w, ib->h);
+
+   if (la != lb)
+      return lb - la;
+   if (ia->w * ia->h != ib->w * ib->h)
+      return ib->w * ib->h - ia->w * ia->h;
+   return ia->index - ib->index;
+}
+
+
+
+/* Function: al_add_bitmaps_to_atlas
+ */
+int al_add_bitmaps_to_atlas(ALLEGRO_BITMAP_ATLAS *atlas,
+   ALLEGRO_BITMAP **bitmaps, int count, ALLEGRO_BITMAP **sub_bitmaps)
+{
+   SORT_ITEM *items;
+   int added = 0;
+   int i;
+
+   ASSERT(atlas);
+   ASSERT(bitmaps);
+
+   if (count <= 0)
+      return 0;
+
+   items = al_malloc(count * sizeof(*items));
+   if (!items)
+      return 0;
+
+   for (i = 0; i < count; i++) {
+      items[i].index = i;
+      items[i].w = al_get_bitmap_width(bitmaps[i]);
+      items[i].h = al_get_bitmap_height(bitmaps[i]);
+   }
+
+   /* Placing the largest bitmaps first leaves the fragmented space to
+    * the small ones, which usually packs considerably tighter.
+    */
+   qsort(items, count, sizeof(*items), sort_larger_first);
+
+   for (i = 0; i < count; i++) {
+      int index = items[i].index;
+      ALLEGRO_BITMAP *sub = al_add_bitmap_to_atlas(atlas, bitmaps[index]);
+      if (sub_bitmaps)
+         sub_bitmaps[index] = sub;
+      if (sub)
+         added++;
+   }
+
+   al_free(items);
+   return added;
+}
+
+
+
+/* Function: al_get_bitmap_atlas_bitmap
+ */
+ALLEGRO_BITMAP *al_get_bitmap_atlas_bitmap(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   ASSERT(atlas);
+   return atlas->bitmap;
+}
+
+
+
+/* Function: al_get_bitmap_atlas_count
+ */
+int al_get_bitmap_atlas_count(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   ASSERT(atlas);
+   return _al_vector_size(&atlas->entries);
+}
+
+
+
+/* Function: al_get_bitmap_atlas_entry
+ */
+ALLEGRO_BITMAP *al_get_bitmap_atlas_entry(ALLEGRO_BITMAP_ATLAS *atlas,
+   int index)
+{
+   ATLAS_ENTRY *entry;
+
+   ASSERT(atlas);
+
+   if (index < 0 || index >= (int)_al_vector_size(&atlas->entries))
+      return NULL;
+   entry = _al_vector_ref(&atlas->entries, index);
+   return entry->sub;
+}
+
+
+
+/* Function: al_get_bitmap_atlas_layout
+ */
+ALLEGRO_CONFIG *al_get_bitmap_atlas_layout(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   ALLEGRO_CONFIG *cfg;
+   char key[16];
+   char value[64];
+   unsigned i;
+
+   ASSERT(atlas);
+
+   cfg = al_create_config();
+   if (!cfg)
+      return NULL;
+
+#define SET_INT(section, name, v) \
+   snprintf(value, sizeof(value), "%d", (int)(v)); \
+   al_set_config_value(cfg, section, name, value)
+
+   SET_INT("atlas", "width", al_get_bitmap_width(atlas->bitmap));
+   SET_INT("atlas", "height", al_get_bitmap_height(atlas->bitmap));
+   SET_INT("atlas", "padding", atlas->padding);
+   SET_INT("atlas", "extrude", atlas->extrude);
+   SET_INT("atlas", "count", _al_vector_size(&atlas->entries));
+
+#undef SET_INT
+
+   for (i = 0; i < _al_vector_size(&atlas->entries); i++) {
+      const ATLAS_ENTRY *entry = _al_vector_ref(&atlas->entries, i);
+      snprintf(key, sizeof(key), "%u", i);
+      snprintf(value, sizeof(value), "%d %d %d %d", entry->rect.x,
+         entry->rect.y, entry->rect.w, entry->rect.h);
+      al_set_config_value(cfg, "entries", key, value);
+   }
+
+   return cfg;
+}
+
+
+
+static bool get_config_int(const ALLEGRO_CONFIG *cfg, const char *key,
+   int *v)
+{
+   const char *s = al_get_config_value(cfg, "atlas", key);
+   return s && sscanf(s, "%d", v) == 1;
+}
+
+
+
+/* Function: al_create_bitmap_atlas_from_layout
+ */
+ALLEGRO_BITMAP_ATLAS *al_create_bitmap_atlas_from_layout(
+   ALLEGRO_BITMAP *bitmap, const ALLEGRO_CONFIG *layout)
+{
+   ALLEGRO_BITMAP_ATLAS *atlas;
+   int w, h, padding, extrude, count;
+   int i;
+
+   ASSERT(bitmap);
+   ASSERT(layout);
+
+   if (!get_config_int(layout, "width", &w) ||
+       !get_config_int(layout, "height", &h) ||
+       !get_config_int(layout, "padding", &padding) ||
+       !get_config_int(layout, "extrude", &extrude) ||
+       !get_config_int(layout, "count", &count) ||
+       padding < 0 || extrude < 0 || count < 0) {
+      ALLEGRO_ERROR("Invalid atlas layout.\n");
+      return NULL;
+   }
+   if (w != al_get_bitmap_width(bitmap) ||
+       h != al_get_bitmap_height(bitmap)) {
+      ALLEGRO_ERROR("Atlas layout is for a %dx%d bitmap.\n", w, h);
+      return NULL;
+   }
+   if (al_is_sub_bitmap(bitmap) ||
+       _al_pixel_format_is_compressed(al_get_bitmap_format(bitmap))) {
+      ALLEGRO_ERROR("Unsuitable atlas bitmap.\n");
+      return NULL;
+   }
+
+   atlas = create_atlas(bitmap, padding, extrude);
+   if (!atlas)
+      return NULL;
+
+   for (i = 0; i < count; i++) {
+      char key[16];
+      const char *value;
+      ATLAS_RECT r, node;
+
+      snprintf(key, sizeof(key), "%d", i);
+      value = al_get_config_value(layout, "entries", key);
+      if (!value ||
+          sscanf(value, "%d %d %d %d", &r.x, &r.y, &r.w, &r.h) != 4 ||
+          r.w <= 0 || r.h <= 0 || r.x - extrude < 0 || r.y - extrude < 0 ||
+          r.x + r.w + extrude > w || r.y + r.h + extrude > h) {
+         ALLEGRO_ERROR("Invalid atlas layout entry %d.\n", i);
+         goto fail;
+      }
+
+      node = node_size(atlas, r.w, r.h);
+      node.x = r.x - extrude;
+      node.y = r.y - extrude;
+      if (!add_entry(atlas, &node, r.w, r.h))
+         goto fail;
+   }
+
+   return atlas;
+
+fail:
+   /* The bitmap still belongs to the caller. */
+   atlas->bitmap = NULL;
+   al_destroy_bitmap_atlas(atlas);
+   return NULL;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
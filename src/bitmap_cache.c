@@ -0,0 +1,464 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Cache of decoded bitmaps.
+ *
+ *      See LICENSE.txt for copyright information.
+ *
+ *      When a cache directory is set, al_load_bitmap_flags stores the pixels
+ *      of every bitmap it decodes in a file there, and later loads of the
+ *      same unchanged source copy them straight back instead of decoding.
+ *      Sources and cache files are all accessed through the filesystem
+ *      interface, which must be the standard one, as cache files are
+ *      written under a temporary name and renamed into place.
+ */
+
+
+#include <limits.h>
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_fshook.h"
+#include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_thread.h"
+
+ALLEGRO_DEBUG_CHANNEL("bitmap")
+
+
+/* Cache files are little-endian:
+ *
+ *    header:  "AL5BMPC\0", u32 version, u32 pixel format, u32 width,
+ *             u32 height, u32 load flags, u32 load width, u32 load height,
+ *             u32 new bitmap format, u32 source name length,
+ *             u64 source mtime, u64 source size, u64 size of the rest
+ *    data:    source name, then the rows, each width * pixel size bytes
+ *
+ * Everything that can change what the loaders return is part of the key,
+ * and the file name is a hash of the key.  The full key is stored too, so a
+ * hash collision is merely a miss.
+ */
+#define CACHE_VERSION      1
+#define CACHE_HEADER_SIZE  68
+
+typedef struct CACHE_KEY {
+   ALLEGRO_USTR *source;      /* absolute name of the source file */
+   uint64_t mtime;
+   uint64_t size;
+   uint32_t flags;
+   uint32_t load_w, load_h;
+   uint32_t new_format;
+} CACHE_KEY;
+
+
+static ALLEGRO_USTR *cache_dir = NULL;
+static _AL_MUTEX cache_mutex = _AL_MUTEX_UNINITED;
+
+
+
+static void free_bitmap_cache(void)
+{
+   al_ustr_free(cache_dir);
+   cache_dir = NULL;
+   _al_mutex_destroy(&cache_mutex);
+}
+
+
+
+void _al_init_bitmap_cache(void)
+{
+   _al_mutex_init(&cache_mutex);
+   _al_add_exit_func(free_bitmap_cache, "free_bitmap_cache");
+}
+
+
+
+/* Function: al_set_bitmap_cache_path
+ */
+bool al_set_bitmap_cache_path(const char *path)
+{
+   ALLEGRO_USTR *dir = NULL;
+
+   if (path) {
+      if (!al_make_directory(path)) {
+         ALLEGRO_ERROR("Could not create bitmap cache directory %s.\n", path);
+         return false;
+      }
+      dir = al_ustr_new(path);
+   }
+
+   _al_mutex_lock(&cache_mutex);
+   al_ustr_free(cache_dir);
+   cache_dir = dir;
+   _al_mutex_unlock(&cache_mutex);
+
+   return true;
+}
+
+
+
+static uint32_t cache_get32(const unsigned char *p)
+{
+   return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+      ((uint32_t)p[3] << 24);
+}
+
+
+static uint64_t cache_get64(const unsigned char *p)
+{
+   return (uint64_t)cache_get32(p) | ((uint64_t)cache_get32(p + 4) << 32);
+}
+
+
+static void cache_write64(ALLEGRO_FILE *file, uint64_t x)
+{
+   al_fwrite32le(file, (int32_t)(uint32_t)x);
+   al_fwrite32le(file, (int32_t)(uint32_t)(x >> 32));
+}
+
+
+/* FNV-1a, used only to name the cache files. */
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size)
+{
+   const unsigned char *p = data;
+   size_t i;
+
+   for (i = 0; i < size; i++) {
+      h ^= p[i];
+      h *= UINT64_C(0x100000001b3);
+   }
+   return h;
+}
+
+
+
+/* make_key:
+ *  Fill in the key for loading the source with the current settings, and
+ *  return the name of its cache file.
+ */
+static ALLEGRO_USTR *make_key(const ALLEGRO_USTR *dir, ALLEGRO_FS_ENTRY *fse,
+   int flags, CACHE_KEY *key)
+{
+   ALLEGRO_PATH *path;
+   ALLEGRO_USTR *cache_name;
+   int load_w, load_h;
+   uint64_t h;
+
+   key->mtime = (uint64_t)al_get_fs_entry_mtime(fse);
+   key->size = (uint64_t)al_get_fs_entry_size(fse);
+
+   /* The entry's name is absolute. */
+   path = al_create_path(al_get_fs_entry_name(fse));
+   if (!path)
+      return NULL;
+   al_make_path_canonical(path);
+   key->source = al_ustr_dup(al_path_ustr(path, '/'));
+   al_destroy_path(path);
+
+   al_get_new_bitmap_load_size(&load_w, &load_h);
+   key->flags = (uint32_t)flags;
+   key->load_w = (uint32_t)load_w;
+   key->load_h = (uint32_t)load_h;
+   key->new_format = (uint32_t)al_get_new_bitmap_format();
+
+   h = UINT64_C(0xcbf29ce484222325);
+   h = hash_bytes(h, al_cstr(key->source), al_ustr_size(key->source));
+   h = hash_bytes(h, &key->flags, sizeof(key->flags));
+   h = hash_bytes(h, &key->load_w, sizeof(key->load_w));
+   h = hash_bytes(h, &key->load_h, sizeof(key->load_h));
+   h = hash_bytes(h, &key->new_format, sizeof(key->new_format));
+
+   path = al_create_path_for_directory(al_cstr(dir));
+   cache_name = al_ustr_newf("%08x%08x.cache", (unsigned)(h >> 32),
+      (unsigned)h);
+   al_set_path_filename(path, al_cstr(cache_name));
+   al_ustr_assign(cache_name, al_path_ustr(path, ALLEGRO_NATIVE_PATH_SEP));
+   al_destroy_path(path);
+
+   return cache_name;
+}
+
+
+
+/* read_rows:
+ *  Copy the rows of a cache file into a new bitmap, straight from the
+ *  mapped file if possible.
+ */
+static ALLEGRO_BITMAP *read_rows(ALLEGRO_FILE *file, int format, int w,
+   int h, int flags)
+{
+   ALLEGRO_STATE state;
+   ALLEGRO_BITMAP *bmp;
+   ALLEGRO_LOCKED_REGION *lr;
+   const unsigned char *src;
+   size_t avail;
+   int row_size = w * al_get_pixel_size(format);
+   bool ok = true;
+   int y;
+
+   /* The loaders create indexed bitmaps in this format regardless of the
+    * new bitmap format.
+    */
+   al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+   if ((flags & ALLEGRO_KEEP_INDEX) &&
+         format == ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8)
+      al_set_new_bitmap_format(format);
+   bmp = al_create_bitmap(w, h);
+   al_restore_state(&state);
+   if (!bmp)
+      return NULL;
+
+   lr = al_lock_bitmap(bmp, format, ALLEGRO_LOCK_WRITEONLY);
+   if (!lr) {
+      al_destroy_bitmap(bmp);
+      return NULL;
+   }
+
+   src = al_fborrow(file, &avail);
+   if (src && avail == (size_t)row_size * h) {
+      for (y = 0; y < h; y++) {
+         memcpy((char *)lr->data + y * lr->pitch, src, row_size);
+         src += row_size;
+      }
+   }
+   else {
+      for (y = 0; ok && y < h; y++) {
+         ok = al_fread(file, (char *)lr->data + y * lr->pitch, row_size) ==
+            (size_t)row_size;
+      }
+   }
+
+   al_unlock_bitmap(bmp);
+
+   if (!ok) {
+      al_destroy_bitmap(bmp);
+      return NULL;
+   }
+   return bmp;
+}
+
+
+
+/* load_cache_file:
+ *  Load the bitmap from a cache file, or return NULL if the file is damaged
+ *  or stale.
+ */
+static ALLEGRO_BITMAP *load_cache_file(const char *cache_name,
+   const CACHE_KEY *key)
+{
+   ALLEGRO_FS_ENTRY *fse;
+   ALLEGRO_FILE *file;
+   ALLEGRO_BITMAP *bmp = NULL;
+   unsigned char header[CACHE_HEADER_SIZE];
+   uint32_t format, w, h, name_len;
+   uint64_t data_size;
+   int64_t file_size;
+   char *name = NULL;
+
+   /* Cache files are only ever replaced, never truncated, so they are
+    * safe to map.
+    */
+   fse = al_create_fs_entry(cache_name);
+   if (!fse)
+      return NULL;
+   file = al_open_fs_entry(fse, "rbm");
+   al_destroy_fs_entry(fse);
+   if (!file)
+      return NULL;
+
+   file_size = al_fsize(file);
+   if (al_fread(file, header, CACHE_HEADER_SIZE) != CACHE_HEADER_SIZE ||
+         memcmp(header, "AL5BMPC", 8) != 0 ||
+         cache_get32(header + 8) != CACHE_VERSION ||
+         cache_get32(header + 24) != key->flags ||
+         cache_get32(header + 28) != key->load_w ||
+         cache_get32(header + 32) != key->load_h ||
+         cache_get32(header + 36) != key->new_format ||
+         cache_get64(header + 44) != key->mtime ||
+         cache_get64(header + 52) != key->size) {
+      goto done;
+   }
+
+   format = cache_get32(header + 12);
+   w = cache_get32(header + 16);
+   h = cache_get32(header + 20);
+   name_len = cache_get32(header + 40);
+   data_size = cache_get64(header + 60);
+
+   if (format >= ALLEGRO_NUM_PIXEL_FORMATS ||
+         _al_pixel_format_is_compressed(format) ||
+         al_get_pixel_size(format) <= 0 ||
+         w == 0 || h == 0 || w > INT_MAX / 16 || h > INT_MAX ||
+         name_len != al_ustr_size(key->source) ||
+         data_size != name_len +
+            (uint64_t)w * h * al_get_pixel_size(format) ||
+         (file_size >= 0 &&
+            (uint64_t)file_size != CACHE_HEADER_SIZE + data_size)) {
+      ALLEGRO_WARN("Damaged bitmap cache file %s.\n", cache_name);
+      goto done;
+   }
+
+   name = al_malloc(name_len);
+   if (!name || al_fread(file, name, name_len) != name_len ||
+         memcmp(name, al_cstr(key->source), name_len) != 0) {
+      goto done;
+   }
+
+   bmp = read_rows(file, format, w, h, key->flags);
+   if (!bmp)
+      ALLEGRO_WARN("Could not read bitmap cache file %s.\n", cache_name);
+
+done:
+   al_free(name);
+   al_fclose(file);
+   return bmp;
+}
+
+
+
+/* save_cache_file:
+ *  Write the pixels of a freshly loaded bitmap to a temporary file and move
+ *  it into place, so that a concurrent reader never sees half of it.
+ */
+static void save_cache_file(const char *cache_name, const CACHE_KEY *key,
+   ALLEGRO_BITMAP *bmp)
+{
+   ALLEGRO_FILE *file;
+   ALLEGRO_USTR *tmp_name;
+   ALLEGRO_LOCKED_REGION *lr;
+   int format = al_get_bitmap_format(bmp);
+   int w = al_get_bitmap_width(bmp);
+   int h = al_get_bitmap_height(bmp);
+   int row_size;
+   bool ok;
+   int y;
+
+   /* Compressed bitmaps come from DDS files, which need no decoding. */
+   if (_al_pixel_format_is_compressed(format))
+      return;
+   row_size = w * al_get_pixel_size(format);
+
+   lr = al_lock_bitmap(bmp, format, ALLEGRO_LOCK_READONLY);
+   if (!lr)
+      return;
+
+   tmp_name = al_ustr_new("");
+   file = _al_fs_stdio_create_temp(cache_name, tmp_name);
+   if (!file) {
+      ALLEGRO_DEBUG("Could not write bitmap cache file %s.\n", cache_name);
+      al_unlock_bitmap(bmp);
+      al_ustr_free(tmp_name);
+      return;
+   }
+
+   al_fwrite(file, "AL5BMPC", 8);
+   al_fwrite32le(file, CACHE_VERSION);
+   al_fwrite32le(file, format);
+   al_fwrite32le(file, w);
+   al_fwrite32le(file, h);
+   al_fwrite32le(file, (int32_t)key->flags);
+   al_fwrite32le(file, (int32_t)key->load_w);
+   al_fwrite32le(file, (int32_t)key->load_h);
+   al_fwrite32le(file, (int32_t)key->new_format);
+   al_fwrite32le(file, (int32_t)al_ustr_size(key->source));
+   cache_write64(file, key->mtime);
+   cache_write64(file, key->size);
+   cache_write64(file, al_ustr_size(key->source) + (uint64_t)row_size * h);
+   al_fwrite(file, al_cstr(key->source), al_ustr_size(key->source));
+
+   for (y = 0; y < h; y++)
+      al_fwrite(file, (char *)lr->data + y * lr->pitch, row_size);
+
+   al_unlock_bitmap(bmp);
+
+   ok = !al_ferror(file);
+   ok = al_fclose(file) && ok;
+   if (!_al_fs_stdio_commit_temp(al_cstr(tmp_name), cache_name, ok))
+      ALLEGRO_WARN("Error writing bitmap cache file %s.\n", cache_name);
+   al_ustr_free(tmp_name);
+}
+
+
+
+/* _al_load_bitmap_cached:
+ *  Load a bitmap through the cache if one is set, otherwise just call the
+ *  loader.  With the cache, the source is opened through the filesystem
+ *  interface and given to load_f.
+ */
+ALLEGRO_BITMAP *_al_load_bitmap_cached(const char *filename, int flags,
+   ALLEGRO_BITMAP *(*load)(const char *filename, int flags),
+   ALLEGRO_BITMAP *(*load_f)(ALLEGRO_FILE *fp, const char *filename,
+      int flags))
+{
+   ALLEGRO_USTR *dir = NULL;
+   ALLEGRO_USTR *cache_name;
+   ALLEGRO_FS_ENTRY *fse;
+   ALLEGRO_FILE *fp;
+   ALLEGRO_BITMAP *bmp;
+   CACHE_KEY key;
+
+   _al_mutex_lock(&cache_mutex);
+   if (cache_dir)
+      dir = al_ustr_dup(cache_dir);
+   _al_mutex_unlock(&cache_mutex);
+
+   if (!dir)
+      return load(filename, flags);
+
+   if (al_get_fs_interface() != &_al_fs_interface_stdio) {
+      ALLEGRO_DEBUG("Bitmap cache needs the standard filesystem interface.\n");
+      al_ustr_free(dir);
+      return load(filename, flags);
+   }
+
+   /* Leave missing sources and the error messages to the loader. */
+   fse = al_create_fs_entry(filename);
+   if (!fse || !al_fs_entry_exists(fse) ||
+         (al_get_fs_entry_mode(fse) & ALLEGRO_FILEMODE_ISDIR)) {
+      al_destroy_fs_entry(fse);
+      al_ustr_free(dir);
+      return load(filename, flags);
+   }
+
+   memset(&key, 0, sizeof(key));
+   cache_name = make_key(dir, fse, flags, &key);
+   al_ustr_free(dir);
+   if (!cache_name) {
+      al_destroy_fs_entry(fse);
+      return load(filename, flags);
+   }
+
+   bmp = load_cache_file(al_cstr(cache_name), &key);
+   if (bmp) {
+      ALLEGRO_DEBUG("Loaded %s from the bitmap cache.\n", filename);
+   }
+   else {
+      fp = al_open_fs_entry(fse, "rb");
+      if (fp) {
+         bmp = load_f(fp, filename, flags);
+         al_fclose(fp);
+      }
+      else {
+         ALLEGRO_ERROR("Could not open %s.\n", filename);
+      }
+      if (bmp)
+         save_cache_file(al_cstr(cache_name), &key, bmp);
+   }
+
+   al_destroy_fs_entry(fse);
+   al_ustr_free(key.source);
+   al_ustr_free(cache_name);
+   return bmp;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -17,6 +17,7 @@
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_thread.h"
 #include "allegro5/internal/aintern_vector.h"
 
 #include <string.h>
@@ -38,14 +39,31 @@ typedef struct Handler
 
 
 /* globals */
-static _AL_VECTOR iio_table = _AL_VECTOR_INITIALIZER(Handler);
+/* Handlers are allocated one by one and never freed before shutdown, so
+ * that the extension strings returned by al_identify_bitmap_f stay valid
+ * while other threads register more handlers.
+ */
+static _AL_VECTOR iio_table = _AL_VECTOR_INITIALIZER(Handler *);
+/* Handlers are looked up on every load and save, possibly from several
+ * threads at once, but registered rarely.
+ */
+static _AL_RWLOCK iio_table_lock = _AL_RWLOCK_UNINITED;
 
 
 static Handler *add_iio_table_f(const char *ext)
 {
+   Handler **slot;
    Handler *ent;
 
-   ent = _al_vector_alloc_back(&iio_table);
+   ent = al_malloc(sizeof(*ent));
+   if (!ent)
+      return NULL;
+   slot = _al_vector_alloc_back(&iio_table);
+   if (!slot) {
+      al_free(ent);
+      return NULL;
+   }
+   *slot = ent;
    strcpy(ent->extension, ext);
    ent->loader = NULL;
    ent->saver = NULL;
@@ -68,7 +86,7 @@ static Handler *find_handler(const char *extension, bool create_if_not)
    }
 
    for (i = 0; i < _al_vector_size(&iio_table); i++) {
-      Handler *l = _al_vector_ref(&iio_table, i);
+      Handler *l = *(Handler **)_al_vector_ref(&iio_table, i);
       if (0 == _al_stricmp(extension, l->extension)) {
          return l;
       }
@@ -88,7 +106,7 @@ static Handler *find_handler_for_file(ALLEGRO_FILE *f)
    ASSERT(f);
 
    for (i = 0; i < _al_vector_size(&iio_table); i++) {
-      Handler *l = _al_vector_ref(&iio_table, i);
+      Handler *l = *(Handler **)_al_vector_ref(&iio_table, i);
       if (l->identifier) {
          int64_t pos = al_ftell(f);
          bool identified = l->identifier(f);
@@ -101,26 +119,68 @@ static Handler *find_handler_for_file(ALLEGRO_FILE *f)
 }
 
 
+/* get_handler:
+ *  Copy out the handler for an extension, so that it may be used without
+ *  holding the table lock.
+ */
+static bool get_handler(const char *extension, Handler *out)
+{
+   Handler *h;
+
+   _al_rwlock_lock_read(&iio_table_lock);
+   h = find_handler(extension, false);
+   if (h)
+      *out = *h;
+   _al_rwlock_unlock_read(&iio_table_lock);
+
+   return h != NULL;
+}
+
+
+static bool get_handler_for_file(ALLEGRO_FILE *f, Handler *out)
+{
+   Handler *h;
+
+   _al_rwlock_lock_read(&iio_table_lock);
+   h = find_handler_for_file(f);
+   if (h)
+      *out = *h;
+   _al_rwlock_unlock_read(&iio_table_lock);
+
+   return h != NULL;
+}
+
+
 static void free_iio_table(void)
 {
+   unsigned i;
+
+   for (i = 0; i < _al_vector_size(&iio_table); i++)
+      al_free(*(Handler **)_al_vector_ref(&iio_table, i));
    _al_vector_free(&iio_table);
+   _al_rwlock_destroy(&iio_table_lock);
 }
 
 
 void _al_init_iio_table(void)
 {
+   _al_rwlock_init(&iio_table_lock);
    _al_add_exit_func(free_iio_table, "free_iio_table");
 }
 
 #define REGISTER(function) \
-   Handler *ent = find_handler(extension, function != NULL); \
-   if (!function) { \
-      if (!ent || !ent->function) { \
-         return false; /* Nothing to remove. */ \
-      } \
+   Handler *ent; \
+   bool ret = true; \
+   _al_rwlock_lock_write(&iio_table_lock); \
+   ent = find_handler(extension, function != NULL); \
+   if (!ent || (!function && !ent->function)) { \
+      ret = false; /* Nothing to remove, or bad extension. */ \
+   } \
+   else { \
+      ent->function = function; \
    } \
-   ent->function = function; \
-   return true;
+   _al_rwlock_unlock_write(&iio_table_lock); \
+   return ret;
 
 
 /* Function: al_register_bitmap_loader
@@ -185,12 +245,10 @@ ALLEGRO_BITMAP *al_load_bitmap(const char *filename)
 }
 
 
-/* Function: al_load_bitmap_flags
- */
-ALLEGRO_BITMAP *al_load_bitmap_flags(const char *filename, int flags)
+static ALLEGRO_BITMAP *load_bitmap(const char *filename, int flags)
 {
    const char *ext;
-   Handler *h;
+   Handler h;
    ALLEGRO_BITMAP *ret;
 
    ext = al_identify_bitmap(filename);
@@ -202,9 +260,8 @@ ALLEGRO_BITMAP *al_load_bitmap_flags(const char *filename, int flags)
       }
    }
 
-   h = find_handler(ext, false);
-   if (h && h->loader) {
-      ret = h->loader(filename, flags);
+   if (get_handler(ext, &h) && h.loader) {
+      ret = h.loader(filename, flags);
       if (!ret)
          ALLEGRO_ERROR("Failed loading bitmap %s with %s handler.\n",
             filename, ext);
@@ -218,12 +275,51 @@ ALLEGRO_BITMAP *al_load_bitmap_flags(const char *filename, int flags)
 }
 
 
+/* load_bitmap_f:
+ *  Like load_bitmap, but for a file already opened by the bitmap cache.
+ */
+static ALLEGRO_BITMAP *load_bitmap_f(ALLEGRO_FILE *fp, const char *filename,
+   int flags)
+{
+   const char *ext = strrchr(filename, '.');
+   Handler h;
+   ALLEGRO_BITMAP *ret;
+
+   if (!get_handler_for_file(fp, &h) && !(ext && get_handler(ext, &h))) {
+      ALLEGRO_ERROR("Could not identify bitmap %s!\n", filename);
+      return NULL;
+   }
+
+   if (h.fs_loader)
+      ret = h.fs_loader(fp, flags);
+   else if (h.loader)
+      ret = h.loader(filename, flags);
+   else {
+      ALLEGRO_ERROR("No handler for bitmap %s!\n", filename);
+      return NULL;
+   }
+
+   if (!ret)
+      ALLEGRO_ERROR("Failed loading bitmap %s with %s handler.\n",
+         filename, h.extension);
+   return ret;
+}
+
+
+/* Function: al_load_bitmap_flags
+ */
+ALLEGRO_BITMAP *al_load_bitmap_flags(const char *filename, int flags)
+{
+   return _al_load_bitmap_cached(filename, flags, load_bitmap, load_bitmap_f);
+}
+
+
 /* Function: al_save_bitmap
  */
 bool al_save_bitmap(const char *filename, ALLEGRO_BITMAP *bitmap)
 {
    const char *ext;
-   Handler *h;
+   Handler h;
 
    ext = strrchr(filename, '.');
    if (!ext) {
@@ -231,9 +327,8 @@ bool al_save_bitmap(const char *filename, ALLEGRO_BITMAP *bitmap)
       return false;
    }
 
-   h = find_handler(ext, false);
-   if (h && h->saver)
-      return h->saver(filename, bitmap);
+   if (get_handler(ext, &h) && h.saver)
+      return h.saver(filename, bitmap);
    else {
       ALLEGRO_ERROR("No handler for image %s found\n", filename);
       return false;
@@ -263,13 +358,14 @@ ALLEGRO_BITMAP *al_load_bitmap_f(ALLEGRO_FILE *fp, const char *ident)
 ALLEGRO_BITMAP *al_load_bitmap_flags_f(ALLEGRO_FILE *fp,
    const char *ident, int flags)
 {
-   Handler *h;
+   Handler h;
+   bool found;
    if (ident)
-      h = find_handler(ident, false);
+      found = get_handler(ident, &h);
    else
-      h = find_handler_for_file(fp);
-   if (h && h->fs_loader)
-      return h->fs_loader(fp, flags);
+      found = get_handler_for_file(fp, &h);
+   if (found && h.fs_loader)
+      return h.fs_loader(fp, flags);
    else
       return NULL;
 }
@@ -280,9 +376,9 @@ ALLEGRO_BITMAP *al_load_bitmap_flags_f(ALLEGRO_FILE *fp,
 bool al_save_bitmap_f(ALLEGRO_FILE *fp, const char *ident,
    ALLEGRO_BITMAP *bitmap)
 {
-   Handler *h = find_handler(ident, false);
-   if (h && h->fs_saver)
-      return h->fs_saver(fp, bitmap);
+   Handler h;
+   if (get_handler(ident, &h) && h.fs_saver)
+      return h.fs_saver(fp, bitmap);
    else {
       ALLEGRO_ERROR("No handler for image %s found\n", ident);
       return false;
@@ -294,7 +390,11 @@ bool al_save_bitmap_f(ALLEGRO_FILE *fp, const char *ident,
  */
 char const *al_identify_bitmap_f(ALLEGRO_FILE *fp)
 {
-   Handler *h = find_handler_for_file(fp);
+   Handler *h;
+
+   _al_rwlock_lock_read(&iio_table_lock);
+   h = find_handler_for_file(fp);
+   _al_rwlock_unlock_read(&iio_table_lock);
    if (!h)
       return NULL;
    return h->extension;
@@ -0,0 +1,220 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Background bitmap loading.
+ *
+ *      See LICENSE.txt for copyright information.
+ *
+ *      Each file is identified, read and decoded into a memory bitmap by a
+ *      task on the worker pool, using the ordinary bitmap I/O handlers.
+ *      Finished bitmaps are handed over through an event source.
+ */
+
+
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_events.h"
+
+ALLEGRO_DEBUG_CHANNEL("bitmap")
+
+
+struct ALLEGRO_BITMAP_LOADER
+{
+   ALLEGRO_EVENT_SOURCE es;
+   ALLEGRO_TASK_GROUP *group;
+   _AL_VECTOR jobs;     /* LOAD_JOB *, freed with the loader */
+   bool cancelled;      /* protected by the event source lock */
+};
+
+typedef struct LOAD_JOB
+{
+   ALLEGRO_BITMAP_LOADER *loader;
+   char *filename;
+   int index;
+   int flags;
+   /* The submitting thread's settings, applied on the worker. */
+   const ALLEGRO_FILE_INTERFACE *file_interface;
+   int bitmap_format;
+   int bitmap_flags;
+   int load_w, load_h;
+} LOAD_JOB;
+
+
+
+static bool is_cancelled(ALLEGRO_BITMAP_LOADER *loader)
+{
+   bool cancelled;
+
+   _al_event_source_lock(&loader->es);
+   cancelled = loader->cancelled;
+   _al_event_source_unlock(&loader->es);
+
+   return cancelled;
+}
+
+
+
+static void load_job_proc(void *arg)
+{
+   LOAD_JOB *job = arg;
+   ALLEGRO_BITMAP_LOADER *loader = job->loader;
+   ALLEGRO_BITMAP *bmp = NULL;
+   ALLEGRO_STATE state;
+   ALLEGRO_EVENT event;
+
+   if (!is_cancelled(loader)) {
+      al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS |
+         ALLEGRO_STATE_NEW_FILE_INTERFACE);
+      al_set_new_file_interface(job->file_interface);
+      al_set_new_bitmap_format(job->bitmap_format);
+      al_set_new_bitmap_load_size(job->load_w, job->load_h);
+      al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP | (job->bitmap_flags &
+         ~(ALLEGRO_VIDEO_BITMAP | ALLEGRO_CONVERT_BITMAP)));
+
+      bmp = al_load_bitmap_flags(job->filename, job->flags);
+
+      al_restore_state(&state);
+   }
+
+   _al_event_source_lock(&loader->es);
+   if (!loader->cancelled &&
+         _al_event_source_needs_to_generate_event(&loader->es)) {
+      event.bitmap.type = ALLEGRO_EVENT_BITMAP_LOADED;
+      event.bitmap.timestamp = al_get_time();
+      event.bitmap.bitmap = bmp;
+      event.bitmap.filename = job->filename;
+      event.bitmap.index = job->index;
+      _al_event_source_emit_event(&loader->es, &event);
+      bmp = NULL;
+   }
+   _al_event_source_unlock(&loader->es);
+
+   /* Nobody will receive it. */
+   if (bmp)
+      al_destroy_bitmap(bmp);
+}
+
+
+
+/* Function: al_create_bitmap_loader
+ */
+ALLEGRO_BITMAP_LOADER *al_create_bitmap_loader(void)
+{
+   ALLEGRO_BITMAP_LOADER *loader = al_malloc(sizeof(*loader));
+
+   if (!loader)
+      return NULL;
+
+   loader->group = al_create_task_group();
+   if (!loader->group) {
+      al_free(loader);
+      return NULL;
+   }
+
+   _al_event_source_init(&loader->es);
+   _al_vector_init(&loader->jobs, sizeof(LOAD_JOB *));
+   loader->cancelled = false;
+
+   return loader;
+}
+
+
+
+/* Function: al_destroy_bitmap_loader
+ */
+void al_destroy_bitmap_loader(ALLEGRO_BITMAP_LOADER *loader)
+{
+   unsigned i;
+
+   if (!loader)
+      return;
+
+   _al_event_source_lock(&loader->es);
+   loader->cancelled = true;
+   _al_event_source_unlock(&loader->es);
+
+   /* Loads already under way run to completion, the rest are skipped. */
+   al_destroy_task_group(loader->group);
+
+   for (i = 0; i < _al_vector_size(&loader->jobs); i++) {
+      LOAD_JOB **slot = _al_vector_ref(&loader->jobs, i);
+      al_free((*slot)->filename);
+      al_free(*slot);
+   }
+   _al_vector_free(&loader->jobs);
+
+   _al_event_source_free(&loader->es);
+   al_free(loader);
+}
+
+
+
+/* Function: al_get_bitmap_loader_event_source
+ */
+ALLEGRO_EVENT_SOURCE *al_get_bitmap_loader_event_source(
+   ALLEGRO_BITMAP_LOADER *loader)
+{
+   ASSERT(loader);
+
+   return &loader->es;
+}
+
+
+
+/* Function: al_load_bitmap_async
+ */
+int al_load_bitmap_async(ALLEGRO_BITMAP_LOADER *loader, const char *filename,
+   int flags)
+{
+   LOAD_JOB *job;
+   LOAD_JOB **slot;
+
+   ASSERT(loader);
+   ASSERT(filename);
+
+   job = al_malloc(sizeof(*job));
+   if (!job)
+      return -1;
+
+   job->filename = al_malloc(strlen(filename) + 1);
+   if (!job->filename) {
+      al_free(job);
+      return -1;
+   }
+   strcpy(job->filename, filename);
+
+   slot = _al_vector_alloc_back(&loader->jobs);
+   if (!slot) {
+      al_free(job->filename);
+      al_free(job);
+      return -1;
+   }
+   *slot = job;
+
+   job->loader = loader;
+   job->index = _al_vector_size(&loader->jobs) - 1;
+   job->flags = flags;
+   job->file_interface = al_get_new_file_interface();
+   job->bitmap_format = al_get_new_bitmap_format();
+   job->bitmap_flags = al_get_new_bitmap_flags();
+   al_get_new_bitmap_load_size(&job->load_w, &job->load_h);
+
+   if (!al_run_task(loader->group, load_job_proc, job)) {
+      ALLEGRO_DEBUG("No worker pool, loading %s synchronously.\n", filename);
+      load_job_proc(job);
+   }
+
+   return job->index;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
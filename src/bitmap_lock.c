@@ -35,11 +35,12 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
    ASSERT(y >= 0);
    ASSERT(width >= 0);
    ASSERT(height >= 0);
+
+   /* Compressed formats can only be locked with al_lock_bitmap_blocked. */
+   if (_al_pixel_format_is_compressed(format))
+      return NULL;
+
    ASSERT(!_al_pixel_format_is_video_only(format));
-   if (_al_pixel_format_is_real(format)) {
-      ASSERT(al_get_pixel_block_width(format) == 1);
-      ASSERT(al_get_pixel_block_height(format) == 1);
-   }
 
    /* For sub-bitmaps */
    if (bitmap->parent) {
@@ -78,12 +79,19 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
    }
 
    if (bitmap_flags & ALLEGRO_MEMORY_BITMAP) {
-      int f = _al_get_real_pixel_format(al_get_current_display(), format);
+      bool compressed = _al_pixel_format_is_compressed(bitmap_format);
+      int f;
+      if (compressed && format == ALLEGRO_PIXEL_FORMAT_ANY) {
+         /* Compressed memory bitmaps are decoded into a temporary buffer,
+          * just like the OpenGL driver does for video bitmaps. */
+         format = ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE;
+      }
+      f = _al_get_real_pixel_format(al_get_current_display(), format);
       if (f < 0) {
          return NULL;
       }
       ASSERT(bitmap->memory);
-      if (format == ALLEGRO_PIXEL_FORMAT_ANY || bitmap_format == format || bitmap_format == f) {
+      if (!compressed && (format == ALLEGRO_PIXEL_FORMAT_ANY || bitmap_format == format || bitmap_format == f)) {
          bitmap->locked_region.data = bitmap->memory
             + bitmap->pitch * yc + xc * al_get_pixel_size(bitmap_format);
          bitmap->locked_region.format = bitmap_format;
@@ -95,7 +103,7 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
          bitmap->locked_region.data = al_malloc(bitmap->locked_region.pitch*hc);
          bitmap->locked_region.format = f;
          bitmap->locked_region.pixel_size = al_get_pixel_size(f);
-         if (!(bitmap->lock_flags & ALLEGRO_LOCK_WRITEONLY)) {
+         if (!(flags & ALLEGRO_LOCK_WRITEONLY)) {
             _al_convert_bitmap_data(
                bitmap->memory, bitmap_format, bitmap->pitch,
                bitmap->locked_region.data, f, bitmap->locked_region.pitch,
@@ -149,12 +157,16 @@ void al_unlock_bitmap(ALLEGRO_BITMAP *bitmap)
    else {
       if (bitmap->locked_region.format != 0 && bitmap->locked_region.format != bitmap_format) {
          if (!(bitmap->lock_flags & ALLEGRO_LOCK_READONLY)) {
+            /* Partial blocks at the edge are padded with the last pixels
+             * inside the bitmap, not with whatever the lock held there. */
+            int w = _ALLEGRO_MIN(bitmap->lock_w, bitmap->w - bitmap->lock_x);
+            int h = _ALLEGRO_MIN(bitmap->lock_h, bitmap->h - bitmap->lock_y);
             _al_convert_bitmap_data(
-               bitmap->locked_region.data, bitmap->locked_region.format, bitmap->locked_region.pitch,
+               bitmap->lock_data, bitmap->locked_region.format, bitmap->locked_region.pitch,
                bitmap->memory, bitmap_format, bitmap->pitch,
-               0, 0, bitmap->lock_x, bitmap->lock_y, bitmap->lock_w, bitmap->lock_h);
+               0, 0, bitmap->lock_x, bitmap->lock_y, w, h);
          }
-         al_free(bitmap->locked_region.data);
+         al_free(bitmap->lock_data);
       }
    }
 
@@ -206,7 +218,6 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region_blocked(ALLEGRO_BITMAP *bitmap,
 
    /* Currently, this is the only format that gets to this point */
    ASSERT(_al_pixel_format_is_compressed(bitmap_format));
-   ASSERT(!(bitmap_flags & ALLEGRO_MEMORY_BITMAP));
 
    /* For sub-bitmaps */
    if (bitmap->parent) {
@@ -222,7 +233,8 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region_blocked(ALLEGRO_BITMAP *bitmap,
    if (bitmap->locked)
       return NULL;
 
-   if (!(flags & ALLEGRO_LOCK_READONLY))
+   if (!(bitmap_flags & ALLEGRO_MEMORY_BITMAP) &&
+         !(flags & ALLEGRO_LOCK_READONLY))
       bitmap->dirty = true;
 
    ASSERT(x_block + width_block
@@ -236,10 +248,22 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region_blocked(ALLEGRO_BITMAP *bitmap,
    bitmap->lock_h = height_block * block_height;
    bitmap->lock_flags = flags;
 
-   lr = bitmap->vt->lock_compressed_region(bitmap, bitmap->lock_x,
-      bitmap->lock_y, bitmap->lock_w, bitmap->lock_h, flags);
-   if (!lr) {
-      return NULL;
+   if (bitmap_flags & ALLEGRO_MEMORY_BITMAP) {
+      /* The blocks are stored as they are, so hand them out directly. */
+      ASSERT(bitmap->memory);
+      bitmap->locked_region.data = bitmap->memory
+         + bitmap->pitch * y_block + x_block * al_get_pixel_block_size(bitmap_format);
+      bitmap->locked_region.format = bitmap_format;
+      bitmap->locked_region.pitch = bitmap->pitch;
+      bitmap->locked_region.pixel_size = al_get_pixel_size(bitmap_format);
+      lr = &bitmap->locked_region;
+   }
+   else {
+      lr = bitmap->vt->lock_compressed_region(bitmap, bitmap->lock_x,
+         bitmap->lock_y, bitmap->lock_w, bitmap->lock_h, flags);
+      if (!lr) {
+         return NULL;
+      }
    }
 
    bitmap->locked = true;
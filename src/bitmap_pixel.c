@@ -67,7 +67,7 @@ ALLEGRO_COLOR al_get_pixel(ALLEGRO_BITMAP *bitmap, int x, int y)
 
       /* FIXME: check for valid pixel format */
 
-      data = bitmap->lock_data;
+      data = lr->data;
       _AL_INLINE_GET_PIXEL(lr->format, data, color, false);
 
       al_unlock_bitmap(bitmap);
@@ -118,7 +118,7 @@ void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color)
 
       /* FIXME: check for valid pixel format */
 
-      data = bitmap->lock_data;
+      data = lr->data;
       _AL_INLINE_PUT_PIXEL(lr->format, data, color, false);
 
       al_unlock_bitmap(bitmap);
@@ -138,10 +138,13 @@ void al_put_pixel(int x, int y, ALLEGRO_COLOR color)
  */
 void al_put_blended_pixel(int x, int y, ALLEGRO_COLOR color)
 {
+   _AL_DRAWING_STATE state;
    ALLEGRO_COLOR result;
-   ALLEGRO_BITMAP* bitmap = al_get_target_bitmap();
-   _al_blend_memory(&color, bitmap, x, y, &result);
-   _al_put_pixel(bitmap, x, y, result);
+
+   if (!_al_get_drawing_state(&state))
+      return;
+   _al_blend_memory(&state, &color, state.target, x, y, &result);
+   _al_put_pixel(state.target, x, y, result);
 }
 
 
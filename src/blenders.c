@@ -22,21 +22,20 @@
 #include "allegro5/internal/aintern_display.h"
 #include <string.h>
 
-void _al_blend_memory(ALLEGRO_COLOR *scol,
+void _al_blend_memory(const _AL_DRAWING_STATE *state,
+   ALLEGRO_COLOR *scol,
    ALLEGRO_BITMAP *dest,
    int dx, int dy, ALLEGRO_COLOR *result)
 {
+   const ALLEGRO_BLENDER *b = state->blender;
    ALLEGRO_COLOR dcol;
    ALLEGRO_COLOR constcol;
-   int op, src_blend, dest_blend, alpha_op, alpha_src_blend, alpha_dest_blend;
    dcol = al_get_pixel(dest, dx, dy);
-   al_get_separate_bitmap_blender(&op, &src_blend, &dest_blend,
-                                  &alpha_op, &alpha_src_blend,
-                                  &alpha_dest_blend);
-   constcol = al_get_blend_color();
+   constcol = state->blend_color;
    _al_blend_inline(scol, &dcol,
-                    op, src_blend, dest_blend,
-                    alpha_op, alpha_src_blend, alpha_dest_blend,
+                    b->blend_op, b->blend_source, b->blend_dest,
+                    b->blend_alpha_op, b->blend_alpha_source,
+                    b->blend_alpha_dest,
                     &constcol, result);
    (void) _al_blend_alpha_inline; // silence compiler
 }
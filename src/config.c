@@ -19,16 +19,168 @@
 
 #include <stdio.h>
 #include <ctype.h>
+#include <string.h>
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
-#include "allegro5/internal/aintern_aatree.h"
 #include "allegro5/internal/aintern_config.h"
+#include "allegro5/internal/aintern_file.h"
+#include "allegro5/internal/aintern_fshook.h"
 
+ALLEGRO_DEBUG_CHANNEL("config")
 
 
-static int cmp_ustr(void const *a, void const *b)
+
+static uint32_t hash_ustr(const ALLEGRO_USTR *us)
+{
+   const unsigned char *p = (const unsigned char *)al_cstr(us);
+   size_t n = al_ustr_size(us);
+   uint32_t h = 2166136261u;
+
+   while (n--) {
+      h ^= *p++;
+      h *= 16777619u;
+   }
+
+   return h;
+}
+
+
+/* index_find_slot:
+ *  Return the slot holding `key`, or the empty slot where it would go.
+ *  The index must have at least one empty slot.
+ */
+static _AL_CONFIG_SLOT *index_find_slot(const _AL_CONFIG_INDEX *index,
+   const ALLEGRO_USTR *key, uint32_t hash)
+{
+   unsigned int mask = index->capacity - 1;
+   unsigned int i = hash & mask;
+
+   while (index->slots[i].value) {
+      if (index->slots[i].hash == hash &&
+            al_ustr_equal(index->slots[i].key, key))
+         break;
+      i = (i + 1) & mask;
+   }
+
+   return &index->slots[i];
+}
+
+
+static void *index_search(const _AL_CONFIG_INDEX *index,
+   const ALLEGRO_USTR *key)
+{
+   if (index->count == 0)
+      return NULL;
+   return index_find_slot(index, key, hash_ustr(key))->value;
+}
+
+
+static void index_resize(_AL_CONFIG_INDEX *index, unsigned int capacity)
+{
+   _AL_CONFIG_SLOT *old = index->slots;
+   unsigned int old_capacity = index->capacity;
+   unsigned int i;
+
+   index->capacity = capacity;
+   index->slots = al_calloc(index->capacity, sizeof(_AL_CONFIG_SLOT));
+   ASSERT(index->slots);
+
+   for (i = 0; i < old_capacity; i++) {
+      if (old[i].value)
+         *index_find_slot(index, old[i].key, old[i].hash) = old[i];
+   }
+
+   al_free(old);
+}
+
+
+/* index_reserve:
+ *  Make room for `count` keys without further resizing.
+ */
+static void index_reserve(_AL_CONFIG_INDEX *index, unsigned int count)
+{
+   unsigned int capacity = index->capacity ? index->capacity : 8;
+
+   /* Keep the load factor at or below 3/4. */
+   while ((count + 1) * 4 > capacity * 3)
+      capacity *= 2;
+
+   if (capacity != index->capacity)
+      index_resize(index, capacity);
+}
+
+
+/* index_insert:
+ *  Add a key to the index.  Returns false if it was there already.
+ */
+static bool index_insert(_AL_CONFIG_INDEX *index, const ALLEGRO_USTR *key,
+   void *value)
+{
+   uint32_t hash = hash_ustr(key);
+   _AL_CONFIG_SLOT *slot;
+
+   index_reserve(index, index->count + 1);
+
+   slot = index_find_slot(index, key, hash);
+   if (slot->value)
+      return false;
+   slot->hash = hash;
+   slot->key = key;
+   slot->value = value;
+   index->count++;
+   return true;
+}
+
+
+/* index_delete:
+ *  Remove a key and return its value, or NULL if it was not there.
+ */
+static void *index_delete(_AL_CONFIG_INDEX *index, const ALLEGRO_USTR *key)
+{
+   unsigned int mask = index->capacity - 1;
+   _AL_CONFIG_SLOT *slot;
+   unsigned int i, j;
+   void *value;
+
+   if (index->count == 0)
+      return NULL;
+
+   slot = index_find_slot(index, key, hash_ustr(key));
+   value = slot->value;
+   if (!value)
+      return NULL;
+
+   /* Shift later members of the probe run back into the hole, so that
+    * lookups never stop early at an empty slot.
+    */
+   i = slot - index->slots;
+   j = i;
+   for (;;) {
+      unsigned int home;
+
+      j = (j + 1) & mask;
+      if (!index->slots[j].value)
+         break;
+      home = index->slots[j].hash & mask;
+      if ((j > i && (home <= i || home > j)) ||
+            (j < i && (home <= i && home > j))) {
+         index->slots[i] = index->slots[j];
+         i = j;
+      }
+   }
+   index->slots[i].value = NULL;
+   index->count--;
+
+   return value;
+}
+
+
+static void index_free(_AL_CONFIG_INDEX *index)
 {
-   return al_ustr_compare(a, b);
+   al_free(index->slots);
+   index->slots = NULL;
+   index->capacity = 0;
+   index->count = 0;
 }
 
 
@@ -46,33 +198,14 @@ ALLEGRO_CONFIG *al_create_config(void)
 static ALLEGRO_CONFIG_SECTION *find_section(const ALLEGRO_CONFIG *config,
    const ALLEGRO_USTR *section)
 {
-   return _al_aa_search(config->tree, section, cmp_ustr);
+   return index_search(&config->index, section);
 }
 
 
 static ALLEGRO_CONFIG_ENTRY *find_entry(const ALLEGRO_CONFIG_SECTION *section,
    const ALLEGRO_USTR *key)
 {
-   return _al_aa_search(section->tree, key, cmp_ustr);
-}
-
-
-static void get_key_and_value(const ALLEGRO_USTR *buf,
-   ALLEGRO_USTR *key, ALLEGRO_USTR *value)
-{
-   int eq = al_ustr_find_chr(buf, 0, '=');
-
-   if (eq == -1) {
-      al_ustr_assign(key, buf);
-      al_ustr_assign_cstr(value, "");
-   }
-   else {
-      al_ustr_assign_substr(key, buf, 0, eq);
-      al_ustr_assign_substr(value, buf, eq + 1, al_ustr_size(buf));
-   }
-
-   al_ustr_trim_ws(key);
-   al_ustr_trim_ws(value);
+   return index_search(&section->index, key);
 }
 
 
@@ -99,7 +232,7 @@ static ALLEGRO_CONFIG_SECTION *config_add_section(ALLEGRO_CONFIG *config,
       config->last = section;
    }
 
-   config->tree = _al_aa_insert(config->tree, section->name, section, cmp_ustr);
+   index_insert(&config->index, section->name, section);
 
    return section;
 }
@@ -155,7 +288,7 @@ static void config_set_value(ALLEGRO_CONFIG *config,
       s->last = entry;
    }
 
-   s->tree = _al_aa_insert(s->tree, entry->key, entry, cmp_ustr);
+   index_insert(&s->index, entry->key, entry);
 }
 
 
@@ -288,21 +421,60 @@ const char *al_get_config_value(const ALLEGRO_CONFIG *config,
 }
 
 
-static bool readline(ALLEGRO_FILE *file, ALLEGRO_USTR *line)
+/* read_whole_file:
+ *  Return the rest of the file as one buffer.  The buffer is borrowed from
+ *  the file if possible, otherwise it is read into *ret_buf, which the
+ *  caller frees.
+ */
+static const char *read_whole_file(ALLEGRO_FILE *file, size_t *ret_size,
+   char **ret_buf)
 {
-   char buf[128];
-
-   if (!al_fgets(file, buf, sizeof(buf))) {
-      return false;
+   const char *borrowed;
+   char *buf = NULL;
+   size_t size = 0;
+   size_t capacity;
+   int64_t hint;
+
+   *ret_buf = NULL;
+
+   borrowed = al_fborrow(file, ret_size);
+   if (borrowed) {
+      al_fseek(file, *ret_size, ALLEGRO_SEEK_CUR);
+      return borrowed;
    }
 
-   do {
-      al_ustr_append_cstr(line, buf);
-      if (al_ustr_has_suffix_cstr(line, "\n"))
+   hint = al_fsize(file) - al_ftell(file);
+   capacity = (hint > 0) ? (size_t)hint + 1 : 4096;
+
+   for (;;) {
+      char *new_buf = al_realloc(buf, capacity);
+      if (!new_buf) {
+         al_free(buf);
+         return NULL;
+      }
+      buf = new_buf;
+      size += al_fread(file, buf + size, capacity - size);
+      if (size < capacity)
          break;
-   } while (al_fgets(file, buf, sizeof(buf)));
+      capacity *= 2;
+   }
 
-   return true;
+   *ret_size = size;
+   *ret_buf = buf;
+   return buf;
+}
+
+
+/* trim_ws:
+ *  Narrow [*start, *end) to exclude leading and trailing whitespace, as
+ *  al_ustr_trim_ws would.
+ */
+static void trim_ws(const char **start, const char **end)
+{
+   while (*start < *end && isspace((unsigned char)**start))
+      (*start)++;
+   while (*end > *start && isspace((unsigned char)(*end)[-1]))
+      (*end)--;
 }
 
 
@@ -329,57 +501,76 @@ ALLEGRO_CONFIG *al_load_config_file_f(ALLEGRO_FILE *file)
 {
    ALLEGRO_CONFIG *config;
    ALLEGRO_CONFIG_SECTION *current_section = NULL;
-   ALLEGRO_USTR *line;
-   ALLEGRO_USTR *section;
-   ALLEGRO_USTR *key;
-   ALLEGRO_USTR *value;
+   const ALLEGRO_USTR *section_name = al_ustr_empty_string();
+   ALLEGRO_USTR_INFO line_info, key_info, value_info;
+   const ALLEGRO_USTR *line, *key, *value;
+   const char *data, *p, *end;
+   char *buf;
+   size_t size;
    ASSERT(file);
 
+   data = read_whole_file(file, &size, &buf);
+   if (!data) {
+      return NULL;
+   }
+
    config = al_create_config();
    if (!config) {
+      al_free(buf);
       return NULL;
    }
 
-   line = al_ustr_new("");
-   section = al_ustr_new("");
-   key = al_ustr_new("");
-   value = al_ustr_new("");
-
-   while (1) {
-      al_ustr_assign_cstr(line, "");
-      if (!readline(file, line))
-         break;
-      al_ustr_trim_ws(line);
-
-      if (al_ustr_has_prefix_cstr(line, "#") || al_ustr_size(line) == 0) {
+   /* The lines are referenced in place, nothing is copied until it goes
+    * into the configuration.
+    */
+   p = data;
+   end = data + size;
+   while (p < end) {
+      const char *nl = memchr(p, '\n', end - p);
+      const char *next = nl ? nl + 1 : end;
+      const char *ls = p;
+      const char *le = nl ? nl : end;
+
+      /* Like al_fgets, stop at a NUL byte. */
+      const char *nul = memchr(ls, '\0', le - ls);
+      if (nul)
+         le = nul;
+
+      p = next;
+      trim_ws(&ls, &le);
+
+      if (ls == le || *ls == '#') {
          /* Preserve comments and blank lines */
-         const ALLEGRO_USTR *name;
-         if (current_section)
-            name = current_section->name;
-         else
-            name = al_ustr_empty_string();
-         config_add_comment(config, name, line);
+         line = al_ref_buffer(&line_info, ls, le - ls);
+         config_add_comment(config, section_name, line);
       }
-      else if (al_ustr_has_prefix_cstr(line, "[")) {
-         int rbracket = al_ustr_rfind_chr(line, al_ustr_size(line), ']');
-         if (rbracket == -1)
-            rbracket = al_ustr_size(line);
-         al_ustr_assign_substr(section, line, 1, rbracket);
-         current_section = config_add_section(config, section);
+      else if (*ls == '[') {
+         const char *rbracket = le;
+         while (rbracket > ls && rbracket[-1] != ']')
+            rbracket--;
+         if (rbracket == ls)
+            rbracket = le;
+         else
+            rbracket--;
+         line = al_ref_buffer(&line_info, ls + 1, rbracket - (ls + 1));
+         current_section = config_add_section(config, line);
+         section_name = current_section->name;
       }
       else {
-         get_key_and_value(line, key, value);
-         if (current_section == NULL)
-            config_set_value(config, al_ustr_empty_string(), key, value);
-         else
-            config_set_value(config, current_section->name, key, value);
+         const char *eq = memchr(ls, '=', le - ls);
+         const char *ke = eq ? eq : le;
+         const char *vs = eq ? eq + 1 : le;
+         const char *ve = le;
+         const char *ks = ls;
+         trim_ws(&ks, &ke);
+         trim_ws(&vs, &ve);
+         key = al_ref_buffer(&key_info, ks, ke - ks);
+         value = al_ref_buffer(&value_info, vs, ve - vs);
+         config_set_value(config, section_name, key, value);
       }
    }
 
-   al_ustr_free(line);
-   al_ustr_free(section);
-   al_ustr_free(key);
-   al_ustr_free(value);
+   al_free(buf);
 
    return config;
 }
@@ -477,6 +668,327 @@ bool al_save_config_file_f(ALLEGRO_FILE *file, const ALLEGRO_CONFIG *config)
 }
 
 
+/* Snapshots are a flat little-endian dump of the parsed configuration:
+ *
+ *    header:  "AL5CFGS\0", u32 version, u32 number of sections,
+ *             u64 source mtime, u64 source size, u64 size of the rest
+ *    section: u32 name length, name, u32 number of entries
+ *    entry:   u32 key length, key, and unless it is a comment,
+ *             u32 value length, value
+ *
+ * Comments have SNAPSHOT_COMMENT set in their key length.
+ */
+#define SNAPSHOT_VERSION      1
+#define SNAPSHOT_HEADER_SIZE  40
+#define SNAPSHOT_COMMENT      0x80000000u
+
+typedef struct SNAPSHOT_READER {
+   const unsigned char *p;
+   const unsigned char *end;
+} SNAPSHOT_READER;
+
+
+static uint32_t snapshot_get32(const unsigned char *p)
+{
+   return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+      ((uint32_t)p[3] << 24);
+}
+
+
+static uint64_t snapshot_get64(const unsigned char *p)
+{
+   return (uint64_t)snapshot_get32(p) | ((uint64_t)snapshot_get32(p + 4) << 32);
+}
+
+
+static bool snapshot_read32(SNAPSHOT_READER *r, uint32_t *x)
+{
+   if (r->end - r->p < 4)
+      return false;
+   *x = snapshot_get32(r->p);
+   r->p += 4;
+   return true;
+}
+
+
+static ALLEGRO_USTR *snapshot_read_ustr(SNAPSHOT_READER *r, uint32_t len)
+{
+   ALLEGRO_USTR *us;
+
+   if ((size_t)(r->end - r->p) < len)
+      return NULL;
+   us = al_ustr_new_from_buffer((const char *)r->p, len);
+   r->p += len;
+   return us;
+}
+
+
+/* snapshot_read_section:
+ *  Read one section and append it to the configuration.  The snapshot was
+ *  made from a valid configuration, so unlike the text parser this does not
+ *  merge duplicates; it rejects them.
+ */
+static bool snapshot_read_section(SNAPSHOT_READER *r, ALLEGRO_CONFIG *config)
+{
+   ALLEGRO_CONFIG_SECTION *s;
+   ALLEGRO_CONFIG_ENTRY *e;
+   uint32_t len, n, i;
+
+   s = al_calloc(1, sizeof(ALLEGRO_CONFIG_SECTION));
+   if (!s)
+      return false;
+   if (!snapshot_read32(r, &len) || !(s->name = snapshot_read_ustr(r, len))) {
+      al_free(s);
+      return false;
+   }
+
+   if (config->head == NULL) {
+      config->head = s;
+   }
+   else {
+      config->last->next = s;
+      s->prev = config->last;
+   }
+   config->last = s;
+
+   if (!index_insert(&config->index, s->name, s))
+      return false;
+
+   if (!snapshot_read32(r, &n))
+      return false;
+   /* Each entry takes at least four bytes. */
+   if (n > (size_t)(r->end - r->p) / 4)
+      return false;
+   index_reserve(&s->index, n);
+
+   for (i = 0; i < n; i++) {
+      if (!snapshot_read32(r, &len))
+         return false;
+
+      e = al_calloc(1, sizeof(ALLEGRO_CONFIG_ENTRY));
+      if (!e)
+         return false;
+      if (s->head == NULL) {
+         s->head = e;
+      }
+      else {
+         s->last->next = e;
+         e->prev = s->last;
+      }
+      s->last = e;
+
+      e->is_comment = (len & SNAPSHOT_COMMENT) != 0;
+      e->key = snapshot_read_ustr(r, len & ~SNAPSHOT_COMMENT);
+      if (!e->key)
+         return false;
+      if (e->is_comment)
+         continue;
+
+      if (!snapshot_read32(r, &len) || !(e->value = snapshot_read_ustr(r, len)))
+         return false;
+      if (!index_insert(&s->index, e->key, e))
+         return false;
+   }
+
+   return true;
+}
+
+
+/* load_snapshot:
+ *  Rebuild a configuration from a snapshot, or return NULL if the snapshot
+ *  is damaged or does not match the source file.
+ */
+static ALLEGRO_CONFIG *load_snapshot(ALLEGRO_FILE *file, uint64_t mtime,
+   uint64_t size)
+{
+   ALLEGRO_CONFIG *config;
+   SNAPSHOT_READER r;
+   const unsigned char *data;
+   char *buf;
+   size_t data_size;
+   uint32_t num_sections, i;
+   bool ok = true;
+
+   data = (const unsigned char *)read_whole_file(file, &data_size, &buf);
+   if (!data)
+      return NULL;
+
+   if (data_size < SNAPSHOT_HEADER_SIZE ||
+         memcmp(data, "AL5CFGS", 8) != 0 ||
+         snapshot_get32(data + 8) != SNAPSHOT_VERSION ||
+         snapshot_get64(data + 16) != mtime ||
+         snapshot_get64(data + 24) != size ||
+         snapshot_get64(data + 32) != data_size - SNAPSHOT_HEADER_SIZE) {
+      al_free(buf);
+      return NULL;
+   }
+
+   num_sections = snapshot_get32(data + 12);
+   r.p = data + SNAPSHOT_HEADER_SIZE;
+   r.end = data + data_size;
+
+   config = al_create_config();
+   if (!config) {
+      al_free(buf);
+      return NULL;
+   }
+
+   /* Each section takes at least eight bytes. */
+   if (num_sections > (size_t)(r.end - r.p) / 8)
+      ok = false;
+   else
+      index_reserve(&config->index, num_sections);
+
+   for (i = 0; ok && i < num_sections; i++)
+      ok = snapshot_read_section(&r, config);
+   if (r.p != r.end)
+      ok = false;
+
+   al_free(buf);
+
+   if (!ok) {
+      ALLEGRO_WARN("Damaged configuration snapshot.\n");
+      al_destroy_config(config);
+      return NULL;
+   }
+
+   return config;
+}
+
+
+static void snapshot_write64(ALLEGRO_FILE *file, uint64_t x)
+{
+   al_fwrite32le(file, (int32_t)(uint32_t)x);
+   al_fwrite32le(file, (int32_t)(uint32_t)(x >> 32));
+}
+
+
+static void snapshot_write_ustr(ALLEGRO_FILE *file, const ALLEGRO_USTR *us,
+   uint32_t flags)
+{
+   al_fwrite32le(file, (int32_t)(al_ustr_size(us) | flags));
+   al_fwrite(file, al_cstr(us), al_ustr_size(us));
+}
+
+
+/* save_snapshot:
+ *  Write a snapshot of the configuration to a temporary file and move it
+ *  into place, so that a reader never sees half a snapshot.  This needs
+ *  the standard file interface, to be able to rename the file.
+ */
+static void save_snapshot(const char *filename, const ALLEGRO_CONFIG *config,
+   uint64_t mtime, uint64_t size)
+{
+   ALLEGRO_FILE *file;
+   ALLEGRO_USTR *tmp_name;
+   ALLEGRO_CONFIG_SECTION *s;
+   ALLEGRO_CONFIG_ENTRY *e;
+   uint32_t num_sections = 0;
+   uint64_t data_size = 0;
+   bool ok;
+
+   for (s = config->head; s; s = s->next) {
+      num_sections++;
+      data_size += 8 + al_ustr_size(s->name);
+      for (e = s->head; e; e = e->next) {
+         data_size += 4 + al_ustr_size(e->key);
+         if (!e->is_comment)
+            data_size += 4 + al_ustr_size(e->value);
+      }
+   }
+
+   if (al_get_new_file_interface() != &_al_file_interface_stdio) {
+      ALLEGRO_DEBUG("Not writing configuration snapshot %s through a "
+         "custom file interface.\n", filename);
+      return;
+   }
+
+   tmp_name = al_ustr_new("");
+   file = _al_fs_stdio_create_temp(filename, tmp_name);
+   if (!file) {
+      ALLEGRO_DEBUG("Could not write configuration snapshot %s.\n", filename);
+      al_ustr_free(tmp_name);
+      return;
+   }
+
+   al_fwrite(file, "AL5CFGS", 8);
+   al_fwrite32le(file, SNAPSHOT_VERSION);
+   al_fwrite32le(file, (int32_t)num_sections);
+   snapshot_write64(file, mtime);
+   snapshot_write64(file, size);
+   snapshot_write64(file, data_size);
+
+   for (s = config->head; s; s = s->next) {
+      uint32_t n = 0;
+      for (e = s->head; e; e = e->next)
+         n++;
+      snapshot_write_ustr(file, s->name, 0);
+      al_fwrite32le(file, (int32_t)n);
+      for (e = s->head; e; e = e->next) {
+         if (e->is_comment) {
+            snapshot_write_ustr(file, e->key, SNAPSHOT_COMMENT);
+         }
+         else {
+            snapshot_write_ustr(file, e->key, 0);
+            snapshot_write_ustr(file, e->value, 0);
+         }
+      }
+   }
+
+   ok = !al_ferror(file);
+   ok = al_fclose(file) && ok;
+   if (!_al_fs_stdio_commit_temp(al_cstr(tmp_name), filename, ok))
+      ALLEGRO_WARN("Error writing configuration snapshot %s.\n", filename);
+   al_ustr_free(tmp_name);
+}
+
+
+/* Function: al_load_config_file_cached
+ */
+ALLEGRO_CONFIG *al_load_config_file_cached(const char *filename,
+   const char *snapshot_filename)
+{
+   ALLEGRO_FS_ENTRY *fse;
+   ALLEGRO_USTR *default_name = NULL;
+   ALLEGRO_CONFIG *config = NULL;
+   ALLEGRO_FILE *file;
+   uint64_t mtime, size;
+   ASSERT(filename);
+
+   fse = al_create_fs_entry(filename);
+   if (!fse)
+      return NULL;
+   if (!al_fs_entry_exists(fse)) {
+      al_destroy_fs_entry(fse);
+      return NULL;
+   }
+   mtime = (uint64_t)al_get_fs_entry_mtime(fse);
+   size = (uint64_t)al_get_fs_entry_size(fse);
+   al_destroy_fs_entry(fse);
+
+   if (!snapshot_filename) {
+      default_name = al_ustr_newf("%s.snapshot", filename);
+      snapshot_filename = al_cstr(default_name);
+   }
+
+   file = _al_fopen_mapped(snapshot_filename);
+   if (file) {
+      config = load_snapshot(file, mtime, size);
+      al_fclose(file);
+   }
+
+   if (!config) {
+      config = al_load_config_file(filename);
+      if (config)
+         save_snapshot(snapshot_filename, config, mtime, size);
+   }
+
+   al_ustr_free(default_name);
+
+   return config;
+}
+
+
 /* do_config_merge_into:
  *  Helper function for merging.
  */
@@ -549,7 +1061,7 @@ static void destroy_section(ALLEGRO_CONFIG_SECTION *s)
       e = tmp;
    }
    al_ustr_free(s->name);
-   _al_aa_free(s->tree);
+   index_free(&s->index);
    al_free(s);
 }
 
@@ -571,7 +1083,7 @@ void al_destroy_config(ALLEGRO_CONFIG *config)
       s = tmp;
    }
 
-   _al_aa_free(config->tree);
+   index_free(&config->index);
    al_free(config);
 }
 
@@ -667,8 +1179,7 @@ bool al_remove_config_section(ALLEGRO_CONFIG *config, char const *section)
 
    usection = al_ref_cstr(&section_info, section);
 
-   value = NULL;
-   config->tree = _al_aa_delete(config->tree, usection, cmp_ustr, &value);
+   value = index_delete(&config->index, usection);
    if (!value)
       return false;
 
@@ -716,8 +1227,7 @@ bool al_remove_config_key(ALLEGRO_CONFIG *config, char const *section,
    if (!s)
       return false;
 
-   value = NULL;
-   s->tree = _al_aa_delete(s->tree, ukey, cmp_ustr, &value);
+   value = index_delete(&s->index, ukey);
    if (!value)
       return false;
 
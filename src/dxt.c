@@ -0,0 +1,572 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Software DXT1/DXT3/DXT5 block decoding and encoding.
+ *
+ *      See LICENSE.txt for copyright information.
+ *
+ *      The decoder follows the S3TC rules used by the GPU drivers.  The
+ *      encoder is a fast range fit: it takes the bounding box of the block
+ *      colours, corrects the box diagonal with the sign of the covariance,
+ *      insets it slightly and picks the nearest palette entry for every
+ *      pixel, then improves the endpoints with one least squares pass.
+ *      This is much quicker than a cluster fit and good enough for
+ *      textures which are edited in memory and then uploaded.
+ */
+
+
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_pixels.h"
+
+#define DXT_BLOCK 4
+
+
+static int block_bytes(int format)
+{
+   return (format == ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1) ? 8 : 16;
+}
+
+
+static void expand_565(unsigned c, unsigned char *rgba)
+{
+   unsigned r = (c >> 11) & 31;
+   unsigned g = (c >> 5) & 63;
+   unsigned b = c & 31;
+   rgba[0] = (r << 3) | (r >> 2);
+   rgba[1] = (g << 2) | (g >> 4);
+   rgba[2] = (b << 3) | (b >> 2);
+   rgba[3] = 255;
+}
+
+
+static unsigned pack_565(const int *rgb)
+{
+   return (((rgb[0] * 31 + 127) / 255) << 11) |
+      (((rgb[1] * 63 + 127) / 255) << 5) |
+      ((rgb[2] * 31 + 127) / 255);
+}
+
+
+/* Builds the four entry palette of a colour block.  DXT3 and DXT5 always
+ * use the four colour mode.
+ */
+static void colour_palette(unsigned c0, unsigned c1, bool four_colours,
+   unsigned char pal[4][4])
+{
+   int i;
+
+   expand_565(c0, pal[0]);
+   expand_565(c1, pal[1]);
+
+   if (four_colours) {
+      for (i = 0; i < 3; i++) {
+         pal[2][i] = (2 * pal[0][i] + pal[1][i]) / 3;
+         pal[3][i] = (pal[0][i] + 2 * pal[1][i]) / 3;
+      }
+      pal[2][3] = pal[3][3] = 255;
+   }
+   else {
+      for (i = 0; i < 3; i++) {
+         pal[2][i] = (pal[0][i] + pal[1][i]) / 2;
+         pal[3][i] = 0;
+      }
+      pal[2][3] = 255;
+      pal[3][3] = 0;
+   }
+}
+
+
+static void decode_colour_block(const unsigned char *block, bool dxt1,
+   unsigned char out[16][4])
+{
+   unsigned char pal[4][4];
+   unsigned c0 = block[0] | (block[1] << 8);
+   unsigned c1 = block[2] | (block[3] << 8);
+   uint32_t bits = block[4] | (block[5] << 8) | (block[6] << 16) |
+      ((uint32_t)block[7] << 24);
+   int i;
+
+   colour_palette(c0, c1, !dxt1 || c0 > c1, pal);
+
+   for (i = 0; i < 16; i++) {
+      memcpy(out[i], pal[(bits >> (2 * i)) & 3], 4);
+   }
+}
+
+
+static void alpha_palette(int a0, int a1, unsigned char pal[8])
+{
+   int i;
+
+   pal[0] = a0;
+   pal[1] = a1;
+   if (a0 > a1) {
+      for (i = 1; i < 7; i++)
+         pal[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+   }
+   else {
+      for (i = 1; i < 5; i++)
+         pal[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+      pal[6] = 0;
+      pal[7] = 255;
+   }
+}
+
+
+static void decode_dxt3_alpha(const unsigned char *block,
+   unsigned char out[16][4])
+{
+   int i;
+
+   for (i = 0; i < 16; i++) {
+      int a = (block[i / 2] >> ((i & 1) * 4)) & 15;
+      out[i][3] = a * 17;
+   }
+}
+
+
+static void decode_dxt5_alpha(const unsigned char *block,
+   unsigned char out[16][4])
+{
+   unsigned char pal[8];
+   uint64_t bits = 0;
+   int i;
+
+   alpha_palette(block[0], block[1], pal);
+   for (i = 0; i < 6; i++)
+      bits |= (uint64_t)block[2 + i] << (8 * i);
+
+   for (i = 0; i < 16; i++) {
+      out[i][3] = pal[(bits >> (3 * i)) & 7];
+   }
+}
+
+
+static void decode_block(int format, const unsigned char *block,
+   unsigned char out[16][4])
+{
+   switch (format) {
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:
+         decode_colour_block(block, true, out);
+         break;
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:
+         decode_colour_block(block + 8, false, out);
+         decode_dxt3_alpha(block, out);
+         break;
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5:
+         decode_colour_block(block + 8, false, out);
+         decode_dxt5_alpha(block, out);
+         break;
+   }
+}
+
+
+static int colour_distance(const unsigned char *a, const unsigned char *b)
+{
+   int dr = a[0] - b[0];
+   int dg = a[1] - b[1];
+   int db = a[2] - b[2];
+   return dr * dr + dg * dg + db * db;
+}
+
+
+static uint32_t pick_indices(unsigned char in[16][4], const bool *used,
+   unsigned char pal[4][4], int entries, int *error)
+{
+   uint32_t bits = 0;
+   int i, j;
+
+   *error = 0;
+   for (i = 0; i < 16; i++) {
+      int best = 0;
+      int best_dist;
+      if (!used[i]) {
+         bits |= (uint32_t)3 << (2 * i);
+         continue;
+      }
+      best_dist = colour_distance(in[i], pal[0]);
+      for (j = 1; j < entries; j++) {
+         int dist = colour_distance(in[i], pal[j]);
+         if (dist < best_dist) {
+            best_dist = dist;
+            best = j;
+         }
+      }
+      bits |= (uint32_t)best << (2 * i);
+      *error += best_dist;
+   }
+
+   return bits;
+}
+
+
+/* Solves for the pair of four colour mode endpoints which fits the chosen
+ * indices best in the least squares sense.  Returns false if the result
+ * can't be stored with c0 > c1.
+ */
+static bool refine_endpoints(unsigned char in[16][4], uint32_t bits,
+   unsigned *c0, unsigned *c1)
+{
+   static const float weight[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+   float aa = 0, bb = 0, ab = 0;
+   float ax[3] = {0, 0, 0};
+   float bx[3] = {0, 0, 0};
+   float det;
+   int hi[3], lo[3];
+   int c, i;
+
+   for (i = 0; i < 16; i++) {
+      float a = weight[(bits >> (2 * i)) & 3];
+      float b = 1.0f - a;
+      aa += a * a;
+      bb += b * b;
+      ab += a * b;
+      for (c = 0; c < 3; c++) {
+         ax[c] += a * in[i][c];
+         bx[c] += b * in[i][c];
+      }
+   }
+
+   det = aa * bb - ab * ab;
+   if (det == 0.0f)
+      return false;
+
+   for (c = 0; c < 3; c++) {
+      float h = (ax[c] * bb - bx[c] * ab) / det;
+      float l = (bx[c] * aa - ax[c] * ab) / det;
+      hi[c] = _ALLEGRO_CLAMP(0, (int)(h + 0.5f), 255);
+      lo[c] = _ALLEGRO_CLAMP(0, (int)(l + 0.5f), 255);
+   }
+
+   *c0 = pack_565(hi);
+   *c1 = pack_565(lo);
+   if (*c0 < *c1) {
+      /* Swapping the endpoints would also swap the meaning of the
+       * indices, which the next pass picks again anyway. */
+      unsigned t = *c0;
+      *c0 = *c1;
+      *c1 = t;
+   }
+   return *c0 != *c1;
+}
+
+
+/* Encodes the colour part of a block.  DXT1 blocks with pixels whose alpha
+ * is below 128 are written in the three colour mode, where index 3 is
+ * transparent black.
+ */
+static void encode_colour_block(unsigned char in[16][4], bool dxt1,
+   unsigned char *block)
+{
+   unsigned char pal[4][4];
+   int lo[3] = {255, 255, 255};
+   int hi[3] = {0, 0, 0};
+   int mean[3] = {0, 0, 0};
+   int cov[3] = {0, 0, 0};
+   bool transparent = false;
+   bool used[16];
+   int n = 0;
+   int axis = 0;
+   int c, i;
+   unsigned c0, c1;
+   uint32_t bits = 0;
+
+   for (i = 0; i < 16; i++) {
+      used[i] = !dxt1 || in[i][3] >= 128;
+      if (!used[i]) {
+         transparent = true;
+         continue;
+      }
+      for (c = 0; c < 3; c++) {
+         lo[c] = _ALLEGRO_MIN(lo[c], in[i][c]);
+         hi[c] = _ALLEGRO_MAX(hi[c], in[i][c]);
+         mean[c] += in[i][c];
+      }
+      n++;
+   }
+
+   if (n == 0) {
+      /* Fully transparent DXT1 block. */
+      memset(block, 0, 4);
+      memset(block + 4, 0xff, 4);
+      return;
+   }
+
+   /* The bounding box only gives the right diagonal if every channel grows
+    * along the same direction as the channel with the largest range.
+    */
+   for (c = 1; c < 3; c++) {
+      if (hi[c] - lo[c] > hi[axis] - lo[axis])
+         axis = c;
+   }
+   for (i = 0; i < 16; i++) {
+      if (!used[i])
+         continue;
+      for (c = 0; c < 3; c++)
+         cov[c] += (in[i][c] * n - mean[c]) * (in[i][axis] * n - mean[axis]);
+   }
+
+   for (c = 0; c < 3; c++) {
+      int inset = (hi[c] - lo[c]) >> 4;
+      lo[c] += inset;
+      hi[c] -= inset;
+      if (cov[c] < 0) {
+         int t = lo[c];
+         lo[c] = hi[c];
+         hi[c] = t;
+      }
+   }
+
+   c0 = pack_565(hi);
+   c1 = pack_565(lo);
+   if (transparent ? c0 > c1 : c0 < c1) {
+      unsigned t = c0;
+      c0 = c1;
+      c1 = t;
+   }
+
+   if (c0 != c1) {
+      int error;
+      colour_palette(c0, c1, !transparent, pal);
+      bits = pick_indices(in, used, pal, transparent ? 3 : 4, &error);
+
+      if (!transparent && error > 0) {
+         unsigned r0, r1;
+         uint32_t rbits;
+         int rerror;
+         if (refine_endpoints(in, bits, &r0, &r1)) {
+            colour_palette(r0, r1, true, pal);
+            rbits = pick_indices(in, used, pal, 4, &rerror);
+            if (rerror < error) {
+               c0 = r0;
+               c1 = r1;
+               bits = rbits;
+            }
+         }
+      }
+   }
+   else {
+      for (i = 0; i < 16; i++) {
+         if (!used[i])
+            bits |= (uint32_t)3 << (2 * i);
+      }
+   }
+
+   block[0] = c0 & 0xff;
+   block[1] = c0 >> 8;
+   block[2] = c1 & 0xff;
+   block[3] = c1 >> 8;
+   block[4] = bits & 0xff;
+   block[5] = (bits >> 8) & 0xff;
+   block[6] = (bits >> 16) & 0xff;
+   block[7] = bits >> 24;
+}
+
+
+static void encode_dxt3_alpha(unsigned char in[16][4], unsigned char *block)
+{
+   int i;
+
+   memset(block, 0, 8);
+   for (i = 0; i < 16; i++) {
+      int a = (in[i][3] * 15 + 127) / 255;
+      block[i / 2] |= a << ((i & 1) * 4);
+   }
+}
+
+
+static void encode_dxt5_alpha(unsigned char in[16][4], unsigned char *block)
+{
+   int a0 = 0;
+   int a1 = 255;
+   uint64_t bits = 0;
+   int i;
+
+   for (i = 0; i < 16; i++) {
+      a0 = _ALLEGRO_MAX(a0, in[i][3]);
+      a1 = _ALLEGRO_MIN(a1, in[i][3]);
+   }
+
+   /* With a0 > a1 the palette holds eight evenly spaced levels from a0 down
+    * to a1, so the index follows from the position between the two.
+    */
+   if (a0 > a1) {
+      int range = a0 - a1;
+      for (i = 0; i < 16; i++) {
+         int t = ((in[i][3] - a1) * 7 + range / 2) / range;
+         int index = (t == 7) ? 0 : (t == 0) ? 1 : 8 - t;
+         bits |= (uint64_t)index << (3 * i);
+      }
+   }
+
+   block[0] = a0;
+   block[1] = a1;
+   for (i = 0; i < 6; i++)
+      block[2 + i] = (bits >> (8 * i)) & 0xff;
+}
+
+
+static void encode_block(int format, unsigned char in[16][4],
+   unsigned char *block)
+{
+   switch (format) {
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:
+         encode_colour_block(in, true, block);
+         break;
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:
+         encode_dxt3_alpha(in, block);
+         encode_colour_block(in, false, block + 8);
+         break;
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5:
+         encode_dxt5_alpha(in, block);
+         encode_colour_block(in, false, block + 8);
+         break;
+   }
+}
+
+
+/* Decodes the blocks covering the given region of src into ABGR_8888_LE
+ * pixels.  sx and sy must lie on a block boundary; partial blocks at the
+ * right and bottom edge only write the pixels inside the region.
+ */
+void _al_decode_dxt_blocks(int format, const void *src, int src_pitch,
+   void *dst, int dst_pitch, int sx, int sy, int dx, int dy,
+   int width, int height)
+{
+   int size = block_bytes(format);
+   unsigned char pixels[16][4];
+   int bx, by, x, y;
+
+   ASSERT(_al_pixel_format_is_compressed(format));
+   ASSERT(sx % DXT_BLOCK == 0);
+   ASSERT(sy % DXT_BLOCK == 0);
+
+   for (by = 0; by < height; by += DXT_BLOCK) {
+      const unsigned char *src_row = (const unsigned char *)src +
+         (sy + by) / DXT_BLOCK * src_pitch + sx / DXT_BLOCK * size;
+      int h = _ALLEGRO_MIN(DXT_BLOCK, height - by);
+
+      for (bx = 0; bx < width; bx += DXT_BLOCK) {
+         int w = _ALLEGRO_MIN(DXT_BLOCK, width - bx);
+
+         decode_block(format, src_row + bx / DXT_BLOCK * size, pixels);
+
+         for (y = 0; y < h; y++) {
+            unsigned char *dst_ptr = (unsigned char *)dst +
+               (dy + by + y) * dst_pitch + (dx + bx) * 4;
+            for (x = 0; x < w; x++)
+               memcpy(dst_ptr + x * 4, pixels[y * DXT_BLOCK + x], 4);
+         }
+      }
+   }
+}
+
+
+/* Encodes ABGR_8888_LE pixels into the blocks covering the given region of
+ * dst.  dx and dy must lie on a block boundary.  Partial blocks at the
+ * right and bottom edge are padded by repeating the last column and row.
+ */
+void _al_encode_dxt_blocks(int format, const void *src, int src_pitch,
+   void *dst, int dst_pitch, int sx, int sy, int dx, int dy,
+   int width, int height)
+{
+   int size = block_bytes(format);
+   unsigned char pixels[16][4];
+   int bx, by, x, y;
+
+   ASSERT(_al_pixel_format_is_compressed(format));
+   ASSERT(dx % DXT_BLOCK == 0);
+   ASSERT(dy % DXT_BLOCK == 0);
+
+   for (by = 0; by < height; by += DXT_BLOCK) {
+      unsigned char *dst_row = (unsigned char *)dst +
+         (dy + by) / DXT_BLOCK * dst_pitch + dx / DXT_BLOCK * size;
+      int h = _ALLEGRO_MIN(DXT_BLOCK, height - by);
+
+      for (bx = 0; bx < width; bx += DXT_BLOCK) {
+         int w = _ALLEGRO_MIN(DXT_BLOCK, width - bx);
+
+         for (y = 0; y < DXT_BLOCK; y++) {
+            const unsigned char *src_ptr = (const unsigned char *)src +
+               (sy + by + _ALLEGRO_MIN(y, h - 1)) * src_pitch +
+               (sx + bx) * 4;
+            for (x = 0; x < DXT_BLOCK; x++)
+               memcpy(pixels[y * DXT_BLOCK + x],
+                  src_ptr + _ALLEGRO_MIN(x, w - 1) * 4, 4);
+         }
+
+         encode_block(format, pixels, dst_row + bx / DXT_BLOCK * size);
+      }
+   }
+}
+
+
+/* Converts between a compressed and any other format, going through
+ * ABGR_8888_LE one row of blocks at a time.
+ */
+void _al_convert_compressed_data(
+   const void *src, int src_format, int src_pitch,
+   void *dst, int dst_format, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   const int tmp_format = ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE;
+   bool src_compressed = _al_pixel_format_is_compressed(src_format);
+   bool dst_compressed = _al_pixel_format_is_compressed(dst_format);
+   unsigned char *tmp;
+   int tmp_pitch = width * 4;
+   int y, h;
+
+   ASSERT(src_compressed || dst_compressed);
+
+   if (src_compressed && dst_format == tmp_format) {
+      _al_decode_dxt_blocks(src_format, src, src_pitch, dst, dst_pitch,
+         sx, sy, dx, dy, width, height);
+      return;
+   }
+   if (dst_compressed && src_format == tmp_format) {
+      _al_encode_dxt_blocks(dst_format, src, src_pitch, dst, dst_pitch,
+         sx, sy, dx, dy, width, height);
+      return;
+   }
+
+   tmp = al_malloc(tmp_pitch * DXT_BLOCK);
+   if (!tmp)
+      return;
+
+   for (y = 0; y < height; y += DXT_BLOCK) {
+      h = _ALLEGRO_MIN(DXT_BLOCK, height - y);
+
+      if (src_compressed) {
+         _al_decode_dxt_blocks(src_format, src, src_pitch, tmp, tmp_pitch,
+            sx, sy + y, 0, 0, width, h);
+      }
+      else {
+         _al_convert_bitmap_data(src, src_format, src_pitch,
+            tmp, tmp_format, tmp_pitch, sx, sy + y, 0, 0, width, h);
+      }
+
+      if (dst_compressed) {
+         _al_encode_dxt_blocks(dst_format, tmp, tmp_pitch, dst, dst_pitch,
+            0, 0, dx, dy + y, width, h);
+      }
+      else {
+         _al_convert_bitmap_data(tmp, tmp_format, tmp_pitch,
+            dst, dst_format, dst_pitch, 0, 0, dx, dy + y, width, h);
+      }
+   }
+
+   al_free(tmp);
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -43,6 +43,7 @@ struct ALLEGRO_EVENT_QUEUE
    _AL_MUTEX mutex;
    _AL_COND cond;
    _AL_LIST_ITEM *dtor_item;
+   ALLEGRO_EVENT_QUEUE_STATS stats;  /* depth field unused */
 };
 
 
@@ -101,9 +102,10 @@ ALLEGRO_EVENT_QUEUE *al_create_event_queue(void)
       queue->events_head = 0;
       queue->events_tail = 0;
       queue->paused = false;
+      memset(&queue->stats, 0, sizeof(queue->stats));
 
       _AL_MARK_MUTEX_UNINITED(queue->mutex);
-      _al_mutex_init(&queue->mutex);
+      _al_mutex_init_adaptive(&queue->mutex);
       _al_cond_init(&queue->cond);
 
       queue->dtor_item = _al_register_destructor(_al_dtor_list, "queue", queue,
@@ -269,6 +271,40 @@ static unsigned int circ_array_next(const _AL_VECTOR *vector, unsigned int i)
 
 
 
+/* queue_depth:
+ *  Return the number of events in the queue.  The queue must be locked.
+ */
+static unsigned int queue_depth(const ALLEGRO_EVENT_QUEUE *queue)
+{
+   const unsigned int size = _al_vector_size(&queue->events);
+
+   return (queue->events_head + size - queue->events_tail) % size;
+}
+
+
+
+/* note_dequeued_event:
+ *  Update the statistics for an event being taken out of the queue.
+ *  Events carry the time they were generated, so that's the start of the
+ *  latency interval.  The queue must be locked.
+ */
+static void note_dequeued_event(ALLEGRO_EVENT_QUEUE *queue,
+   const ALLEGRO_EVENT *event)
+{
+   queue->stats.num_dequeued++;
+
+   if (event->any.timestamp > 0.0) {
+      double latency = al_get_time() - event->any.timestamp;
+      if (latency > 0.0) {
+         queue->stats.total_latency += latency;
+         if (latency > queue->stats.max_latency)
+            queue->stats.max_latency = latency;
+      }
+   }
+}
+
+
+
 /* get_next_event_if_any: [primary thread]
  *  Helper function.  It returns a pointer to the next event in the
  *  queue, or NULL.  Optionally the event is removed from the queue.
@@ -288,6 +324,7 @@ static ALLEGRO_EVENT *get_next_event_if_any(ALLEGRO_EVENT_QUEUE *queue,
    event = _al_vector_ref(&queue->events, queue->events_tail);
    if (delete) {
       queue->events_tail = circ_array_next(&queue->events, queue->events_tail);
+      note_dequeued_event(queue, event);
    }
    return event;
 }
@@ -519,6 +556,8 @@ static void expand_events_array(ALLEGRO_EVENT_QUEUE *queue)
       }
       queue->events_head += old_size;
    }
+
+   queue->stats.num_expansions++;
 }
 
 
@@ -532,6 +571,7 @@ static ALLEGRO_EVENT *alloc_event(ALLEGRO_EVENT_QUEUE *queue)
 {
    ALLEGRO_EVENT *event;
    unsigned int adv_head;
+   unsigned int depth;
 
    adv_head = circ_array_next(&queue->events, queue->events_head);
    if (adv_head == queue->events_tail) {
@@ -541,6 +581,12 @@ static ALLEGRO_EVENT *alloc_event(ALLEGRO_EVENT_QUEUE *queue)
 
    event = _al_vector_ref(&queue->events, queue->events_head);
    queue->events_head = adv_head;
+
+   queue->stats.num_queued++;
+   depth = queue_depth(queue);
+   if (depth > queue->stats.peak_depth)
+      queue->stats.peak_depth = depth;
+
    return event;
 }
 
@@ -591,20 +637,24 @@ static void unref_if_user_event(ALLEGRO_EVENT *event)
 /* Internal function: _al_event_queue_push_event
  *  Event sources call this function when they have something to add to
  *  the queue.  If a queue cannot accept the event, the event's
- *  refcount will not be incremented.
+ *  refcount will not be incremented and false is returned.
  *
  *  If no event queues can accept the event, the event should be
  *  returned to the event source's list of recyclable events.
  */
-void _al_event_queue_push_event(ALLEGRO_EVENT_QUEUE *queue,
+bool _al_event_queue_push_event(ALLEGRO_EVENT_QUEUE *queue,
    const ALLEGRO_EVENT *orig_event)
 {
    ALLEGRO_EVENT *new_event;
    ASSERT(queue);
    ASSERT(orig_event);
 
-   if (queue->paused)
-      return;
+   if (queue->paused) {
+      _al_mutex_lock(&queue->mutex);
+      queue->stats.num_dropped++;
+      _al_mutex_unlock(&queue->mutex);
+      return false;
+   }
 
    _al_mutex_lock(&queue->mutex);
    {
@@ -618,6 +668,8 @@ void _al_event_queue_push_event(ALLEGRO_EVENT_QUEUE *queue,
       _al_cond_broadcast(&queue->cond);
    }
    _al_mutex_unlock(&queue->mutex);
+
+   return true;
 }
 
 
@@ -731,6 +783,36 @@ void al_unref_user_event(ALLEGRO_USER_EVENT *event)
 
 
 
+/* Function: al_get_event_queue_stats
+ */
+void al_get_event_queue_stats(ALLEGRO_EVENT_QUEUE *queue,
+   ALLEGRO_EVENT_QUEUE_STATS *stats)
+{
+   ASSERT(queue);
+   ASSERT(stats);
+
+   _al_mutex_lock(&queue->mutex);
+   *stats = queue->stats;
+   stats->depth = queue_depth(queue);
+   _al_mutex_unlock(&queue->mutex);
+}
+
+
+
+/* Function: al_reset_event_queue_stats
+ */
+void al_reset_event_queue_stats(ALLEGRO_EVENT_QUEUE *queue)
+{
+   ASSERT(queue);
+
+   _al_mutex_lock(&queue->mutex);
+   memset(&queue->stats, 0, sizeof(queue->stats));
+   queue->stats.peak_depth = queue_depth(queue);
+   _al_mutex_unlock(&queue->mutex);
+}
+
+
+
 /*
  * Local Variables:
  * c-basic-offset: 3
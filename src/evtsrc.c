@@ -40,7 +40,7 @@ void _al_event_source_init(ALLEGRO_EVENT_SOURCE *es)
 
    memset(es, 0, sizeof(*es));
    _AL_MARK_MUTEX_UNINITED(this->mutex);
-   _al_mutex_init(&this->mutex);
+   _al_mutex_init_adaptive(&this->mutex);
    _al_vector_init(&this->queues, sizeof(ALLEGRO_EVENT_QUEUE *));
    this->data = 0;
 }
@@ -183,9 +183,12 @@ void _al_event_source_emit_event(ALLEGRO_EVENT_SOURCE *es, ALLEGRO_EVENT *event)
 
       for (i = 0; i < num_queues; i++) {
          slot = _al_vector_ref(&this->queues, i);
-         _al_event_queue_push_event(*slot, event);
+         if (!_al_event_queue_push_event(*slot, event))
+            this->num_dropped++;
       }
    }
+
+   this->num_emitted++;
 }
 
 
@@ -279,6 +282,38 @@ intptr_t al_get_event_source_data(const ALLEGRO_EVENT_SOURCE *source)
 
 
 
+/* Function: al_get_event_source_stats
+ */
+void al_get_event_source_stats(ALLEGRO_EVENT_SOURCE *source,
+   ALLEGRO_EVENT_SOURCE_STATS *stats)
+{
+   ALLEGRO_EVENT_SOURCE_REAL *rsrc = (ALLEGRO_EVENT_SOURCE_REAL *)source;
+   ASSERT(source);
+   ASSERT(stats);
+
+   _al_event_source_lock(source);
+   stats->num_emitted = rsrc->num_emitted;
+   stats->num_dropped = rsrc->num_dropped;
+   _al_event_source_unlock(source);
+}
+
+
+
+/* Function: al_reset_event_source_stats
+ */
+void al_reset_event_source_stats(ALLEGRO_EVENT_SOURCE *source)
+{
+   ALLEGRO_EVENT_SOURCE_REAL *rsrc = (ALLEGRO_EVENT_SOURCE_REAL *)source;
+   ASSERT(source);
+
+   _al_event_source_lock(source);
+   rsrc->num_emitted = 0;
+   rsrc->num_dropped = 0;
+   _al_event_source_unlock(source);
+}
+
+
+
 /*
  * Local Variables:
  * c-basic-offset: 3
@@ -14,11 +14,48 @@
  */
 
 
+#include <string.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_file.h"
 
 
+/* forward declarations */
+static bool drop_read_ahead(ALLEGRO_FILE *f);
+
+
+static void init_file_handle(ALLEGRO_FILE *f, const ALLEGRO_FILE_INTERFACE *drv)
+{
+   f->vtable = drv;
+   f->ungetc_len = 0;
+   f->read_ahead = false;
+   f->rbuf_eof = false;
+   f->rbuf = NULL;
+   f->rbuf_pos = 0;
+   f->rbuf_len = 0;
+   f->path = NULL;
+   f->async = NULL;
+}
+
+
+/* mode_allows_read_ahead:
+ *  Only files opened for reading only are buffered.  Text mode on Windows
+ *  translates newlines, which would break the position arithmetic, so
+ *  binary mode is required there.
+ */
+static bool mode_allows_read_ahead(const char *mode)
+{
+   if (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))
+      return false;
+#ifdef ALLEGRO_WINDOWS
+   if (!strchr(mode, 'b'))
+      return false;
+#endif
+   return true;
+}
+
+
 /* Function: al_fopen
  */
 ALLEGRO_FILE *al_fopen(const char *path, const char *mode)
@@ -44,13 +81,19 @@ ALLEGRO_FILE *al_fopen_interface(const ALLEGRO_FILE_INTERFACE *drv,
          al_set_errno(ENOMEM);
       }
       else {
-         f->vtable = drv;
+         init_file_handle(f, drv);
          f->userdata = drv->fi_fopen(path, mode);
-         f->ungetc_len = 0;
          if (!f->userdata) {
             al_free(f);
             f = NULL;
          }
+         else {
+            f->path = al_malloc(strlen(path) + 1);
+            if (f->path)
+               strcpy(f->path, path);
+            if (mode_allows_read_ahead(mode))
+               _al_set_file_read_ahead(f, true);
+         }
       }
    }
 
@@ -58,6 +101,20 @@ ALLEGRO_FILE *al_fopen_interface(const ALLEGRO_FILE_INTERFACE *drv,
 }
 
 
+/* _al_fopen_mapped:
+ *  Open a file for reading in binary mode, asking the standard file
+ *  interface to map it into memory.  Only for files which are replaced
+ *  rather than rewritten in place, as mapped files must not be truncated.
+ */
+ALLEGRO_FILE *_al_fopen_mapped(const char *path)
+{
+   const ALLEGRO_FILE_INTERFACE *drv = al_get_new_file_interface();
+
+   return al_fopen_interface(drv, path,
+      (drv == &_al_file_interface_stdio) ? "rbm" : "rb");
+}
+
+
 /* Function: al_create_file_handle
  */
 ALLEGRO_FILE *al_create_file_handle(const ALLEGRO_FILE_INTERFACE *drv,
@@ -72,9 +129,8 @@ ALLEGRO_FILE *al_create_file_handle(const ALLEGRO_FILE_INTERFACE *drv,
       al_set_errno(ENOMEM);
    }
    else {
-      f->vtable = drv;
+      init_file_handle(f, drv);
       f->userdata = userdata;
-      f->ungetc_len = 0;
    }
 
    return f;
@@ -86,7 +142,15 @@ ALLEGRO_FILE *al_create_file_handle(const ALLEGRO_FILE_INTERFACE *drv,
 bool al_fclose(ALLEGRO_FILE *f)
 {
    if (f) {
-      bool ret = f->vtable->fi_fclose(f);
+      bool ret;
+      _al_file_async_close(f);
+      /* Leave the backend where the user stopped reading, which matters
+       * for slices sharing a parent file.
+       */
+      drop_read_ahead(f);
+      ret = f->vtable->fi_fclose(f);
+      al_free(f->rbuf);
+      al_free(f->path);
       al_free(f);
       return ret;
    }
@@ -96,6 +160,102 @@ bool al_fclose(ALLEGRO_FILE *f)
 }
 
 
+/* _al_set_file_read_ahead:
+ *  Enable or disable the read-ahead buffer.  It needs a seekable backend,
+ *  so that the backend can be moved back to the logical position when
+ *  buffered data is discarded.
+ */
+void _al_set_file_read_ahead(ALLEGRO_FILE *f, bool enable)
+{
+   ASSERT(f);
+
+   if (enable) {
+      if (!f->read_ahead && f->vtable->fi_ftell(f) >= 0) {
+         f->read_ahead = true;
+         f->rbuf_eof = false;
+      }
+   }
+   else if (f->read_ahead) {
+      drop_read_ahead(f);
+      al_free(f->rbuf);
+      f->rbuf = NULL;
+      f->read_ahead = false;
+   }
+}
+
+
+/* drop_read_ahead:
+ *  Discard any buffered data, moving the backend back to the logical
+ *  position.
+ */
+static bool drop_read_ahead(ALLEGRO_FILE *f)
+{
+   size_t buffered = f->rbuf_len - f->rbuf_pos;
+
+   f->rbuf_pos = 0;
+   f->rbuf_len = 0;
+
+   if (buffered > 0)
+      return f->vtable->fi_fseek(f, -(int64_t)buffered, ALLEGRO_SEEK_CUR);
+   return true;
+}
+
+
+/* file_read:
+ *  Read through the read-ahead buffer, if enabled.  Small reads refill the
+ *  buffer, large reads go straight to the backend.
+ */
+static size_t file_read(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   unsigned char *cptr = ptr;
+   size_t avail;
+   size_t n;
+
+   if (!f->read_ahead)
+      return f->vtable->fi_fread(f, ptr, size);
+
+   avail = f->rbuf_len - f->rbuf_pos;
+   if (size <= avail) {
+      memcpy(cptr, f->rbuf + f->rbuf_pos, size);
+      f->rbuf_pos += size;
+      return size;
+   }
+
+   if (avail > 0) {
+      memcpy(cptr, f->rbuf + f->rbuf_pos, avail);
+      cptr += avail;
+      size -= avail;
+   }
+   f->rbuf_pos = 0;
+   f->rbuf_len = 0;
+
+   if (!f->rbuf && size < ALLEGRO_READ_AHEAD_SIZE / 2) {
+      f->rbuf = al_malloc(ALLEGRO_READ_AHEAD_SIZE);
+   }
+
+   if (!f->rbuf || size >= ALLEGRO_READ_AHEAD_SIZE / 2) {
+      n = f->vtable->fi_fread(f, cptr, size);
+   }
+   else {
+      f->rbuf_len = f->vtable->fi_fread(f, f->rbuf, ALLEGRO_READ_AHEAD_SIZE);
+      /* Running into the end while filling the buffer must not count as
+       * the caller reading past it.  A null seek clears the backend's end
+       * of file indicator, as with stdio.
+       */
+      if (f->rbuf_len < ALLEGRO_READ_AHEAD_SIZE)
+         f->vtable->fi_fseek(f, 0, ALLEGRO_SEEK_CUR);
+      n = _ALLEGRO_MIN(size, f->rbuf_len);
+      memcpy(cptr, f->rbuf, n);
+      f->rbuf_pos = n;
+   }
+
+   if (n < size)
+      f->rbuf_eof = true;
+
+   return avail + n;
+}
+
+
 /* Function: al_fread
  */
 size_t al_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
@@ -113,10 +273,10 @@ size_t al_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
          --size;
       }
 
-      return bytes_ungetc + f->vtable->fi_fread(f, cptr, size);
+      return bytes_ungetc + file_read(f, cptr, size);
    }
    else {
-      return f->vtable->fi_fread(f, ptr, size);
+      return file_read(f, ptr, size);
    }
 }
 
@@ -129,6 +289,7 @@ size_t al_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
    ASSERT(ptr || size == 0);
 
    f->ungetc_len = 0;
+   drop_read_ahead(f);
    return f->vtable->fi_fwrite(f, ptr, size);
 }
 
@@ -147,9 +308,14 @@ bool al_fflush(ALLEGRO_FILE *f)
  */
 int64_t al_ftell(ALLEGRO_FILE *f)
 {
+   int64_t pos;
    ASSERT(f);
 
-   return f->vtable->fi_ftell(f) - f->ungetc_len;
+   pos = f->vtable->fi_ftell(f);
+   if (pos == -1)
+      return -1;
+
+   return pos - f->ungetc_len - (f->rbuf_len - f->rbuf_pos);
 }
 
 
@@ -172,6 +338,24 @@ bool al_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
       f->ungetc_len = 0;
    }
 
+   if (f->read_ahead) {
+      size_t buffered = f->rbuf_len - f->rbuf_pos;
+
+      f->rbuf_eof = false;
+
+      if (whence == ALLEGRO_SEEK_CUR) {
+         /* Short skips stay within the buffer. */
+         if (offset >= -(int64_t)f->rbuf_pos && offset < (int64_t)buffered) {
+            f->rbuf_pos += offset;
+            return true;
+         }
+         offset -= buffered;
+      }
+
+      f->rbuf_pos = 0;
+      f->rbuf_len = 0;
+   }
+
    return f->vtable->fi_fseek(f, offset, whence);
 }
 
@@ -182,7 +366,20 @@ bool al_feof(ALLEGRO_FILE *f)
 {
    ASSERT(f);
 
-   return f->ungetc_len == 0 && f->vtable->fi_feof(f);
+   if (f->ungetc_len > 0)
+      return false;
+
+   /* With the buffer empty the backend is at the logical position, so its
+    * own end-of-file test applies.
+    */
+   if (f->read_ahead) {
+      if (f->rbuf_pos < f->rbuf_len)
+         return false;
+      if (f->rbuf_eof)
+         return true;
+   }
+
+   return f->vtable->fi_feof(f);
 }
 
 
@@ -215,10 +412,26 @@ void al_fclearerr(ALLEGRO_FILE *f)
 {
    ASSERT(f);
 
+   f->rbuf_eof = false;
    f->vtable->fi_fclearerr(f);
 }
 
 
+/* read_small:
+ *  Serve a fixed-size read directly from the read-ahead buffer if possible.
+ */
+static size_t read_small(ALLEGRO_FILE *f, unsigned char *b, size_t n)
+{
+   if (f->rbuf_len - f->rbuf_pos >= n && f->ungetc_len == 0) {
+      memcpy(b, f->rbuf + f->rbuf_pos, n);
+      f->rbuf_pos += n;
+      return n;
+   }
+
+   return al_fread(f, b, n);
+}
+
+
 /* Function: al_fgetc
  */
 int al_fgetc(ALLEGRO_FILE *f)
@@ -226,6 +439,10 @@ int al_fgetc(ALLEGRO_FILE *f)
    uint8_t c;
    ASSERT(f);
 
+   if (f->rbuf_pos < f->rbuf_len && f->ungetc_len == 0) {
+      return f->rbuf[f->rbuf_pos++];
+   }
+
    if (al_fread(f, &c, 1) != 1) {
       return EOF;
    }
@@ -256,7 +473,7 @@ int16_t al_fread16le(ALLEGRO_FILE *f)
    unsigned char b[2];
    ASSERT(f);
 
-   if (al_fread(f, b, 2) == 2) {
+   if (read_small(f, b, 2) == 2) {
       return (((int16_t)b[1] << 8) | (int16_t)b[0]);
    }
 
@@ -271,7 +488,7 @@ int32_t al_fread32le(ALLEGRO_FILE *f)
    unsigned char b[4];
    ASSERT(f);
 
-   if (al_fread(f, b, 4) == 4) {
+   if (read_small(f, b, 4) == 4) {
       return (((int32_t)b[3] << 24) | ((int32_t)b[2] << 16) |
               ((int32_t)b[1] << 8) | (int32_t)b[0]);
    }
@@ -335,7 +552,7 @@ int16_t al_fread16be(ALLEGRO_FILE *f)
    unsigned char b[2];
    ASSERT(f);
 
-   if (al_fread(f, b, 2) == 2) {
+   if (read_small(f, b, 2) == 2) {
       return (((int16_t)b[0] << 8) | (int16_t)b[1]);
    }
 
@@ -350,7 +567,7 @@ int32_t al_fread32be(ALLEGRO_FILE *f)
    unsigned char b[4];
    ASSERT(f);
 
-   if (al_fread(f, b, 4) == 4) {
+   if (read_small(f, b, 4) == 4) {
       return (((int32_t)b[0] << 24) | ((int32_t)b[1] << 16) |
               ((int32_t)b[2] << 8) | (int32_t)b[3]);
    }
@@ -498,23 +715,44 @@ int al_fungetc(ALLEGRO_FILE *f, int c)
 {
    ASSERT(f != NULL);
 
+   if (f->read_ahead) {
+      f->rbuf_eof = false;
+      /* The byte just read is still in the buffer, so step back over it. */
+      if (f->ungetc_len == 0 && f->rbuf_pos > 0) {
+         f->rbuf[--f->rbuf_pos] = (unsigned char) c;
+         return c;
+      }
+      /* The backend is ahead of the logical position. */
+      if (f->rbuf_pos < f->rbuf_len) {
+         return _al_fungetc_buffered(f, c);
+      }
+   }
+
    if (f->vtable->fi_fungetc) {
       return f->vtable->fi_fungetc(f, c);
    }
    else {
       /* If the interface does not provide an implementation for ungetc,
-       * then a default one will be used. (Note that if the interface does
-       * implement it, then this ungetc buffer will never be filled, and all
-       * other references to it within this file will always be ignored.)
+       * then a default one will be used.  Interfaces may also fall back to
+       * it themselves.
        */
-      if (f->ungetc_len == ALLEGRO_UNGETC_SIZE) {
-         return EOF;
-      }
+      return _al_fungetc_buffered(f, c);
+   }
+}
 
-      f->ungetc[f->ungetc_len++] = (unsigned char) c;
 
-      return c;
+/* _al_fungetc_buffered:
+ *  Push a byte back into the generic ungetc buffer.
+ */
+int _al_fungetc_buffered(ALLEGRO_FILE *f, int c)
+{
+   if (f->ungetc_len == ALLEGRO_UNGETC_SIZE) {
+      return EOF;
    }
+
+   f->ungetc[f->ungetc_len++] = (unsigned char) c;
+
+   return c;
 }
 
 
@@ -528,6 +766,39 @@ int64_t al_fsize(ALLEGRO_FILE *f)
 }
 
 
+/* Function: al_fborrow
+ */
+const void *al_fborrow(ALLEGRO_FILE *f, size_t *ret_size)
+{
+   const void *(*borrow)(ALLEGRO_FILE *f, size_t *ret_size);
+   ASSERT(f != NULL);
+   ASSERT(ret_size);
+
+   *ret_size = 0;
+
+   /* Bytes pushed back with al_fungetc are not part of the backing
+    * buffer, so there is nothing contiguous to lend.
+    */
+   if (f->ungetc_len)
+      return NULL;
+
+   if (f->vtable == &_al_file_interface_stdio)
+      borrow = _al_file_stdio_borrow;
+   else if (f->vtable == &_al_file_interface_slice)
+      borrow = _al_file_slice_borrow;
+   else if (f->vtable == &_al_file_interface_pack)
+      borrow = _al_file_pack_borrow;
+   else
+      return NULL;
+
+   /* The backend must be at the logical position. */
+   if (!drop_read_ahead(f))
+      return NULL;
+
+   return borrow(f, ret_size);
+}
+
+
 /* Function: al_get_file_userdata
  */
 void *al_get_file_userdata(ALLEGRO_FILE *f)
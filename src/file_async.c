@@ -0,0 +1,278 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Asynchronous file reads.
+ *
+ *      See LICENSE.txt for copyright information.
+ *
+ *      Reads are run as tasks on the worker pool and report completion
+ *      through a per-file event source.  Memory-mapped files are read at
+ *      an offset without touching the file position, so any number of
+ *      requests can be in flight at once.  Other files opened by name are
+ *      read through a second handle owned by the workers, whose requests
+ *      take turns seeking and reading it.  The caller's handle is never
+ *      used from a worker.
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_file.h"
+#include "allegro5/internal/aintern_thread.h"
+
+ALLEGRO_DEBUG_CHANNEL("file")
+
+
+struct _AL_FILE_ASYNC
+{
+   ALLEGRO_EVENT_SOURCE es;
+   ALLEGRO_TASK_GROUP *group;
+   _AL_MUTEX mutex;     /* serialises reads through `reader' */
+   ALLEGRO_FILE *reader;
+};
+
+typedef struct ASYNC_READ
+{
+   ALLEGRO_FILE *f;
+   int64_t offset;
+   void *ptr;
+   size_t size;
+} ASYNC_READ;
+
+
+/* Guards the creation of the per-file state. */
+static _AL_MUTEX async_mutex = _AL_MUTEX_UNINITED;
+
+
+
+static void shutdown_file_async(void)
+{
+   _al_mutex_destroy(&async_mutex);
+}
+
+
+
+void _al_init_file_async(void)
+{
+   _al_mutex_init(&async_mutex);
+   _al_add_exit_func(shutdown_file_async, "shutdown_file_async");
+}
+
+
+
+static bool is_mapped(ALLEGRO_FILE *f)
+{
+   return f->vtable == &_al_file_interface_stdio && _al_file_stdio_is_mapped(f);
+}
+
+
+
+static _AL_FILE_ASYNC *create_async(ALLEGRO_FILE *f)
+{
+   _AL_FILE_ASYNC *async = al_malloc(sizeof(*async));
+
+   if (!async)
+      return NULL;
+
+   async->group = al_create_task_group();
+   if (!async->group) {
+      al_free(async);
+      return NULL;
+   }
+   _al_event_source_init(&async->es);
+   _AL_MARK_MUTEX_UNINITED(async->mutex);
+   _al_mutex_init(&async->mutex);
+
+   /* Mapped stdio files are read in place.  Anything else gets a handle of
+    * its own, if it can be opened again.
+    */
+   async->reader = NULL;
+   if (!is_mapped(f) && f->path && f->vtable->fi_fopen) {
+      async->reader = al_fopen_interface(f->vtable, f->path, "rb");
+      if (!async->reader)
+         ALLEGRO_WARN("Could not reopen %s, reading synchronously.\n",
+            f->path);
+   }
+
+   return async;
+}
+
+
+
+static _AL_FILE_ASYNC *get_async(ALLEGRO_FILE *f)
+{
+   _AL_FILE_ASYNC *async;
+
+   _al_mutex_lock(&async_mutex);
+   if (!f->async)
+      f->async = create_async(f);
+   async = f->async;
+   _al_mutex_unlock(&async_mutex);
+
+   return async;
+}
+
+
+
+/* read_at:
+ *  Read `size` bytes at `offset` of `f`, leaving its position as it was.
+ *  Only for the thread which owns `f`.
+ */
+static size_t read_at(ALLEGRO_FILE *f, int64_t offset, void *ptr, size_t size)
+{
+   size_t n = 0;
+   int64_t pos;
+
+   pos = al_ftell(f);
+   if (pos != -1 && al_fseek(f, offset, ALLEGRO_SEEK_SET)) {
+      n = al_fread(f, ptr, size);
+      al_fseek(f, pos, ALLEGRO_SEEK_SET);
+   }
+
+   return n;
+}
+
+
+
+/* read_apart:
+ *  Read without touching the caller's handle.  Returns false if the file
+ *  has to be read through that handle instead.
+ */
+static bool read_apart(ALLEGRO_FILE *f, int64_t offset, void *ptr,
+   size_t size, size_t *ret_size)
+{
+   _AL_FILE_ASYNC *async = f->async;
+
+   if (is_mapped(f))
+      return _al_file_stdio_pread(f, offset, ptr, size, ret_size);
+
+   if (!async->reader)
+      return false;
+
+   _al_mutex_lock(&async->mutex);
+   *ret_size = read_at(async->reader, offset, ptr, size);
+   _al_mutex_unlock(&async->mutex);
+
+   return true;
+}
+
+
+
+static void emit_read_event(ALLEGRO_FILE *f, ASYNC_READ *req, size_t n)
+{
+   _AL_FILE_ASYNC *async = f->async;
+   ALLEGRO_EVENT event;
+
+   _al_event_source_lock(&async->es);
+   if (_al_event_source_needs_to_generate_event(&async->es)) {
+      event.file.type = ALLEGRO_EVENT_FILE_READ;
+      event.file.timestamp = al_get_time();
+      event.file.buffer = req->ptr;
+      event.file.offset = req->offset;
+      event.file.size = req->size;
+      event.file.bytes_read = n;
+      _al_event_source_emit_event(&async->es, &event);
+   }
+   _al_event_source_unlock(&async->es);
+}
+
+
+
+static void async_read_proc(void *arg)
+{
+   ASYNC_READ *req = arg;
+   size_t n = 0;
+
+   read_apart(req->f, req->offset, req->ptr, req->size, &n);
+   emit_read_event(req->f, req, n);
+   al_free(req);
+}
+
+
+
+/* Function: al_fread_async
+ */
+bool al_fread_async(ALLEGRO_FILE *f, int64_t offset, void *ptr, size_t size)
+{
+   _AL_FILE_ASYNC *async;
+   ASYNC_READ *req;
+
+   ASSERT(f);
+   ASSERT(ptr || size == 0);
+   ASSERT(offset >= 0);
+
+   async = get_async(f);
+   if (!async)
+      return false;
+
+   req = al_malloc(sizeof(*req));
+   if (!req)
+      return false;
+
+   req->f = f;
+   req->offset = offset;
+   req->ptr = ptr;
+   req->size = size;
+
+   /* A file which can only be read through the caller's handle is read
+    * right here, on the thread which owns it.
+    */
+   if (!async->reader && !is_mapped(f)) {
+      emit_read_event(f, req, read_at(f, offset, ptr, size));
+      al_free(req);
+      return true;
+   }
+
+   if (!al_run_task(async->group, async_read_proc, req)) {
+      ALLEGRO_DEBUG("No worker pool, reading synchronously.\n");
+      async_read_proc(req);
+   }
+
+   return true;
+}
+
+
+
+/* Function: al_get_file_event_source
+ */
+ALLEGRO_EVENT_SOURCE *al_get_file_event_source(ALLEGRO_FILE *f)
+{
+   _AL_FILE_ASYNC *async;
+
+   ASSERT(f);
+
+   async = get_async(f);
+   return async ? &async->es : NULL;
+}
+
+
+
+/* _al_file_async_close:
+ *  Wait for outstanding reads on the file and free the asynchronous state.
+ */
+void _al_file_async_close(ALLEGRO_FILE *f)
+{
+   _AL_FILE_ASYNC *async = f->async;
+
+   if (!async)
+      return;
+
+   al_destroy_task_group(async->group);
+   al_fclose(async->reader);
+   _al_event_source_free(&async->es);
+   _al_mutex_destroy(&async->mutex);
+   al_free(async);
+   f->async = NULL;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
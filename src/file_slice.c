@@ -15,6 +15,7 @@
  */
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern_file.h"
 
 typedef struct SLICE_DATA SLICE_DATA;
 
@@ -187,7 +188,30 @@ static off_t slice_fsize(ALLEGRO_FILE *f)
    return slice->size;
 }
 
-static const ALLEGRO_FILE_INTERFACE fi =
+/* _al_file_slice_borrow:
+ *  Borrow from the parent file, which is positioned where the slice is.
+ */
+const void *_al_file_slice_borrow(ALLEGRO_FILE *f, size_t *ret_size)
+{
+   SLICE_DATA *slice = al_get_file_userdata(f);
+   const void *p;
+   size_t size;
+
+   if (!(slice->mode & SLICE_READ))
+      return NULL;
+
+   p = al_fborrow(slice->fp, &size);
+   if (!p)
+      return NULL;
+
+   if (!(slice->mode & SLICE_EXPANDABLE) && size > slice->size - slice->pos)
+      size = slice->size - slice->pos;
+
+   *ret_size = size;
+   return p;
+}
+
+const ALLEGRO_FILE_INTERFACE _al_file_interface_slice =
 {
    NULL,
    slice_fclose,
@@ -209,6 +233,7 @@ static const ALLEGRO_FILE_INTERFACE fi =
 ALLEGRO_FILE *al_fopen_slice(ALLEGRO_FILE *fp, size_t initial_size, const char *mode)
 {
    SLICE_DATA *userdata = al_calloc(1, sizeof(*userdata));
+   ALLEGRO_FILE *f;
    int ch;
    
    if (!userdata) {
@@ -239,6 +264,15 @@ ALLEGRO_FILE *al_fopen_slice(ALLEGRO_FILE *fp, size_t initial_size, const char *
    userdata->anchor = al_ftell(fp);
    userdata->size = initial_size;
    
-   return al_create_file_handle(&fi, userdata);
+   f = al_create_file_handle(&_al_file_interface_slice, userdata);
+   if (!f) {
+      al_free(userdata);
+      return NULL;
+   }
+
+   if ((userdata->mode & (SLICE_READ | SLICE_WRITE)) == SLICE_READ)
+      _al_set_file_read_ahead(f, true);
+
+   return f;
 }
 
@@ -26,6 +26,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_file.h"
@@ -36,6 +37,14 @@
 #include <sys/stat.h>
 #endif
 
+#if defined(ALLEGRO_HAVE_MMAP) && defined(ALLEGRO_HAVE_SYS_STAT_H) && \
+   !defined(ALLEGRO_WINDOWS)
+   #define USE_MMAP
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <unistd.h>
+#endif
+
 ALLEGRO_DEBUG_CHANNEL("stdio")
 
 /* forward declaration */
@@ -51,6 +60,15 @@ typedef struct
    FILE *fp;
    int errnum;
    char errmsg[80];
+
+   /* Files opened with "m" for reading only are mapped into memory when
+    * possible, in which case fp is NULL and the following fields are used
+    * instead.  map_pos may be past the end, as with stdio.
+    */
+   const unsigned char *map;
+   size_t map_size;
+   uint64_t map_pos;
+   bool map_eof;
 } USERDATA;
 
 
@@ -80,6 +98,7 @@ ALLEGRO_FILE *al_fopen_fd(int fd, const char *mode)
     */
    userdata->fp = NULL;
    userdata->errnum = 0;
+   userdata->map = NULL;
 
    f = al_create_file_handle(&_al_file_interface_stdio, userdata);
    if (!f) {
@@ -99,13 +118,92 @@ ALLEGRO_FILE *al_fopen_fd(int fd, const char *mode)
 }
 
 
+#ifdef USE_MMAP
+/* map_file:
+ *  Map a regular file opened with "m" for reading only into memory.
+ *  Returns NULL if that is not possible, so the caller falls back to stdio.
+ */
+static USERDATA *map_file(const char *path, const char *mode)
+{
+   USERDATA *userdata;
+   struct stat st;
+   void *map;
+   int fd;
+
+   if (!strchr(mode, 'm') ||
+         strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))
+      return NULL;
+
+   fd = open(path, O_RDONLY);
+   if (fd == -1)
+      return NULL;
+
+   if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+         (uint64_t)st.st_size > SIZE_MAX) {
+      close(fd);
+      return NULL;
+   }
+
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return NULL;
+
+   userdata = al_malloc(sizeof(USERDATA));
+   if (!userdata) {
+      munmap(map, st.st_size);
+      return NULL;
+   }
+
+   userdata->fp = NULL;
+   userdata->errnum = 0;
+   userdata->map = map;
+   userdata->map_size = st.st_size;
+   userdata->map_pos = 0;
+   userdata->map_eof = false;
+
+   ALLEGRO_DEBUG("mapped %s (%lu bytes)\n", path, (unsigned long)st.st_size);
+   return userdata;
+}
+#endif
+
+
+/* strip_map_flag:
+ *  Copy the mode without "m", which is ours and not understood by every C
+ *  library.
+ */
+static const char *strip_map_flag(const char *mode, char *buf, size_t size)
+{
+   size_t i = 0;
+
+   if (!strchr(mode, 'm') || strlen(mode) >= size)
+      return mode;
+
+   for (; *mode; mode++) {
+      if (*mode != 'm')
+         buf[i++] = *mode;
+   }
+   buf[i] = '\0';
+   return buf;
+}
+
+
 static void *file_stdio_fopen(const char *path, const char *mode)
 {
    FILE *fp;
    USERDATA *userdata;
+   char mode_buf[16];
 
    ALLEGRO_DEBUG("opening %s %s\n", path, mode);
 
+#ifdef USE_MMAP
+   userdata = map_file(path, mode);
+   if (userdata)
+      return userdata;
+#endif
+
+   mode = strip_map_flag(mode, mode_buf, sizeof(mode_buf));
+
 #ifdef ALLEGRO_WINDOWS
    {
       wchar_t *wpath = _al_win_utf8_to_utf16(path);
@@ -131,6 +229,7 @@ static void *file_stdio_fopen(const char *path, const char *mode)
 
    userdata->fp = fp;
    userdata->errnum = 0;
+   userdata->map = NULL;
 
    return userdata;
 }
@@ -141,6 +240,14 @@ static bool file_stdio_fclose(ALLEGRO_FILE *f)
    USERDATA *userdata = get_userdata(f);
    bool ret;
 
+#ifdef USE_MMAP
+   if (userdata->map) {
+      munmap((void *)userdata->map, userdata->map_size);
+      al_free(userdata);
+      return true;
+   }
+#endif
+
    if (userdata->fp == NULL) {
       /* This can happen in the middle of al_fopen_fd. */
       ret = true;
@@ -163,10 +270,27 @@ static size_t file_stdio_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
 {
    USERDATA *userdata = get_userdata(f);
 
+   if (userdata->map) {
+      size_t avail = (userdata->map_pos < userdata->map_size) ?
+         userdata->map_size - userdata->map_pos : 0;
+      if (size > avail) {
+         size = avail;
+         userdata->map_eof = true;
+      }
+      if (size > 0) {
+         memcpy(ptr, userdata->map + userdata->map_pos, size);
+         userdata->map_pos += size;
+      }
+      return size;
+   }
+
    if (size == 1) {
       /* Optimise common case. */
       int c = fgetc(userdata->fp);
       if (c == EOF) {
+         /* Reaching the end is not an error. */
+         if (!ferror(userdata->fp))
+            return 0;
          userdata->errnum = errno;
          al_set_errno(errno);
          return 0;
@@ -176,7 +300,7 @@ static size_t file_stdio_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
    }
    else {
       size_t ret = fread(ptr, 1, size, userdata->fp);
-      if (ret < size) {
+      if (ret < size && ferror(userdata->fp)) {
          userdata->errnum = errno;
          al_set_errno(errno);
       }
@@ -190,6 +314,12 @@ static size_t file_stdio_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
    USERDATA *userdata = get_userdata(f);
    size_t ret;
 
+   if (userdata->map) {
+      userdata->errnum = EBADF;
+      al_set_errno(EBADF);
+      return 0;
+   }
+
    ret = fwrite(ptr, 1, size, userdata->fp);
    if (ret < size) {
       userdata->errnum = errno;
@@ -204,6 +334,9 @@ static bool file_stdio_fflush(ALLEGRO_FILE *f)
 {
    USERDATA *userdata = get_userdata(f);
 
+   if (userdata->map)
+      return true;
+
    if (fflush(userdata->fp) == EOF) {
       userdata->errnum = errno;
       al_set_errno(errno);
@@ -219,6 +352,9 @@ static int64_t file_stdio_ftell(ALLEGRO_FILE *f)
    USERDATA *userdata = get_userdata(f);
    int64_t ret;
 
+   if (userdata->map)
+      return userdata->map_pos;
+
 #if defined(ALLEGRO_HAVE_FTELLO)
    ret = ftello(userdata->fp);
 #elif defined(ALLEGRO_HAVE_FTELLI64)
@@ -241,6 +377,23 @@ static bool file_stdio_fseek(ALLEGRO_FILE *f, int64_t offset,
    USERDATA *userdata = get_userdata(f);
    int rc;
 
+   if (userdata->map) {
+      int64_t pos = offset;
+      if (whence == ALLEGRO_SEEK_CUR)
+         pos += userdata->map_pos;
+      else if (whence == ALLEGRO_SEEK_END)
+         pos += userdata->map_size;
+      if (pos < 0) {
+         userdata->errnum = EINVAL;
+         al_set_errno(EINVAL);
+         return false;
+      }
+      /* Seeking past the end is allowed, as with stdio. */
+      userdata->map_pos = pos;
+      userdata->map_eof = false;
+      return true;
+   }
+
    switch (whence) {
       case ALLEGRO_SEEK_SET: whence = SEEK_SET; break;
       case ALLEGRO_SEEK_CUR: whence = SEEK_CUR; break;
@@ -269,6 +422,9 @@ static bool file_stdio_feof(ALLEGRO_FILE *f)
 {
    USERDATA *userdata = get_userdata(f);
 
+   if (userdata->map)
+      return userdata->map_eof;
+
    return feof(userdata->fp);
 }
 
@@ -277,6 +433,9 @@ static int file_stdio_ferror(ALLEGRO_FILE *f)
 {
    USERDATA *userdata = get_userdata(f);
 
+   if (userdata->map)
+      return 0;
+
    return ferror(userdata->fp);
 }
 
@@ -317,6 +476,11 @@ static void file_stdio_fclearerr(ALLEGRO_FILE *f)
 {
    USERDATA *userdata = get_userdata(f);
 
+   if (userdata->map) {
+      userdata->map_eof = false;
+      return;
+   }
+
    clearerr(userdata->fp);
 }
 
@@ -326,6 +490,19 @@ static int file_stdio_fungetc(ALLEGRO_FILE *f, int c)
    USERDATA *userdata = get_userdata(f);
    int rc;
 
+   if (userdata->map) {
+      /* The mapping is read-only, so only the byte just read can be pushed
+       * back in place.  Anything else goes into the generic buffer.
+       */
+      userdata->map_eof = false;
+      if (userdata->map_pos > 0 && userdata->map_pos <= userdata->map_size &&
+            userdata->map[userdata->map_pos - 1] == (unsigned char)c) {
+         userdata->map_pos--;
+         return c;
+      }
+      return _al_fungetc_buffered(f, c);
+   }
+
    rc = ungetc(c, userdata->fp);
    if (rc == EOF) {
       userdata->errnum = errno;
@@ -338,9 +515,13 @@ static int file_stdio_fungetc(ALLEGRO_FILE *f, int c)
 
 static off_t file_stdio_fsize(ALLEGRO_FILE *f)
 {
+   USERDATA *userdata = get_userdata(f);
    int64_t old_pos;
    int64_t new_pos;
 
+   if (userdata->map)
+      return userdata->map_size;
+
    old_pos = file_stdio_ftell(f);
    if (old_pos == -1)
       return -1;
@@ -377,6 +558,61 @@ const struct ALLEGRO_FILE_INTERFACE _al_file_interface_stdio =
 };
 
 
+/* _al_file_stdio_borrow:
+ *  Return the mapped contents from the current position onwards, or NULL
+ *  if the file is not mapped.
+ */
+const void *_al_file_stdio_borrow(ALLEGRO_FILE *f, size_t *ret_size)
+{
+   USERDATA *userdata = get_userdata(f);
+
+   if (!userdata->map)
+      return NULL;
+
+   if (userdata->map_pos >= userdata->map_size) {
+      *ret_size = 0;
+      return userdata->map + userdata->map_size;
+   }
+
+   *ret_size = userdata->map_size - userdata->map_pos;
+   return userdata->map + userdata->map_pos;
+}
+
+
+/* _al_file_stdio_is_mapped:
+ *  Returns true if the file is read from a memory mapping.
+ */
+bool _al_file_stdio_is_mapped(ALLEGRO_FILE *f)
+{
+   return get_userdata(f)->map != NULL;
+}
+
+
+/* _al_file_stdio_pread:
+ *  Copy from the mapping at the given offset, leaving the file position
+ *  alone.  This is safe to call from several threads at once.  Returns
+ *  false if the file is not mapped.
+ */
+bool _al_file_stdio_pread(ALLEGRO_FILE *f, int64_t offset, void *ptr,
+   size_t size, size_t *ret_size)
+{
+   USERDATA *userdata = get_userdata(f);
+
+   if (!userdata->map)
+      return false;
+
+   if ((uint64_t)offset >= userdata->map_size)
+      size = 0;
+   else if (size > userdata->map_size - offset)
+      size = userdata->map_size - offset;
+
+   if (size > 0)
+      memcpy(ptr, userdata->map + offset, size);
+   *ret_size = size;
+   return true;
+}
+
+
 /* Function: al_set_standard_file_interface
  */
 void al_set_standard_file_interface(void)
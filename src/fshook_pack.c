@@ -0,0 +1,1099 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      File System Hook and file interface for pack files.
+ *
+ *      See LICENSE.txt for copyright information.
+ *
+ *      A pack file is an archive with an index sorted by name hash at the
+ *      head.  The archive is borrowed whole from a memory-mapped file, or
+ *      read into memory if that is not possible, so opening an entry is a
+ *      hash lookup with no system calls.
+ */
+
+
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_file.h"
+
+ALLEGRO_DEBUG_CHANNEL("fshook")
+
+
+#define PACK_MAGIC         "AL5PACK"   /* plus the terminating NUL */
+#define PACK_VERSION       1
+#define PACK_HEADER_SIZE   24
+#define PACK_RECORD_SIZE   40
+#define PACK_MAX_PATH      1024
+
+enum {
+   PACK_STORED = 0,
+   PACK_LZ4 = 1
+};
+
+typedef struct PACK_ENTRY
+{
+   uint32_t hash;
+   int method;
+   const char *name;             /* NUL-terminated, inside the archive */
+   const unsigned char *data;
+   size_t stored_size;
+   size_t size;
+} PACK_ENTRY;
+
+struct ALLEGRO_PACK
+{
+   ALLEGRO_FILE *fp;             /* keeps the borrowed archive alive */
+   unsigned char *buffer;        /* archive read into memory, if not borrowed */
+   const unsigned char *base;
+   size_t base_size;
+   PACK_ENTRY *entries;          /* sorted by hash, then by name */
+   const PACK_ENTRY **by_name;   /* sorted by name, for directory listing */
+   uint32_t num_entries;
+};
+
+typedef struct PACK_FILE
+{
+   const unsigned char *data;
+   unsigned char *buffer;        /* decompressed entry, or NULL */
+   int64_t size;
+   int64_t pos;
+   bool eof;
+} PACK_FILE;
+
+typedef struct PACK_FS_ENTRY
+{
+   ALLEGRO_FS_ENTRY fs_entry;    /* must be first */
+   char *path;                   /* "/" followed by the normalised name */
+   size_t name_len;
+   const PACK_ENTRY *file;
+   bool is_dir;
+
+   /* For directory listing. */
+   bool is_dir_open;
+   uint32_t dir_pos;
+   const char *last_child;
+   size_t last_child_len;
+} PACK_FS_ENTRY;
+
+/* forward declaration */
+static const ALLEGRO_FS_INTERFACE fs_pack_vtable;
+
+/* The pack served by the interfaces, and the current directory within it
+ * as a normalised name.  Like the PhysFS addon, this is global state.
+ */
+static ALLEGRO_PACK *current_pack = NULL;
+static char pack_cwd[PACK_MAX_PATH] = "";
+
+
+
+static uint32_t get32(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+
+static uint64_t get64(const unsigned char *p)
+{
+   return get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+
+
+/* hash_name:
+ *  32-bit FNV-1a of a normalised entry name.
+ */
+static uint32_t hash_name(const char *name, size_t len)
+{
+   uint32_t h = 2166136261u;
+   size_t i;
+
+   for (i = 0; i < len; i++) {
+      h ^= (unsigned char)name[i];
+      h *= 16777619u;
+   }
+
+   return h;
+}
+
+
+
+/* normalise_path:
+ *  Resolve `path` against the directory `cwd` into `buf`, giving a name
+ *  without a leading slash.  Either separator is accepted and "." and ".."
+ *  components are resolved.  Returns the length of the name, or -1 if the
+ *  path is too long or leaves the root.
+ */
+static int normalise_path(const char *cwd, const char *path, char *buf)
+{
+   const char *p = path;
+   size_t len = 0;
+
+   if (*p != '/' && *p != '\\') {
+      len = strlen(cwd);
+      memcpy(buf, cwd, len);
+   }
+
+   while (*p) {
+      const char *start;
+      size_t n;
+
+      while (*p == '/' || *p == '\\')
+         p++;
+      start = p;
+      while (*p && *p != '/' && *p != '\\')
+         p++;
+      n = p - start;
+
+      if (n == 0 || (n == 1 && start[0] == '.'))
+         continue;
+
+      if (n == 2 && start[0] == '.' && start[1] == '.') {
+         if (len == 0)
+            return -1;
+         while (len > 0 && buf[len - 1] != '/')
+            len--;
+         if (len > 0)
+            len--;
+         continue;
+      }
+
+      if (len + 1 + n >= PACK_MAX_PATH)
+         return -1;
+      if (len > 0)
+         buf[len++] = '/';
+      memcpy(buf + len, start, n);
+      len += n;
+   }
+
+   buf[len] = '\0';
+   return (int)len;
+}
+
+
+
+static const PACK_ENTRY *find_entry(const ALLEGRO_PACK *pack,
+   const char *name, size_t len)
+{
+   uint32_t hash = hash_name(name, len);
+   uint32_t lo = 0;
+   uint32_t hi = pack->num_entries;
+
+   while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (pack->entries[mid].hash < hash)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   for (; lo < pack->num_entries && pack->entries[lo].hash == hash; lo++) {
+      if (strcmp(pack->entries[lo].name, name) == 0)
+         return &pack->entries[lo];
+   }
+
+   return NULL;
+}
+
+
+
+/* first_in_dir:
+ *  Return the position in name order of the first entry whose name starts
+ *  with `prefix`, which is a directory name with a trailing slash, or empty
+ *  for the root.
+ */
+static uint32_t first_in_dir(const ALLEGRO_PACK *pack, const char *prefix)
+{
+   uint32_t lo = 0;
+   uint32_t hi = pack->num_entries;
+
+   while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (strcmp(pack->by_name[mid]->name, prefix) < 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   return lo;
+}
+
+
+
+/* make_dir_prefix:
+ *  Append a slash to a non-empty directory name.  `buf` must hold
+ *  PACK_MAX_PATH + 1 bytes.  Returns -1 if the name is too long.
+ */
+static int make_dir_prefix(char *buf, const char *name, size_t len)
+{
+   if (len >= PACK_MAX_PATH)
+      return -1;
+   memcpy(buf, name, len);
+   if (len > 0)
+      buf[len++] = '/';
+   buf[len] = '\0';
+   return (int)len;
+}
+
+
+
+/* Directories are not stored, they exist by having entries inside them. */
+static bool is_directory(const ALLEGRO_PACK *pack, const char *name,
+   size_t len)
+{
+   char prefix[PACK_MAX_PATH + 1];
+   int plen;
+   uint32_t i;
+
+   if (len == 0)
+      return true;
+
+   plen = make_dir_prefix(prefix, name, len);
+   if (plen < 0)
+      return false;
+   i = first_in_dir(pack, prefix);
+   return i < pack->num_entries &&
+      strncmp(pack->by_name[i]->name, prefix, plen) == 0;
+}
+
+
+
+/* lz4_decompress:
+ *  Decode an LZ4 block, which must fill `dst` exactly.
+ */
+static bool lz4_decompress(const unsigned char *src, size_t src_size,
+   unsigned char *dst, size_t dst_size)
+{
+   const unsigned char *ip = src;
+   const unsigned char *iend = src + src_size;
+   unsigned char *op = dst;
+   unsigned char *oend = dst + dst_size;
+
+   while (ip < iend) {
+      unsigned int token = *ip++;
+      const unsigned char *match;
+      size_t len = token >> 4;
+      size_t offset;
+      unsigned int b;
+
+      if (len == 15) {
+         do {
+            if (ip >= iend)
+               return false;
+            b = *ip++;
+            len += b;
+         } while (b == 255);
+      }
+      if (len > (size_t)(iend - ip) || len > (size_t)(oend - op))
+         return false;
+      memcpy(op, ip, len);
+      op += len;
+      ip += len;
+
+      /* The last sequence has literals only. */
+      if (ip == iend)
+         break;
+
+      if (iend - ip < 2)
+         return false;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (offset == 0 || offset > (size_t)(op - dst))
+         return false;
+
+      len = token & 15;
+      if (len == 15) {
+         do {
+            if (ip >= iend)
+               return false;
+            b = *ip++;
+            len += b;
+         } while (b == 255);
+      }
+      len += 4;
+      if (len > (size_t)(oend - op))
+         return false;
+
+      /* The match may overlap the bytes it produces. */
+      match = op - offset;
+      if (offset >= len) {
+         memcpy(op, match, len);
+         op += len;
+      }
+      else {
+         while (len--)
+            *op++ = *match++;
+      }
+   }
+
+   return op == oend;
+}
+
+
+
+static int compare_names(const void *a, const void *b)
+{
+   const PACK_ENTRY *const *ea = a;
+   const PACK_ENTRY *const *eb = b;
+   return strcmp((*ea)->name, (*eb)->name);
+}
+
+
+
+/* load_index:
+ *  Check the archive and build the in-memory index.
+ */
+static bool load_index(ALLEGRO_PACK *pack)
+{
+   const unsigned char *p = pack->base;
+   const char *names;
+   uint32_t n, names_size, i;
+   size_t index_end;
+
+   if (pack->base_size < PACK_HEADER_SIZE ||
+         memcmp(p, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0) {
+      ALLEGRO_ERROR("Not a pack file.\n");
+      return false;
+   }
+   if (get32(p + 8) != PACK_VERSION) {
+      ALLEGRO_ERROR("Unsupported pack file version %u.\n", get32(p + 8));
+      return false;
+   }
+
+   n = get32(p + 12);
+   names_size = get32(p + 16);
+   if ((pack->base_size - PACK_HEADER_SIZE) / PACK_RECORD_SIZE < n)
+      goto corrupt;
+   index_end = PACK_HEADER_SIZE + (size_t)n * PACK_RECORD_SIZE;
+   if (pack->base_size - index_end < names_size)
+      goto corrupt;
+   names = (const char *)p + index_end;
+
+   pack->entries = al_malloc((n ? n : 1) * sizeof(PACK_ENTRY));
+   pack->by_name = al_malloc((n ? n : 1) * sizeof(PACK_ENTRY *));
+   if (!pack->entries || !pack->by_name)
+      return false;
+   pack->num_entries = n;
+
+   for (i = 0; i < n; i++) {
+      const unsigned char *r = p + PACK_HEADER_SIZE + i * PACK_RECORD_SIZE;
+      PACK_ENTRY *e = &pack->entries[i];
+      uint32_t name_offset = get32(r + 8);
+      uint32_t name_size = get32(r + 12);
+      uint64_t offset = get64(r + 16);
+      uint64_t stored_size = get64(r + 24);
+      uint64_t size = get64(r + 32);
+
+      if (name_offset >= names_size || names_size - name_offset <= name_size ||
+            names[name_offset + name_size] != '\0')
+         goto corrupt;
+      /* Directory listing copies names into PACK_MAX_PATH sized buffers. */
+      if (name_size >= PACK_MAX_PATH - 1)
+         goto corrupt;
+      if (offset > pack->base_size || stored_size > pack->base_size - offset)
+         goto corrupt;
+
+      e->hash = get32(r);
+      e->method = get32(r + 4);
+      e->name = names + name_offset;
+      e->data = p + offset;
+      e->stored_size = stored_size;
+      e->size = size;
+
+      if (e->size != size)
+         goto corrupt;
+      if (e->method == PACK_STORED && size != stored_size)
+         goto corrupt;
+      if (e->method != PACK_STORED && e->method != PACK_LZ4)
+         goto corrupt;
+      if (e->hash != hash_name(e->name, name_size))
+         goto corrupt;
+      if (i > 0 && e->hash < e[-1].hash)
+         goto corrupt;
+
+      pack->by_name[i] = e;
+   }
+
+   qsort(pack->by_name, n, sizeof(PACK_ENTRY *), compare_names);
+
+   ALLEGRO_DEBUG("Loaded pack index with %u entries.\n", n);
+   return true;
+
+corrupt:
+   ALLEGRO_ERROR("Corrupt pack file index.\n");
+   return false;
+}
+
+
+
+/* Function: al_open_pack
+ */
+ALLEGRO_PACK *al_open_pack(const char *filename)
+{
+   ALLEGRO_PACK *pack;
+   ALLEGRO_FILE *fp;
+   const void *base;
+   size_t size;
+   int64_t fsize;
+
+   ASSERT(filename);
+
+   fp = _al_fopen_mapped(filename);
+   if (!fp)
+      return NULL;
+
+   pack = al_calloc(1, sizeof(*pack));
+   if (!pack) {
+      al_fclose(fp);
+      return NULL;
+   }
+
+   base = al_fborrow(fp, &size);
+   if (base) {
+      pack->fp = fp;
+   }
+   else {
+      fsize = al_fsize(fp);
+      if (fsize < 0 || (size_t)fsize != (uint64_t)fsize) {
+         al_fclose(fp);
+         al_free(pack);
+         return NULL;
+      }
+      size = fsize;
+      pack->buffer = al_malloc(size ? size : 1);
+      if (!pack->buffer || al_fread(fp, pack->buffer, size) != size) {
+         ALLEGRO_ERROR("Could not read pack file %s.\n", filename);
+         al_fclose(fp);
+         al_free(pack->buffer);
+         al_free(pack);
+         return NULL;
+      }
+      al_fclose(fp);
+      base = pack->buffer;
+   }
+
+   pack->base = base;
+   pack->base_size = size;
+
+   if (!load_index(pack)) {
+      al_close_pack(pack);
+      return NULL;
+   }
+
+   return pack;
+}
+
+
+
+/* Function: al_close_pack
+ */
+void al_close_pack(ALLEGRO_PACK *pack)
+{
+   if (!pack)
+      return;
+
+   if (current_pack == pack)
+      current_pack = NULL;
+
+   al_free(pack->entries);
+   al_free(pack->by_name);
+   al_free(pack->buffer);
+   if (pack->fp)
+      al_fclose(pack->fp);
+   al_free(pack);
+}
+
+
+
+static PACK_FILE *open_entry(const PACK_ENTRY *entry)
+{
+   PACK_FILE *pf = al_malloc(sizeof(*pf));
+
+   if (!pf) {
+      al_set_errno(ENOMEM);
+      return NULL;
+   }
+
+   pf->data = entry->data;
+   pf->buffer = NULL;
+   pf->size = entry->size;
+   pf->pos = 0;
+   pf->eof = false;
+
+   if (entry->method == PACK_LZ4) {
+      pf->buffer = al_malloc(entry->size ? entry->size : 1);
+      if (!pf->buffer) {
+         al_set_errno(ENOMEM);
+         al_free(pf);
+         return NULL;
+      }
+      if (!lz4_decompress(entry->data, entry->stored_size, pf->buffer,
+            entry->size)) {
+         ALLEGRO_ERROR("Corrupt pack entry %s.\n", entry->name);
+         al_set_errno(EINVAL);
+         al_free(pf->buffer);
+         al_free(pf);
+         return NULL;
+      }
+      pf->data = pf->buffer;
+   }
+
+   return pf;
+}
+
+
+
+static void *file_pack_fopen(const char *path, const char *mode)
+{
+   char name[PACK_MAX_PATH];
+   const PACK_ENTRY *entry;
+   int len;
+
+   if (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+')) {
+      al_set_errno(EACCES);
+      return NULL;
+   }
+
+   if (!current_pack || (len = normalise_path(pack_cwd, path, name)) < 0) {
+      al_set_errno(ENOENT);
+      return NULL;
+   }
+
+   entry = find_entry(current_pack, name, len);
+   if (!entry) {
+      al_set_errno(ENOENT);
+      return NULL;
+   }
+
+   return open_entry(entry);
+}
+
+
+
+static bool file_pack_fclose(ALLEGRO_FILE *f)
+{
+   PACK_FILE *pf = al_get_file_userdata(f);
+
+   al_free(pf->buffer);
+   al_free(pf);
+   return true;
+}
+
+
+
+static size_t file_pack_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   PACK_FILE *pf = al_get_file_userdata(f);
+   size_t n = 0;
+
+   if (pf->pos < pf->size)
+      n = pf->size - pf->pos;
+   if (n > size)
+      n = size;
+   else if (n < size)
+      pf->eof = true;
+
+   memcpy(ptr, pf->data + pf->pos, n);
+   pf->pos += n;
+   return n;
+}
+
+
+
+static size_t file_pack_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
+{
+   (void)f;
+   (void)ptr;
+   (void)size;
+
+   al_set_errno(EACCES);
+   return 0;
+}
+
+
+
+static bool file_pack_fflush(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return true;
+}
+
+
+
+static int64_t file_pack_ftell(ALLEGRO_FILE *f)
+{
+   PACK_FILE *pf = al_get_file_userdata(f);
+   return pf->pos;
+}
+
+
+
+static bool file_pack_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
+{
+   PACK_FILE *pf = al_get_file_userdata(f);
+   int64_t pos;
+
+   switch (whence) {
+      case ALLEGRO_SEEK_SET:
+         pos = offset;
+         break;
+      case ALLEGRO_SEEK_CUR:
+         pos = pf->pos + offset;
+         break;
+      case ALLEGRO_SEEK_END:
+         pos = pf->size + offset;
+         break;
+      default:
+         return false;
+   }
+
+   if (pos < 0)
+      return false;
+   if (pos > pf->size)
+      pos = pf->size;
+
+   pf->pos = pos;
+   pf->eof = false;
+   return true;
+}
+
+
+
+static bool file_pack_feof(ALLEGRO_FILE *f)
+{
+   PACK_FILE *pf = al_get_file_userdata(f);
+   return pf->eof;
+}
+
+
+
+static int file_pack_ferror(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return 0;
+}
+
+
+
+static const char *file_pack_ferrmsg(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return "";
+}
+
+
+
+static void file_pack_fclearerr(ALLEGRO_FILE *f)
+{
+   PACK_FILE *pf = al_get_file_userdata(f);
+   pf->eof = false;
+}
+
+
+
+static off_t file_pack_fsize(ALLEGRO_FILE *f)
+{
+   PACK_FILE *pf = al_get_file_userdata(f);
+   return pf->size;
+}
+
+
+
+/* _al_file_pack_borrow:
+ *  Return the entry's contents from the current position onwards.
+ */
+const void *_al_file_pack_borrow(ALLEGRO_FILE *f, size_t *ret_size)
+{
+   PACK_FILE *pf = al_get_file_userdata(f);
+
+   *ret_size = pf->size - pf->pos;
+   return pf->data + pf->pos;
+}
+
+
+
+const ALLEGRO_FILE_INTERFACE _al_file_interface_pack =
+{
+   file_pack_fopen,
+   file_pack_fclose,
+   file_pack_fread,
+   file_pack_fwrite,
+   file_pack_fflush,
+   file_pack_ftell,
+   file_pack_fseek,
+   file_pack_feof,
+   file_pack_ferror,
+   file_pack_ferrmsg,
+   file_pack_fclearerr,
+   NULL,  /* ungetc */
+   file_pack_fsize
+};
+
+
+
+/* Function: al_open_pack_entry
+ */
+ALLEGRO_FILE *al_open_pack_entry(ALLEGRO_PACK *pack, const char *name)
+{
+   char buf[PACK_MAX_PATH];
+   const PACK_ENTRY *entry;
+   PACK_FILE *pf;
+   ALLEGRO_FILE *f;
+   int len;
+
+   ASSERT(pack);
+   ASSERT(name);
+
+   len = normalise_path("", name, buf);
+   if (len < 0 || !(entry = find_entry(pack, buf, len))) {
+      al_set_errno(ENOENT);
+      return NULL;
+   }
+
+   pf = open_entry(entry);
+   if (!pf)
+      return NULL;
+
+   f = al_create_file_handle(&_al_file_interface_pack, pf);
+   if (!f) {
+      al_free(pf->buffer);
+      al_free(pf);
+      return NULL;
+   }
+
+   _al_set_file_read_ahead(f, true);
+   return f;
+}
+
+
+
+static bool fs_pack_update_entry(ALLEGRO_FS_ENTRY *fse)
+{
+   PACK_FS_ENTRY *e = (PACK_FS_ENTRY *)fse;
+
+   e->file = NULL;
+   e->is_dir = false;
+
+   if (!current_pack)
+      return false;
+
+   e->file = find_entry(current_pack, e->path + 1, e->name_len);
+   if (!e->file)
+      e->is_dir = is_directory(current_pack, e->path + 1, e->name_len);
+   return true;
+}
+
+
+
+/* create_entry:
+ *  Create an entry for a normalised name.
+ */
+static ALLEGRO_FS_ENTRY *create_entry(const char *name, size_t len)
+{
+   PACK_FS_ENTRY *e;
+
+   if (len >= PACK_MAX_PATH) {
+      al_set_errno(ENAMETOOLONG);
+      return NULL;
+   }
+
+   e = al_calloc(1, sizeof(*e));
+   if (!e)
+      return NULL;
+
+   e->path = al_malloc(len + 2);
+   if (!e->path) {
+      al_free(e);
+      return NULL;
+   }
+   e->path[0] = '/';
+   memcpy(e->path + 1, name, len);
+   e->path[len + 1] = '\0';
+   e->name_len = len;
+   e->fs_entry.vtable = &fs_pack_vtable;
+
+   fs_pack_update_entry(&e->fs_entry);
+   return &e->fs_entry;
+}
+
+
+
+static ALLEGRO_FS_ENTRY *fs_pack_create_entry(const char *path)
+{
+   char name[PACK_MAX_PATH];
+   int len = normalise_path(pack_cwd, path, name);
+
+   if (len < 0) {
+      al_set_errno(ENOENT);
+      return NULL;
+   }
+
+   return create_entry(name, len);
+}
+
+
+
+static bool fs_pack_close_directory(ALLEGRO_FS_ENTRY *fse)
+{
+   PACK_FS_ENTRY *e = (PACK_FS_ENTRY *)fse;
+
+   e->is_dir_open = false;
+   return true;
+}
+
+
+
+static void fs_pack_destroy_entry(ALLEGRO_FS_ENTRY *fse)
+{
+   PACK_FS_ENTRY *e = (PACK_FS_ENTRY *)fse;
+
+   if (e->is_dir_open)
+      fs_pack_close_directory(fse);
+   al_free(e->path);
+   al_free(e);
+}
+
+
+
+static const char *fs_pack_entry_name(ALLEGRO_FS_ENTRY *fse)
+{
+   PACK_FS_ENTRY *e = (PACK_FS_ENTRY *)fse;
+   return e->path;
+}
+
+
+
+static uint32_t fs_pack_entry_mode(ALLEGRO_FS_ENTRY *fse)
+{
+   PACK_FS_ENTRY *e = (PACK_FS_ENTRY *)fse;
+
+   if (e->file)
+      return ALLEGRO_FILEMODE_READ | ALLEGRO_FILEMODE_ISFILE;
+   if (e->is_dir)
+      return ALLEGRO_FILEMODE_READ | ALLEGRO_FILEMODE_EXECUTE |
+         ALLEGRO_FILEMODE_ISDIR;
+   return 0;
+}
+
+
+
+static time_t fs_pack_entry_time(ALLEGRO_FS_ENTRY *fse)
+{
+   /* Pack files do not store times. */
+   (void)fse;
+   return 0;
+}
+
+
+
+static off_t fs_pack_entry_size(ALLEGRO_FS_ENTRY *fse)
+{
+   PACK_FS_ENTRY *e = (PACK_FS_ENTRY *)fse;
+   return e->file ? (off_t)e->file->size : 0;
+}
+
+
+
+static bool fs_pack_entry_exists(ALLEGRO_FS_ENTRY *fse)
+{
+   PACK_FS_ENTRY *e = (PACK_FS_ENTRY *)fse;
+   return e->file || e->is_dir;
+}
+
+
+
+static bool fs_pack_remove_entry(ALLEGRO_FS_ENTRY *fse)
+{
+   (void)fse;
+   al_set_errno(EACCES);
+   return false;
+}
+
+
+
+static bool fs_pack_open_directory(ALLEGRO_FS_ENTRY *fse)
+{
+   PACK_FS_ENTRY *e = (PACK_FS_ENTRY *)fse;
+   char prefix[PACK_MAX_PATH + 1];
+
+   if (!e->is_dir || !current_pack)
+      return false;
+
+   if (make_dir_prefix(prefix, e->path + 1, e->name_len) < 0)
+      return false;
+   e->dir_pos = first_in_dir(current_pack, prefix);
+   e->last_child = NULL;
+   e->last_child_len = 0;
+   e->is_dir_open = true;
+   return true;
+}
+
+
+
+static ALLEGRO_FS_ENTRY *fs_pack_read_directory(ALLEGRO_FS_ENTRY *fse)
+{
+   PACK_FS_ENTRY *e = (PACK_FS_ENTRY *)fse;
+   char prefix[PACK_MAX_PATH + 1];
+   int plen;
+
+   if (!e->is_dir_open || !current_pack)
+      return NULL;
+
+   plen = make_dir_prefix(prefix, e->path + 1, e->name_len);
+   if (plen < 0)
+      return NULL;
+
+   /* The entries inside the directory are contiguous in name order, and so
+    * are the entries inside each subdirectory, which is listed once.
+    */
+   while (e->dir_pos < current_pack->num_entries) {
+      const char *name = current_pack->by_name[e->dir_pos]->name;
+      const char *child;
+      const char *slash;
+      size_t clen;
+
+      if (strncmp(name, prefix, plen) != 0)
+         break;
+      e->dir_pos++;
+
+      child = name + plen;
+      slash = strchr(child, '/');
+      clen = slash ? (size_t)(slash - child) : strlen(child);
+
+      if (e->last_child && clen == e->last_child_len &&
+            memcmp(child, e->last_child, clen) == 0)
+         continue;
+
+      e->last_child = child;
+      e->last_child_len = clen;
+      return create_entry(name, plen + clen);
+   }
+
+   return NULL;
+}
+
+
+
+static bool fs_pack_filename_exists(const char *path)
+{
+   char name[PACK_MAX_PATH];
+   int len = normalise_path(pack_cwd, path, name);
+
+   if (len < 0 || !current_pack)
+      return false;
+
+   return find_entry(current_pack, name, len) ||
+      is_directory(current_pack, name, len);
+}
+
+
+
+static bool fs_pack_remove_filename(const char *path)
+{
+   (void)path;
+   al_set_errno(EACCES);
+   return false;
+}
+
+
+
+static char *fs_pack_get_current_directory(void)
+{
+   size_t len = strlen(pack_cwd);
+   char *s = al_malloc(len + 2);
+
+   if (s) {
+      s[0] = '/';
+      memcpy(s + 1, pack_cwd, len + 1);
+   }
+   return s;
+}
+
+
+
+static bool fs_pack_change_directory(const char *path)
+{
+   char name[PACK_MAX_PATH];
+   int len = normalise_path(pack_cwd, path, name);
+
+   if (len < 0 || !current_pack || !is_directory(current_pack, name, len))
+      return false;
+
+   memcpy(pack_cwd, name, len + 1);
+   return true;
+}
+
+
+
+static bool fs_pack_make_directory(const char *path)
+{
+   (void)path;
+   al_set_errno(EACCES);
+   return false;
+}
+
+
+
+static ALLEGRO_FILE *fs_pack_open_file(ALLEGRO_FS_ENTRY *fse, const char *mode)
+{
+   return al_fopen_interface(&_al_file_interface_pack,
+      fs_pack_entry_name(fse), mode);
+}
+
+
+
+static const ALLEGRO_FS_INTERFACE fs_pack_vtable =
+{
+   fs_pack_create_entry,
+   fs_pack_destroy_entry,
+   fs_pack_entry_name,
+   fs_pack_update_entry,
+   fs_pack_entry_mode,
+   fs_pack_entry_time,
+   fs_pack_entry_time,
+   fs_pack_entry_time,
+   fs_pack_entry_size,
+   fs_pack_entry_exists,
+   fs_pack_remove_entry,
+
+   fs_pack_open_directory,
+   fs_pack_read_directory,
+   fs_pack_close_directory,
+
+   fs_pack_filename_exists,
+   fs_pack_remove_filename,
+   fs_pack_get_current_directory,
+   fs_pack_change_directory,
+   fs_pack_make_directory,
+
+   fs_pack_open_file
+};
+
+
+
+/* Function: al_set_pack_file_interface
+ */
+void al_set_pack_file_interface(ALLEGRO_PACK *pack)
+{
+   ASSERT(pack);
+
+   if (current_pack != pack) {
+      current_pack = pack;
+      pack_cwd[0] = '\0';
+   }
+
+   al_set_new_file_interface(&_al_file_interface_pack);
+   al_set_fs_interface(&fs_pack_vtable);
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -55,6 +55,11 @@ ALLEGRO_DEBUG_CHANNEL("fshook")
    #include <sys/stat.h>
 #endif
 
+#include <fcntl.h>
+#ifdef ALLEGRO_WINDOWS
+   #include <io.h>
+#endif
+
 #ifdef ALLEGRO_HAVE_DIRENT_H
    #include <sys/types.h>
    #include <dirent.h>
@@ -464,6 +469,207 @@ static ALLEGRO_FS_ENTRY *fs_stdio_read_directory(ALLEGRO_FS_ENTRY *fp)
 }
 
 
+/* _al_fs_stdio_read_names:
+ *  Call proc for each name in the directory, without creating entries.
+ *  The mode is ALLEGRO_FILEMODE_ISDIR or ALLEGRO_FILEMODE_ISFILE where
+ *  readdir tells the type, and 0 where it takes a stat to find out.
+ *  is_link is only set where readdir says so.
+ */
+bool _al_fs_stdio_read_names(const char *path,
+   bool (*proc)(const char *name, uint32_t mode, bool is_link, void *arg),
+   void *arg)
+{
+   WRAP_DIR_TYPE *dir;
+   WRAP_DIRENT_TYPE *ent;
+   bool ok = true;
+#ifdef ALLEGRO_WINDOWS
+   wchar_t *wpath = _al_win_utf8_to_utf16(path);
+   if (!wpath)
+      return false;
+   dir = WRAP_OPENDIR(wpath);
+   al_free(wpath);
+#else
+   dir = WRAP_OPENDIR(path);
+#endif
+   if (!dir) {
+      al_set_errno(errno);
+      return false;
+   }
+
+   while (ok && (ent = WRAP_READDIR(dir))) {
+      uint32_t mode = 0;
+      bool is_link = false;
+
+      if (0 == WRAP_STRCMP(ent->d_name, WRAP_LIT("."))
+            || 0 == WRAP_STRCMP(ent->d_name, WRAP_LIT("..")))
+         continue;
+
+#if defined(_DIRENT_HAVE_D_TYPE) || defined(ALLEGRO_MACOSX) || \
+      defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+      /* The type of a symbolic link is that of its target, like stat. */
+      if (ent->d_type == DT_DIR)
+         mode = ALLEGRO_FILEMODE_ISDIR;
+      else if (ent->d_type == DT_LNK)
+         is_link = true;
+      else if (ent->d_type != DT_UNKNOWN)
+         mode = ALLEGRO_FILEMODE_ISFILE;
+#endif
+
+#ifdef ALLEGRO_WINDOWS
+      {
+         char *name = _al_win_utf16_to_utf8(ent->d_name);
+         if (!name) {
+            ok = false;
+            break;
+         }
+         ok = proc(name, mode, is_link, arg);
+         al_free(name);
+      }
+#else
+      ok = proc(ent->d_name, mode, is_link, arg);
+#endif
+   }
+
+   WRAP_CLOSEDIR(dir);
+   return ok;
+}
+
+
+/* _al_fs_stdio_stat:
+ *  Stat a path without creating an entry.  Returns false if it failed.
+ */
+bool _al_fs_stdio_stat(const char *path, uint32_t *mode, off_t *size,
+   time_t *mtime)
+{
+   ALLEGRO_FS_ENTRY_STDIO tmp;
+   int ret;
+
+   memset(&tmp, 0, sizeof(tmp));
+#ifdef ALLEGRO_WINDOWS
+   tmp.abs_path = _al_win_utf8_to_utf16(path);
+   if (!tmp.abs_path)
+      return false;
+#else
+   tmp.abs_path = (char *)path;
+#endif
+
+   ret = WRAP_STAT(tmp.abs_path, &tmp.st);
+   if (ret == 0)
+      fs_update_stat_mode(&tmp);
+
+#ifdef ALLEGRO_WINDOWS
+   al_free(tmp.abs_path);
+#endif
+
+   if (ret == -1) {
+      al_set_errno(errno);
+      return false;
+   }
+
+   *mode = tmp.stat_mode;
+   *size = tmp.st.st_size;
+   *mtime = tmp.st.st_mtime;
+   return true;
+}
+
+
+/* open_exclusive:
+ *  Create a file for writing, failing with EEXIST if it is already there.
+ */
+static int open_exclusive(const char *path)
+{
+#ifdef ALLEGRO_WINDOWS
+   wchar_t *wpath = _al_win_utf8_to_utf16(path);
+   int fd = -1;
+
+   if (wpath) {
+      fd = _wopen(wpath, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY,
+         _S_IREAD | _S_IWRITE);
+      al_free(wpath);
+   }
+   return fd;
+#else
+   return open(path, O_WRONLY | O_CREAT | O_EXCL, 0666);
+#endif
+}
+
+
+/* _al_fs_stdio_create_temp:
+ *  Create a file next to `path', to be written and then moved over `path'
+ *  with _al_fs_stdio_commit_temp, so that readers never see a partly
+ *  written file.  Its name is stored in `tmp_path'.
+ */
+ALLEGRO_FILE *_al_fs_stdio_create_temp(const char *path,
+   ALLEGRO_USTR *tmp_path)
+{
+   static unsigned int counter = 0;
+   uint32_t r = (uint32_t)time(NULL) ^ (uint32_t)(uintptr_t)tmp_path;
+   ALLEGRO_FILE *file;
+   int fd;
+   int i;
+
+   /* The file is created exclusively, so the temporary file of another
+    * writer is never clobbered; pick another name instead.
+    */
+   for (i = 0; i < 3; i++) {
+      r = r * 1103515245u + 12345u + counter++;
+      al_ustr_truncate(tmp_path, 0);
+      al_ustr_appendf(tmp_path, "%s.%08x.tmp", path, r);
+
+      fd = open_exclusive(al_cstr(tmp_path));
+      if (fd == -1) {
+         al_set_errno(errno);
+         if (errno == EEXIST)
+            continue;
+         return NULL;
+      }
+
+      file = al_fopen_fd(fd, "wb");
+      if (!file) {
+         close(fd);
+         _al_fs_stdio_commit_temp(al_cstr(tmp_path), path, false);
+         return NULL;
+      }
+      return file;
+   }
+
+   return NULL;
+}
+
+
+/* _al_fs_stdio_commit_temp:
+ *  Move a file from _al_fs_stdio_create_temp over `path' if `keep' is set,
+ *  replacing what was there.  Otherwise, or if that fails, the temporary
+ *  file is removed.
+ */
+bool _al_fs_stdio_commit_temp(const char *tmp_path, const char *path,
+   bool keep)
+{
+#ifdef ALLEGRO_WINDOWS
+   wchar_t *wtmp = _al_win_utf8_to_utf16(tmp_path);
+   wchar_t *wpath = _al_win_utf8_to_utf16(path);
+
+   if (keep) {
+      keep = wtmp && wpath &&
+         MoveFileExW(wtmp, wpath, MOVEFILE_REPLACE_EXISTING);
+   }
+   if (!keep && wtmp)
+      WRAP_UNLINK(wtmp);
+   al_free(wtmp);
+   al_free(wpath);
+#else
+   if (keep && rename(tmp_path, path) != 0) {
+      al_set_errno(errno);
+      keep = false;
+   }
+   if (!keep)
+      WRAP_UNLINK(tmp_path);
+#endif
+
+   return keep;
+}
+
+
 static void fs_stdio_destroy_entry(ALLEGRO_FS_ENTRY *fh_)
 {
    ALLEGRO_FS_ENTRY_STDIO *fh = (ALLEGRO_FS_ENTRY_STDIO *) fh_;
@@ -0,0 +1,493 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Recursive directory walks.
+ *
+ *      See LICENSE.txt for copyright information.
+ *
+ *      With the standard file system interface, directories are listed
+ *      without creating an ALLEGRO_FS_ENTRY per file, types come from
+ *      readdir where possible, and the remaining stat calls are spread
+ *      over the worker pool a batch at a time.  Other interfaces are
+ *      walked through their entries.
+ */
+
+
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_fshook.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("fshook")
+
+
+#define WALK_BATCH_SIZE    256
+#define STAT_CHUNK_SIZE    32
+#define NUM_STAT_CHUNKS    (WALK_BATCH_SIZE / STAT_CHUNK_SIZE)
+
+typedef struct WALK WALK;
+
+typedef struct STAT_CHUNK
+{
+   WALK *walk;
+   int start;
+   int end;
+} STAT_CHUNK;
+
+struct WALK
+{
+   const char *patterns;
+   int flags;
+   int (*callback)(const ALLEGRO_FS_WALK_ENTRY *entries, int count,
+      void *extra);
+   void *extra;
+   size_t root_len;
+
+   /* The current batch.  Paths are owned by the batch. */
+   ALLEGRO_FS_WALK_ENTRY entries[WALK_BATCH_SIZE];
+   bool needs_stat[WALK_BATCH_SIZE];
+   bool stat_failed[WALK_BATCH_SIZE];
+   int count;
+
+   ALLEGRO_TASK_GROUP *group;
+   STAT_CHUNK chunks[NUM_STAT_CHUNKS];
+};
+
+typedef struct NAME_ITEM
+{
+   char *name;
+   uint32_t mode;
+   bool is_link;
+} NAME_ITEM;
+
+
+
+static bool is_path_sep(char c)
+{
+   return c == '/' || c == ALLEGRO_NATIVE_PATH_SEP;
+}
+
+
+
+static int ascii_tolower(int c)
+{
+   return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+
+
+/* match_glob:
+ *  Match name against the pattern [p, pe).  '*' matches any run of
+ *  characters, '?' a single character, and letters match either case.
+ */
+static bool match_glob(const char *p, const char *pe, const char *name)
+{
+   const char *star = NULL;
+   const char *star_name = NULL;
+   const unsigned char *s = (const unsigned char *)name;
+
+   while (*s) {
+      if (p < pe && *p == '?') {
+         p++;
+         /* Skip a whole UTF-8 sequence. */
+         s++;
+         while ((*s & 0xC0) == 0x80)
+            s++;
+      }
+      else if (p < pe && *p != '*' &&
+            ascii_tolower((unsigned char)*p) == ascii_tolower(*s)) {
+         p++;
+         s++;
+      }
+      else if (p < pe && *p == '*') {
+         star = ++p;
+         star_name = (const char *)s;
+      }
+      else if (star) {
+         p = star;
+         s = (const unsigned char *)++star_name;
+      }
+      else {
+         return false;
+      }
+   }
+
+   while (p < pe && *p == '*')
+      p++;
+   return p == pe;
+}
+
+
+
+static bool match_patterns(const char *patterns, const char *name)
+{
+   const char *p = patterns;
+
+   if (!patterns || !*patterns)
+      return true;
+
+   for (;;) {
+      const char *end = strchr(p, ';');
+      if (!end)
+         return match_glob(p, p + strlen(p), name);
+      if (match_glob(p, end, name))
+         return true;
+      p = end + 1;
+   }
+}
+
+
+
+static void stat_entry(WALK *walk, int i)
+{
+   ALLEGRO_FS_WALK_ENTRY *e = &walk->entries[i];
+
+   if (!walk->needs_stat[i])
+      return;
+   walk->stat_failed[i] = !_al_fs_stdio_stat(e->path, &e->mode, &e->size,
+      &e->mtime);
+}
+
+
+
+static void stat_chunk_proc(void *arg)
+{
+   STAT_CHUNK *chunk = arg;
+   int i;
+
+   for (i = chunk->start; i < chunk->end; i++)
+      stat_entry(chunk->walk, i);
+}
+
+
+
+static void stat_batch(WALK *walk)
+{
+   int num_chunks = (walk->count + STAT_CHUNK_SIZE - 1) / STAT_CHUNK_SIZE;
+   int i;
+
+   for (i = 0; i < num_chunks; i++) {
+      STAT_CHUNK *chunk = &walk->chunks[i];
+      chunk->walk = walk;
+      chunk->start = i * STAT_CHUNK_SIZE;
+      chunk->end = _ALLEGRO_MIN(walk->count, chunk->start + STAT_CHUNK_SIZE);
+
+      /* The calling thread takes the last chunk itself. */
+      if (i == num_chunks - 1 || !walk->group ||
+            !al_run_task(walk->group, stat_chunk_proc, chunk)) {
+         stat_chunk_proc(chunk);
+      }
+   }
+
+   if (walk->group)
+      al_wait_task_group(walk->group);
+}
+
+
+
+static void free_batch(WALK *walk)
+{
+   int i;
+
+   for (i = 0; i < walk->count; i++)
+      al_free((char *)walk->entries[i].path);
+   walk->count = 0;
+}
+
+
+
+/* flush_batch:
+ *  Finish the metadata of the current batch and pass it to the callback.
+ */
+static int flush_batch(WALK *walk)
+{
+   int result;
+   int i, n;
+
+   if (walk->count == 0)
+      return ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+
+   if (walk->flags & ALLEGRO_FS_WALK_STAT)
+      stat_batch(walk);
+
+   /* Drop files which disappeared since the directory was read. */
+   for (i = n = 0; i < walk->count; i++) {
+      if (walk->stat_failed[i]) {
+         al_free((char *)walk->entries[i].path);
+         continue;
+      }
+      walk->entries[n++] = walk->entries[i];
+   }
+   walk->count = n;
+
+   result = ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+   if (n > 0)
+      result = walk->callback(walk->entries, n, walk->extra);
+   free_batch(walk);
+
+   if (result == ALLEGRO_FOR_EACH_FS_ENTRY_SKIP)
+      result = ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+   return result;
+}
+
+
+
+static int add_entry(WALK *walk, const char *path, uint32_t mode, off_t size,
+   time_t mtime, bool needs_stat)
+{
+   ALLEGRO_FS_WALK_ENTRY *e;
+   char *copy;
+   size_t len = strlen(path);
+
+   copy = al_malloc(len + 1);
+   if (!copy) {
+      al_set_errno(ENOMEM);
+      return ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+   }
+   memcpy(copy, path, len + 1);
+
+   if (!(walk->flags & ALLEGRO_FS_WALK_STAT)) {
+      mode &= ALLEGRO_FILEMODE_ISDIR | ALLEGRO_FILEMODE_ISFILE;
+      size = 0;
+      mtime = 0;
+   }
+
+   e = &walk->entries[walk->count];
+   e->path = copy;
+   e->name = copy + _ALLEGRO_MIN(walk->root_len, len);
+   e->mode = mode;
+   e->size = size;
+   e->mtime = mtime;
+   walk->needs_stat[walk->count] = needs_stat;
+   walk->stat_failed[walk->count] = false;
+   walk->count++;
+
+   if (walk->count == WALK_BATCH_SIZE)
+      return flush_batch(walk);
+   return ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+}
+
+
+
+static bool wanted(WALK *walk, const char *name, uint32_t mode)
+{
+   if ((mode & ALLEGRO_FILEMODE_ISDIR) &&
+         !(walk->flags & ALLEGRO_FS_WALK_DIRECTORIES))
+      return false;
+   return match_patterns(walk->patterns, name);
+}
+
+
+
+static bool collect_name(const char *name, uint32_t mode, bool is_link,
+   void *arg)
+{
+   _AL_VECTOR *names = arg;
+   NAME_ITEM *item;
+   size_t len = strlen(name);
+
+   item = _al_vector_alloc_back(names);
+   if (!item)
+      return false;
+   item->name = al_malloc(len + 1);
+   if (!item->name) {
+      _al_vector_delete_at(names, _al_vector_size(names) - 1);
+      return false;
+   }
+   memcpy(item->name, name, len + 1);
+   item->mode = mode;
+   item->is_link = is_link;
+   return true;
+}
+
+
+
+/* walk_stdio_dir:
+ *  Walk the directory at path, which is restored before returning.  The
+ *  names are read up front so that only one directory is open at a time.
+ */
+static int walk_stdio_dir(WALK *walk, ALLEGRO_USTR *path)
+{
+   _AL_VECTOR names = _AL_VECTOR_INITIALIZER(NAME_ITEM);
+   size_t path_len = al_ustr_size(path);
+   int result = ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+   unsigned i;
+
+   if (!_al_fs_stdio_read_names(path_len ? al_cstr(path) : ".",
+         collect_name, &names)) {
+      result = ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+   }
+
+   for (i = 0; i < _al_vector_size(&names); i++) {
+      NAME_ITEM *item = _al_vector_ref(&names, i);
+      uint32_t mode = item->mode;
+      off_t size = 0;
+      time_t mtime = 0;
+      bool have_stat = false;
+
+      if (result != ALLEGRO_FOR_EACH_FS_ENTRY_OK)
+         goto next;
+
+      al_ustr_truncate(path, path_len);
+      if (path_len > 0 && !is_path_sep(al_cstr(path)[path_len - 1]))
+         al_ustr_append_chr(path, ALLEGRO_NATIVE_PATH_SEP);
+      al_ustr_append_cstr(path, item->name);
+
+      /* Symbolic links have to be resolved to tell directories apart. */
+      if (mode == 0) {
+         if (!_al_fs_stdio_stat(al_cstr(path), &mode, &size, &mtime)) {
+            /* Dangling link, or deleted in the meantime. */
+            goto next;
+         }
+         have_stat = true;
+      }
+
+      if (wanted(walk, item->name, mode)) {
+         result = add_entry(walk, al_cstr(path), mode, size, mtime,
+            !have_stat && (walk->flags & ALLEGRO_FS_WALK_STAT));
+      }
+
+      /* Links to directories are not followed, which keeps out cycles. */
+      if (result == ALLEGRO_FOR_EACH_FS_ENTRY_OK &&
+            (mode & ALLEGRO_FILEMODE_ISDIR) && !item->is_link) {
+         result = walk_stdio_dir(walk, path);
+      }
+
+   next:
+      al_free(item->name);
+   }
+
+   _al_vector_free(&names);
+   al_ustr_truncate(path, path_len);
+   return result;
+}
+
+
+
+static const char *base_name(const char *path)
+{
+   const char *p = path + strlen(path);
+
+   while (p > path && !is_path_sep(p[-1]))
+      p--;
+   return p;
+}
+
+
+
+/* walk_fs_entries:
+ *  Walk a directory through the current file system interface.
+ */
+static int walk_fs_entries(WALK *walk, ALLEGRO_FS_ENTRY *dir)
+{
+   ALLEGRO_FS_ENTRY *entry;
+   int result = ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+
+   if (!al_open_directory(dir)) {
+      al_set_errno(ENOENT);
+      return ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+   }
+
+   while (result == ALLEGRO_FOR_EACH_FS_ENTRY_OK &&
+         (entry = al_read_directory(dir))) {
+      const char *path = al_get_fs_entry_name(entry);
+      uint32_t mode = al_get_fs_entry_mode(entry);
+
+      if (wanted(walk, base_name(path), mode)) {
+         result = add_entry(walk, path, mode, al_get_fs_entry_size(entry),
+            al_get_fs_entry_mtime(entry), false);
+      }
+
+      if (result == ALLEGRO_FOR_EACH_FS_ENTRY_OK &&
+            (mode & ALLEGRO_FILEMODE_ISDIR)) {
+         result = walk_fs_entries(walk, entry);
+      }
+
+      al_destroy_fs_entry(entry);
+   }
+
+   al_close_directory(dir);
+   return result;
+}
+
+
+
+static size_t root_prefix_len(const char *root)
+{
+   size_t len = strlen(root);
+
+   if (len > 0 && !is_path_sep(root[len - 1]))
+      len++;
+   return len;
+}
+
+
+
+/* Function: al_walk_directory
+ */
+int al_walk_directory(const char *path, const char *patterns, int flags,
+   int (*callback)(const ALLEGRO_FS_WALK_ENTRY *entries, int count,
+   void *extra), void *extra)
+{
+   WALK *walk;
+   int result;
+
+   ASSERT(path);
+   ASSERT(callback);
+
+   walk = al_calloc(1, sizeof(*walk));
+   if (!walk) {
+      al_set_errno(ENOMEM);
+      return ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+   }
+   walk->patterns = patterns;
+   walk->flags = flags;
+   walk->callback = callback;
+   walk->extra = extra;
+
+   if (al_get_fs_interface() == &_al_fs_interface_stdio) {
+      ALLEGRO_USTR *us = al_ustr_new(path);
+
+      if (flags & ALLEGRO_FS_WALK_STAT)
+         walk->group = al_create_task_group();
+      walk->root_len = root_prefix_len(path);
+
+      result = walk_stdio_dir(walk, us);
+      al_ustr_free(us);
+   }
+   else {
+      ALLEGRO_FS_ENTRY *root = al_create_fs_entry(path);
+
+      if (root) {
+         walk->root_len = root_prefix_len(al_get_fs_entry_name(root));
+         result = walk_fs_entries(walk, root);
+         al_destroy_fs_entry(root);
+      }
+      else {
+         result = ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+      }
+   }
+
+   if (result == ALLEGRO_FOR_EACH_FS_ENTRY_OK)
+      result = flush_batch(walk);
+   else
+      free_batch(walk);
+
+   if (walk->group)
+      al_destroy_task_group(walk->group);
+   al_free(walk);
+
+   return result;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -907,7 +907,13 @@ static void ljoy_process_new_data(void *data)
    ALLEGRO_EVENT_SOURCE *es = al_get_joystick_event_source();
 
    if (!es) {
-      // Joystick driver not fully initialized
+      /* Joystick driver not fully initialized.  The fd is watched
+       * edge-triggered, so the pending events must still be read and
+       * dropped, or this would not be called again for new ones.
+       */
+      struct input_event input_events[32];
+      while (read(joy->fd, &input_events, sizeof input_events) > 0) {
+      }
       return;
    }
 
@@ -135,17 +135,24 @@ void _al_draw_bitmap_region_memory(ALLEGRO_BITMAP *src,
    int sx, int sy, int sw, int sh,
    int dx, int dy, int flags)
 {
+   _AL_DRAWING_STATE state;
    int op, src_mode, dst_mode;
    int op_alpha, src_alpha, dst_alpha;
    float xtrans, ytrans;
    
    ASSERT(src->parent == NULL);
 
-   al_get_separate_bitmap_blender(&op,
-      &src_mode, &dst_mode, &op_alpha, &src_alpha, &dst_alpha);
+   if (!_al_get_drawing_state(&state))
+      return;
+   op = state.blender->blend_op;
+   src_mode = state.blender->blend_source;
+   dst_mode = state.blender->blend_dest;
+   op_alpha = state.blender->blend_alpha_op;
+   src_alpha = state.blender->blend_alpha_source;
+   dst_alpha = state.blender->blend_alpha_dest;
 
    if (_AL_DEST_IS_ZERO && _AL_SRC_NOT_MODIFIED_TINT_WHITE &&
-      _al_transform_is_translation(al_get_current_transform(), &xtrans, &ytrans))
+      _al_transform_is_translation(state.transform, &xtrans, &ytrans))
    {
       _al_draw_bitmap_region_memory_fast(src, sx, sy, sw, sh,
          dx + xtrans, dy + ytrans, flags);
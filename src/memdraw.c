@@ -38,15 +38,19 @@ typedef struct {
 void _al_draw_pixel_memory(ALLEGRO_BITMAP *bitmap, float x, float y,
    ALLEGRO_COLOR *color)
 {
+   _AL_DRAWING_STATE state;
    ALLEGRO_COLOR result;
    int ix, iy;
+
+   if (!_al_get_drawing_state(&state))
+      return;
    /*
     * Probably not worth it to check for identity
     */
-   al_transform_coordinates(al_get_current_transform(), &x, &y);
+   al_transform_coordinates(state.transform, &x, &y);
    ix = (int)x;
    iy = (int)y;
-   _al_blend_memory(color, bitmap, ix, iy, &result);
+   _al_blend_memory(&state, color, bitmap, ix, iy, &result);
    _al_put_pixel(bitmap, ix, iy, result);
 }
 
@@ -89,6 +89,11 @@ void _al_mutex_init_recursive(_AL_MUTEX *mutex)
    _al_mutex_init(mutex);
 }
 
+void _al_mutex_init_adaptive(_AL_MUTEX *mutex)
+{
+   _al_mutex_init(mutex);
+}
+
 void _al_mutex_destroy(_AL_MUTEX *mutex)
 {
    ASSERT(mutex);
@@ -99,6 +104,25 @@ void _al_mutex_destroy(_AL_MUTEX *mutex)
    }
 }
 
+/* reader/writer locks */
+
+void _al_rwlock_init(_AL_RWLOCK *rwlock)
+{
+   ASSERT(rwlock);
+
+   rwlock->mutex = SDL_CreateMutex();
+}
+
+void _al_rwlock_destroy(_AL_RWLOCK *rwlock)
+{
+   ASSERT(rwlock);
+
+   if (rwlock->mutex) {
+      SDL_DestroyMutex(rwlock->mutex);
+      rwlock->mutex = NULL;
+   }
+}
+
 /* condition variables */
 /* most of the condition variable implementation is actually inline */
 
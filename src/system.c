@@ -29,8 +29,10 @@
 #include "allegro5/internal/aintern_debug.h"
 #include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_file.h"
 #include "allegro5/internal/aintern_pixels.h"
 #include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_tasks.h"
 #include "allegro5/internal/aintern_thread.h"
 #include "allegro5/internal/aintern_timer.h"
 #include "allegro5/internal/aintern_tls.h"
@@ -281,11 +283,17 @@ bool al_install_system(int version, int (*atexit_ptr)(void (*)(void)))
    _al_init_events();
 
    _al_init_iio_table();
+
+   _al_init_bitmap_cache();
    
    _al_init_convert_bitmap_list();
 
    _al_init_timers();
 
+   _al_init_tasks();
+
+   _al_init_file_async();
+
 #ifdef ALLEGRO_CFG_SHADER_GLSL
    _al_glsl_init_shaders();
 #endif
@@ -0,0 +1,552 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Work-stealing task scheduler.
+ *
+ *      See LICENSE.txt for copyright information.
+ *
+ *      A fixed pool of worker threads, one per CPU, each with its own
+ *      deque of tasks.  A worker pushes and pops tasks at the bottom of
+ *      its own deque and, when that runs dry, steals from the top of the
+ *      other workers' deques.  Tasks submitted from threads outside the
+ *      pool go into a shared injection deque.
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_tasks.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_tls.h"
+
+ALLEGRO_DEBUG_CHANNEL("tasks")
+
+
+typedef struct TASK
+{
+   void (*proc)(void *arg);
+   void *arg;
+   ALLEGRO_TASK_GROUP *group;
+} TASK;
+
+
+/* A ring buffer of tasks.  `top' and `bottom' increase monotonically and
+ * are reduced modulo `capacity', which is always a power of two.
+ */
+typedef struct TASK_DEQUE
+{
+   _AL_MUTEX mutex;
+   TASK *tasks;
+   unsigned int capacity;
+   unsigned int top;
+   unsigned int bottom;
+} TASK_DEQUE;
+
+
+typedef struct TASK_WORKER
+{
+   _AL_THREAD thread;
+   TASK_DEQUE deque;
+   unsigned int victim_seed;
+} TASK_WORKER;
+
+
+struct ALLEGRO_TASK_GROUP
+{
+   /* All fields are protected by sched.mutex. */
+   int pending;
+   int waiters;
+   void (*continuation)(void *arg);
+   void *continuation_arg;
+};
+
+
+static struct
+{
+   bool inited;
+   bool stopping;
+   _AL_MUTEX mutex;
+   _AL_COND cond;
+   int queued;
+   int num_workers;
+   TASK_WORKER *workers;
+   TASK_DEQUE injection;
+   unsigned int victim_seed;
+} sched;
+
+
+
+static void deque_init(TASK_DEQUE *dq)
+{
+   _AL_MARK_MUTEX_UNINITED(dq->mutex);
+   _al_mutex_init_adaptive(&dq->mutex);
+   dq->tasks = NULL;
+   dq->capacity = 0;
+   dq->top = 0;
+   dq->bottom = 0;
+}
+
+
+
+static void deque_destroy(TASK_DEQUE *dq)
+{
+   ASSERT(dq->top == dq->bottom);
+
+   _al_mutex_destroy(&dq->mutex);
+   al_free(dq->tasks);
+   dq->tasks = NULL;
+   dq->capacity = 0;
+}
+
+
+
+/* deque_grow: [dq->mutex held]
+ *  Double the capacity of the deque, unwrapping the ring buffer.
+ */
+static bool deque_grow(TASK_DEQUE *dq)
+{
+   unsigned int new_capacity = dq->capacity ? dq->capacity * 2 : 64;
+   unsigned int count = dq->bottom - dq->top;
+   TASK *new_tasks;
+   unsigned int i;
+
+   new_tasks = al_malloc(new_capacity * sizeof(TASK));
+   if (!new_tasks)
+      return false;
+
+   for (i = 0; i < count; i++)
+      new_tasks[i] = dq->tasks[(dq->top + i) & (dq->capacity - 1)];
+
+   al_free(dq->tasks);
+   dq->tasks = new_tasks;
+   dq->capacity = new_capacity;
+   dq->top = 0;
+   dq->bottom = count;
+   return true;
+}
+
+
+
+static bool deque_push_bottom(TASK_DEQUE *dq, const TASK *task)
+{
+   bool ret = true;
+
+   _al_mutex_lock(&dq->mutex);
+   if (dq->bottom - dq->top == dq->capacity)
+      ret = deque_grow(dq);
+   if (ret) {
+      dq->tasks[dq->bottom & (dq->capacity - 1)] = *task;
+      dq->bottom++;
+   }
+   _al_mutex_unlock(&dq->mutex);
+
+   return ret;
+}
+
+
+
+static bool deque_pop_bottom(TASK_DEQUE *dq, TASK *task)
+{
+   bool ret = false;
+
+   _al_mutex_lock(&dq->mutex);
+   if (dq->bottom != dq->top) {
+      dq->bottom--;
+      *task = dq->tasks[dq->bottom & (dq->capacity - 1)];
+      ret = true;
+   }
+   _al_mutex_unlock(&dq->mutex);
+
+   return ret;
+}
+
+
+
+static bool deque_steal_top(TASK_DEQUE *dq, TASK *task)
+{
+   bool ret = false;
+
+   _al_mutex_lock(&dq->mutex);
+   if (dq->bottom != dq->top) {
+      *task = dq->tasks[dq->top & (dq->capacity - 1)];
+      dq->top++;
+      ret = true;
+   }
+   _al_mutex_unlock(&dq->mutex);
+
+   return ret;
+}
+
+
+
+static unsigned int next_victim(unsigned int *seed)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return (*seed >> 16) % (unsigned int)sched.num_workers;
+}
+
+
+
+/* find_task: [any thread]
+ *  Take a task to run.  `self' is the calling worker, or NULL if the
+ *  caller is not part of the pool.
+ */
+static bool find_task(TASK_WORKER *self, TASK *task)
+{
+   bool found = false;
+
+   if (self)
+      found = deque_pop_bottom(&self->deque, task);
+
+   if (!found)
+      found = deque_steal_top(&sched.injection, task);
+
+   if (!found && sched.num_workers > 0) {
+      unsigned int start;
+      int i;
+
+      if (self) {
+         start = next_victim(&self->victim_seed);
+      }
+      else {
+         _al_mutex_lock(&sched.mutex);
+         start = next_victim(&sched.victim_seed);
+         _al_mutex_unlock(&sched.mutex);
+      }
+
+      for (i = 0; i < sched.num_workers && !found; i++) {
+         TASK_WORKER *victim =
+            &sched.workers[(start + i) % (unsigned int)sched.num_workers];
+         if (victim != self)
+            found = deque_steal_top(&victim->deque, task);
+      }
+   }
+
+   if (found) {
+      _al_mutex_lock(&sched.mutex);
+      sched.queued--;
+      _al_mutex_unlock(&sched.mutex);
+   }
+
+   return found;
+}
+
+
+
+/* run_task: [any thread]
+ *  Run a task and account for its completion in its group.  When the
+ *  last pending task of a group finishes, the group's continuation runs
+ *  before waiters are released.
+ */
+static void run_task(TASK *task)
+{
+   ALLEGRO_TASK_GROUP *group = task->group;
+
+   task->proc(task->arg);
+
+   if (!group)
+      return;
+
+   _al_mutex_lock(&sched.mutex);
+   if (group->pending == 1 && group->continuation) {
+      void (*proc)(void *arg) = group->continuation;
+      void *arg = group->continuation_arg;
+
+      group->continuation = NULL;
+      group->continuation_arg = NULL;
+      _al_mutex_unlock(&sched.mutex);
+      proc(arg);
+      _al_mutex_lock(&sched.mutex);
+   }
+   group->pending--;
+   if (group->pending == 0 && group->waiters > 0)
+      _al_cond_broadcast(&sched.cond);
+   _al_mutex_unlock(&sched.mutex);
+}
+
+
+
+/* worker_proc: [worker thread]
+ *  Run tasks until the scheduler is shut down and all queued tasks have
+ *  been drained.
+ */
+static void worker_proc(_AL_THREAD *thread, void *arg)
+{
+   TASK_WORKER *self = arg;
+   (void)thread;
+
+   _al_tls_set_task_worker(self);
+
+   for (;;) {
+      TASK task;
+      bool stop;
+
+      if (find_task(self, &task)) {
+         run_task(&task);
+         continue;
+      }
+
+      _al_mutex_lock(&sched.mutex);
+      while (sched.queued == 0 && !sched.stopping)
+         _al_cond_wait(&sched.cond, &sched.mutex);
+      stop = (sched.queued == 0 && sched.stopping);
+      _al_mutex_unlock(&sched.mutex);
+
+      if (stop)
+         break;
+   }
+
+   _al_tls_set_task_worker(NULL);
+}
+
+
+
+static int desired_worker_count(void)
+{
+   int count = al_get_cpu_count();
+   return (count > 0) ? count : 1;
+}
+
+
+
+/* start_workers: [sched.mutex held]
+ *  Spawn the worker pool on first use.
+ */
+static bool start_workers(void)
+{
+   int count;
+   int i;
+
+   if (sched.workers)
+      return true;
+   if (sched.stopping)
+      return false;
+
+   count = desired_worker_count();
+   sched.workers = al_calloc(count, sizeof(TASK_WORKER));
+   if (!sched.workers)
+      return false;
+
+   for (i = 0; i < count; i++) {
+      deque_init(&sched.workers[i].deque);
+      sched.workers[i].victim_seed = i + 1;
+   }
+   /* Set before starting any thread, since workers read it when stealing. */
+   sched.num_workers = count;
+   for (i = 0; i < count; i++) {
+      _al_thread_create(&sched.workers[i].thread, worker_proc,
+         &sched.workers[i]);
+   }
+
+   ALLEGRO_INFO("Started %d task workers\n", count);
+   return true;
+}
+
+
+
+static void shutdown_tasks(void)
+{
+   int i;
+
+   if (!sched.inited)
+      return;
+
+   _al_mutex_lock(&sched.mutex);
+   sched.stopping = true;
+   _al_cond_broadcast(&sched.cond);
+   _al_mutex_unlock(&sched.mutex);
+
+   for (i = 0; i < sched.num_workers; i++)
+      _al_thread_join(&sched.workers[i].thread);
+   for (i = 0; i < sched.num_workers; i++)
+      deque_destroy(&sched.workers[i].deque);
+   al_free(sched.workers);
+   sched.workers = NULL;
+   sched.num_workers = 0;
+
+   deque_destroy(&sched.injection);
+   _al_cond_destroy(&sched.cond);
+   _al_mutex_destroy(&sched.mutex);
+   sched.inited = false;
+}
+
+
+
+/* _al_init_tasks:
+ *  Prepare the scheduler.  Worker threads are only started on first use.
+ */
+void _al_init_tasks(void)
+{
+   if (sched.inited)
+      return;
+
+   _AL_MARK_MUTEX_UNINITED(sched.mutex);
+   _al_mutex_init_adaptive(&sched.mutex);
+   _al_cond_init(&sched.cond);
+   deque_init(&sched.injection);
+   sched.stopping = false;
+   sched.queued = 0;
+   sched.num_workers = 0;
+   sched.workers = NULL;
+   sched.victim_seed = 1;
+   sched.inited = true;
+
+   _al_add_exit_func(shutdown_tasks, "shutdown_tasks");
+}
+
+
+
+/* Function: al_create_task_group
+ */
+ALLEGRO_TASK_GROUP *al_create_task_group(void)
+{
+   return al_calloc(1, sizeof(ALLEGRO_TASK_GROUP));
+}
+
+
+
+/* Function: al_destroy_task_group
+ */
+void al_destroy_task_group(ALLEGRO_TASK_GROUP *group)
+{
+   if (group) {
+      al_wait_task_group(group);
+      al_free(group);
+   }
+}
+
+
+
+/* Function: al_run_task
+ */
+bool al_run_task(ALLEGRO_TASK_GROUP *group, void (*proc)(void *arg),
+   void *arg)
+{
+   TASK_WORKER *self;
+   TASK task;
+   bool ret;
+
+   ASSERT(proc);
+
+   if (!sched.inited)
+      return false;
+
+   task.proc = proc;
+   task.arg = arg;
+   task.group = group;
+
+   self = _al_tls_get_task_worker();
+
+   _al_mutex_lock(&sched.mutex);
+   ret = start_workers();
+   if (ret) {
+      if (group)
+         group->pending++;
+      ret = deque_push_bottom(self ? &self->deque : &sched.injection, &task);
+      if (ret) {
+         sched.queued++;
+         _al_cond_signal(&sched.cond);
+      }
+      else if (group) {
+         group->pending--;
+      }
+   }
+   _al_mutex_unlock(&sched.mutex);
+
+   return ret;
+}
+
+
+
+/* Function: al_wait_task_group
+ */
+void al_wait_task_group(ALLEGRO_TASK_GROUP *group)
+{
+   TASK_WORKER *self;
+
+   ASSERT(group);
+
+   if (!sched.inited)
+      return;
+
+   self = _al_tls_get_task_worker();
+
+   _al_mutex_lock(&sched.mutex);
+   group->waiters++;
+   while (group->pending > 0) {
+      TASK task;
+
+      /* Help out rather than block.  This also keeps workers that wait on
+       * a nested group from starving the pool.
+       */
+      _al_mutex_unlock(&sched.mutex);
+      if (find_task(self, &task)) {
+         run_task(&task);
+         _al_mutex_lock(&sched.mutex);
+         continue;
+      }
+      _al_mutex_lock(&sched.mutex);
+
+      if (group->pending > 0 && sched.queued == 0)
+         _al_cond_wait(&sched.cond, &sched.mutex);
+   }
+   group->waiters--;
+   _al_mutex_unlock(&sched.mutex);
+}
+
+
+
+/* Function: al_set_task_group_continuation
+ */
+void al_set_task_group_continuation(ALLEGRO_TASK_GROUP *group,
+   void (*proc)(void *arg), void *arg)
+{
+   bool run_now = false;
+
+   ASSERT(group);
+   ASSERT(proc);
+
+   if (sched.inited)
+      _al_mutex_lock(&sched.mutex);
+   if (group->pending == 0) {
+      run_now = true;
+   }
+   else {
+      group->continuation = proc;
+      group->continuation_arg = arg;
+   }
+   if (sched.inited)
+      _al_mutex_unlock(&sched.mutex);
+
+   if (run_now)
+      proc(arg);
+}
+
+
+
+/* Function: al_get_task_worker_count
+ */
+int al_get_task_worker_count(void)
+{
+   int count;
+
+   if (!sched.inited)
+      return 0;
+
+   _al_mutex_lock(&sched.mutex);
+   count = sched.workers ? sched.num_workers : desired_worker_count();
+   _al_mutex_unlock(&sched.mutex);
+
+   return count;
+}
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -55,6 +55,11 @@ struct ALLEGRO_COND {
 };
 
 
+struct ALLEGRO_RWLOCK {
+   _AL_RWLOCK rwlock;
+};
+
+
 static void thread_func_trampoline(_AL_THREAD *inner, void *_outer)
 {
    ALLEGRO_THREAD *outer = (ALLEGRO_THREAD *) _outer;
@@ -317,6 +322,19 @@ ALLEGRO_MUTEX *al_create_mutex_recursive(void)
 }
 
 
+/* Function: al_create_mutex_adaptive
+ */
+ALLEGRO_MUTEX *al_create_mutex_adaptive(void)
+{
+   ALLEGRO_MUTEX *mutex = al_malloc(sizeof(*mutex));
+   if (mutex) {
+      _AL_MARK_MUTEX_UNINITED(mutex->mutex);
+      _al_mutex_init_adaptive(&mutex->mutex);
+   }
+   return mutex;
+}
+
+
 /* Function: al_lock_mutex
  */
 void al_lock_mutex(ALLEGRO_MUTEX *mutex)
@@ -414,4 +432,64 @@ void al_signal_cond(ALLEGRO_COND *cond)
 }
 
 
+/* Function: al_create_rwlock
+ */
+ALLEGRO_RWLOCK *al_create_rwlock(void)
+{
+   ALLEGRO_RWLOCK *rwlock = al_malloc(sizeof(*rwlock));
+   if (rwlock) {
+      _AL_MARK_RWLOCK_UNINITED(rwlock->rwlock);
+      _al_rwlock_init(&rwlock->rwlock);
+   }
+   return rwlock;
+}
+
+
+/* Function: al_destroy_rwlock
+ */
+void al_destroy_rwlock(ALLEGRO_RWLOCK *rwlock)
+{
+   if (rwlock) {
+      _al_rwlock_destroy(&rwlock->rwlock);
+      al_free(rwlock);
+   }
+}
+
+
+/* Function: al_lock_rwlock_read
+ */
+void al_lock_rwlock_read(ALLEGRO_RWLOCK *rwlock)
+{
+   ASSERT(rwlock);
+   _al_rwlock_lock_read(&rwlock->rwlock);
+}
+
+
+/* Function: al_unlock_rwlock_read
+ */
+void al_unlock_rwlock_read(ALLEGRO_RWLOCK *rwlock)
+{
+   ASSERT(rwlock);
+   _al_rwlock_unlock_read(&rwlock->rwlock);
+}
+
+
+/* Function: al_lock_rwlock_write
+ */
+void al_lock_rwlock_write(ALLEGRO_RWLOCK *rwlock)
+{
+   ASSERT(rwlock);
+   _al_rwlock_lock_write(&rwlock->rwlock);
+}
+
+
+/* Function: al_unlock_rwlock_write
+ */
+void al_unlock_rwlock_write(ALLEGRO_RWLOCK *rwlock)
+{
+   ASSERT(rwlock);
+   _al_rwlock_unlock_write(&rwlock->rwlock);
+}
+
+
 /* vim: set sts=3 sw=3 et: */
@@ -206,7 +206,7 @@ static void enable_timer(ALLEGRO_TIMER *timer, bool reset_counter)
 
 void _al_init_timers(void)
 {
-   timers_mutex = al_create_mutex();
+   timers_mutex = al_create_mutex_adaptive();
    timer_cond = al_create_cond();
    _al_add_exit_func(shutdown_timers, "shutdown_timers");
 }
@@ -39,6 +39,7 @@
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_blend.h"
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_file.h"
 #include "allegro5/internal/aintern_fshook.h"
@@ -90,6 +91,8 @@ typedef struct thread_local_state {
    int new_bitmap_flags;
    int new_bitmap_wrap_u;
    int new_bitmap_wrap_v;
+   int new_bitmap_load_w;
+   int new_bitmap_load_h;
 
    /* Files */
    const ALLEGRO_FILE_INTERFACE *new_file_interface;
@@ -109,6 +112,9 @@ typedef struct thread_local_state {
 
    /* Destructor ownership count */
    int dtor_owner_count;
+
+   /* Task scheduler worker run by this thread, if any */
+   void *task_worker;
 } thread_local_state;
 
 
@@ -164,7 +170,11 @@ static void initialize_tls_values(thread_local_state *tls)
 
 #if defined(ALLEGRO_CFG_DLL_TLS)
    #include "tls_dll.inc"
-#elif defined(ALLEGRO_MACOSX) || defined(ALLEGRO_IPHONE) || defined(ALLEGRO_ANDROID) || defined(ALLEGRO_RASPBERRYPI)
+#elif defined(ALLEGRO_MACOSX) || defined(ALLEGRO_IPHONE) || defined(ALLEGRO_ANDROID)
+   /* Native TLS is not dependable on all supported toolchains for these
+    * platforms.  Everywhere else, including the Raspberry Pi, the compiler
+    * keyword avoids a pthread_getspecific() call on every state lookup.
+    */
    #include "tls_pthread.inc"
 #else
    #include "tls_native.inc"
@@ -521,6 +531,33 @@ ALLEGRO_BITMAP *al_get_target_bitmap(void)
 
 
 
+/* _al_get_drawing_state:
+ *  Fetch the target bitmap, effective blender and transform at once, for
+ *  drawing routines which would otherwise look up thread local storage
+ *  several times per call.  Returns false if there is no target bitmap.
+ */
+bool _al_get_drawing_state(_AL_DRAWING_STATE *state)
+{
+   thread_local_state *tls;
+   ALLEGRO_BITMAP *target;
+
+   if ((tls = tls_get()) == NULL)
+      return false;
+
+   target = tls->target_bitmap;
+   state->target = target;
+   state->blend_color = tls->current_blender.blend_color;
+   if (target && target->use_bitmap_blender)
+      state->blender = &target->blender;
+   else
+      state->blender = &tls->current_blender;
+   state->transform = target ? &target->transform : NULL;
+
+   return target != NULL;
+}
+
+
+
 /* Function: al_set_blender
  */
 void al_set_blender(int op, int src, int dst)
@@ -726,6 +763,8 @@ void al_store_state(ALLEGRO_STATE *state, int flags)
       _STORE(new_bitmap_flags);
       _STORE(new_bitmap_wrap_u);
       _STORE(new_bitmap_wrap_v);
+      _STORE(new_bitmap_load_w);
+      _STORE(new_bitmap_load_h);
    }
 
    if (flags & ALLEGRO_STATE_DISPLAY) {
@@ -797,6 +836,8 @@ void al_restore_state(ALLEGRO_STATE const *state)
       _RESTORE(new_bitmap_flags);
       _RESTORE(new_bitmap_wrap_u);
       _RESTORE(new_bitmap_wrap_v);
+      _RESTORE(new_bitmap_load_w);
+      _RESTORE(new_bitmap_load_h);
    }
 
    if (flags & ALLEGRO_STATE_DISPLAY) {
@@ -987,6 +1028,32 @@ void al_set_new_bitmap_wrap(ALLEGRO_BITMAP_WRAP u, ALLEGRO_BITMAP_WRAP v)
    tls->new_bitmap_wrap_v = v;
 }
 
+/* Function: al_get_new_bitmap_load_size
+ */
+void al_get_new_bitmap_load_size(int *w, int *h)
+{
+   ASSERT(w);
+   ASSERT(h);
+
+   thread_local_state *tls;
+   if ((tls = tls_get()) == NULL)
+      return;
+
+   *w = tls->new_bitmap_load_w;
+   *h = tls->new_bitmap_load_h;
+}
+
+/* Function: al_set_new_bitmap_load_size
+ */
+void al_set_new_bitmap_load_size(int w, int h)
+{
+   thread_local_state *tls;
+   if ((tls = tls_get()) == NULL)
+      return;
+   tls->new_bitmap_load_w = w;
+   tls->new_bitmap_load_h = h;
+}
+
 #ifdef ALLEGRO_ANDROID
 JNIEnv *_al_android_get_jnienv(void)
 GETTER(jnienv, 0)
@@ -1005,4 +1072,12 @@ int *_al_tls_get_dtor_owner_count(void)
 }
 
 
+void *_al_tls_get_task_worker(void)
+GETTER(task_worker, NULL)
+
+
+void _al_tls_set_task_worker(void *worker)
+SETTER(task_worker, worker)
+
+
 /* vim: set sts=3 sw=3 et: */
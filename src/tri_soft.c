@@ -692,6 +692,7 @@ void _al_triangle_2d(ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX
 {
    int shade = 1;
    int grad = 1;
+   _AL_DRAWING_STATE state;
    int op, src_mode, dst_mode, op_alpha, src_alpha, dst_alpha;
    ALLEGRO_COLOR v1c, v2c, v3c;
 
@@ -699,8 +700,14 @@ void _al_triangle_2d(ALLEGRO_BITMAP* texture, ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX
    v2c = v2->color;
    v3c = v3->color;
 
-   al_get_separate_bitmap_blender(&op,
-      &src_mode, &dst_mode, &op_alpha, &src_alpha, &dst_alpha);
+   if (!_al_get_drawing_state(&state))
+      return;
+   op = state.blender->blend_op;
+   src_mode = state.blender->blend_source;
+   dst_mode = state.blender->blend_dest;
+   op_alpha = state.blender->blend_alpha_op;
+   src_alpha = state.blender->blend_alpha_source;
+   dst_alpha = state.blender->blend_alpha_dest;
    if (_AL_DEST_IS_ZERO && _AL_SRC_NOT_MODIFIED) {
       shade = 0;
    }
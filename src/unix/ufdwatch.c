@@ -20,8 +20,12 @@
  */
 
 
+#include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/select.h>
 #include <unistd.h>
@@ -32,6 +36,14 @@
 #include "allegro5/internal/aintern_vector.h"
 #include "allegro5/platform/aintunix.h"
 
+#if defined(ALLEGRO_HAVE_SYS_EPOLL_H) && defined(ALLEGRO_HAVE_SYS_EVENTFD_H)
+   #define USE_EPOLL
+   #include <sys/epoll.h>
+   #include <sys/eventfd.h>
+#endif
+
+ALLEGRO_DEBUG_CHANNEL("fdwatch")
+
 
 
 typedef struct WATCH_ITEM
@@ -48,6 +60,179 @@ static _AL_VECTOR fd_watch_list = _AL_VECTOR_INITIALIZER(WATCH_ITEM);
 
 
 
+/* find_watch_item: [any thread, fd_watch_mutex held]
+ *  Return the watch item for `fd', or NULL if it is not being watched.
+ */
+static WATCH_ITEM *find_watch_item(int fd, unsigned int *index)
+{
+   WATCH_ITEM *wi;
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
+      wi = _al_vector_ref(&fd_watch_list, i);
+      if (wi->fd == fd) {
+         if (index)
+            *index = i;
+         return wi;
+      }
+   }
+
+   return NULL;
+}
+
+
+
+#ifdef USE_EPOLL
+
+/* Maximum number of ready fds handled per epoll_wait() call.  Any
+ * remaining ones are simply picked up by the next call.
+ */
+#define MAX_READY_EVENTS   16
+
+static int fd_watch_epoll = -1;
+static int fd_watch_wakeup = -1;
+
+
+
+/* fd_watch_thread_func: [fdwatch thread]
+ *  The thread loop function.  Sleeps in epoll_wait() until one of the
+ *  watched fds has activity, or until the wakeup eventfd is signalled
+ *  because the thread is being stopped.
+ */
+static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
+{
+   (void)unused;
+
+   while (!_al_get_thread_should_stop(self)) {
+      struct epoll_event events[MAX_READY_EVENTS];
+      int nready;
+      int i;
+
+      nready = epoll_wait(fd_watch_epoll, events, MAX_READY_EVENTS, -1);
+      if (nready < 1)
+         continue;
+
+      _al_mutex_lock(&fd_watch_mutex);
+      {
+         for (i = 0; i < nready; i++) {
+            WATCH_ITEM *wi;
+
+            if (events[i].data.fd == fd_watch_wakeup) {
+               uint64_t count;
+               while (read(fd_watch_wakeup, &count, sizeof(count)) > 0) {
+               }
+               continue;
+            }
+
+            /* An earlier callback in this batch may have stopped watching
+             * this fd, so look it up again rather than trusting the event.
+             * The callback is allowed to modify the watch list so the mutex
+             * must be recursive.
+             */
+            wi = find_watch_item(events[i].data.fd, NULL);
+            if (wi)
+               wi->callback(wi->cb_data);
+         }
+      }
+      _al_mutex_unlock(&fd_watch_mutex);
+   }
+}
+
+
+
+/* fd_watch_backend_start: [primary thread]
+ *  Create the epoll instance and the eventfd used to wake the thread.
+ */
+static bool fd_watch_backend_start(void)
+{
+   struct epoll_event ev;
+
+   fd_watch_epoll = epoll_create1(EPOLL_CLOEXEC);
+   if (fd_watch_epoll < 0) {
+      ALLEGRO_ERROR("epoll_create1 failed: %s\n", strerror(errno));
+      return false;
+   }
+
+   fd_watch_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   if (fd_watch_wakeup < 0) {
+      ALLEGRO_ERROR("eventfd failed: %s\n", strerror(errno));
+      close(fd_watch_epoll);
+      fd_watch_epoll = -1;
+      return false;
+   }
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.fd = fd_watch_wakeup;
+   epoll_ctl(fd_watch_epoll, EPOLL_CTL_ADD, fd_watch_wakeup, &ev);
+
+   return true;
+}
+
+
+
+/* fd_watch_backend_add: [primary thread]
+ *  Register `fd' with the epoll instance.  Non-blocking fds are watched
+ *  edge-triggered, since their callbacks are expected to drain them; fds
+ *  in blocking mode stay level-triggered so a callback that reads only
+ *  part of the pending data does not stall.
+ */
+static void fd_watch_backend_add(int fd)
+{
+   struct epoll_event ev;
+   int flags;
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.fd = fd;
+
+   flags = fcntl(fd, F_GETFL);
+   if (flags != -1 && (flags & O_NONBLOCK))
+      ev.events |= EPOLLET;
+
+   if (epoll_ctl(fd_watch_epoll, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      ALLEGRO_ERROR("epoll_ctl(ADD, %d) failed: %s\n", fd, strerror(errno));
+   }
+}
+
+
+
+/* fd_watch_backend_remove: [primary thread]
+ *  Unregister `fd' from the epoll instance.  The fd may already have been
+ *  closed, in which case the kernel has dropped it for us.
+ */
+static void fd_watch_backend_remove(int fd)
+{
+   epoll_ctl(fd_watch_epoll, EPOLL_CTL_DEL, fd, NULL);
+}
+
+
+
+/* fd_watch_backend_wakeup: [primary thread]
+ *  Interrupt a pending epoll_wait() so the thread notices it should stop.
+ */
+static void fd_watch_backend_wakeup(void)
+{
+   uint64_t one = 1;
+   ssize_t r = write(fd_watch_wakeup, &one, sizeof(one));
+   (void)r;
+}
+
+
+
+/* fd_watch_backend_stop: [primary thread]
+ *  Release the epoll instance and the wakeup eventfd.
+ */
+static void fd_watch_backend_stop(void)
+{
+   close(fd_watch_wakeup);
+   close(fd_watch_epoll);
+   fd_watch_wakeup = -1;
+   fd_watch_epoll = -1;
+}
+
+#else /* !USE_EPOLL */
+
 /* fd_watch_thread_func: [fdwatch thread]
  *  The thread loop function.
  */
@@ -112,13 +297,27 @@ static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
 }
 
 
+/* The select() loop rebuilds its fd set every iteration and polls the
+ * stop flag every 250 ms, so it needs no extra state.
+ */
+static bool fd_watch_backend_start(void) { return true; }
+static void fd_watch_backend_add(int fd) { (void)fd; }
+static void fd_watch_backend_remove(int fd) { (void)fd; }
+static void fd_watch_backend_wakeup(void) { }
+static void fd_watch_backend_stop(void) { }
+
+#endif /* !USE_EPOLL */
+
+
 
 /* _al_unix_start_watching_fd: [primary thread]
  * 
  *  Start watching for data on file descriptor `fd'.  This is done in
  *  a background thread, which is started if necessary.  When there is
  *  data waiting to be read on fd, `callback' is applied to `cb_data'.
- *  The callback function should read as much data off fd as possible.
+ *  The callback function should read as much data off fd as possible;
+ *  if fd is non-blocking it may be watched edge-triggered, so it must
+ *  be drained until read() would block.
  *
  *  Note: the callback is run from the background thread.  You can
  *  assume there is only one callback being called from the fdwatch
@@ -131,6 +330,9 @@ void _al_unix_start_watching_fd(int fd, void (*callback)(void *), void *cb_data)
 
    /* start the background thread if necessary */
    if (_al_vector_size(&fd_watch_list) == 0) {
+      if (!fd_watch_backend_start())
+         return;
+
       /* We need a recursive mutex to allow callbacks to modify the fd watch
        * list.
        */
@@ -146,6 +348,8 @@ void _al_unix_start_watching_fd(int fd, void (*callback)(void *), void *cb_data)
       wi->fd = fd;
       wi->callback = callback;
       wi->cb_data = cb_data;
+
+      fd_watch_backend_add(fd);
    }
    _al_mutex_unlock(&fd_watch_mutex);
 }
@@ -166,23 +370,22 @@ void _al_unix_stop_watching_fd(int fd)
    /* find the fd in the watch list and remove it */
    _al_mutex_lock(&fd_watch_mutex);
    {
-      WATCH_ITEM *wi;
       unsigned int i;
 
-      for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
-         wi = _al_vector_ref(&fd_watch_list, i);
-         if (wi->fd == fd) {
-            _al_vector_delete_at(&fd_watch_list, i);
-            list_empty = _al_vector_is_empty(&fd_watch_list);
-            break;
-         }
+      if (find_watch_item(fd, &i)) {
+         fd_watch_backend_remove(fd);
+         _al_vector_delete_at(&fd_watch_list, i);
+         list_empty = _al_vector_is_empty(&fd_watch_list);
       }
    }
    _al_mutex_unlock(&fd_watch_mutex);
 
    /* if no more fd's are being watched, stop the background thread */
    if (list_empty) {
+      _al_thread_set_should_stop(&fd_watch_thread);
+      fd_watch_backend_wakeup();
       _al_thread_join(&fd_watch_thread);
+      fd_watch_backend_stop();
       _al_mutex_destroy(&fd_watch_mutex);
       _al_vector_free(&fd_watch_list);
    }
@@ -18,6 +18,7 @@
 
 #define _XOPEN_SOURCE 500       /* for Unix98 recursive mutexes */
                                 /* XXX: added configure test */
+#define _GNU_SOURCE             /* for adaptive mutexes on glibc */
 
 #include <sys/time.h>
 
@@ -166,6 +167,29 @@ void _al_mutex_init_recursive(_AL_MUTEX *mutex)
 }
 
 
+/* _al_mutex_init_adaptive:
+ *  Initialise a mutex which spins briefly before sleeping, for short
+ *  critical sections.  Falls back to a normal mutex where unsupported.
+ */
+void _al_mutex_init_adaptive(_AL_MUTEX *mutex)
+{
+#ifdef PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+   pthread_mutexattr_t attr;
+
+   ASSERT(mutex);
+
+   pthread_mutexattr_init(&attr);
+   pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+   pthread_mutex_init(&mutex->mutex, &attr);
+   mutex->inited = true;
+
+   pthread_mutexattr_destroy(&attr);
+#else
+   _al_mutex_init(mutex);
+#endif
+}
+
+
 void _al_mutex_destroy(_AL_MUTEX *mutex)
 {
    ASSERT(mutex);
@@ -177,6 +201,29 @@ void _al_mutex_destroy(_AL_MUTEX *mutex)
 }
 
 
+/* reader/writer locks */
+/* most of the reader/writer lock implementation is actually inline */
+
+void _al_rwlock_init(_AL_RWLOCK *rwlock)
+{
+   ASSERT(rwlock);
+
+   pthread_rwlock_init(&rwlock->lock, NULL);
+   rwlock->inited = true;
+}
+
+
+void _al_rwlock_destroy(_AL_RWLOCK *rwlock)
+{
+   ASSERT(rwlock);
+
+   if (rwlock->inited) {
+      pthread_rwlock_destroy(&rwlock->lock);
+      rwlock->inited = false;
+   }
+}
+
+
 /* condition variables */
 /* most of the condition variable implementation is actually inline */
 
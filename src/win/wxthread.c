@@ -16,6 +16,14 @@
  */
 
 
+/* For slim reader/writer locks. */
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#elif _WIN32_WINNT < 0x0600
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_thread.h"
@@ -132,6 +140,24 @@ void _al_mutex_init_recursive(_AL_MUTEX *mutex)
 }
 
 
+/* _al_mutex_init_adaptive:
+ *  Critical sections can spin on multiprocessor systems before waiting on
+ *  the kernel object, which suits short critical sections.
+ */
+void _al_mutex_init_adaptive(_AL_MUTEX *mutex)
+{
+   ASSERT(mutex);
+
+   if (!mutex->cs)
+      mutex->cs = al_malloc(sizeof *mutex->cs);
+   ASSERT(mutex->cs);
+   if (mutex->cs)
+      InitializeCriticalSectionAndSpinCount(mutex->cs, 4000);
+   else
+      abort();
+}
+
+
 void _al_mutex_destroy(_AL_MUTEX *mutex)
 {
    ASSERT(mutex);
@@ -144,6 +170,55 @@ void _al_mutex_destroy(_AL_MUTEX *mutex)
 }
 
 
+/* reader/writer locks */
+
+void _al_rwlock_init(_AL_RWLOCK *rwlock)
+{
+   ASSERT(rwlock);
+   ASSERT(sizeof(rwlock->srw) == sizeof(SRWLOCK));
+
+   InitializeSRWLock((PSRWLOCK)&rwlock->srw);
+   rwlock->inited = true;
+}
+
+
+void _al_rwlock_destroy(_AL_RWLOCK *rwlock)
+{
+   ASSERT(rwlock);
+
+   /* SRW locks need no cleanup. */
+   rwlock->inited = false;
+}
+
+
+void _al_rwlock_lock_read(_AL_RWLOCK *rwlock)
+{
+   if (rwlock->inited)
+      AcquireSRWLockShared((PSRWLOCK)&rwlock->srw);
+}
+
+
+void _al_rwlock_unlock_read(_AL_RWLOCK *rwlock)
+{
+   if (rwlock->inited)
+      ReleaseSRWLockShared((PSRWLOCK)&rwlock->srw);
+}
+
+
+void _al_rwlock_lock_write(_AL_RWLOCK *rwlock)
+{
+   if (rwlock->inited)
+      AcquireSRWLockExclusive((PSRWLOCK)&rwlock->srw);
+}
+
+
+void _al_rwlock_unlock_write(_AL_RWLOCK *rwlock)
+{
+   if (rwlock->inited)
+      ReleaseSRWLockExclusive((PSRWLOCK)&rwlock->srw);
+}
+
+
 /* condition variables */
 
 /*
@@ -0,0 +1,202 @@
+/*
+ *    Tests saving and loading DDS files, and locking compressed memory
+ *    bitmaps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_image.h"
+
+/* Unlike assert, also checks in release builds. */
+#define CHECK(x) \
+   do { \
+      if (!(x)) { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+         abort(); \
+      } \
+   } while (0)
+
+/* Not a multiple of the block size, so the edge blocks are partial. */
+#define WIDTH        30
+#define HEIGHT       18
+
+/* The largest difference allowed in any channel.  The pictures are smooth,
+ * so DXT compression should stay well within this.
+ */
+#define TOLERANCE    24
+
+static ALLEGRO_BITMAP *make_picture(bool alpha)
+{
+   ALLEGRO_BITMAP *bmp;
+   int x, y;
+
+   /* Bitmaps without alpha are saved as DXT1. */
+   al_set_new_bitmap_format(alpha ? ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE :
+      ALLEGRO_PIXEL_FORMAT_XBGR_8888);
+   bmp = al_create_bitmap(WIDTH, HEIGHT);
+   CHECK(bmp);
+   al_set_target_bitmap(bmp);
+   for (y = 0; y < HEIGHT; y++) {
+      for (x = 0; x < WIDTH; x++) {
+         int a = alpha ? 255 - x * 8 : 255;
+         al_put_pixel(x, y, al_map_rgba(x * 8, y * 12, 200 - x * 3, a));
+      }
+   }
+   return bmp;
+}
+
+static ALLEGRO_BITMAP *save_and_load(ALLEGRO_BITMAP *bmp)
+{
+   ALLEGRO_PATH *path;
+   ALLEGRO_BITMAP *loaded;
+   ALLEGRO_FILE *f;
+   const char *filename;
+
+   f = al_make_temp_file("test_dds_XXXXXX.dds", &path);
+   CHECK(f);
+   CHECK(al_save_bitmap_f(f, ".dds", bmp));
+   al_fclose(f);
+
+   filename = al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP);
+   CHECK(0 == strcmp(al_identify_bitmap(filename), ".dds"));
+   loaded = al_load_bitmap(filename);
+   CHECK(loaded);
+
+   al_remove_filename(filename);
+   al_destroy_path(path);
+   return loaded;
+}
+
+static int max_difference(ALLEGRO_BITMAP *a, ALLEGRO_BITMAP *b)
+{
+   ALLEGRO_LOCKED_REGION *la, *lb;
+   int y, i;
+   int max = 0;
+
+   la = al_lock_bitmap(a, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_READONLY);
+   lb = al_lock_bitmap(b, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_READONLY);
+   CHECK(la && lb);
+
+   for (y = 0; y < HEIGHT; y++) {
+      unsigned char *ra = (unsigned char *)la->data + y * la->pitch;
+      unsigned char *rb = (unsigned char *)lb->data + y * lb->pitch;
+      for (i = 0; i < WIDTH * 4; i++) {
+         int d = abs(ra[i] - rb[i]);
+         if (d > max)
+            max = d;
+      }
+   }
+
+   al_unlock_bitmap(a);
+   al_unlock_bitmap(b);
+   return max;
+}
+
+static bool same_blocks(ALLEGRO_BITMAP *a, ALLEGRO_BITMAP *b)
+{
+   int format = al_get_bitmap_format(a);
+   int rows = (HEIGHT + 3) / 4;
+   int row_size = (WIDTH + 3) / 4 * al_get_pixel_block_size(format);
+   ALLEGRO_LOCKED_REGION *la, *lb;
+   bool same = true;
+   int y;
+
+   la = al_lock_bitmap_blocked(a, ALLEGRO_LOCK_READONLY);
+   lb = al_lock_bitmap_blocked(b, ALLEGRO_LOCK_READONLY);
+   CHECK(la && lb);
+
+   for (y = 0; y < rows; y++) {
+      if (memcmp((char *)la->data + y * la->pitch,
+            (char *)lb->data + y * lb->pitch, row_size) != 0)
+         same = false;
+   }
+
+   al_unlock_bitmap(a);
+   al_unlock_bitmap(b);
+   return same;
+}
+
+static void test_round_trip(bool alpha, int expected_format)
+{
+   ALLEGRO_BITMAP *bmp, *loaded, *reloaded;
+   int diff;
+
+   bmp = make_picture(alpha);
+   loaded = save_and_load(bmp);
+   CHECK(al_get_bitmap_width(loaded) == WIDTH);
+   CHECK(al_get_bitmap_height(loaded) == HEIGHT);
+   CHECK(al_get_bitmap_format(loaded) == expected_format);
+
+   diff = max_difference(bmp, loaded);
+   printf("format %d: largest difference %d\n", expected_format, diff);
+   CHECK(diff <= TOLERANCE);
+
+   /* Compressed bitmaps are saved as they are. */
+   reloaded = save_and_load(loaded);
+   CHECK(al_get_bitmap_format(reloaded) == expected_format);
+   CHECK(same_blocks(loaded, reloaded));
+
+   al_destroy_bitmap(reloaded);
+   al_destroy_bitmap(loaded);
+   al_destroy_bitmap(bmp);
+}
+
+static void test_lock_compressed(void)
+{
+   ALLEGRO_BITMAP *bmp, *loaded;
+   ALLEGRO_LOCKED_REGION *lr;
+   int format;
+
+   bmp = make_picture(true);
+   loaded = save_and_load(bmp);
+   format = al_get_bitmap_format(loaded);
+   CHECK(format == ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5);
+
+   /* Compressed formats need al_lock_bitmap_blocked. */
+   CHECK(!al_lock_bitmap(loaded, format, ALLEGRO_LOCK_READONLY));
+   CHECK(!al_lock_bitmap_region(loaded, 4, 4, 8, 8, format,
+      ALLEGRO_LOCK_READWRITE));
+   CHECK(!al_is_bitmap_locked(loaded));
+   CHECK(!al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1,
+      ALLEGRO_LOCK_READONLY));
+   CHECK(!al_is_bitmap_locked(bmp));
+
+   lr = al_lock_bitmap(loaded, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+   CHECK(lr);
+   CHECK(!al_lock_bitmap(loaded, ALLEGRO_PIXEL_FORMAT_ANY,
+      ALLEGRO_LOCK_READONLY));
+   CHECK(al_get_pixel_block_width(lr->format) == 1);
+   al_unlock_bitmap(loaded);
+
+   lr = al_lock_bitmap_blocked(loaded, ALLEGRO_LOCK_READONLY);
+   CHECK(lr);
+   CHECK(lr->format == format);
+   al_unlock_bitmap(loaded);
+
+   al_destroy_bitmap(loaded);
+   al_destroy_bitmap(bmp);
+}
+
+int main(int argc, char **argv)
+{
+   (void)argc;
+   (void)argv;
+
+   CHECK(al_init());
+   CHECK(al_init_image_addon());
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+   test_round_trip(false, ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1);
+   test_round_trip(true, ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5);
+   test_lock_compressed();
+
+   printf("test_dds: OK\n");
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -175,6 +175,57 @@ static ALLEGRO_BITMAP *load_relative_bitmap(char const *filename, int flags)
    return bmp;
 }
 
+static ALLEGRO_BITMAP *load_relative_bitmap_region(char const *filename,
+   int x, int y, int w, int h, int flags)
+{
+   ALLEGRO_BITMAP *bmp;
+
+   bmp = al_load_bitmap_region(filename, x, y, w, h, flags);
+   if (!bmp) {
+      fprintf(stderr, "test_driver: failed to load region of %s\n", filename);
+      bmp = create_fallback_bitmap();
+   }
+   return bmp;
+}
+
+static bool copy_image_row(const ALLEGRO_IMAGE_ROWS *rows, int row,
+   const unsigned char *pixels, void *extra)
+{
+   ALLEGRO_BITMAP **bmp = extra;
+   ALLEGRO_LOCKED_REGION *lr;
+
+   if (!*bmp) {
+      *bmp = al_create_bitmap(rows->width, rows->height);
+      if (!*bmp)
+         return false;
+   }
+
+   lr = al_lock_bitmap_region(*bmp, 0, row, rows->width, 1,
+      ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+   if (!lr)
+      return false;
+   memcpy(lr->data, pixels, rows->width * 4);
+   al_unlock_bitmap(*bmp);
+   return true;
+}
+
+/* Assembles a bitmap from the rows passed to the al_load_bitmap_rows
+ * callback.
+ */
+static ALLEGRO_BITMAP *load_relative_bitmap_rows(char const *filename,
+   int x, int y, int w, int h, int flags)
+{
+   ALLEGRO_BITMAP *bmp = NULL;
+
+   if (!al_load_bitmap_rows(filename, x, y, w, h, flags, copy_image_row,
+         &bmp) || !bmp) {
+      fprintf(stderr, "test_driver: failed to load rows of %s\n", filename);
+      al_destroy_bitmap(bmp);
+      bmp = create_fallback_bitmap();
+   }
+   return bmp;
+}
+
 static void load_bitmaps(ALLEGRO_CONFIG const *cfg, const char *section,
    BmpType bmp_type, int flags)
 {
@@ -1156,6 +1207,18 @@ static bool do_test(ALLEGRO_CONFIG *cfg, char const *testname,
          (*bmp) = load_relative_bitmap(V(0), get_load_bitmap_flag(V(1)));
          continue;
       }
+      if (SCANLVAL("al_load_bitmap_region", 6)) {
+         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(lval, bmp_type);
+         (*bmp) = load_relative_bitmap_region(V(0), I(1), I(2), I(3), I(4),
+            get_load_bitmap_flag(V(5)));
+         continue;
+      }
+      if (SCANLVAL("load_bitmap_rows", 6)) {
+         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(lval, bmp_type);
+         (*bmp) = load_relative_bitmap_rows(V(0), I(1), I(2), I(3), I(4),
+            get_load_bitmap_flag(V(5)));
+         continue;
+      }
       if (SCAN("al_save_bitmap", 2)) {
          if (!al_save_bitmap(V(0), B(1))) {
             fatal_error("failed to save %s", V(0));
@@ -0,0 +1,176 @@
+/*
+ *    Stress test for registering image handlers while other threads
+ *    identify and load images.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_image.h"
+
+/* Unlike assert, also checks in release builds. */
+#define CHECK(x) \
+   do { \
+      if (!(x)) { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+         abort(); \
+      } \
+   } while (0)
+
+#define NUM_REGISTERERS    2
+#define NUM_LOADERS        4
+#define NUM_EXTENSIONS     200
+#define NUM_LOADS          100
+
+static const char *bmp_path;
+static const char *junk_path;
+
+static bool never_identify(ALLEGRO_FILE *f)
+{
+   char c;
+   /* Read something, as a real identifier would. */
+   al_fread(f, &c, 1);
+   return false;
+}
+
+static ALLEGRO_BITMAP *never_load(ALLEGRO_FILE *f, int flags)
+{
+   (void)f;
+   (void)flags;
+   return NULL;
+}
+
+static void make_ext(char *ext, int thread, int i)
+{
+   sprintf(ext, ".stress%d_%d", thread, i);
+}
+
+static void *registerer(ALLEGRO_THREAD *thread, void *arg)
+{
+   int id = (int)(intptr_t)arg;
+   char ext[32];
+   int i;
+   (void)thread;
+
+   for (i = 0; i < NUM_EXTENSIONS; i++) {
+      make_ext(ext, id, i);
+      CHECK(al_register_bitmap_loader_f(ext, never_load));
+      CHECK(al_register_bitmap_identifier(ext, never_identify));
+   }
+
+   return NULL;
+}
+
+static void *loader(ALLEGRO_THREAD *thread, void *arg)
+{
+   const char *first_ext;
+   int i;
+   (void)thread;
+   (void)arg;
+
+   first_ext = al_identify_bitmap(bmp_path);
+   CHECK(first_ext && 0 == strcmp(first_ext, ".bmp"));
+
+   for (i = 0; i < NUM_LOADS; i++) {
+      ALLEGRO_BITMAP *bmp;
+      ALLEGRO_COLOR c;
+      const char *ext;
+      unsigned char r, g, b;
+
+      ext = al_identify_bitmap(bmp_path);
+      CHECK(ext && 0 == strcmp(ext, ".bmp"));
+      CHECK(al_identify_bitmap(junk_path) == NULL);
+
+      bmp = al_load_bitmap(bmp_path);
+      CHECK(bmp);
+      CHECK(al_get_bitmap_width(bmp) == 16);
+      c = al_get_pixel(bmp, 3, 5);
+      al_unmap_rgb(c, &r, &g, &b);
+      CHECK(r == 3 * 16 && g == 5 * 16 && b == 128);
+      al_destroy_bitmap(bmp);
+
+      /* Strings returned earlier must survive the table growing, so they
+       * may not move.
+       */
+      CHECK(ext == first_ext);
+      CHECK(0 == strcmp(first_ext, ".bmp"));
+   }
+
+   return NULL;
+}
+
+static void make_files(ALLEGRO_PATH **bmp, ALLEGRO_PATH **junk)
+{
+   ALLEGRO_BITMAP *b;
+   ALLEGRO_FILE *f;
+   char zeros[64];
+   int x, y;
+
+   b = al_create_bitmap(16, 16);
+   CHECK(b);
+   al_set_target_bitmap(b);
+   for (y = 0; y < 16; y++)
+      for (x = 0; x < 16; x++)
+         al_put_pixel(x, y, al_map_rgb(x * 16, y * 16, 128));
+
+   f = al_make_temp_file("test_image_threads_XXXXXX.bmp", bmp);
+   CHECK(f);
+   CHECK(al_save_bitmap_f(f, ".bmp", b));
+   al_fclose(f);
+   al_destroy_bitmap(b);
+
+   memset(zeros, 0, sizeof(zeros));
+   f = al_make_temp_file("test_image_threads_XXXXXX", junk);
+   CHECK(f);
+   al_fwrite(f, zeros, sizeof(zeros));
+   al_fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+   ALLEGRO_THREAD *threads[NUM_REGISTERERS + NUM_LOADERS];
+   ALLEGRO_PATH *bmp, *junk;
+   char ext[32];
+   int i, j;
+   (void)argc;
+   (void)argv;
+
+   CHECK(al_init());
+   CHECK(al_init_image_addon());
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+   make_files(&bmp, &junk);
+   bmp_path = al_path_cstr(bmp, ALLEGRO_NATIVE_PATH_SEP);
+   junk_path = al_path_cstr(junk, ALLEGRO_NATIVE_PATH_SEP);
+
+   for (i = 0; i < NUM_REGISTERERS; i++)
+      threads[i] = al_create_thread(registerer, (void *)(intptr_t)i);
+   for (; i < NUM_REGISTERERS + NUM_LOADERS; i++)
+      threads[i] = al_create_thread(loader, NULL);
+   for (i = 0; i < NUM_REGISTERERS + NUM_LOADERS; i++) {
+      CHECK(threads[i]);
+      al_start_thread(threads[i]);
+   }
+   for (i = 0; i < NUM_REGISTERERS + NUM_LOADERS; i++)
+      al_destroy_thread(threads[i]);
+
+   /* Every handler must have made it into the table. */
+   for (i = 0; i < NUM_REGISTERERS; i++) {
+      for (j = 0; j < NUM_EXTENSIONS; j++) {
+         make_ext(ext, i, j);
+         CHECK(al_register_bitmap_loader_f(ext, NULL));
+      }
+   }
+
+   al_remove_filename(bmp_path);
+   al_remove_filename(junk_path);
+   al_destroy_path(bmp);
+   al_destroy_path(junk);
+
+   printf("test_image_threads: OK\n");
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
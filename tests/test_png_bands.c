@@ -0,0 +1,143 @@
+/*
+ *    Tests that PNG files saved by the banded encoder load back the same as
+ *    those saved by libpng.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_image.h"
+
+/* Unlike assert, also checks in release builds. */
+#define CHECK(x) \
+   do { \
+      if (!(x)) { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+         abort(); \
+      } \
+   } while (0)
+
+/* Rows are 1201 bytes once filtered, so the 32 KiB deflate window reaches
+ * back only 27 rows and later bands are primed with part of the image.
+ */
+#define WIDTH        300
+#define HEIGHT       101
+
+static ALLEGRO_BITMAP *make_picture(void)
+{
+   ALLEGRO_BITMAP *bmp;
+   unsigned int r = 1;
+   int x, y;
+
+   bmp = al_create_bitmap(WIDTH, HEIGHT);
+   CHECK(bmp);
+   al_set_target_bitmap(bmp);
+   for (y = 0; y < HEIGHT; y++) {
+      for (x = 0; x < WIDTH; x++) {
+         /* Smooth areas compress well, noise exercises the literals. */
+         r = r * 1103515245u + 12345u;
+         if (y % 20 < 10)
+            al_put_pixel(x, y, al_map_rgba(x, y * 2, x ^ y, 255 - y));
+         else
+            al_put_pixel(x, y, al_map_rgba(r >> 24, r >> 16, r >> 8, r));
+      }
+   }
+   return bmp;
+}
+
+static ALLEGRO_BITMAP *save_and_load(ALLEGRO_BITMAP *bmp,
+   const char *band_rows, const char *level)
+{
+   ALLEGRO_CONFIG *cfg = al_get_system_config();
+   ALLEGRO_PATH *path;
+   ALLEGRO_BITMAP *loaded;
+   ALLEGRO_FILE *f;
+   const char *filename;
+
+   al_set_config_value(cfg, "image", "png_band_rows", band_rows);
+   al_set_config_value(cfg, "image", "png_compression_level", level);
+
+   f = al_make_temp_file("test_png_bands_XXXXXX.png", &path);
+   CHECK(f);
+   CHECK(al_save_bitmap_f(f, ".png", bmp));
+   al_fclose(f);
+
+   filename = al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP);
+   loaded = al_load_bitmap_flags(filename, ALLEGRO_NO_PREMULTIPLIED_ALPHA);
+   CHECK(loaded);
+   CHECK(al_get_bitmap_width(loaded) == WIDTH);
+   CHECK(al_get_bitmap_height(loaded) == HEIGHT);
+
+   al_remove_filename(filename);
+   al_destroy_path(path);
+   return loaded;
+}
+
+static bool same_pixels(ALLEGRO_BITMAP *a, ALLEGRO_BITMAP *b)
+{
+   ALLEGRO_LOCKED_REGION *la, *lb;
+   bool same = true;
+   int y;
+
+   la = al_lock_bitmap(a, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_READONLY);
+   lb = al_lock_bitmap(b, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_READONLY);
+   CHECK(la && lb);
+
+   for (y = 0; y < HEIGHT; y++) {
+      if (memcmp((char *)la->data + y * la->pitch,
+            (char *)lb->data + y * lb->pitch, WIDTH * 4) != 0)
+         same = false;
+   }
+
+   al_unlock_bitmap(a);
+   al_unlock_bitmap(b);
+   return same;
+}
+
+int main(int argc, char **argv)
+{
+   static const char *levels[] = {"none", "fastest", "default", "best"};
+   /* One band, bands inside the window, bands past it, and a short last
+    * band in each case.
+    */
+   static const char *band_rows[] = {"1", "7", "16", "50", "100"};
+   ALLEGRO_BITMAP *bmp, *serial, *banded;
+   int i, j;
+   (void)argc;
+   (void)argv;
+
+   CHECK(al_init());
+   CHECK(al_init_image_addon());
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+   al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE);
+
+   bmp = make_picture();
+
+   for (i = 0; i < (int)(sizeof(levels) / sizeof(levels[0])); i++) {
+      serial = save_and_load(bmp, "0", levels[i]);
+      CHECK(same_pixels(bmp, serial));
+
+      for (j = 0; j < (int)(sizeof(band_rows) / sizeof(band_rows[0])); j++) {
+         banded = save_and_load(bmp, band_rows[j], levels[i]);
+         if (!same_pixels(serial, banded)) {
+            fprintf(stderr, "level %s, %s rows per band: pixels differ\n",
+               levels[i], band_rows[j]);
+            abort();
+         }
+         al_destroy_bitmap(banded);
+      }
+
+      al_destroy_bitmap(serial);
+   }
+
+   al_destroy_bitmap(bmp);
+
+   printf("test_png_bands: OK\n");
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -0,0 +1,196 @@
+/*
+ *    Tests reading image dimensions and formats with al_probe_bitmap.
+ *
+ *    Run from the tests directory, or the tests directory of the build.
+ */
+
+#define ALLEGRO_UNSTABLE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_image.h"
+
+/* Unlike assert, also checks in release builds. */
+#define CHECK(x) \
+   do { \
+      if (!(x)) { \
+         fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+         abort(); \
+      } \
+   } while (0)
+
+typedef struct PROBE_TEST {
+   const char *filename;
+   int width;
+   int height;
+   int channels;
+   int bit_depth;
+} PROBE_TEST;
+
+static const PROBE_TEST tests[] = {
+   {"data/bmp_1.bmp",                  22,  12, 3, 1},
+   {"data/bmp_2.bmp",                  22,  12, 3, 2},
+   {"data/bmp_4.bmp",                  22,  12, 3, 4},
+   {"data/bmp_4_rle.bmp",              22,  12, 3, 4},
+   {"data/bmp_8.bmp",                  22,  12, 3, 8},
+   {"data/bmp_8_os2.bmp",              22,  12, 3, 8},
+   {"data/bmp_8_rle.bmp",              22,  12, 3, 8},
+   {"data/bmp_16_555.bmp",             22,  12, 3, 16},
+   {"data/bmp_16_565.bmp",             22,  12, 3, 16},
+   {"data/bmp_16_1555.bmp",            22,  12, 4, 16},
+   {"data/bmp_24.bmp",                 22,  12, 3, 24},
+   {"data/bmp_24_top_down.bmp",        22,  12, 3, 24},
+   {"data/bmp_32_argb.bmp",            22,  12, 4, 32},
+   {"data/bmp_32_bitfields.bmp",       22,  12, 4, 32},
+   {"data/bmp_32_rgba.bmp",            22,  12, 4, 32},
+   {"data/bmp_32_xrgb.bmp",            22,  12, 4, 32},
+   {"data/pcx_8.pcx",                  22,  12, 3, 8},
+   {"data/pcx_24.pcx",                 22,  12, 3, 24},
+   {"data/ref_rgb.png",                22,  12, 3, 24},
+   {"data/ref_rgba.png",               22,  12, 4, 32},
+   {"data/tga_8_cmap.tga",             22,  12, 3, 8},
+   {"data/tga_8_cmap_rle.tga",         22,  12, 3, 8},
+   {"data/tga_8_grey.tga",             22,  12, 1, 8},
+   {"data/tga_8_grey_rle.tga",         22,  12, 1, 8},
+   {"data/tga_16.tga",                 22,  12, 3, 16},
+   {"data/tga_16_rle.tga",             22,  12, 3, 16},
+   {"data/tga_24.tga",                 22,  12, 3, 24},
+   {"data/tga_24_rle.tga",             22,  12, 3, 24},
+   {"data/tga_24_top_down.tga",        22,  12, 3, 24},
+   {"data/tga_32.tga",                 22,  12, 4, 32},
+   {"data/tga_32_rle.tga",             22,  12, 4, 32},
+   {"../examples/data/alexlogo.png",   128, 128, 3, 8},
+   {"../examples/data/icon.png",       48,  48,  4, 4},
+   {"../examples/data/mysha_pal.png",  320, 200, 4, 8},
+   {"../examples/data/obp.jpg",        532, 416, 3, 24},
+   {"../examples/data/mysha256x256.webp", 256, 256, 4, 32},
+   {"../examples/data/mysha_dxt1.dds", 320, 200, 4, 4},
+   {"../examples/data/mysha_dxt3.dds", 320, 200, 4, 8},
+   {"../examples/data/mysha_dxt5.dds", 320, 200, 4, 8}
+};
+
+static void test_files(void)
+{
+   ALLEGRO_IMAGE_INFO info;
+   ALLEGRO_BITMAP *bmp;
+   unsigned i;
+
+   for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+      const PROBE_TEST *t = &tests[i];
+
+      memset(&info, 0, sizeof(info));
+      if (!al_probe_bitmap(t->filename, &info)) {
+         fprintf(stderr, "%s: probe failed\n", t->filename);
+         abort();
+      }
+      if (info.width != t->width || info.height != t->height ||
+            info.channels != t->channels || info.bit_depth != t->bit_depth) {
+         fprintf(stderr, "%s: got %dx%d, %d channels, %d bits\n",
+            t->filename, info.width, info.height, info.channels,
+            info.bit_depth);
+         abort();
+      }
+
+      /* The loader may not be built in, but when it is it must agree. */
+      bmp = al_load_bitmap(t->filename);
+      if (bmp) {
+         CHECK(al_get_bitmap_width(bmp) == info.width);
+         CHECK(al_get_bitmap_height(bmp) == info.height);
+         al_destroy_bitmap(bmp);
+      }
+   }
+}
+
+static void test_file_position(void)
+{
+   ALLEGRO_IMAGE_INFO info;
+   ALLEGRO_FILE *f;
+
+   f = al_fopen("data/tga_24.tga", "rb");
+   CHECK(f);
+
+   /* The identified type takes precedence over the ident. */
+   CHECK(al_probe_bitmap_f(f, ".png", &info));
+   CHECK(info.width == 22 && info.height == 12);
+   CHECK(al_ftell(f) == 0);
+
+   /* The prober starts at the current position and returns to it. */
+   CHECK(al_fseek(f, 5, ALLEGRO_SEEK_SET));
+   CHECK(!al_probe_bitmap_f(f, ".tga", &info));
+   CHECK(al_ftell(f) == 5);
+
+   al_fclose(f);
+}
+
+static bool probe_data(const void *data, size_t size, const char *ident,
+   ALLEGRO_IMAGE_INFO *info)
+{
+   ALLEGRO_PATH *path;
+   ALLEGRO_FILE *f;
+   const char *filename;
+   bool ret;
+
+   f = al_make_temp_file("test_probe_XXXXXX", &path);
+   CHECK(f);
+   CHECK(al_fwrite(f, data, size) == size);
+   al_fclose(f);
+
+   filename = al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP);
+   f = al_fopen(filename, "rb");
+   CHECK(f);
+   ret = al_probe_bitmap_f(f, ident, info);
+   al_fclose(f);
+
+   al_remove_filename(filename);
+   al_destroy_path(path);
+   return ret;
+}
+
+static void test_bad_headers(void)
+{
+   ALLEGRO_IMAGE_INFO info;
+   unsigned char tga[18 + 4];
+   static const char junk[] = "This is not an image, but it is long enough.";
+
+   /* An uncompressed 24-bit 1x1 TGA. */
+   memset(tga, 0, sizeof(tga));
+   tga[2] = 2;
+   tga[12] = 1;
+   tga[14] = 1;
+   tga[16] = 24;
+   CHECK(probe_data(tga, sizeof(tga), ".tga", &info));
+   CHECK(info.width == 1 && info.height == 1);
+
+   tga[12] = 0;
+   CHECK(!probe_data(tga, sizeof(tga), ".tga", &info));
+   tga[12] = 1;
+   tga[14] = 0;
+   CHECK(!probe_data(tga, sizeof(tga), ".tga", &info));
+
+   CHECK(!probe_data(junk, sizeof(junk), ".bmp", &info));
+   CHECK(!probe_data(junk, sizeof(junk), ".png", &info));
+   CHECK(!probe_data(junk, sizeof(junk), ".xyz", &info));
+   CHECK(!probe_data(junk, sizeof(junk), NULL, &info));
+   CHECK(!al_probe_bitmap("data/does_not_exist.png", &info));
+}
+
+int main(int argc, char **argv)
+{
+   (void)argc;
+   (void)argv;
+
+   CHECK(al_init());
+   CHECK(al_init_image_addon());
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+   test_files();
+   test_file_position();
+   test_bad_headers();
+
+   printf("test_probe: OK\n");
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */